@@ -907,6 +907,8 @@ bool SimpleOutput::StartStreaming(obs_service_t *service)
 	const char *dbrPresetString = config_get_string(
 		main->Config(), "Output", "DynamicBitratePreset");
 	int dbrPreset = dbrPresetString == "Fast" ? 1 : 0;
+	const char *dbrController = config_get_string(
+		main->Config(), "Output", "DynamicBitrateController");
 	OBSDataAutoRelease settings = obs_data_create();
 	obs_data_set_string(settings, "bind_ip", bindIP);
 	obs_data_set_bool(settings, "new_socket_loop_enabled",
@@ -915,6 +917,7 @@ bool SimpleOutput::StartStreaming(obs_service_t *service)
 			  enableLowLatencyMode);
 	obs_data_set_bool(settings, "dyn_bitrate", enableDynBitrate);
 	obs_data_set_int(settings, "dyn_bitrate_preset", dbrPreset);
+	obs_data_set_string(settings, "dyn_bitrate_controller", dbrController);
 	obs_output_update(streamOutput, settings);
 
 	if (!reconnect)
@@ -1801,6 +1804,8 @@ bool AdvancedOutput::StartStreaming(obs_service_t *service)
 	const char *dbrPresetString = config_get_string(
 		main->Config(), "Output", "DynamicBitratePreset");
 	int dbrPreset = dbrPresetString == "Fast" ? 1 : 0;
+	const char *dbrController = config_get_string(
+		main->Config(), "Output", "DynamicBitrateController");
 	OBSDataAutoRelease settings = obs_data_create();
 	obs_data_set_string(settings, "bind_ip", bindIP);
 	obs_data_set_bool(settings, "new_socket_loop_enabled",
@@ -1809,6 +1814,7 @@ bool AdvancedOutput::StartStreaming(obs_service_t *service)
 			  enableLowLatencyMode);
 	obs_data_set_bool(settings, "dyn_bitrate", enableDynBitrate);
 	obs_data_set_int(settings, "dyn_bitrate_preset", dbrPreset);
+	obs_data_set_string(settings, "dyn_bitrate_controller", dbrController);
 	obs_output_update(streamOutput, settings);
 
 	if (!reconnect)
@@ -1502,6 +1502,8 @@ bool OBSBasic::InitBasicConfigDefaults()
 	config_set_default_bool(basicConfig, "Output", "DynamicBitrate", false);
 	config_set_default_string(basicConfig, "Output", "DynamicBitratePreset",
 				  "Fast");
+	config_set_default_string(basicConfig, "Output",
+				  "DynamicBitrateController", "default");
 
 	int i = 0;
 	uint32_t scale_cx = cx;
@@ -567,6 +567,7 @@ OBSBasicSettings::OBSBasicSettings(QWidget *parent)
 	HookWidget(ui->autoRemux,            CHECK_CHANGED,  ADV_CHANGED);
 	HookWidget(ui->dynBitrate,           CHECK_CHANGED,  ADV_CHANGED);
 	HookWidget(ui->dbrPresets,           COMBO_CHANGED,  ADV_CHANGED);
+	HookWidget(ui->dbrController,        COMBO_CHANGED,  ADV_CHANGED);
 	/* clang-format on */
 
 #define ADD_HOTKEY_FOCUS_TYPE(s)      \
@@ -839,6 +840,17 @@ OBSBasicSettings::OBSBasicSettings(QWidget *parent)
 		ui->bindToIP->addItem(QT_UTF8(name), val);
 	}
 
+	// Get Dynamic Bitrate Controllers
+	p = obs_properties_get(ppts, "dyn_bitrate_controller");
+
+	count = obs_property_list_item_count(p);
+	for (size_t i = 0; i < count; i++) {
+		const char *name = obs_property_list_item_name(p, i);
+		const char *val = obs_property_list_item_string(p, i);
+
+		ui->dbrController->addItem(QT_UTF8(name), val);
+	}
+
 	obs_properties_destroy(ppts);
 
 	InitStreamPage();
@@ -2679,6 +2691,11 @@ void OBSBasicSettings::LoadAdvancedSettings()
 		ui->dbrPresets->setCurrentIndex(1);
 	ui->dbrPresets->setHidden(!dynBitrate);
 	ui->label_68->setHidden(!dynBitrate);
+	const char *dbrController = config_get_string(
+		main->Config(), "Output", "DynamicBitrateController");
+	SetComboByValue(ui->dbrController, dbrController);
+	ui->dbrController->setHidden(!dynBitrate);
+	ui->dbrControllerLabel->setHidden(!dynBitrate);
 
 	bool confirmOnExit =
 		config_get_bool(GetGlobalConfig(), "General", "ConfirmOnExit");
@@ -3465,6 +3482,7 @@ void OBSBasicSettings::SaveAdvancedSettings()
 	if (WidgetChanged(ui->dbrPresets))
 		config_set_string(main->Config(), "Output",
 				  "DynamicBitratePreset", dbrPresetsSetup);
+	SaveComboData(ui->dbrController, "Output", "DynamicBitrateController");
 
 	if (obs_audio_monitoring_available()) {
 		QString newDevice =
@@ -4279,6 +4297,8 @@ void OBSBasicSettings::on_dynBitrate_stateChanged(int state)
 	bool isChecked = state == 0 ? false : true;
 	ui->dbrPresets->setHidden(!isChecked);
 	ui->label_68->setHidden(!isChecked);
+	ui->dbrController->setHidden(!isChecked);
+	ui->dbrControllerLabel->setHidden(!isChecked);
 }
 
 #define INVALID_RES_STR "Basic.Settings.Video.InvalidResolution"
@@ -26,3 +26,22 @@ void audio_monitor_destroy(struct audio_monitor *monitor)
 {
 	UNUSED_PARAMETER(monitor);
 }
+
+struct audio_monitor *audio_monitor_create_track(size_t mix_idx)
+{
+	UNUSED_PARAMETER(mix_idx);
+	return NULL;
+}
+
+void audio_monitor_output_track(struct audio_monitor *monitor,
+				const struct audio_data *data)
+{
+	UNUSED_PARAMETER(monitor);
+	UNUSED_PARAMETER(data);
+}
+
+uint64_t audio_monitor_get_latency(const struct audio_monitor *monitor)
+{
+	UNUSED_PARAMETER(monitor);
+	return 0;
+}
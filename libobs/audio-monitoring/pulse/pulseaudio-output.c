@@ -4,6 +4,10 @@
 #define PULSE_DATA(voidptr) struct audio_monitor *data = voidptr;
 #define blog(level, msg, ...) blog(level, "pulse-am: " msg, ##__VA_ARGS__)
 
+/* track monitors start at twice their minimum buffer size, and try to
+ * shrink back towards it after this long without an underflow */
+#define TRACK_LATENCY_SHRINK_INTERVAL 10000000000ULL
+
 struct audio_monitor {
 	obs_source_t *source;
 	pa_stream *stream;
@@ -24,6 +28,18 @@ struct audio_monitor {
 
 	bool ignore;
 	pthread_mutex_t playback_mutex;
+
+	/* track monitoring.  the audio thread only queues the mix into
+	 * new_data, the stream is written from write_queue so that the audio
+	 * thread never waits for the pulse mainloop */
+	bool track;
+	size_t mix_idx;
+	uint32_t min_tlength;
+	uint64_t last_underflow_ts;
+	volatile long latency_us;
+	os_task_queue_t *write_queue;
+	volatile bool write_queued;
+	DARRAY(uint8_t) write_buf;
 };
 
 static enum speaker_layout
@@ -368,11 +384,11 @@ static void do_stream_write(void *param)
 	}
 }
 
-static void on_audio_playback(void *param, obs_source_t *source,
-			      const struct audio_data *audio_data, bool muted)
+/* must be called with playback_mutex held */
+static void push_audio(struct audio_monitor *monitor,
+		       const struct audio_data *audio_data, bool muted,
+		       float vol)
 {
-	struct audio_monitor *monitor = param;
-	float vol = source->user_volume;
 	size_t bytes;
 
 	uint8_t *resample_data[MAX_AV_PLANES];
@@ -380,19 +396,13 @@ static void on_audio_playback(void *param, obs_source_t *source,
 	uint64_t ts_offset;
 	bool success;
 
-	if (pthread_mutex_trylock(&monitor->playback_mutex) != 0)
-		return;
-
-	if (os_atomic_load_long(&source->activate_refs) == 0)
-		goto unlock;
-
 	success = audio_resampler_resample(
 		monitor->resampler, resample_data, &resample_frames, &ts_offset,
 		(const uint8_t *const *)audio_data->data,
 		(uint32_t)audio_data->frames);
 
 	if (!success)
-		goto unlock;
+		return;
 
 	bytes = monitor->bytes_per_frame * resample_frames;
 
@@ -408,12 +418,121 @@ static void on_audio_playback(void *param, obs_source_t *source,
 	circlebuf_push_back(&monitor->new_data, resample_data[0], bytes);
 	monitor->packets++;
 	monitor->frames += resample_frames;
+}
+
+static void on_audio_playback(void *param, obs_source_t *source,
+			      const struct audio_data *audio_data, bool muted)
+{
+	struct audio_monitor *monitor = param;
+
+	if (pthread_mutex_trylock(&monitor->playback_mutex) != 0)
+		return;
+
+	if (os_atomic_load_long(&source->activate_refs) != 0)
+		push_audio(monitor, audio_data, muted, source->user_volume);
 
-unlock:
 	pthread_mutex_unlock(&monitor->playback_mutex);
 	do_stream_write(param);
 }
 
+/* lowers the buffer size again after a while without underflows, and
+ * measures the current delay: data still queued here plus the stream
+ * latency reported by the server */
+static void update_track_latency(struct audio_monitor *monitor,
+				 size_t queued_bytes)
+{
+	uint64_t now = os_gettime_ns();
+	pa_usec_t usec = 0;
+	int negative = 0;
+	int ret;
+
+	pulseaudio_lock();
+
+	if (monitor->attr.tlength > monitor->min_tlength &&
+	    now - monitor->last_underflow_ts > TRACK_LATENCY_SHRINK_INTERVAL) {
+		uint32_t tlength = monitor->attr.tlength * 3 / 4;
+		if (tlength < monitor->min_tlength)
+			tlength = monitor->min_tlength;
+
+		monitor->attr.tlength = tlength;
+		pa_stream_set_buffer_attr(monitor->stream, &monitor->attr, NULL,
+					  NULL);
+		monitor->last_underflow_ts = now;
+	}
+
+	ret = pa_stream_get_latency(monitor->stream, &usec, &negative);
+
+	pulseaudio_unlock();
+
+	if (ret < 0)
+		return;
+	if (negative)
+		usec = 0;
+
+	uint64_t queued_frames = queued_bytes / monitor->bytes_per_frame;
+	usec += util_mul_div64(queued_frames, 1000000ULL,
+			       monitor->samples_per_sec);
+	os_atomic_set_long(&monitor->latency_us, (long)usec);
+}
+
+static void track_stream_write(void *param)
+{
+	struct audio_monitor *monitor = param;
+	size_t queued_bytes;
+	size_t bytes;
+
+	os_atomic_set_bool(&monitor->write_queued, false);
+
+	pthread_mutex_lock(&monitor->playback_mutex);
+	bytes = monitor->new_data.size;
+	if (bytes > monitor->bytesRemaining)
+		bytes = monitor->bytesRemaining;
+
+	da_resize(monitor->write_buf, bytes);
+	circlebuf_pop_front(&monitor->new_data, monitor->write_buf.array,
+			    bytes);
+	monitor->bytesRemaining -= bytes;
+	queued_bytes = monitor->new_data.size;
+	pthread_mutex_unlock(&monitor->playback_mutex);
+
+	if (bytes) {
+		pulseaudio_lock();
+		pa_stream_write(monitor->stream, monitor->write_buf.array,
+				bytes, NULL, 0LL, PA_SEEK_RELATIVE);
+		pulseaudio_unlock();
+	}
+
+	update_track_latency(monitor, queued_bytes);
+}
+
+static inline void queue_track_stream_write(struct audio_monitor *monitor)
+{
+	if (!os_atomic_exchange_bool(&monitor->write_queued, true))
+		os_task_queue_queue_task(monitor->write_queue,
+					 track_stream_write, monitor);
+}
+
+void audio_monitor_output_track(struct audio_monitor *monitor,
+				const struct audio_data *audio_data)
+{
+	if (!monitor || !monitor->track || !monitor->stream)
+		return;
+	if (pthread_mutex_trylock(&monitor->playback_mutex) != 0)
+		return;
+
+	push_audio(monitor, audio_data, false, 1.0f);
+
+	pthread_mutex_unlock(&monitor->playback_mutex);
+	queue_track_stream_write(monitor);
+}
+
+uint64_t audio_monitor_get_latency(const struct audio_monitor *monitor)
+{
+	return monitor ? (uint64_t)os_atomic_load_long(&monitor->latency_us) *
+				 1000ULL
+		       : 0;
+}
+
 static void pulseaudio_stream_write(pa_stream *p, size_t nbytes, void *userdata)
 {
 	UNUSED_PARAMETER(p);
@@ -423,6 +542,9 @@ static void pulseaudio_stream_write(pa_stream *p, size_t nbytes, void *userdata)
 	data->bytesRemaining += nbytes;
 	pthread_mutex_unlock(&data->playback_mutex);
 
+	if (data->track)
+		queue_track_stream_write(data);
+
 	pulseaudio_signal(0);
 }
 
@@ -438,7 +560,9 @@ static void pulseaudio_underflow(pa_stream *p, void *userdata)
 	uint64_t latency = pa_bytes_to_usec(data->attr.tlength, &spec);
 
 	pthread_mutex_lock(&data->playback_mutex);
-	if (obs_source_active(data->source) && latency < 1000000) {
+	data->last_underflow_ts = os_gettime_ns();
+	if ((data->track || obs_source_active(data->source)) &&
+	    latency < 1000000) {
 		data->attr.fragsize = (uint32_t)-1;
 		data->attr.maxlength = (uint32_t)-1;
 		data->attr.prebuf = (uint32_t)-1;
@@ -540,6 +664,10 @@ static void pulseaudio_stop_playback(struct audio_monitor *monitor)
 	blog(LOG_INFO,
 	     "Got %" PRIuFAST32 " packets with %" PRIuFAST64 " frames",
 	     monitor->packets, monitor->frames);
+	if (monitor->track)
+		blog(LOG_INFO, "Track %d monitor latency was %ld ms",
+		     (int)monitor->mix_idx + 1,
+		     os_atomic_load_long(&monitor->latency_us) / 1000);
 
 	monitor->packets = 0;
 	monitor->frames = 0;
@@ -556,7 +684,8 @@ static bool audio_monitor_init(struct audio_monitor *monitor,
 	if (!id)
 		return false;
 
-	if (source->info.output_flags & OBS_SOURCE_DO_NOT_SELF_MONITOR) {
+	if (source &&
+	    (source->info.output_flags & OBS_SOURCE_DO_NOT_SELF_MONITOR)) {
 		obs_data_t *s = obs_source_get_settings(source);
 		const char *s_dev_id = obs_data_get_string(s, "device_id");
 		bool match = devices_match(s_dev_id, id);
@@ -631,8 +760,13 @@ static bool audio_monitor_init(struct audio_monitor *monitor,
 
 	pa_channel_map channel_map = pulseaudio_channel_map(monitor->speakers);
 
+	char track_name[32];
+	snprintf(track_name, sizeof(track_name), "Track %d",
+		 (int)monitor->mix_idx + 1);
+
 	monitor->stream = pulseaudio_stream_new(
-		obs_source_get_name(monitor->source), &spec, &channel_map);
+		source ? obs_source_get_name(source) : track_name, &spec,
+		&channel_map);
 	if (!monitor->stream) {
 		blog(LOG_ERROR, "Unable to create stream");
 		return false;
@@ -647,6 +781,28 @@ static bool audio_monitor_init(struct audio_monitor *monitor,
 	pa_stream_flags_t flags = PA_STREAM_INTERPOLATE_TIMING |
 				  PA_STREAM_AUTO_TIMING_UPDATE;
 
+	if (monitor->track) {
+		/* the mix arrives once per engine period, so two periods is
+		 * the smallest buffer that can survive the audio thread's
+		 * scheduling jitter */
+		uint64_t period_us = util_mul_div64(
+			audio_output_get_frames(obs->audio.audio), 1000000ULL,
+			info->samples_per_sec);
+
+		monitor->min_tlength =
+			(uint32_t)pa_usec_to_bytes(period_us * 2, &spec);
+		monitor->attr.tlength = monitor->min_tlength * 2;
+		monitor->last_underflow_ts = os_gettime_ns();
+		flags |= PA_STREAM_ADJUST_LATENCY;
+
+		monitor->write_queue = os_task_queue_create();
+		if (!monitor->write_queue) {
+			blog(LOG_WARNING, "%s: %s", __FUNCTION__,
+			     "Failed to create write queue");
+			return false;
+		}
+	}
+
 	if (pthread_mutex_init(&monitor->playback_mutex, NULL) != 0) {
 		blog(LOG_WARNING, "%s: %s", __FUNCTION__,
 		     "Failed to init mutex");
@@ -672,8 +828,9 @@ static void audio_monitor_init_final(struct audio_monitor *monitor)
 	if (monitor->ignore)
 		return;
 
-	obs_source_add_audio_capture_callback(monitor->source,
-					      on_audio_playback, monitor);
+	if (!monitor->track)
+		obs_source_add_audio_capture_callback(
+			monitor->source, on_audio_playback, monitor);
 
 	pulseaudio_write_callback(monitor->stream, pulseaudio_stream_write,
 				  (void *)monitor);
@@ -691,6 +848,16 @@ static inline void audio_monitor_free(struct audio_monitor *monitor)
 		obs_source_remove_audio_capture_callback(
 			monitor->source, on_audio_playback, monitor);
 
+	/* the write callback queues writes too, so detach it before draining
+	 * the queue, while the stream is still valid */
+	if (monitor->write_queue) {
+		if (monitor->stream)
+			pulseaudio_write_callback(monitor->stream, NULL, NULL);
+		os_task_queue_destroy(monitor->write_queue);
+		monitor->write_queue = NULL;
+	}
+	da_free(monitor->write_buf);
+
 	audio_resampler_destroy(monitor->resampler);
 	circlebuf_free(&monitor->new_data);
 
@@ -729,6 +896,9 @@ void audio_monitor_reset(struct audio_monitor *monitor)
 	bool success;
 	audio_monitor_free(monitor);
 
+	new_monitor.track = monitor->track;
+	new_monitor.mix_idx = monitor->mix_idx;
+
 	pthread_mutex_lock(&monitor->playback_mutex);
 	success = audio_monitor_init(&new_monitor, monitor->source);
 	pthread_mutex_unlock(&monitor->playback_mutex);
@@ -741,6 +911,31 @@ void audio_monitor_reset(struct audio_monitor *monitor)
 	}
 }
 
+struct audio_monitor *audio_monitor_create_track(size_t mix_idx)
+{
+	struct audio_monitor monitor = {0};
+	struct audio_monitor *out;
+
+	monitor.track = true;
+	monitor.mix_idx = mix_idx;
+
+	if (!audio_monitor_init(&monitor, NULL))
+		goto fail;
+
+	out = bmemdup(&monitor, sizeof(monitor));
+
+	pthread_mutex_lock(&obs->audio.monitoring_mutex);
+	da_push_back(obs->audio.monitors, &out);
+	pthread_mutex_unlock(&obs->audio.monitoring_mutex);
+
+	audio_monitor_init_final(out);
+	return out;
+
+fail:
+	audio_monitor_free(&monitor);
+	return NULL;
+}
+
 void audio_monitor_destroy(struct audio_monitor *monitor)
 {
 	if (monitor) {
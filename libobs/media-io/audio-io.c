@@ -58,7 +58,7 @@ static inline void audio_input_free(struct audio_input *input)
 
 struct audio_mix {
 	DARRAY(struct audio_input) inputs;
-	float buffer[MAX_AUDIO_CHANNELS][AUDIO_OUTPUT_FRAMES];
+	float *buffer[MAX_AUDIO_CHANNELS];
 };
 
 struct audio_output {
@@ -75,7 +75,8 @@ struct audio_output {
 	audio_input_callback_t input_cb;
 	void *input_param;
 	pthread_mutex_t input_mutex;
-	struct audio_mix mixes[MAX_AUDIO_MIXES];
+	float *mix_data;
+	struct audio_mix mixes[MAX_AUDIO_TRACKS];
 };
 
 /* ------------------------------------------------------------------------- */
@@ -132,7 +133,7 @@ static inline void clamp_audio_output(struct audio_output *audio, size_t bytes)
 {
 	size_t float_size = bytes / sizeof(float);
 
-	for (size_t mix_idx = 0; mix_idx < MAX_AUDIO_MIXES; mix_idx++) {
+	for (size_t mix_idx = 0; mix_idx < audio->info.mixes; mix_idx++) {
 		struct audio_mix *mix = &audio->mixes[mix_idx];
 
 		/* do not process mixing if a specific mix is inactive */
@@ -156,8 +157,8 @@ static inline void clamp_audio_output(struct audio_output *audio, size_t bytes)
 static void input_and_output(struct audio_output *audio, uint64_t audio_time,
 			     uint64_t prev_time)
 {
-	size_t bytes = AUDIO_OUTPUT_FRAMES * audio->block_size;
-	struct audio_output_data data[MAX_AUDIO_MIXES];
+	size_t bytes = audio->info.frames * audio->block_size;
+	struct audio_output_data data[MAX_AUDIO_TRACKS];
 	uint32_t active_mixes = 0;
 	uint64_t new_ts = 0;
 	bool success;
@@ -171,19 +172,19 @@ static void input_and_output(struct audio_output *audio, uint64_t audio_time,
 
 	/* get mixers */
 	pthread_mutex_lock(&audio->input_mutex);
-	for (size_t i = 0; i < MAX_AUDIO_MIXES; i++) {
-		active_mixes |= (1 << i);
+	for (size_t i = 0; i < audio->info.mixes; i++) {
+		active_mixes |= (1U << i);
 	}
 	pthread_mutex_unlock(&audio->input_mutex);
 
 	/* clear mix buffers */
-	for (size_t mix_idx = 0; mix_idx < MAX_AUDIO_MIXES; mix_idx++) {
+	for (size_t mix_idx = 0; mix_idx < audio->info.mixes; mix_idx++) {
 		struct audio_mix *mix = &audio->mixes[mix_idx];
 
-		memset(mix->buffer, 0, sizeof(mix->buffer));
-
-		for (size_t i = 0; i < audio->planes; i++)
+		for (size_t i = 0; i < audio->planes; i++) {
+			memset(mix->buffer[i], 0, bytes);
 			data[mix_idx].data[i] = mix->buffer[i];
+		}
 	}
 
 	/* get new audio data */
@@ -196,8 +197,8 @@ static void input_and_output(struct audio_output *audio, uint64_t audio_time,
 	clamp_audio_output(audio, bytes);
 
 	/* output */
-	for (size_t i = 0; i < MAX_AUDIO_MIXES; i++)
-		do_audio_output(audio, i, new_ts, AUDIO_OUTPUT_FRAMES);
+	for (size_t i = 0; i < audio->info.mixes; i++)
+		do_audio_output(audio, i, new_ts, audio->info.frames);
 }
 
 static void *audio_thread(void *param)
@@ -209,13 +210,13 @@ static void *audio_thread(void *param)
 
 	struct audio_output *audio = param;
 	size_t rate = audio->info.samples_per_sec;
+	uint32_t frames = audio->info.frames;
 	uint64_t samples = 0;
 	uint64_t start_time = os_gettime_ns();
 	uint64_t prev_time = start_time;
 	uint64_t audio_time = prev_time;
 	uint32_t audio_wait_time =
-		(uint32_t)(audio_frames_to_ns(rate, AUDIO_OUTPUT_FRAMES) /
-			   1000000);
+		(uint32_t)(audio_frames_to_ns(rate, frames) / 1000000);
 
 	os_set_thread_name("audio-io: audio thread");
 
@@ -232,7 +233,7 @@ static void *audio_thread(void *param)
 
 		cur_time = os_gettime_ns();
 		while (audio_time <= cur_time) {
-			samples += AUDIO_OUTPUT_FRAMES;
+			samples += frames;
 			audio_time =
 				start_time + audio_frames_to_ns(rate, samples);
 
@@ -305,7 +306,7 @@ bool audio_output_connect(audio_t *audio, size_t mi,
 {
 	bool success = false;
 
-	if (!audio || mi >= MAX_AUDIO_MIXES)
+	if (!audio || mi >= audio->info.mixes)
 		return false;
 
 	pthread_mutex_lock(&audio->input_mutex);
@@ -346,7 +347,7 @@ bool audio_output_connect(audio_t *audio, size_t mi,
 void audio_output_disconnect(audio_t *audio, size_t mix_idx,
 			     audio_output_callback_t callback, void *param)
 {
-	if (!audio || mix_idx >= MAX_AUDIO_MIXES)
+	if (!audio || mix_idx >= audio->info.mixes)
 		return;
 
 	pthread_mutex_lock(&audio->input_mutex);
@@ -364,7 +365,9 @@ void audio_output_disconnect(audio_t *audio, size_t mix_idx,
 static inline bool valid_audio_params(const struct audio_output_info *info)
 {
 	return info->format && info->name && info->samples_per_sec > 0 &&
-	       info->speakers > 0;
+	       info->speakers > 0 && info->frames <= AUDIO_OUTPUT_FRAMES &&
+	       (!info->frames || info->frames >= AUDIO_OUTPUT_MIN_FRAMES) &&
+	       info->mixes <= MAX_AUDIO_TRACKS;
 }
 
 int audio_output_open(audio_t **audio, struct audio_output_info *info)
@@ -380,8 +383,24 @@ int audio_output_open(audio_t **audio, struct audio_output_info *info)
 		goto fail0;
 
 	memcpy(&out->info, info, sizeof(struct audio_output_info));
+	if (!out->info.frames)
+		out->info.frames = AUDIO_OUTPUT_FRAMES;
+	if (!out->info.mixes)
+		out->info.mixes = MAX_AUDIO_MIXES;
 	out->channels = get_audio_channels(info->speakers);
 	out->planes = planar ? out->channels : 1;
+
+	/* only the mixes in use get buffers */
+	out->mix_data = bmalloc(out->info.mixes * out->planes *
+				AUDIO_OUTPUT_FRAMES * sizeof(float));
+	for (size_t mix_idx = 0; mix_idx < out->info.mixes; mix_idx++) {
+		float *mix_data = out->mix_data + mix_idx * out->planes *
+							  AUDIO_OUTPUT_FRAMES;
+
+		for (size_t i = 0; i < out->planes; i++)
+			out->mixes[mix_idx].buffer[i] =
+				mix_data + i * AUDIO_OUTPUT_FRAMES;
+	}
 	out->input_cb = info->input_callback;
 	out->input_param = info->input_param;
 	out->block_size = (planar ? 1 : out->channels) *
@@ -421,7 +440,7 @@ void audio_output_close(audio_t *audio)
 		pthread_mutex_destroy(&audio->input_mutex);
 	}
 
-	for (size_t mix_idx = 0; mix_idx < MAX_AUDIO_MIXES; mix_idx++) {
+	for (size_t mix_idx = 0; mix_idx < MAX_AUDIO_TRACKS; mix_idx++) {
 		struct audio_mix *mix = &audio->mixes[mix_idx];
 
 		for (size_t i = 0; i < mix->inputs.num; i++)
@@ -429,6 +448,7 @@ void audio_output_close(audio_t *audio)
 
 		da_free(mix->inputs);
 	}
+	bfree(audio->mix_data);
 	bfree(audio);
 }
 
@@ -442,7 +462,7 @@ bool audio_output_active(const audio_t *audio)
 	if (!audio)
 		return false;
 
-	for (size_t mix_idx = 0; mix_idx < MAX_AUDIO_MIXES; mix_idx++) {
+	for (size_t mix_idx = 0; mix_idx < audio->info.mixes; mix_idx++) {
 		const struct audio_mix *mix = &audio->mixes[mix_idx];
 
 		if (mix->inputs.num != 0)
@@ -471,3 +491,13 @@ uint32_t audio_output_get_sample_rate(const audio_t *audio)
 {
 	return audio ? audio->info.samples_per_sec : 0;
 }
+
+uint32_t audio_output_get_frames(const audio_t *audio)
+{
+	return audio ? audio->info.frames : 0;
+}
+
+size_t audio_output_get_mixes(const audio_t *audio)
+{
+	return audio ? audio->info.mixes : 0;
+}
@@ -25,13 +25,17 @@
 extern "C" {
 #endif
 
+/* mixes (tracks) in public structs such as obs_source_audio_mix, and the
+ * default number of mixes.  changing it breaks the plugin ABI. */
 #define MAX_AUDIO_MIXES 6
+/* upper bound on the number of mixes audio-io and the core can run.  the
+ * number actually in use is audio_output_get_mixes(). */
+#define MAX_AUDIO_TRACKS 32
 #define MAX_AUDIO_CHANNELS 24
+/* maximum (and default) number of frames per audio tick.  the actual
+ * engine period is audio_output_get_frames() and can be smaller. */
 #define AUDIO_OUTPUT_FRAMES 1024
-
-#define TOTAL_AUDIO_SIZE                                              \
-	(MAX_AUDIO_MIXES * MAX_AUDIO_CHANNELS * AUDIO_OUTPUT_FRAMES * \
-	 sizeof(float))
+#define AUDIO_OUTPUT_MIN_FRAMES 64
 
 /*
  * Base audio output component.  Use this to create an audio output track
@@ -123,9 +127,14 @@ struct audio_output_info {
 	enum audio_format format;
 	enum speaker_layout speakers;
 
+	/* frames per tick, 0 for AUDIO_OUTPUT_FRAMES */
+	uint32_t frames;
+
+	/* number of mixes, up to MAX_AUDIO_TRACKS, 0 for MAX_AUDIO_MIXES */
+	uint32_t mixes;
+
 	audio_input_callback_t input_callback;
 	void *input_param;
-	struct audio_data audio_out;
 };
 
 struct audio_convert_info {
@@ -280,6 +289,8 @@ EXPORT size_t audio_output_get_block_size(const audio_t *audio);
 EXPORT size_t audio_output_get_planes(const audio_t *audio);
 EXPORT size_t audio_output_get_channels(const audio_t *audio);
 EXPORT uint32_t audio_output_get_sample_rate(const audio_t *audio);
+EXPORT uint32_t audio_output_get_frames(const audio_t *audio);
+EXPORT size_t audio_output_get_mixes(const audio_t *audio);
 EXPORT const struct audio_output_info *
 audio_output_get_info(const audio_t *audio);
 
@@ -0,0 +1,155 @@
+/******************************************************************************
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <string.h>
+
+#include "audio-mix.h"
+
+#include "../util/sse-intrin.h"
+
+/* destinations handled by one pass over a source plane */
+#define MAX_MIX_OPS_FUSED 8
+
+void audio_mix_accumulate(float *dst, const float *src, float gain,
+			  size_t frames)
+{
+	const __m128 gain_v = _mm_set1_ps(gain);
+	size_t i = 0;
+
+	/* two vectors per iteration to hide the add latency */
+	for (; i + 8 <= frames; i += 8) {
+		__m128 s0 = _mm_loadu_ps(src + i);
+		__m128 s1 = _mm_loadu_ps(src + i + 4);
+		__m128 d0 = _mm_loadu_ps(dst + i);
+		__m128 d1 = _mm_loadu_ps(dst + i + 4);
+
+		d0 = _mm_add_ps(d0, _mm_mul_ps(s0, gain_v));
+		d1 = _mm_add_ps(d1, _mm_mul_ps(s1, gain_v));
+
+		_mm_storeu_ps(dst + i, d0);
+		_mm_storeu_ps(dst + i + 4, d1);
+	}
+
+	for (; i + 4 <= frames; i += 4) {
+		__m128 d = _mm_loadu_ps(dst + i);
+		d = _mm_add_ps(d, _mm_mul_ps(_mm_loadu_ps(src + i), gain_v));
+		_mm_storeu_ps(dst + i, d);
+	}
+
+	for (; i < frames; i++)
+		dst[i] += src[i] * gain;
+}
+
+void audio_mix_apply_gain(float *data, float gain, size_t frames)
+{
+	if (gain == 1.0f)
+		return;
+
+	if (gain == 0.0f) {
+		memset(data, 0, frames * sizeof(float));
+		return;
+	}
+
+	const __m128 gain_v = _mm_set1_ps(gain);
+	size_t i = 0;
+
+	for (; i + 8 <= frames; i += 8) {
+		__m128 d0 = _mm_loadu_ps(data + i);
+		__m128 d1 = _mm_loadu_ps(data + i + 4);
+		_mm_storeu_ps(data + i, _mm_mul_ps(d0, gain_v));
+		_mm_storeu_ps(data + i + 4, _mm_mul_ps(d1, gain_v));
+	}
+
+	for (; i + 4 <= frames; i += 4)
+		_mm_storeu_ps(data + i,
+			      _mm_mul_ps(_mm_loadu_ps(data + i), gain_v));
+
+	for (; i < frames; i++)
+		data[i] *= gain;
+}
+
+/* dst += src * gain for every op, all of which read the same source plane.
+ * Each block of the source is loaded once and added to every destination
+ * while it is still in registers. */
+static void accumulate_fused(const struct audio_mix_op *ops, size_t num_ops,
+			     size_t frames)
+{
+	const float *src = ops[0].src;
+	__m128 gains[MAX_MIX_OPS_FUSED];
+	size_t i = 0;
+
+	for (size_t j = 0; j < num_ops; j++)
+		gains[j] = _mm_set1_ps(ops[j].gain);
+
+	for (; i + 16 <= frames; i += 16) {
+		__m128 s0 = _mm_loadu_ps(src + i);
+		__m128 s1 = _mm_loadu_ps(src + i + 4);
+		__m128 s2 = _mm_loadu_ps(src + i + 8);
+		__m128 s3 = _mm_loadu_ps(src + i + 12);
+
+		for (size_t j = 0; j < num_ops; j++) {
+			float *dst = ops[j].dst + i;
+			__m128 d0 = _mm_loadu_ps(dst);
+			__m128 d1 = _mm_loadu_ps(dst + 4);
+			__m128 d2 = _mm_loadu_ps(dst + 8);
+			__m128 d3 = _mm_loadu_ps(dst + 12);
+
+			d0 = _mm_add_ps(d0, _mm_mul_ps(s0, gains[j]));
+			d1 = _mm_add_ps(d1, _mm_mul_ps(s1, gains[j]));
+			d2 = _mm_add_ps(d2, _mm_mul_ps(s2, gains[j]));
+			d3 = _mm_add_ps(d3, _mm_mul_ps(s3, gains[j]));
+
+			_mm_storeu_ps(dst, d0);
+			_mm_storeu_ps(dst + 4, d1);
+			_mm_storeu_ps(dst + 8, d2);
+			_mm_storeu_ps(dst + 12, d3);
+		}
+	}
+
+	for (; i < frames; i++) {
+		float s = src[i];
+		for (size_t j = 0; j < num_ops; j++)
+			ops[j].dst[i] += s * ops[j].gain;
+	}
+}
+
+void audio_mix_accumulate_ops(const struct audio_mix_op *ops, size_t num_ops,
+			      size_t frames)
+{
+	struct audio_mix_op group[MAX_MIX_OPS_FUSED];
+	size_t i = 0;
+
+	while (i < num_ops) {
+		const float *src = ops[i].src;
+		size_t count = 0;
+
+		for (; i < num_ops && ops[i].src == src; i++) {
+			if (ops[i].gain == 0.0f)
+				continue;
+
+			group[count++] = ops[i];
+			if (count == MAX_MIX_OPS_FUSED) {
+				accumulate_fused(group, count, frames);
+				count = 0;
+			}
+		}
+
+		if (count == 1)
+			audio_mix_accumulate(group[0].dst, src, group[0].gain,
+					     frames);
+		else if (count)
+			accumulate_fused(group, count, frames);
+	}
+}
@@ -0,0 +1,54 @@
+/******************************************************************************
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "../util/c99defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Planar float mixing kernels used by the core audio thread.
+ *
+ * The vectorized paths go through util/sse-intrin.h, so they compile to SSE2
+ * on x86 and are translated to NEON by simde on ARM.  Buffers do not need to
+ * be aligned.
+ */
+
+struct audio_mix_op {
+	float *dst;
+	const float *src;
+	float gain;
+};
+
+/* dst[i] += src[i] * gain */
+EXPORT void audio_mix_accumulate(float *dst, const float *src, float gain,
+				 size_t frames);
+
+/* data[i] *= gain, with fast paths for unity and zero gain */
+EXPORT void audio_mix_apply_gain(float *data, float gain, size_t frames);
+
+/* Runs audio_mix_accumulate for every op in a single call.  Adjacent ops
+ * that read the same source plane are done in one pass, so the source is
+ * only read once for all of their destinations.  Ops with a zero gain are
+ * skipped entirely. */
+EXPORT void audio_mix_accumulate_ops(const struct audio_mix_op *ops,
+				     size_t num_ops, size_t frames);
+
+#ifdef __cplusplus
+}
+#endif
@@ -31,31 +31,175 @@
 
 extern profiler_name_store_t *obs_get_profiler_name_store(void);
 
-#define MAX_CONVERT_BUFFERS 3
 #define MAX_CACHE_SIZE 16
 
+/* ------------------------------------------------------------------------- */
+/* reference counted frame buffers                                           */
+
+struct video_buffer_pool;
+
+struct video_buffer {
+	struct video_frame frame;
+	volatile long refs;
+	struct video_buffer_pool *pool;
+};
+
+/* Buffers of one format and size.  Every buffer that is handed out holds a
+ * reference to its pool, so a pool outlives its owner for as long as someone
+ * still has one of its frames. */
+struct video_buffer_pool {
+	enum video_format format;
+	uint32_t width;
+	uint32_t height;
+
+	volatile long refs;
+	pthread_mutex_t mutex;
+	DARRAY(struct video_buffer *) free_buffers;
+};
+
+static struct video_buffer_pool *
+video_buffer_pool_create(enum video_format format, uint32_t width,
+			 uint32_t height)
+{
+	struct video_buffer_pool *pool;
+
+	pool = bzalloc(sizeof(struct video_buffer_pool));
+	pool->format = format;
+	pool->width = width;
+	pool->height = height;
+	pool->refs = 1;
+
+	if (pthread_mutex_init(&pool->mutex, NULL) != 0) {
+		bfree(pool);
+		return NULL;
+	}
+
+	return pool;
+}
+
+static void video_buffer_pool_release(struct video_buffer_pool *pool)
+{
+	if (!pool || os_atomic_dec_long(&pool->refs) != 0)
+		return;
+
+	for (size_t i = 0; i < pool->free_buffers.num; i++) {
+		struct video_buffer *buffer = pool->free_buffers.array[i];
+		video_frame_free(&buffer->frame);
+		bfree(buffer);
+	}
+
+	da_free(pool->free_buffers);
+	pthread_mutex_destroy(&pool->mutex);
+	bfree(pool);
+}
+
+static struct video_buffer *
+video_buffer_pool_get(struct video_buffer_pool *pool)
+{
+	struct video_buffer *buffer = NULL;
+
+	pthread_mutex_lock(&pool->mutex);
+	if (pool->free_buffers.num) {
+		buffer = pool->free_buffers.array[pool->free_buffers.num - 1];
+		da_pop_back(pool->free_buffers);
+	}
+	pthread_mutex_unlock(&pool->mutex);
+
+	if (!buffer) {
+		buffer = bzalloc(sizeof(struct video_buffer));
+		buffer->pool = pool;
+		video_frame_init(&buffer->frame, pool->format, pool->width,
+				 pool->height);
+	}
+
+	buffer->refs = 1;
+	os_atomic_inc_long(&pool->refs);
+	return buffer;
+}
+
+void video_buffer_addref(struct video_buffer *buffer)
+{
+	if (buffer)
+		os_atomic_inc_long(&buffer->refs);
+}
+
+void video_buffer_release(struct video_buffer *buffer)
+{
+	if (!buffer || os_atomic_dec_long(&buffer->refs) != 0)
+		return;
+
+	struct video_buffer_pool *pool = buffer->pool;
+
+	pthread_mutex_lock(&pool->mutex);
+	da_push_back(pool->free_buffers, &buffer);
+	pthread_mutex_unlock(&pool->mutex);
+
+	video_buffer_pool_release(pool);
+}
+
+static inline bool video_buffer_shared(struct video_buffer *buffer)
+{
+	return os_atomic_load_long(&buffer->refs) > 1;
+}
+
+/* video_data is public and cannot grow, so the buffer is kept next to it.
+ * Raw video callbacks get a pointer to the data member, which is what lets
+ * video_data_get_buffer() find the buffer. */
+struct buffered_frame {
+	struct video_data data;
+	struct video_buffer *buffer;
+};
+
+struct video_buffer *video_data_get_buffer(const struct video_data *frame)
+{
+	return frame ? ((const struct buffered_frame *)frame)->buffer : NULL;
+}
+
+static inline void set_video_buffer(struct buffered_frame *frame,
+				    struct video_buffer *buffer)
+{
+	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+		frame->data.data[i] = buffer->frame.data[i];
+		frame->data.linesize[i] = buffer->frame.linesize[i];
+	}
+
+	frame->buffer = buffer;
+}
+
+/* ------------------------------------------------------------------------- */
+
 struct cached_frame_info {
-	struct video_data frame;
+	struct buffered_frame frame;
 	int skipped;
 	int count;
 };
 
+/* Every input gets its own queue and thread, so a slow consumer only makes
+ * itself drop frames instead of holding up everyone else. */
 struct video_input {
 	struct video_scale_info conversion;
 	video_scaler_t *scaler;
-	struct video_frame frame[MAX_CONVERT_BUFFERS];
-	int cur_frame;
+	struct video_buffer_pool *pool;
 
 	void (*callback)(void *param, struct video_data *frame);
 	void *param;
-};
 
-static inline void video_input_free(struct video_input *input)
-{
-	for (size_t i = 0; i < MAX_CONVERT_BUFFERS; i++)
-		video_frame_free(&input->frame[i]);
-	video_scaler_destroy(input->scaler);
-}
+	pthread_t thread;
+	os_sem_t *queue_semaphore;
+	pthread_mutex_t queue_mutex;
+	volatile bool stop;
+	volatile bool free_on_exit;
+	bool initialized;
+	const char *profile_name;
+
+	struct buffered_frame queue[MAX_CACHE_SIZE];
+	size_t queue_size;
+	size_t queue_first;
+	size_t queue_num;
+
+	volatile long skipped_frames;
+	volatile long total_frames;
+};
 
 struct video_output {
 	struct video_output_info info;
@@ -72,12 +216,13 @@ struct video_output {
 	bool initialized;
 
 	pthread_mutex_t input_mutex;
-	DARRAY(struct video_input) inputs;
+	DARRAY(struct video_input *) inputs;
 
 	size_t available_frames;
 	size_t first_added;
 	size_t last_added;
 	struct cached_frame_info cache[MAX_CACHE_SIZE];
+	struct video_buffer_pool *pool;
 
 	volatile bool raw_active;
 	volatile long gpu_refs;
@@ -85,37 +230,148 @@ struct video_output {
 
 /* ------------------------------------------------------------------------- */
 
+/* on success, frame holds a reference to the frame the callback should get */
 static inline bool scale_video_output(struct video_input *input,
-				      struct video_data *data)
+				      struct buffered_frame *frame)
 {
 	bool success = true;
 
 	if (input->scaler) {
-		struct video_frame *frame;
+		struct video_buffer *buffer;
+		struct video_frame *output;
 
-		if (++input->cur_frame == MAX_CONVERT_BUFFERS)
-			input->cur_frame = 0;
+		buffer = video_buffer_pool_get(input->pool);
+		output = &buffer->frame;
 
-		frame = &input->frame[input->cur_frame];
-
-		success = video_scaler_scale(input->scaler, frame->data,
-					     frame->linesize,
-					     (const uint8_t *const *)data->data,
-					     data->linesize);
+		success = video_scaler_scale(
+			input->scaler, output->data, output->linesize,
+			(const uint8_t *const *)frame->data.data,
+			frame->data.linesize);
 
 		if (success) {
-			for (size_t i = 0; i < MAX_AV_PLANES; i++) {
-				data->data[i] = frame->data[i];
-				data->linesize[i] = frame->linesize[i];
-			}
+			set_video_buffer(frame, buffer);
 		} else {
 			blog(LOG_WARNING, "video-io: Could not scale frame!");
+			video_buffer_release(buffer);
 		}
+	} else {
+		video_buffer_addref(frame->buffer);
 	}
 
 	return success;
 }
 
+static void video_input_free(struct video_input *input)
+{
+	if (input->initialized) {
+		for (size_t i = 0; i < input->queue_num; i++) {
+			size_t idx = (input->queue_first + i) %
+				     input->queue_size;
+			video_buffer_release(input->queue[idx].buffer);
+		}
+
+		os_sem_destroy(input->queue_semaphore);
+		pthread_mutex_destroy(&input->queue_mutex);
+	}
+
+	video_buffer_pool_release(input->pool);
+	video_scaler_destroy(input->scaler);
+	bfree(input);
+}
+
+static void *input_thread(void *param)
+{
+	struct video_input *input = param;
+
+	os_set_thread_name("video-io: input thread");
+
+	while (os_sem_wait(input->queue_semaphore) == 0) {
+		struct buffered_frame frame;
+		struct buffered_frame scaled;
+
+		if (os_atomic_load_bool(&input->stop))
+			break;
+
+		pthread_mutex_lock(&input->queue_mutex);
+		frame = input->queue[input->queue_first];
+		if (++input->queue_first == input->queue_size)
+			input->queue_first = 0;
+		input->queue_num--;
+		pthread_mutex_unlock(&input->queue_mutex);
+
+		profile_start(input->profile_name);
+
+		scaled = frame;
+		if (scale_video_output(input, &scaled)) {
+			input->callback(input->param, &scaled.data);
+			video_buffer_release(scaled.buffer);
+		}
+
+		video_buffer_release(frame.buffer);
+
+		profile_end(input->profile_name);
+
+		profile_reenable_thread();
+	}
+
+	if (os_atomic_load_bool(&input->free_on_exit))
+		video_input_free(input);
+
+	return NULL;
+}
+
+static void video_input_destroy(struct video_input *input)
+{
+	if (!input)
+		return;
+
+	if (input->initialized) {
+		os_atomic_set_bool(&input->stop, true);
+
+		/* disconnected from inside its own callback (e.g. an encoder
+		 * stopping on an error), the thread frees the input itself
+		 * once the callback returns */
+		if (pthread_equal(pthread_self(), input->thread)) {
+			os_atomic_set_bool(&input->free_on_exit, true);
+			pthread_detach(input->thread);
+			os_sem_post(input->queue_semaphore);
+			return;
+		}
+
+		os_sem_post(input->queue_semaphore);
+		pthread_join(input->thread, NULL);
+	}
+
+	video_input_free(input);
+}
+
+/* an input whose queue is full skips the frame, that only counts against
+ * the input itself */
+static void video_input_push(struct video_input *input,
+			     const struct buffered_frame *frame)
+{
+	bool pushed = false;
+
+	os_atomic_inc_long(&input->total_frames);
+
+	pthread_mutex_lock(&input->queue_mutex);
+	if (input->queue_num < input->queue_size) {
+		size_t idx = (input->queue_first + input->queue_num) %
+			     input->queue_size;
+
+		input->queue[idx] = *frame;
+		video_buffer_addref(frame->buffer);
+		input->queue_num++;
+		pushed = true;
+	}
+	pthread_mutex_unlock(&input->queue_mutex);
+
+	if (pushed)
+		os_sem_post(input->queue_semaphore);
+	else
+		os_atomic_inc_long(&input->skipped_frames);
+}
+
 static inline bool video_output_cur_frame(struct video_output *video)
 {
 	struct cached_frame_info *frame_info;
@@ -134,13 +390,8 @@ static inline bool video_output_cur_frame(struct video_output *video)
 
 	pthread_mutex_lock(&video->input_mutex);
 
-	for (size_t i = 0; i < video->inputs.num; i++) {
-		struct video_input *input = video->inputs.array + i;
-		struct video_data frame = frame_info->frame;
-
-		if (scale_video_output(input, &frame))
-			input->callback(input->param, &frame);
-	}
+	for (size_t i = 0; i < video->inputs.num; i++)
+		video_input_push(video->inputs.array[i], &frame_info->frame);
 
 	pthread_mutex_unlock(&video->input_mutex);
 
@@ -148,7 +399,7 @@ static inline bool video_output_cur_frame(struct video_output *video)
 
 	pthread_mutex_lock(&video->data_mutex);
 
-	frame_info->frame.timestamp += video->frame_time;
+	frame_info->frame.data.timestamp += video->frame_time;
 	complete = --frame_info->count == 0;
 	skipped = frame_info->skipped > 0;
 
@@ -159,6 +410,8 @@ static inline bool video_output_cur_frame(struct video_output *video)
 		if (++video->available_frames == video->info.cache_size)
 			video->last_added = video->first_added;
 	} else if (skipped) {
+		/* the frame was never produced, every input repeats the last
+		 * one */
 		--frame_info->skipped;
 		os_atomic_inc_long(&video->skipped_frames);
 	}
@@ -206,20 +459,23 @@ static inline bool valid_video_params(const struct video_output_info *info)
 	       info->fps_num != 0;
 }
 
-static inline void init_cache(struct video_output *video)
+static inline bool init_cache(struct video_output *video)
 {
 	if (video->info.cache_size > MAX_CACHE_SIZE)
 		video->info.cache_size = MAX_CACHE_SIZE;
 
-	for (size_t i = 0; i < video->info.cache_size; i++) {
-		struct video_frame *frame;
-		frame = (struct video_frame *)&video->cache[i];
+	video->pool = video_buffer_pool_create(
+		video->info.format, video->info.width, video->info.height);
+	if (!video->pool)
+		return false;
 
-		video_frame_init(frame, video->info.format, video->info.width,
-				 video->info.height);
+	for (size_t i = 0; i < video->info.cache_size; i++) {
+		set_video_buffer(&video->cache[i].frame,
+				 video_buffer_pool_get(video->pool));
 	}
 
 	video->available_frames = video->info.cache_size;
+	return true;
 }
 
 int video_output_open(video_t **video, struct video_output_info *info)
@@ -244,11 +500,11 @@ int video_output_open(video_t **video, struct video_output_info *info)
 		goto fail1;
 	if (os_sem_init(&out->update_semaphore, 0) != 0)
 		goto fail2;
+	if (!init_cache(out))
+		goto fail3;
 	if (pthread_create(&out->thread, NULL, video_thread, out) != 0)
 		goto fail3;
 
-	init_cache(out);
-
 	out->initialized = true;
 	*video = out;
 	return VIDEO_OUTPUT_SUCCESS;
@@ -272,11 +528,12 @@ void video_output_close(video_t *video)
 	video_output_stop(video);
 
 	for (size_t i = 0; i < video->inputs.num; i++)
-		video_input_free(&video->inputs.array[i]);
+		video_input_destroy(video->inputs.array[i]);
 	da_free(video->inputs);
 
 	for (size_t i = 0; i < video->info.cache_size; i++)
-		video_frame_free((struct video_frame *)&video->cache[i]);
+		video_buffer_release(video->cache[i].frame.buffer);
+	video_buffer_pool_release(video->pool);
 
 	bfree(video);
 }
@@ -287,7 +544,7 @@ static size_t video_get_input_idx(const video_t *video,
 				  void *param)
 {
 	for (size_t i = 0; i < video->inputs.num; i++) {
-		struct video_input *input = video->inputs.array + i;
+		struct video_input *input = video->inputs.array[i];
 		if (input->callback == callback && input->param == param)
 			return i;
 	}
@@ -322,14 +579,33 @@ static inline bool video_input_init(struct video_input *input,
 			return false;
 		}
 
-		for (size_t i = 0; i < MAX_CONVERT_BUFFERS; i++)
-			video_frame_init(&input->frame[i],
-					 input->conversion.format,
-					 input->conversion.width,
-					 input->conversion.height);
+		input->pool = video_buffer_pool_create(
+			input->conversion.format, input->conversion.width,
+			input->conversion.height);
+		if (!input->pool)
+			return false;
 	}
 
+	input->queue_size = video->info.cache_size;
+	input->profile_name = profile_store_name(
+		obs_get_profiler_name_store(), "video_input_thread(%s)",
+		video->info.name);
+
+	if (pthread_mutex_init(&input->queue_mutex, NULL) != 0)
+		return false;
+	if (os_sem_init(&input->queue_semaphore, 0) != 0)
+		goto fail0;
+	if (pthread_create(&input->thread, NULL, input_thread, input) != 0)
+		goto fail1;
+
+	input->initialized = true;
 	return true;
+
+fail1:
+	os_sem_destroy(input->queue_semaphore);
+fail0:
+	pthread_mutex_destroy(&input->queue_mutex);
+	return false;
 }
 
 static inline void reset_frames(video_t *video)
@@ -350,26 +626,25 @@ bool video_output_connect(
 	pthread_mutex_lock(&video->input_mutex);
 
 	if (video_get_input_idx(video, callback, param) == DARRAY_INVALID) {
-		struct video_input input;
-		memset(&input, 0, sizeof(input));
+		struct video_input *input = bzalloc(sizeof(*input));
 
-		input.callback = callback;
-		input.param = param;
+		input->callback = callback;
+		input->param = param;
 
 		if (conversion) {
-			input.conversion = *conversion;
+			input->conversion = *conversion;
 		} else {
-			input.conversion.format = video->info.format;
-			input.conversion.width = video->info.width;
-			input.conversion.height = video->info.height;
+			input->conversion.format = video->info.format;
+			input->conversion.width = video->info.width;
+			input->conversion.height = video->info.height;
 		}
 
-		if (input.conversion.width == 0)
-			input.conversion.width = video->info.width;
-		if (input.conversion.height == 0)
-			input.conversion.height = video->info.height;
+		if (input->conversion.width == 0)
+			input->conversion.width = video->info.width;
+		if (input->conversion.height == 0)
+			input->conversion.height = video->info.height;
 
-		success = video_input_init(&input, video);
+		success = video_input_init(input, video);
 		if (success) {
 			if (video->inputs.num == 0) {
 				if (!os_atomic_load_long(&video->gpu_refs)) {
@@ -378,6 +653,8 @@ bool video_output_connect(
 				os_atomic_set_bool(&video->raw_active, true);
 			}
 			da_push_back(video->inputs, &input);
+		} else {
+			video_input_destroy(input);
 		}
 	}
 
@@ -403,11 +680,26 @@ static void log_skipped(video_t *video)
 		     percentage_skipped);
 }
 
+static void log_input_skipped(video_t *video, struct video_input *input)
+{
+	long skipped = os_atomic_load_long(&input->skipped_frames);
+	long total = os_atomic_load_long(&input->total_frames);
+
+	if (skipped)
+		blog(LOG_INFO,
+		     "video-io: '%s' input disconnected, number of "
+		     "frames it skipped: %ld/%ld (%0.1f%%)",
+		     video->info.name, skipped, total,
+		     (double)skipped / (double)total * 100.0);
+}
+
 void video_output_disconnect(video_t *video,
 			     void (*callback)(void *param,
 					      struct video_data *frame),
 			     void *param)
 {
+	struct video_input *input = NULL;
+
 	if (!video || !callback)
 		return;
 
@@ -415,8 +707,9 @@ void video_output_disconnect(video_t *video,
 
 	size_t idx = video_get_input_idx(video, callback, param);
 	if (idx != DARRAY_INVALID) {
-		video_input_free(video->inputs.array + idx);
+		input = video->inputs.array[idx];
 		da_erase(video->inputs, idx);
+		log_input_skipped(video, input);
 
 		if (video->inputs.num == 0) {
 			os_atomic_set_bool(&video->raw_active, false);
@@ -427,6 +720,9 @@ void video_output_disconnect(video_t *video,
 	}
 
 	pthread_mutex_unlock(&video->input_mutex);
+
+	/* waits for a callback that is still running */
+	video_input_destroy(input);
 }
 
 bool video_output_active(const video_t *video)
@@ -464,11 +760,21 @@ bool video_output_lock_frame(video_t *video, struct video_frame *frame,
 		}
 
 		cfi = &video->cache[video->last_added];
-		cfi->frame.timestamp = timestamp;
+
+		/* a consumer still holds the frame that was here, so give the
+		 * slot new storage instead of writing over it */
+		if (video_buffer_shared(cfi->frame.buffer)) {
+			struct video_buffer *buffer = cfi->frame.buffer;
+			set_video_buffer(&cfi->frame,
+					 video_buffer_pool_get(video->pool));
+			video_buffer_release(buffer);
+		}
+
+		cfi->frame.data.timestamp = timestamp;
 		cfi->count = count;
 		cfi->skipped = 0;
 
-		memcpy(frame, &cfi->frame, sizeof(*frame));
+		memcpy(frame, &cfi->frame.data, sizeof(*frame));
 
 		locked = true;
 	}
@@ -555,6 +861,37 @@ uint32_t video_output_get_total_frames(const video_t *video)
 	return (uint32_t)os_atomic_load_long(&video->total_frames);
 }
 
+bool video_output_get_input_frames(video_t *video,
+				   void (*callback)(void *param,
+						    struct video_data *frame),
+				   void *param, uint32_t *total,
+				   uint32_t *skipped)
+{
+	bool found = false;
+
+	if (!video || !callback)
+		return false;
+
+	pthread_mutex_lock(&video->input_mutex);
+
+	size_t idx = video_get_input_idx(video, callback, param);
+	if (idx != DARRAY_INVALID) {
+		struct video_input *input = video->inputs.array[idx];
+
+		if (total)
+			*total = (uint32_t)os_atomic_load_long(
+				&input->total_frames);
+		if (skipped)
+			*skipped = (uint32_t)os_atomic_load_long(
+				&input->skipped_frames);
+		found = true;
+	}
+
+	pthread_mutex_unlock(&video->input_mutex);
+
+	return found;
+}
+
 /* Note: These four functions below are a very slight bit of a hack.  If the
  * texture encoder thread is active while the raw encoder thread is active, the
  * total frame count will just be doubled while they're both active.  Which is
@@ -97,6 +97,14 @@ enum video_range_type {
 	VIDEO_RANGE_FULL,
 };
 
+/*
+ * Reference counted frame storage.  The planes of a frame stay valid for as
+ * long as a reference to its buffer is held, so a consumer that needs a frame
+ * after its callback returns (e.g. an encoder with lookahead) can take a
+ * reference instead of copying the data.
+ */
+struct video_buffer;
+
 struct video_data {
 	uint8_t *data[MAX_AV_PLANES];
 	uint32_t linesize[MAX_AV_PLANES];
@@ -259,6 +267,14 @@ EXPORT bool video_format_get_parameters_for_format(
 #define VIDEO_OUTPUT_INVALIDPARAM -1
 #define VIDEO_OUTPUT_FAIL -2
 
+EXPORT void video_buffer_addref(struct video_buffer *buffer);
+EXPORT void video_buffer_release(struct video_buffer *buffer);
+
+/* storage of a frame passed to a raw video callback, or NULL.  Only valid on
+ * the frame pointer the callback was given, not on a copy of it. */
+EXPORT struct video_buffer *
+video_data_get_buffer(const struct video_data *frame);
+
 EXPORT int video_output_open(video_t **video, struct video_output_info *info);
 EXPORT void video_output_close(video_t *video);
 
@@ -290,6 +306,12 @@ EXPORT double video_output_get_frame_rate(const video_t *video);
 EXPORT uint32_t video_output_get_skipped_frames(const video_t *video);
 EXPORT uint32_t video_output_get_total_frames(const video_t *video);
 
+/* frames a single input was given and the ones it had to skip because it
+ * fell behind, returns false if the callback is not connected */
+EXPORT bool video_output_get_input_frames(
+	video_t *video, void (*callback)(void *param, struct video_data *frame),
+	void *param, uint32_t *total, uint32_t *skipped);
+
 extern void video_output_inc_texture_encoders(video_t *video);
 extern void video_output_dec_texture_encoders(video_t *video);
 extern void video_output_inc_texture_frames(video_t *video);
@@ -18,6 +18,7 @@
 #include <inttypes.h>
 #include "obs-internal.h"
 #include "util/util_uint64.h"
+#include "media-io/audio-mix.h"
 
 struct ts_info {
 	uint64_t start;
@@ -31,10 +32,14 @@ static void push_audio_tree(obs_source_t *parent, obs_source_t *source, void *p)
 {
 	struct obs_core_audio *audio = p;
 
-	if (da_find(audio->render_order, &source, 0) == DARRAY_INVALID) {
+	/* the flag is only set while the source is in the render order, so
+	 * it doubles as the duplicate check */
+	if (!os_atomic_load_bool(&source->audio_render_cached)) {
 		obs_source_t *s = obs_source_get_ref(source);
-		if (s)
+		if (s) {
+			os_atomic_set_bool(&s->audio_render_cached, true);
 			da_push_back(audio->render_order, &s);
+		}
 	}
 
 	UNUSED_PARAMETER(parent);
@@ -45,12 +50,25 @@ static inline size_t convert_time_to_frames(size_t sample_rate, uint64_t t)
 	return (size_t)util_mul_div64(t, sample_rate, 1000000000ULL);
 }
 
+static inline bool source_sends_to_mix(const obs_source_t *source,
+				      size_t mix_idx)
+{
+	/* custom audio_render sources (scenes, transitions) fill every mix
+	 * themselves, so their mixer flags don't describe their buffers */
+	if (source->info.audio_render)
+		return true;
+
+	return (source->audio_mixers & (1U << mix_idx)) != 0;
+}
+
 static inline void mix_audio(struct audio_output_data *mixes,
 			     obs_source_t *source, size_t channels,
 			     size_t sample_rate, struct ts_info *ts,
 			     float *vol_data, bool *muted)
 {
-	size_t total_floats = AUDIO_OUTPUT_FRAMES;
+	struct audio_mix_op ops[MAX_AUDIO_TRACKS * MAX_AUDIO_CHANNELS];
+	size_t num_ops = 0;
+	size_t total_floats = obs->audio.frames;
 	size_t start_point = 0;
 
 	if (!(obs_source_get_sends(source)) || source->audio_ts < ts->start ||
@@ -60,48 +78,50 @@ static inline void mix_audio(struct audio_output_data *mixes,
 	if (source->audio_ts != ts->start) {
 		start_point = convert_time_to_frames(
 			sample_rate, source->audio_ts - ts->start);
-		if (start_point == AUDIO_OUTPUT_FRAMES)
+		if (start_point == obs->audio.frames)
 			return;
 
 		total_floats -= start_point;
 	}
 
-	for (size_t mix_idx = 0; mix_idx < MAX_AUDIO_MIXES; mix_idx++) {
-		for (size_t ch = 0; ch < channels; ch++) {
-			register float *mix = mixes[mix_idx].data[ch];
-			register float *aud =
-				source->audio_output_buf[mix_idx][ch];
-			register float *end;
+	/* grouped by channel, so that mixes sharing the source's buffer are
+	 * adjacent and get mixed in a single pass over it */
+	for (size_t ch = 0; ch < channels; ch++) {
+		for (size_t mix_idx = 0; mix_idx < obs->audio.num_mixes;
+		     mix_idx++) {
+			float gain = muted[mix_idx] ? 0.0f : vol_data[mix_idx];
 
-			mix += start_point;
-			end = aud + total_floats;
+			/* tracks this source does not send to hold only
+			 * silence */
+			if (gain == 0.0f ||
+			    !source_sends_to_mix(source, mix_idx))
+				continue;
 
-			float gain = muted[mix_idx] ? 0.0f : vol_data[mix_idx];
-			while (aud < end)
-				*(mix++) += *(aud++) * gain;
+			struct audio_mix_op *op = &ops[num_ops++];
+			op->dst = mixes[mix_idx].data[ch] + start_point;
+			op->src = source->audio_output_buf[mix_idx][ch];
+			op->gain = gain;
 		}
 	}
+
+	audio_mix_accumulate_ops(ops, num_ops, total_floats);
 }
 
 static inline void process_gain(struct audio_output_data *mixes,
 				size_t channels, float *vol_data, bool *muted)
 {
-	size_t total_floats = AUDIO_OUTPUT_FRAMES;
-	for (size_t mix_idx = 0; mix_idx < MAX_AUDIO_MIXES; mix_idx++) {
-		for (size_t ch = 0; ch < channels; ch++) {
-			register float *mix = mixes[mix_idx].data[ch];
-			register float *end = mix + total_floats;
-			float gain = muted[mix_idx] ? 0.0f : vol_data[mix_idx];
-			while (mix < end)
-				*(mix++) *= gain;
-		}
+	for (size_t mix_idx = 0; mix_idx < obs->audio.num_mixes; mix_idx++) {
+		float gain = muted[mix_idx] ? 0.0f : vol_data[mix_idx];
+		for (size_t ch = 0; ch < channels; ch++)
+			audio_mix_apply_gain(mixes[mix_idx].data[ch], gain,
+					     obs->audio.frames);
 	}
 }
 
-static bool ignore_audio(obs_source_t *source, size_t channels,
-			 size_t sample_rate, uint64_t start_ts)
+static bool ignore_audio(obs_source_t *source, size_t sample_rate,
+			 uint64_t start_ts)
 {
-	size_t num_floats = source->audio_input_buf[0].size / sizeof(float);
+	size_t num_floats = float_ring_size(&source->audio_input_buf);
 	const char *name = obs_source_get_name(source);
 
 	if (!source->audio_ts && num_floats) {
@@ -109,9 +129,7 @@ static bool ignore_audio(obs_source_t *source, size_t channels,
 		blog(LOG_DEBUG, "[src: %s] no timestamp, but audio available?",
 		     name);
 #endif
-		for (size_t ch = 0; ch < channels; ch++)
-			circlebuf_pop_front(&source->audio_input_buf[ch], NULL,
-					    source->audio_input_buf[0].size);
+		float_ring_pop_front(&source->audio_input_buf, num_floats);
 		source->last_audio_input_buf_size = 0;
 		return false;
 	}
@@ -130,9 +148,7 @@ static bool ignore_audio(obs_source_t *source, size_t channels,
 		     "[src: %s] ignored %" PRIu64 "/%" PRIu64 " samples", name,
 		     (uint64_t)drop, (uint64_t)num_floats);
 #endif
-		for (size_t ch = 0; ch < channels; ch++)
-			circlebuf_pop_front(&source->audio_input_buf[ch], NULL,
-					    drop * sizeof(float));
+		float_ring_pop_front(&source->audio_input_buf, drop);
 
 		source->last_audio_input_buf_size = 0;
 		source->audio_ts +=
@@ -169,13 +185,13 @@ static bool ignore_audio(obs_source_t *source, size_t channels,
 	return false;
 }
 
-static bool discard_if_stopped(obs_source_t *source, size_t channels)
+static bool discard_if_stopped(obs_source_t *source)
 {
 	size_t last_size;
 	size_t size;
 
 	last_size = source->last_audio_input_buf_size;
-	size = source->audio_input_buf[0].size;
+	size = float_ring_size(&source->audio_input_buf);
 
 	if (!size)
 		return false;
@@ -192,9 +208,7 @@ static bool discard_if_stopped(obs_source_t *source, size_t channels)
 			return false;
 		}
 
-		for (size_t ch = 0; ch < channels; ch++)
-			circlebuf_pop_front(&source->audio_input_buf[ch], NULL,
-					    source->audio_input_buf[ch].size);
+		float_ring_pop_front(&source->audio_input_buf, size);
 
 		source->pending_stop = false;
 		source->audio_ts = 0;
@@ -210,16 +224,11 @@ static bool discard_if_stopped(obs_source_t *source, size_t channels)
 	}
 }
 
-#define MAX_AUDIO_SIZE (AUDIO_OUTPUT_FRAMES * sizeof(float))
-
 static inline void discard_audio(struct obs_core_audio *audio,
 				 obs_source_t *source, size_t channels,
 				 size_t sample_rate, struct ts_info *ts)
 {
-	size_t total_floats = AUDIO_OUTPUT_FRAMES;
-	size_t size;
-	/* debug assert only */
-	UNUSED_PARAMETER(audio);
+	size_t total_floats = audio->frames;
 
 #if DEBUG_AUDIO == 1
 	bool is_audio_source = source->info.output_flags & OBS_SOURCE_AUDIO;
@@ -243,8 +252,9 @@ static inline void discard_audio(struct obs_core_audio *audio,
 
 	if (source->audio_ts < (ts->start - 1)) {
 		if (source->audio_pending &&
-		    source->audio_input_buf[0].size < MAX_AUDIO_SIZE &&
-		    discard_if_stopped(source, channels))
+		    float_ring_size(&source->audio_input_buf) <
+			    audio->frames &&
+		    discard_if_stopped(source))
 			return;
 
 #if DEBUG_AUDIO == 1
@@ -270,7 +280,7 @@ static inline void discard_audio(struct obs_core_audio *audio,
 	    source->audio_ts != (ts->start - 1)) {
 		size_t start_point = convert_time_to_frames(
 			sample_rate, source->audio_ts - ts->start);
-		if (start_point == AUDIO_OUTPUT_FRAMES) {
+		if (start_point == audio->frames) {
 #if DEBUG_AUDIO == 1
 			if (is_audio_source)
 				blog(LOG_DEBUG, "can't discard, start point is "
@@ -282,10 +292,8 @@ static inline void discard_audio(struct obs_core_audio *audio,
 		total_floats -= start_point;
 	}
 
-	size = total_floats * sizeof(float);
-
-	if (source->audio_input_buf[0].size < size) {
-		if (discard_if_stopped(source, channels))
+	if (float_ring_size(&source->audio_input_buf) < total_floats) {
+		if (discard_if_stopped(source))
 			return;
 
 #if DEBUG_AUDIO == 1
@@ -296,8 +304,7 @@ static inline void discard_audio(struct obs_core_audio *audio,
 		return;
 	}
 
-	for (size_t ch = 0; ch < channels; ch++)
-		circlebuf_pop_front(&source->audio_input_buf[ch], NULL, size);
+	float_ring_pop_front(&source->audio_input_buf, total_floats);
 
 	source->last_audio_input_buf_size = 0;
 
@@ -332,8 +339,8 @@ static void set_fixed_audio_buffering(struct obs_core_audio *audio,
 	ticks = audio->max_buffering_ticks - audio->total_buffering_ticks;
 	audio->total_buffering_ticks += ticks;
 
-	ms = ticks * AUDIO_OUTPUT_FRAMES * 1000 / sample_rate;
-	total_ms = audio->total_buffering_ticks * AUDIO_OUTPUT_FRAMES * 1000 /
+	ms = ticks * audio->frames * 1000 / sample_rate;
+	total_ms = audio->total_buffering_ticks * audio->frames * 1000 /
 		   sample_rate;
 
 	blog(LOG_INFO,
@@ -346,7 +353,7 @@ static void set_fixed_audio_buffering(struct obs_core_audio *audio,
 	new_ts.start =
 		audio->buffered_ts -
 		audio_frames_to_ns(sample_rate, audio->buffering_wait_ticks *
-							AUDIO_OUTPUT_FRAMES);
+							audio->frames);
 
 	while (ticks--) {
 		const uint64_t cur_ticks = ++audio->buffering_wait_ticks;
@@ -355,7 +362,7 @@ static void set_fixed_audio_buffering(struct obs_core_audio *audio,
 		new_ts.start =
 			audio->buffered_ts -
 			audio_frames_to_ns(sample_rate,
-					   cur_ticks * AUDIO_OUTPUT_FRAMES);
+					   cur_ticks * audio->frames);
 
 #if DEBUG_AUDIO == 1
 		blog(LOG_DEBUG, "add buffered ts: %" PRIu64 "-%" PRIu64,
@@ -388,7 +395,7 @@ static void add_audio_buffering(struct obs_core_audio *audio,
 
 	offset = ts->start - min_ts;
 	frames = ns_to_audio_frames(sample_rate, offset);
-	ticks = (int)((frames + AUDIO_OUTPUT_FRAMES - 1) / AUDIO_OUTPUT_FRAMES);
+	ticks = (int)((frames + audio->frames - 1) / audio->frames);
 
 	audio->total_buffering_ticks += ticks;
 
@@ -399,8 +406,8 @@ static void add_audio_buffering(struct obs_core_audio *audio,
 		blog(LOG_WARNING, "Max audio buffering reached!");
 	}
 
-	ms = ticks * AUDIO_OUTPUT_FRAMES * 1000 / sample_rate;
-	total_ms = audio->total_buffering_ticks * AUDIO_OUTPUT_FRAMES * 1000 /
+	ms = ticks * audio->frames * 1000 / sample_rate;
+	total_ms = audio->total_buffering_ticks * audio->frames * 1000 /
 		   sample_rate;
 
 	blog(LOG_INFO,
@@ -420,7 +427,7 @@ static void add_audio_buffering(struct obs_core_audio *audio,
 	new_ts.start =
 		audio->buffered_ts -
 		audio_frames_to_ns(sample_rate, audio->buffering_wait_ticks *
-							AUDIO_OUTPUT_FRAMES);
+							audio->frames);
 
 	while (ticks--) {
 		const uint64_t cur_ticks = ++audio->buffering_wait_ticks;
@@ -429,7 +436,7 @@ static void add_audio_buffering(struct obs_core_audio *audio,
 		new_ts.start =
 			audio->buffered_ts -
 			audio_frames_to_ns(sample_rate,
-					   cur_ticks * AUDIO_OUTPUT_FRAMES);
+					   cur_ticks * audio->frames);
 
 #if DEBUG_AUDIO == 1
 		blog(LOG_DEBUG, "add buffered ts: %" PRIu64 "-%" PRIu64,
@@ -446,8 +453,7 @@ static void add_audio_buffering(struct obs_core_audio *audio,
 static bool audio_buffer_insuffient(struct obs_source *source,
 				    size_t sample_rate, uint64_t min_ts)
 {
-	size_t total_floats = AUDIO_OUTPUT_FRAMES;
-	size_t size;
+	size_t total_floats = obs->audio.frames;
 
 	if (source->info.audio_render || source->audio_pending ||
 	    !source->audio_ts) {
@@ -457,15 +463,13 @@ static bool audio_buffer_insuffient(struct obs_source *source,
 	if (source->audio_ts != min_ts && source->audio_ts != (min_ts - 1)) {
 		size_t start_point = convert_time_to_frames(
 			sample_rate, source->audio_ts - min_ts);
-		if (start_point >= AUDIO_OUTPUT_FRAMES)
+		if (start_point >= obs->audio.frames)
 			return false;
 
 		total_floats -= start_point;
 	}
 
-	size = total_floats * sizeof(float);
-
-	if (source->audio_input_buf[0].size < size) {
+	if (float_ring_size(&source->audio_input_buf) < total_floats) {
 		source->audio_pending = true;
 		return true;
 	}
@@ -514,10 +518,67 @@ static inline const char *calc_min_ts(struct obs_core_data *data,
 	return buffering_name;
 }
 
-static inline void release_audio_sources(struct obs_core_audio *audio)
+static inline bool audio_render_independent(const obs_source_t *source)
 {
-	for (size_t i = 0; i < audio->render_order.num; i++)
-		obs_source_release(audio->render_order.array[i]);
+	return !source->info.audio_render && !source->info.audio_mix;
+}
+
+void audio_release_render_order(struct obs_core_audio *audio)
+{
+	for (size_t i = 0; i < audio->render_order.num; i++) {
+		obs_source_t *source = audio->render_order.array[i];
+		os_atomic_set_bool(&source->audio_render_cached, false);
+		obs_source_release(source);
+	}
+
+	da_resize(audio->render_order, 0);
+	da_resize(audio->root_nodes, 0);
+	da_resize(audio->render_inputs, 0);
+}
+
+/* the render order only changes with the source topology (see
+ * obs_invalidate_audio_render_order), so it is kept between ticks along
+ * with the source references it holds */
+static void build_audio_render_order(struct obs_core_audio *audio)
+{
+	struct obs_core_data *data = &obs->data;
+	struct obs_source *source;
+	long gen = os_atomic_load_long(&audio->render_order_gen);
+
+	if (gen == audio->render_order_built_gen)
+		return;
+
+	audio_release_render_order(audio);
+
+	/* NOTE: these are source channels, not audio channels */
+	for (uint32_t i = 0; i < MAX_CHANNELS; i++) {
+		obs_source_t *source = obs_get_output_source(i);
+		if (source) {
+			obs_source_enum_active_tree(source, push_audio_tree,
+						    audio);
+			push_audio_tree(NULL, source, audio);
+			da_push_back(audio->root_nodes, &source);
+			obs_source_release(source);
+		}
+	}
+
+	pthread_mutex_lock(&data->audio_sources_mutex);
+
+	source = data->first_audio_source;
+	while (source) {
+		push_audio_tree(NULL, source, audio);
+		source = (struct obs_source *)source->next_audio_source;
+	}
+
+	pthread_mutex_unlock(&data->audio_sources_mutex);
+
+	for (size_t i = 0; i < audio->render_order.num; i++) {
+		source = audio->render_order.array[i];
+		if (audio_render_independent(source))
+			da_push_back(audio->render_inputs, &source);
+	}
+
+	audio->render_order_built_gen = gen;
 }
 
 static inline void execute_audio_tasks(void)
@@ -537,6 +598,121 @@ static inline void execute_audio_tasks(void)
 	}
 }
 
+struct render_job_data {
+	struct obs_core_audio *audio;
+	uint32_t mixers;
+	size_t channels;
+	size_t sample_rate;
+	size_t audio_size;
+	uint64_t start_ts;
+};
+
+static const char *build_audio_render_order_name = "build_audio_render_order";
+static const char *render_audio_inputs_name = "render_audio_inputs";
+
+static void render_audio_source(struct render_job_data *job,
+				obs_source_t *source)
+{
+	obs_source_audio_render(source, job->mixers, job->channels,
+				job->sample_rate, job->audio_size);
+
+	/* if a source has gone backward in time and we can no
+	 * longer buffer, drop some or all of its audio */
+	if (audio_buffering_maxed(job->audio) && source->audio_ts != 0 &&
+	    source->audio_ts < job->start_ts) {
+		if (source->info.audio_render) {
+			blog(LOG_DEBUG,
+			     "render audio source %s timestamp has "
+			     "gone backwards",
+			     obs_source_get_name(source));
+
+			/* just avoid further damage */
+			source->audio_pending = true;
+#if DEBUG_AUDIO == 1
+			/* this should really be fixed */
+			assert(false);
+#endif
+		} else {
+			pthread_mutex_lock(&source->audio_buf_mutex);
+			bool rerender = ignore_audio(source, job->sample_rate,
+						     job->start_ts);
+			pthread_mutex_unlock(&source->audio_buf_mutex);
+
+			/* if we (potentially) recovered, re-render */
+			if (rerender)
+				obs_source_audio_render(source, job->mixers,
+							job->channels,
+							job->sample_rate,
+							job->audio_size);
+		}
+	}
+}
+
+static void render_audio_source_job(void *param, size_t idx)
+{
+	struct render_job_data *job = param;
+	render_audio_source(job, job->audio->render_inputs.array[idx]);
+}
+
+struct track_job_data {
+	struct audio_output_data *mixes;
+	size_t channels;
+	uint64_t timestamp;
+};
+
+static const char *process_audio_tracks_name = "process_audio_tracks";
+
+static void process_audio_track_job(void *param, size_t mix_idx)
+{
+	struct track_job_data *job = param;
+	struct audio_output_data *mix = &job->mixes[mix_idx];
+	obs_source_t *track =
+		(obs_source_t *)obs->data.audio_mixes.tracks[mix_idx];
+
+	/* the frontend only creates track sources for the tracks it shows,
+	 * mixes without one are output as they are */
+	if (!track)
+		return;
+
+	/* no profiler scope here: jobs mostly run on pool threads, which the
+	 * profiler would record as separate roots.  the whole batch is timed
+	 * on the audio thread by process_audio_tracks. */
+
+	/* track filters run in place on the mix buffers */
+	if (!obs_source_process_audio_track(track, mix->data, job->channels,
+					    job->timestamp)) {
+		for (size_t ch = 0; ch < job->channels; ch++)
+			memset(mix->data[ch], 0,
+			       obs->audio.frames * sizeof(float));
+	}
+}
+
+static void monitor_track(struct obs_core_audio *audio,
+			  struct audio_output_data *mixes, size_t channels,
+			  uint64_t timestamp)
+{
+	/* like the source monitors, skip a tick rather than wait for the
+	 * monitoring API */
+	if (pthread_mutex_trylock(&audio->monitoring_mutex) != 0)
+		return;
+
+	if (audio->track_monitor) {
+		struct audio_output_data *mix =
+			&mixes[audio->track_monitor_mix];
+		struct audio_data monitor_data = {0};
+
+		for (size_t ch = 0; ch < channels; ch++)
+			monitor_data.data[ch] = (uint8_t *)mix->data[ch];
+		monitor_data.frames = (uint32_t)audio->frames;
+		monitor_data.timestamp = timestamp;
+
+		audio_monitor_output_track(audio->track_monitor,
+					   &monitor_data);
+	}
+
+	pthread_mutex_unlock(&audio->monitoring_mutex);
+}
+
 bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in,
 		    uint64_t *out_ts, uint32_t mixers,
 		    struct audio_output_data *mixes)
@@ -544,89 +720,51 @@ bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in,
 	struct obs_core_data *data = &obs->data;
 	struct obs_core_audio *audio = &obs->audio;
 	struct obs_source *source;
-	const struct audio_output_info *obs_info;
 	size_t sample_rate = audio_output_get_sample_rate(audio->audio);
 	size_t channels = audio_output_get_channels(audio->audio);
-	obs_info = audio_output_get_info(audio->audio);
 	struct ts_info ts = {start_ts_in, end_ts_in};
 	size_t audio_size;
 	uint64_t min_ts;
 
-	da_resize(audio->render_order, 0);
-	da_resize(audio->root_nodes, 0);
-
 	circlebuf_push_back(&audio->buffered_timestamps, &ts, sizeof(ts));
 	circlebuf_peek_front(&audio->buffered_timestamps, &ts, sizeof(ts));
 	min_ts = ts.start;
 
-	audio_size = AUDIO_OUTPUT_FRAMES * sizeof(float);
+	audio_size = audio->frames * sizeof(float);
 
 #if DEBUG_AUDIO == 1
 	blog(LOG_DEBUG, "ts %llu-%llu", ts.start, ts.end);
 #endif
 
 	/* ------------------------------------------------ */
-	/* build audio render order
-	 * NOTE: these are source channels, not audio channels */
-	for (uint32_t i = 0; i < MAX_CHANNELS; i++) {
-		obs_source_t *source = obs_get_output_source(i);
-		if (source) {
-			obs_source_enum_active_tree(source, push_audio_tree,
-						    audio);
-			push_audio_tree(NULL, source, audio);
-			da_push_back(audio->root_nodes, &source);
-			obs_source_release(source);
-		}
-	}
-
-	pthread_mutex_lock(&data->audio_sources_mutex);
-
-	source = data->first_audio_source;
-	while (source) {
-		push_audio_tree(NULL, source, audio);
-		source = (struct obs_source *)source->next_audio_source;
-	}
-
-	pthread_mutex_unlock(&data->audio_sources_mutex);
+	/* build audio render order */
+	profile_start(build_audio_render_order_name);
+	build_audio_render_order(audio);
+	profile_end(build_audio_render_order_name);
 
 	/* ------------------------------------------------ */
-	/* render audio data */
+	/* render audio data
+	 * plain inputs only touch their own buffers and are rendered in
+	 * parallel, then scenes/transitions/submixes (which read their
+	 * children) are rendered in walk order, children first */
+	struct render_job_data render_job = {
+		.audio = audio,
+		.mixers = mixers,
+		.channels = channels,
+		.sample_rate = sample_rate,
+		.audio_size = audio_size,
+		.start_ts = ts.start,
+	};
+
+	profile_start(render_audio_inputs_name);
+	os_task_pool_run(audio->worker_pool, render_audio_source_job,
+			 &render_job, audio->render_inputs.num);
+	profile_end(render_audio_inputs_name);
+
 	for (size_t i = 0; i < audio->render_order.num; i++) {
 		obs_source_t *source = audio->render_order.array[i];
-		obs_source_audio_render(source, mixers, channels, sample_rate,
-					audio_size);
-
-		/* if a source has gone backward in time and we can no
-		 * longer buffer, drop some or all of its audio */
-		if (audio_buffering_maxed(audio) && source->audio_ts != 0 &&
-		    source->audio_ts < ts.start) {
-			if (source->info.audio_render) {
-				blog(LOG_DEBUG,
-				     "render audio source %s timestamp has "
-				     "gone backwards",
-				     obs_source_get_name(source));
-
-				/* just avoid further damage */
-				source->audio_pending = true;
-#if DEBUG_AUDIO == 1
-				/* this should really be fixed */
-				assert(false);
-#endif
-			} else {
-				pthread_mutex_lock(&source->audio_buf_mutex);
-				bool rerender = ignore_audio(source, channels,
-							     sample_rate,
-							     ts.start);
-				pthread_mutex_unlock(&source->audio_buf_mutex);
-
-				/* if we (potentially) recovered, re-render */
-				if (rerender)
-					obs_source_audio_render(source, mixers,
-								channels,
-								sample_rate,
-								audio_size);
-			}
-		}
+		if (!audio_render_independent(source))
+			render_audio_source(&render_job, source);
 	}
 
 	/* ------------------------------------------------ */
@@ -665,53 +803,31 @@ bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in,
 			pthread_mutex_unlock(&source->audio_buf_mutex);
 		}
 
-		struct audio_data audio_out = obs_info->audio_out;
-		audio_out.timestamp = start_ts_in;
+		struct track_job_data job_data = {
+			.mixes = mixes,
+			.channels = channels,
+			.timestamp = start_ts_in,
+		};
+
+		/* tracks are independent of each other, so they are filtered
+		 * in parallel; the meters still run here, in track order */
+		profile_start(process_audio_tracks_name);
+		os_task_pool_run(audio->worker_pool, process_audio_track_job,
+				 &job_data, audio->num_mixes);
+		profile_end(process_audio_tracks_name);
+
+		for (size_t i = 0; i < audio->num_mixes; i++) {
+			struct audio_data meter_data = {0};
 
-		struct obs_audio_data *o = NULL;
-		for (size_t i = 0; i < MAX_AUDIO_MIXES; i++) {
-			for (size_t j = 0; j < channels; j++)
-				memcpy(audio_out.data[j], mixes[i].data[j],
-				       AUDIO_OUTPUT_FRAMES * sizeof(float));
-			struct obs_source_audio s;
-			s.format = obs_info->format;
-			s.frames = AUDIO_OUTPUT_FRAMES;
-			s.samples_per_sec = (uint32_t)sample_rate;
-			s.speakers = obs_info->speakers;
-			s.timestamp = start_ts_in;
 			for (size_t j = 0; j < channels; j++)
-				s.data[j] = audio_out.data[j];
-			for (size_t j = channels; j < MAX_AV_PLANES; j++)
-				s.data[j] = NULL;
-
-			o = obs_source_output_audio_track(
-				(obs_source_t *)data->audio_mixes.tracks[i],
-				&s);
-
-			if (o) {
-				for (size_t j = 0; j < channels; j++) {
-					memcpy(audio_out.data[j], o->data[j],
-					       AUDIO_OUTPUT_FRAMES *
-						       sizeof(float));
-					memcpy(mixes[i].data[j], o->data[j],
-					       AUDIO_OUTPUT_FRAMES *
-						       sizeof(float));
-				}
-
-				/* Mute output */
-			} else {
-				for (size_t j = 0; j < channels; j++) {
-					memset(audio_out.data[j], 0,
-					       AUDIO_OUTPUT_FRAMES *
-						       sizeof(float));
-					memset(mixes[i].data[j], 0,
-					       AUDIO_OUTPUT_FRAMES *
-						       sizeof(float));
-				}
-			}
+				meter_data.data[j] =
+					(uint8_t *)mixes[i].data[j];
+			meter_data.frames = audio->frames;
+			meter_data.timestamp = start_ts_in;
+
 			obs_audio_mix_lock();
 			volmeter_data_received(data->audio_mixes.meters[i],
-					       &audio_out,
+					       &meter_data,
 					       data->audio_mixes.muted[i]);
 			obs_audio_mix_unlock();
 		}
@@ -721,6 +837,8 @@ bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in,
 			     &data->audio_mixes.muted[0]);
 	}
 
+	monitor_track(audio, mixes, channels, start_ts_in);
+
 	/* ------------------------------------------------ */
 	/* discard audio */
 	pthread_mutex_lock(&data->audio_sources_mutex);
@@ -736,10 +854,6 @@ bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in,
 
 	pthread_mutex_unlock(&data->audio_sources_mutex);
 
-	/* ------------------------------------------------ */
-	/* release audio sources */
-	release_audio_sources(audio);
-
 	circlebuf_pop_front(&audio->buffered_timestamps, NULL, sizeof(ts));
 
 	*out_ts = ts.start;
@@ -975,7 +975,7 @@ void send_off_encoder_packet(obs_encoder_t *encoder, bool success,
 }
 
 static const char *do_encode_name = "do_encode";
-bool do_encode(struct obs_encoder *encoder, struct encoder_frame *frame)
+bool do_encode(struct obs_encoder *encoder, struct encoder_frame_data *frame)
 {
 	profile_start(do_encode_name);
 	if (!encoder->profile_encoder_encode_name)
@@ -998,8 +998,8 @@ bool do_encode(struct obs_encoder *encoder, struct encoder_frame *frame)
 	pkt.encoder = encoder;
 
 	profile_start(encoder->profile_encoder_encode_name);
-	success = encoder->info.encode(encoder->context.data, frame, &pkt,
-				       &received);
+	success = encoder->info.encode(encoder->context.data, &frame->frame,
+				       &pkt, &received);
 	profile_end(encoder->profile_encoder_encode_name);
 	send_off_encoder_packet(encoder, success, received, &pkt);
 
@@ -1008,6 +1008,14 @@ bool do_encode(struct obs_encoder *encoder, struct encoder_frame *frame)
 	return success;
 }
 
+struct video_buffer *
+obs_encoder_frame_get_buffer(const struct encoder_frame *frame)
+{
+	const struct encoder_frame_data *frame_data =
+		(const struct encoder_frame_data *)frame;
+	return frame ? frame_data->buffer : NULL;
+}
+
 static inline bool video_pause_check_internal(struct pause_data *pause,
 					      uint64_t ts)
 {
@@ -1045,7 +1053,8 @@ static void receive_video(void *param, struct video_data *frame)
 
 	struct obs_encoder *encoder = param;
 	struct obs_encoder *pair = encoder->paired_encoder;
-	struct encoder_frame enc_frame;
+	struct encoder_frame_data frame_data;
+	struct encoder_frame *enc_frame = &frame_data.frame;
 
 	if (!encoder->first_received && pair) {
 		if (!pair->first_received ||
@@ -1057,20 +1066,21 @@ static void receive_video(void *param, struct video_data *frame)
 	if (video_pause_check(&encoder->pause, frame->timestamp))
 		goto wait_for_audio;
 
-	memset(&enc_frame, 0, sizeof(struct encoder_frame));
+	memset(&frame_data, 0, sizeof(frame_data));
 
 	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
-		enc_frame.data[i] = frame->data[i];
-		enc_frame.linesize[i] = frame->linesize[i];
+		enc_frame->data[i] = frame->data[i];
+		enc_frame->linesize[i] = frame->linesize[i];
 	}
 
 	if (!encoder->start_ts)
 		encoder->start_ts = frame->timestamp;
 
-	enc_frame.frames = 1;
-	enc_frame.pts = encoder->cur_pts;
+	enc_frame->frames = 1;
+	enc_frame->pts = encoder->cur_pts;
+	frame_data.buffer = video_data_get_buffer(frame);
 
-	if (do_encode(encoder, &enc_frame))
+	if (do_encode(encoder, &frame_data))
 		encoder->cur_pts += encoder->timebase_num;
 
 wait_for_audio:
@@ -1183,23 +1193,24 @@ fail:
 
 static bool send_audio_data(struct obs_encoder *encoder)
 {
-	struct encoder_frame enc_frame;
+	struct encoder_frame_data frame_data;
+	struct encoder_frame *enc_frame = &frame_data.frame;
 
-	memset(&enc_frame, 0, sizeof(struct encoder_frame));
+	memset(&frame_data, 0, sizeof(frame_data));
 
 	for (size_t i = 0; i < encoder->planes; i++) {
 		circlebuf_pop_front(&encoder->audio_input_buffer[i],
 				    encoder->audio_output_buffer[i],
 				    encoder->framesize_bytes);
 
-		enc_frame.data[i] = encoder->audio_output_buffer[i];
-		enc_frame.linesize[i] = (uint32_t)encoder->framesize_bytes;
+		enc_frame->data[i] = encoder->audio_output_buffer[i];
+		enc_frame->linesize[i] = (uint32_t)encoder->framesize_bytes;
 	}
 
-	enc_frame.frames = (uint32_t)encoder->framesize;
-	enc_frame.pts = encoder->cur_pts;
+	enc_frame->frames = (uint32_t)encoder->framesize;
+	enc_frame->pts = encoder->cur_pts;
 
-	if (!do_encode(encoder, &enc_frame))
+	if (!do_encode(encoder, &frame_data))
 		return false;
 
 	encoder->cur_pts += encoder->framesize;
@@ -1513,6 +1524,20 @@ bool obs_encoder_paused(const obs_encoder_t *encoder)
 		       : false;
 }
 
+uint32_t obs_encoder_get_skipped_frames(obs_encoder_t *encoder)
+{
+	uint32_t skipped = 0;
+
+	if (!obs_encoder_valid(encoder, "obs_encoder_get_skipped_frames"))
+		return 0;
+
+	if (encoder->info.type == OBS_ENCODER_VIDEO)
+		video_output_get_input_frames(encoder->media, receive_video,
+					      encoder, NULL, &skipped);
+
+	return skipped;
+}
+
 const char *obs_encoder_get_last_error(obs_encoder_t *encoder)
 {
 	if (!obs_encoder_valid(encoder, "obs_encoder_get_last_error"))
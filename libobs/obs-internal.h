@@ -20,11 +20,13 @@
 #include "util/c99defs.h"
 #include "util/darray.h"
 #include "util/circlebuf.h"
+#include "util/float-ring.h"
 #include "util/dstr.h"
 #include "util/threading.h"
 #include "util/platform.h"
 #include "util/profiler.h"
 #include "util/task.h"
+#include "util/histogram.h"
 #include "callback/signal.h"
 #include "callback/proc.h"
 
@@ -36,6 +38,7 @@
 #include "media-io/audio-io.h"
 
 #include "obs.h"
+#include "obs-output-interleave.h"
 
 #include <caption/caption.h>
 
@@ -44,6 +47,10 @@
 #define MICROSECOND_DEN 1000000
 #define NUM_ENCODE_TEXTURES 3
 #define NUM_ENCODE_TEXTURE_FRAMES_TO_WAIT 1
+#define MAX_AUDIO_WORKER_THREADS 7
+#define MAX_VIDEO_WORKER_THREADS 3
+#define TICK_SOURCES_PER_JOB 8
+#define COPY_ROWS_PER_JOB 64
 
 static inline int64_t packet_dts_usec(struct encoder_packet *packet)
 {
@@ -300,6 +307,11 @@ struct obs_core_video {
 	uint32_t lagged_frames;
 	bool thread_initialized;
 
+	pthread_mutex_t frame_stats_mutex;
+	struct histogram frame_phase_hist[OBS_FRAME_PHASE_COUNT];
+	struct histogram frame_jitter_hist;
+	uint32_t frame_lagged[OBS_FRAME_PHASE_COUNT];
+
 	bool gpu_conversion;
 	const char *conversion_techs[NUM_CHANNELS];
 	bool conversion_needed;
@@ -315,6 +327,10 @@ struct obs_core_video {
 
 	gs_texture_t *transparent_texture;
 
+	/* bumped when the graphics device is rebuilt, which loses the contents
+	 * of every texture */
+	volatile long device_gen;
+
 	gs_effect_t *deinterlace_discard_effect;
 	gs_effect_t *deinterlace_discard_2x_effect;
 	gs_effect_t *deinterlace_linear_effect;
@@ -330,15 +346,27 @@ struct obs_core_video {
 
 	pthread_mutex_t task_mutex;
 	struct circlebuf tasks;
+
+	/* sources with tick work this frame, see tick_sources() */
+	DARRAY(struct obs_source *) tick_sources;
+	DARRAY(struct obs_source *) async_tick_sources;
+
+	/* used by the graphics thread for tick work and frame copies */
+	os_task_pool_t *worker_pool;
 };
 
 struct audio_monitor;
 
 struct obs_core_audio {
 	audio_t *audio;
+	size_t frames;
+	size_t num_mixes;
 
 	DARRAY(struct obs_source *) render_order;
 	DARRAY(struct obs_source *) root_nodes;
+	DARRAY(struct obs_source *) render_inputs;
+	volatile long render_order_gen;
+	long render_order_built_gen;
 
 	uint64_t buffered_ts;
 	struct circlebuf buffered_timestamps;
@@ -351,22 +379,26 @@ struct obs_core_audio {
 
 	pthread_mutex_t monitoring_mutex;
 	DARRAY(struct audio_monitor *) monitors;
+	struct audio_monitor *track_monitor;
+	size_t track_monitor_mix;
 	char *monitoring_device_name;
 	char *monitoring_device_id;
 
 	pthread_mutex_t task_mutex;
 	struct circlebuf tasks;
+
+	os_task_pool_t *worker_pool;
 };
 
 struct obs_volumeter;
 struct obs_fader_t;
 
 struct obs_audio_mixes {
-	float volume[MAX_AUDIO_MIXES];
-	bool muted[MAX_AUDIO_MIXES];
-	struct obs_volumeter_t *meters[MAX_AUDIO_MIXES];
-	struct obs_fader_t *faders[MAX_AUDIO_MIXES];
-	struct obs_source_t *tracks[MAX_AUDIO_MIXES];
+	float volume[MAX_AUDIO_TRACKS];
+	bool muted[MAX_AUDIO_TRACKS];
+	struct obs_volumeter_t *meters[MAX_AUDIO_TRACKS];
+	struct obs_fader_t *faders[MAX_AUDIO_TRACKS];
+	struct obs_source_t *tracks[MAX_AUDIO_TRACKS];
 };
 
 /* user sources, output channels, and displays */
@@ -387,6 +419,12 @@ struct obs_core_data {
 	pthread_mutex_t audio_sources_mutex;
 	pthread_mutex_t draw_callbacks_mutex;
 	pthread_mutex_t mixers_mutex;
+
+	/* sources that may have work in obs_source_video_tick(), indexed by
+	 * obs_source::tick_idx.  Sources are added when they may need a tick
+	 * and pruned by the graphics thread once they no longer do. */
+	pthread_mutex_t ticking_sources_mutex;
+	DARRAY(struct obs_source *) ticking_sources;
 	DARRAY(struct draw_callback) draw_callbacks;
 	DARRAY(struct tick_callback) tick_callbacks;
 
@@ -472,6 +510,16 @@ struct obs_core {
 
 extern struct obs_core *obs;
 
+/* call whenever the active source tree, the output channels or the audio
+ * source list change, so the audio thread rebuilds its render order.  call
+ * it after the change is visible: the audio thread may rebuild at any time,
+ * and a rebuild between the call and the change would cache the old tree */
+static inline void obs_invalidate_audio_render_order(void)
+{
+	if (obs)
+		os_atomic_inc_long(&obs->audio.render_order_gen);
+}
+
 struct obs_graphics_context {
 	uint64_t last_time;
 	uint64_t interval;
@@ -496,6 +544,7 @@ obs_graphics_thread_loop_autorelease(struct obs_graphics_context *context);
 
 extern gs_effect_t *obs_load_effect(gs_effect_t **effect, const char *file);
 
+extern void audio_release_render_order(struct obs_core_audio *audio);
 extern bool audio_callback(void *param, uint64_t start_ts_in,
 			   uint64_t end_ts_in, uint64_t *out_ts,
 			   uint32_t mixers, struct audio_output_data *mixes);
@@ -648,6 +697,13 @@ struct caption_cb_info {
 	void *param;
 };
 
+/* obs_source_audio_mix with room for every mix the core can run.  the
+ * public struct is its first MAX_AUDIO_MIXES entries, which is all that
+ * audio_render callbacks from plugins know about. */
+struct obs_source_audio_mix_ext {
+	struct audio_output_data output[MAX_AUDIO_TRACKS];
+};
+
 struct obs_source {
 	struct obs_context_data context;
 	struct obs_source_info info;
@@ -663,12 +719,19 @@ struct obs_source {
 	/* signals to call the source update in the video thread */
 	long defer_update_count;
 
+	/* bumped whenever what the source renders may have changed, see
+	 * OBS_SOURCE_STATIC_VIDEO */
+	volatile long content_gen;
+
 	/* ensures show/hide are only called once */
 	volatile long show_refs;
 
 	/* ensures activate/deactivate are only called once */
 	volatile long activate_refs;
 
+	/* index in obs_core_data::ticking_sources, or DARRAY_INVALID */
+	size_t tick_idx;
+
 	/* source is in the process of being destroyed */
 	volatile long destroying;
 
@@ -710,15 +773,24 @@ struct obs_source {
 	struct obs_source *next_audio_source;
 	struct obs_source **prev_next_audio_source;
 	uint64_t audio_ts;
-	struct circlebuf audio_input_buf[MAX_AUDIO_CHANNELS];
+	struct float_ring audio_input_buf;
 	size_t last_audio_input_buf_size;
 	DARRAY(struct audio_action) audio_actions;
-	float *audio_output_buf[MAX_AUDIO_MIXES][MAX_AUDIO_CHANNELS];
+	/* per-mix views into audio_output_mem, mixes with identical content
+	 * share a buffer (see update_audio_output_mixes) */
+	float *audio_output_buf[MAX_AUDIO_TRACKS][MAX_AUDIO_CHANNELS];
+	float *audio_output_mem[MAX_AUDIO_TRACKS];
+	uint32_t audio_output_users[MAX_AUDIO_TRACKS];
+	/* the mix handed to info.audio_render while it runs */
+	const struct obs_source_audio_mix_ext *audio_render_mix;
+	uint32_t audio_output_routing;
+	size_t audio_output_channels;
 	float *audio_mix_buf[MAX_AUDIO_CHANNELS];
 	struct resample_info sample_info;
 	audio_resampler_t *resampler;
 	pthread_mutex_t audio_actions_mutex;
 	pthread_mutex_t audio_buf_mutex;
+	volatile bool audio_render_cached;
 	pthread_mutex_t audio_mutex;
 	pthread_mutex_t audio_cb_mutex;
 	DARRAY(struct audio_cb_info) audio_cb_list;
@@ -858,6 +930,13 @@ struct audio_monitor *audio_monitor_create(obs_source_t *source);
 void audio_monitor_reset(struct audio_monitor *monitor);
 extern void audio_monitor_destroy(struct audio_monitor *monitor);
 
+/* monitors a whole track; audio_monitor_output_track is called from the
+ * audio thread with the final (post track filter and volume) mix */
+extern struct audio_monitor *audio_monitor_create_track(size_t mix_idx);
+extern void audio_monitor_output_track(struct audio_monitor *monitor,
+				       const struct audio_data *data);
+extern uint64_t audio_monitor_get_latency(const struct audio_monitor *monitor);
+
 extern obs_source_t *
 obs_source_create_set_last_ver(const char *id, const char *name,
 			       obs_data_t *settings, obs_data_t *hotkey_data,
@@ -932,6 +1011,10 @@ extern void obs_source_set_texcoords_centered(obs_source_t *source,
 					      bool centered);
 extern void obs_source_activate(obs_source_t *source, enum view_type type);
 extern void obs_source_deactivate(obs_source_t *source, enum view_type type);
+extern bool obs_source_has_video_tick(const obs_source_t *source);
+extern void obs_source_tick_list_add(obs_source_t *source);
+extern void obs_source_tick_list_prune(obs_source_t *source);
+extern void obs_source_async_pretick(obs_source_t *source);
 extern void obs_source_video_tick(obs_source_t *source, float seconds);
 extern float obs_source_get_target_volume(obs_source_t *source,
 					  obs_source_t *target);
@@ -939,6 +1022,14 @@ extern float obs_source_get_target_volume(obs_source_t *source,
 extern void obs_source_audio_render(obs_source_t *source, uint32_t mixers,
 				    size_t channels, size_t sample_rate,
 				    size_t size);
+extern bool obs_source_process_audio_track(obs_source_t *source, float *data[],
+					   size_t channels, uint64_t timestamp);
+extern void
+obs_source_get_audio_mix_ext(const obs_source_t *source,
+			     struct obs_source_audio_mix_ext *audio);
+extern size_t
+obs_source_audio_render_mixes(const obs_source_t *source,
+			      const struct obs_source_audio_mix *audio);
 
 extern void add_alignment(struct vec2 *v, uint32_t align, int cx, int cy);
 
@@ -1017,13 +1108,13 @@ struct obs_output {
 	volatile bool data_active;
 	volatile bool end_data_capture_thread_active;
 	int64_t video_offset;
-	int64_t audio_offsets[MAX_AUDIO_MIXES];
+	int64_t audio_offsets[MAX_AUDIO_TRACKS];
 	int64_t highest_audio_ts;
 	int64_t highest_video_ts;
 	pthread_t end_data_capture_thread;
 	os_event_t *stopping_event;
 	pthread_mutex_t interleaved_mutex;
-	DARRAY(struct encoder_packet) interleaved_packets;
+	struct interleaver interleaver;
 	int stop_code;
 
 	int reconnect_retry_sec;
@@ -1046,13 +1137,13 @@ struct obs_output {
 	video_t *video;
 	audio_t *audio;
 	obs_encoder_t *video_encoder;
-	obs_encoder_t *audio_encoders[MAX_AUDIO_MIXES];
+	obs_encoder_t *audio_encoders[MAX_AUDIO_TRACKS];
 	obs_service_t *service;
 	size_t mixer_mask;
 
 	struct pause_data pause;
 
-	struct circlebuf audio_buffer[MAX_AUDIO_MIXES][MAX_AV_PLANES];
+	struct circlebuf audio_buffer[MAX_AUDIO_TRACKS][MAX_AV_PLANES];
 	uint64_t audio_start_ts;
 	uint64_t video_start_ts;
 	size_t audio_size;
@@ -1223,7 +1314,16 @@ extern void obs_encoder_remove_output(struct obs_encoder *encoder,
 extern bool start_gpu_encode(obs_encoder_t *encoder);
 extern void stop_gpu_encode(obs_encoder_t *encoder);
 
-extern bool do_encode(struct obs_encoder *encoder, struct encoder_frame *frame);
+/* encoder_frame is public and cannot grow.  Every frame libobs passes to
+ * encode() is the frame member of one of these, see
+ * obs_encoder_frame_get_buffer(). */
+struct encoder_frame_data {
+	struct encoder_frame frame;
+	struct video_buffer *buffer;
+};
+
+extern bool do_encode(struct obs_encoder *encoder,
+		      struct encoder_frame_data *frame);
 extern void send_off_encoder_packet(obs_encoder_t *encoder, bool success,
 				    bool received, struct encoder_packet *pkt);
 
@@ -0,0 +1,165 @@
+/******************************************************************************
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "obs-output-interleave.h"
+
+static inline size_t track_index(enum obs_encoder_type type, size_t audio_idx)
+{
+	return type == OBS_ENCODER_VIDEO ? 0 : audio_idx + 1;
+}
+
+static inline struct encoder_packet *track_front(struct interleaver *il,
+						 size_t track)
+{
+	return circlebuf_data(&il->tracks[track], 0);
+}
+
+static inline bool track_before(struct interleaver *il, size_t a, size_t b)
+{
+	return interleave_before(track_front(il, a), track_front(il, b));
+}
+
+static void sift_up(struct interleaver *il, size_t idx)
+{
+	while (idx) {
+		size_t parent = (idx - 1) / 2;
+
+		if (!track_before(il, il->heap[idx], il->heap[parent]))
+			break;
+
+		uint8_t temp = il->heap[idx];
+		il->heap[idx] = il->heap[parent];
+		il->heap[parent] = temp;
+		idx = parent;
+	}
+}
+
+static void sift_down(struct interleaver *il, size_t idx)
+{
+	for (;;) {
+		size_t left = idx * 2 + 1;
+		size_t right = left + 1;
+		size_t first = idx;
+
+		if (left < il->heap_size &&
+		    track_before(il, il->heap[left], il->heap[first]))
+			first = left;
+		if (right < il->heap_size &&
+		    track_before(il, il->heap[right], il->heap[first]))
+			first = right;
+		if (first == idx)
+			break;
+
+		uint8_t temp = il->heap[idx];
+		il->heap[idx] = il->heap[first];
+		il->heap[first] = temp;
+		idx = first;
+	}
+}
+
+void interleaver_free(struct interleaver *il)
+{
+	for (size_t i = 0; i < INTERLEAVE_TRACKS; i++) {
+		struct circlebuf *track = &il->tracks[i];
+
+		while (track->size) {
+			struct encoder_packet packet;
+			circlebuf_pop_front(track, &packet, sizeof(packet));
+			obs_encoder_packet_release(&packet);
+		}
+
+		circlebuf_free(track);
+	}
+
+	il->heap_size = 0;
+}
+
+void interleaver_push(struct interleaver *il,
+		      const struct encoder_packet *packet)
+{
+	size_t track = track_index(packet->type, packet->track_idx);
+	bool was_empty = !il->tracks[track].size;
+
+	circlebuf_push_back(&il->tracks[track], packet, sizeof(*packet));
+
+	/* the first packet of a track only changes when it was empty */
+	if (was_empty) {
+		il->heap[il->heap_size] = (uint8_t)track;
+		sift_up(il, il->heap_size++);
+	}
+}
+
+struct encoder_packet *interleaver_peek(struct interleaver *il)
+{
+	return il->heap_size ? track_front(il, il->heap[0]) : NULL;
+}
+
+bool interleaver_pop(struct interleaver *il, struct encoder_packet *packet)
+{
+	if (!il->heap_size)
+		return false;
+
+	struct circlebuf *track = &il->tracks[il->heap[0]];
+	circlebuf_pop_front(track, packet, sizeof(*packet));
+
+	if (!track->size)
+		il->heap[0] = il->heap[--il->heap_size];
+	sift_down(il, 0);
+	return true;
+}
+
+void interleaver_discard_to(struct interleaver *il,
+			    const struct encoder_packet *packet, bool inclusive)
+{
+	struct encoder_packet *first;
+
+	/* popping never moves the packets that are left, so 'packet' stays
+	 * where it is until it is popped itself */
+	while ((first = interleaver_peek(il)) != NULL) {
+		struct encoder_packet discarded;
+		bool last = first == packet;
+
+		if (last && !inclusive)
+			break;
+
+		interleaver_pop(il, &discarded);
+		obs_encoder_packet_release(&discarded);
+
+		if (last)
+			break;
+	}
+}
+
+void interleaver_sort(struct interleaver *il)
+{
+	for (size_t i = il->heap_size / 2; i > 0; i--)
+		sift_down(il, i - 1);
+}
+
+size_t interleaver_num_packets(const struct interleaver *il,
+			       enum obs_encoder_type type, size_t audio_idx)
+{
+	size_t track = track_index(type, audio_idx);
+	return il->tracks[track].size / sizeof(struct encoder_packet);
+}
+
+struct encoder_packet *interleaver_packet(struct interleaver *il,
+					  enum obs_encoder_type type,
+					  size_t audio_idx, size_t idx)
+{
+	size_t track = track_index(type, audio_idx);
+	return circlebuf_data(&il->tracks[track],
+			      idx * sizeof(struct encoder_packet));
+}
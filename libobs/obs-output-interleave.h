@@ -0,0 +1,99 @@
+/******************************************************************************
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "util/circlebuf.h"
+#include "obs.h"
+
+/*
+ * Interleaves the encoded packets of an output.
+ *
+ * Every track (the video track and each audio mix) has its own queue, and
+ * the packets of a track are expected to come in in DTS order, as encoders
+ * produce them.  The tracks with packets in them are kept in a small binary
+ * heap ordered by their first packet, so adding a packet never has to look
+ * at any other packet, and taking the first one out is O(log tracks).
+ *
+ * Packets are ordered by DTS; on equal DTS video comes first, then audio in
+ * track order.
+ */
+
+#define INTERLEAVE_TRACKS (MAX_AUDIO_TRACKS + 1)
+
+struct interleaver {
+	struct circlebuf tracks[INTERLEAVE_TRACKS];
+	uint8_t heap[INTERLEAVE_TRACKS];
+	size_t heap_size;
+};
+
+static inline bool interleave_before(const struct encoder_packet *a,
+				     const struct encoder_packet *b)
+{
+	if (a->dts_usec != b->dts_usec)
+		return a->dts_usec < b->dts_usec;
+	if (a->type != b->type)
+		return a->type == OBS_ENCODER_VIDEO;
+	return a->track_idx < b->track_idx;
+}
+
+/* releases every packet left */
+extern void interleaver_free(struct interleaver *il);
+
+/* takes ownership of the packet */
+extern void interleaver_push(struct interleaver *il,
+			     const struct encoder_packet *packet);
+
+/* first packet of all tracks, or NULL if there are none */
+extern struct encoder_packet *interleaver_peek(struct interleaver *il);
+
+/* takes out the first packet, ownership goes to the caller */
+extern bool interleaver_pop(struct interleaver *il,
+			    struct encoder_packet *packet);
+
+/* releases every packet that comes before 'packet' (and 'packet' itself if
+ * 'inclusive' is set), 'packet' must be in the interleaver */
+extern void interleaver_discard_to(struct interleaver *il,
+				   const struct encoder_packet *packet,
+				   bool inclusive);
+
+/* restores the order after the timestamps of queued packets changed, the
+ * order within each track must not have changed */
+extern void interleaver_sort(struct interleaver *il);
+
+/* access to the packets of one track, in order */
+extern size_t interleaver_num_packets(const struct interleaver *il,
+				      enum obs_encoder_type type,
+				      size_t audio_idx);
+extern struct encoder_packet *interleaver_packet(struct interleaver *il,
+						 enum obs_encoder_type type,
+						 size_t audio_idx, size_t idx);
+
+static inline struct encoder_packet *
+interleaver_first(struct interleaver *il, enum obs_encoder_type type,
+		  size_t audio_idx)
+{
+	return interleaver_num_packets(il, type, audio_idx)
+		       ? interleaver_packet(il, type, audio_idx, 0)
+		       : NULL;
+}
+
+static inline struct encoder_packet *
+interleaver_last(struct interleaver *il, enum obs_encoder_type type,
+		 size_t audio_idx)
+{
+	size_t num = interleaver_num_packets(il, type, audio_idx);
+	return num ? interleaver_packet(il, type, audio_idx, num - 1) : NULL;
+}
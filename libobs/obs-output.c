@@ -168,15 +168,12 @@ fail:
 
 static inline void free_packets(struct obs_output *output)
 {
-	for (size_t i = 0; i < output->interleaved_packets.num; i++)
-		obs_encoder_packet_release(output->interleaved_packets.array +
-					   i);
-	da_free(output->interleaved_packets);
+	interleaver_free(&output->interleaver);
 }
 
 static inline void clear_audio_buffers(obs_output_t *output)
 {
-	for (size_t i = 0; i < MAX_AUDIO_MIXES; i++) {
+	for (size_t i = 0; i < MAX_AUDIO_TRACKS; i++) {
 		for (size_t j = 0; j < MAX_AV_PLANES; j++) {
 			circlebuf_free(&output->audio_buffer[i][j]);
 		}
@@ -209,7 +206,7 @@ void obs_output_destroy(obs_output_t *output)
 						  output);
 		}
 
-		for (size_t i = 0; i < MAX_AUDIO_MIXES; i++) {
+		for (size_t i = 0; i < MAX_AUDIO_TRACKS; i++) {
 			if (output->audio_encoders[i]) {
 				obs_encoder_remove_output(
 					output->audio_encoders[i], output);
@@ -566,16 +563,16 @@ static inline bool pause_can_stop(struct pause_data *pause)
 static bool obs_encoded_output_pause(obs_output_t *output, bool pause)
 {
 	obs_encoder_t *venc;
-	obs_encoder_t *aenc[MAX_AUDIO_MIXES];
+	obs_encoder_t *aenc[MAX_AUDIO_TRACKS];
 	uint64_t closest_v_ts;
 	bool success = false;
 
 	venc = output->video_encoder;
-	for (size_t i = 0; i < MAX_AUDIO_MIXES; i++)
+	for (size_t i = 0; i < MAX_AUDIO_TRACKS; i++)
 		aenc[i] = output->audio_encoders[i];
 
 	pthread_mutex_lock(&venc->pause.mutex);
-	for (size_t i = 0; i < MAX_AUDIO_MIXES; i++) {
+	for (size_t i = 0; i < MAX_AUDIO_TRACKS; i++) {
 		if (aenc[i]) {
 			pthread_mutex_lock(&aenc[i]->pause.mutex);
 		}
@@ -589,7 +586,7 @@ static bool obs_encoded_output_pause(obs_output_t *output, bool pause)
 		if (!pause_can_start(&venc->pause)) {
 			goto fail;
 		}
-		for (size_t i = 0; i < MAX_AUDIO_MIXES; i++) {
+		for (size_t i = 0; i < MAX_AUDIO_TRACKS; i++) {
 			if (aenc[i] && !pause_can_start(&aenc[i]->pause)) {
 				goto fail;
 			}
@@ -598,7 +595,7 @@ static bool obs_encoded_output_pause(obs_output_t *output, bool pause)
 		os_atomic_set_bool(&venc->paused, true);
 		venc->pause.ts_start = closest_v_ts;
 
-		for (size_t i = 0; i < MAX_AUDIO_MIXES; i++) {
+		for (size_t i = 0; i < MAX_AUDIO_TRACKS; i++) {
 			if (aenc[i]) {
 				os_atomic_set_bool(&aenc[i]->paused, true);
 				aenc[i]->pause.ts_start = closest_v_ts;
@@ -608,7 +605,7 @@ static bool obs_encoded_output_pause(obs_output_t *output, bool pause)
 		if (!pause_can_stop(&venc->pause)) {
 			goto fail;
 		}
-		for (size_t i = 0; i < MAX_AUDIO_MIXES; i++) {
+		for (size_t i = 0; i < MAX_AUDIO_TRACKS; i++) {
 			if (aenc[i] && !pause_can_stop(&aenc[i]->pause)) {
 				goto fail;
 			}
@@ -617,7 +614,7 @@ static bool obs_encoded_output_pause(obs_output_t *output, bool pause)
 		os_atomic_set_bool(&venc->paused, false);
 		end_pause(&venc->pause, closest_v_ts);
 
-		for (size_t i = 0; i < MAX_AUDIO_MIXES; i++) {
+		for (size_t i = 0; i < MAX_AUDIO_TRACKS; i++) {
 			if (aenc[i]) {
 				os_atomic_set_bool(&aenc[i]->paused, false);
 				end_pause(&aenc[i]->pause, closest_v_ts);
@@ -630,7 +627,7 @@ static bool obs_encoded_output_pause(obs_output_t *output, bool pause)
 	success = true;
 
 fail:
-	for (size_t i = MAX_AUDIO_MIXES; i > 0; i--) {
+	for (size_t i = MAX_AUDIO_TRACKS; i > 0; i--) {
 		if (aenc[i - 1]) {
 			pthread_mutex_unlock(&aenc[i - 1]->pause.mutex);
 		}
@@ -745,7 +742,7 @@ audio_t *obs_output_audio(const obs_output_t *output)
 
 static inline size_t get_first_mixer(const obs_output_t *output)
 {
-	for (size_t i = 0; i < MAX_AUDIO_MIXES; i++) {
+	for (size_t i = 0; i < MAX_AUDIO_TRACKS; i++) {
 		if ((((size_t)1 << i) & output->mixer_mask) != 0) {
 			return i;
 		}
@@ -795,7 +792,7 @@ void obs_output_remove_encoder(struct obs_output *output,
 	if (output->video_encoder == encoder) {
 		output->video_encoder = NULL;
 	} else {
-		for (size_t i = 0; i < MAX_AUDIO_MIXES; i++) {
+		for (size_t i = 0; i < MAX_AUDIO_TRACKS; i++) {
 			if (output->audio_encoders[i] == encoder)
 				output->audio_encoders[i] = NULL;
 		}
@@ -833,6 +830,16 @@ void obs_output_set_video_encoder(obs_output_t *output, obs_encoder_t *encoder)
 					    output->scaled_height);
 }
 
+/* a multitrack output takes an encoder per active mix */
+static inline size_t max_audio_encoders(void)
+{
+	size_t num_mixes = audio_output_get_mixes(obs->audio.audio);
+
+	if (!num_mixes || num_mixes > MAX_AUDIO_TRACKS)
+		return MAX_AUDIO_MIXES;
+	return num_mixes;
+}
+
 void obs_output_set_audio_encoder(obs_output_t *output, obs_encoder_t *encoder,
 				  size_t idx)
 {
@@ -852,7 +859,7 @@ void obs_output_set_audio_encoder(obs_output_t *output, obs_encoder_t *encoder,
 	}
 
 	if ((output->info.flags & OBS_OUTPUT_MULTI_TRACK) != 0) {
-		if (idx >= MAX_AUDIO_MIXES) {
+		if (idx >= max_audio_encoders()) {
 			return;
 		}
 	} else {
@@ -883,7 +890,7 @@ obs_encoder_t *obs_output_get_audio_encoder(const obs_output_t *output,
 		return NULL;
 
 	if ((output->info.flags & OBS_OUTPUT_MULTI_TRACK) != 0) {
-		if (idx >= MAX_AUDIO_MIXES) {
+		if (idx >= MAX_AUDIO_TRACKS) {
 			return NULL;
 		}
 	} else {
@@ -1043,7 +1050,7 @@ static inline size_t num_audio_mixes(const struct obs_output *output)
 	if ((output->info.flags & OBS_OUTPUT_MULTI_TRACK) != 0) {
 		mix_count = 0;
 
-		for (size_t i = 0; i < MAX_AUDIO_MIXES; i++) {
+		for (size_t i = 0; i < MAX_AUDIO_TRACKS; i++) {
 			if (!output->audio_encoders[i])
 				break;
 
@@ -1148,7 +1155,7 @@ get_audio_conversion(struct obs_output *output)
 static size_t get_track_index(const struct obs_output *output,
 			      struct encoder_packet *pkt)
 {
-	for (size_t i = 0; i < MAX_AUDIO_MIXES; i++) {
+	for (size_t i = 0; i < MAX_AUDIO_TRACKS; i++) {
 		struct obs_encoder *encoder = output->audio_encoders[i];
 
 		if (pkt->encoder == encoder)
@@ -1305,15 +1312,16 @@ double last_caption_timestamp = 0;
 
 static inline void send_interleaved(struct obs_output *output)
 {
-	struct encoder_packet out = output->interleaved_packets.array[0];
+	struct encoder_packet *first = interleaver_peek(&output->interleaver);
+	struct encoder_packet out;
 
 	/* do not send an interleaved packet if there's no packet of the
 	 * opposing type of a higher timestamp in the interleave buffer.
 	 * this ensures that the timestamps are monotonic */
-	if (!has_higher_opposing_ts(output, &out))
+	if (!first || !has_higher_opposing_ts(output, first))
 		return;
 
-	da_erase(output->interleaved_packets, 0);
+	interleaver_pop(&output->interleaver, &out);
 
 	if (out.type == OBS_ENCODER_VIDEO) {
 		output->total_frames++;
@@ -1363,186 +1371,123 @@ static inline void set_higher_ts(struct obs_output *output,
 	}
 }
 
-static inline struct encoder_packet *
-find_first_packet_type(struct obs_output *output, enum obs_encoder_type type,
-		       size_t audio_idx);
-static int find_first_packet_type_idx(struct obs_output *output,
-				      enum obs_encoder_type type,
-				      size_t audio_idx);
-
 /* gets the point where audio and video are closest together */
-static size_t get_interleaved_start_idx(struct obs_output *output)
+static struct encoder_packet *get_interleaved_start(struct obs_output *output)
 {
+	struct interleaver *il = &output->interleaver;
 	int64_t closest_diff = 0x7FFFFFFFFFFFFFFFLL;
 	struct encoder_packet *first_video =
-		find_first_packet_type(output, OBS_ENCODER_VIDEO, 0);
-	size_t video_idx = DARRAY_INVALID;
-	size_t idx = 0;
-
-	for (size_t i = 0; i < output->interleaved_packets.num; i++) {
-		struct encoder_packet *packet =
-			&output->interleaved_packets.array[i];
-		int64_t diff;
-
-		if (packet->type != OBS_ENCODER_AUDIO) {
-			if (packet == first_video)
-				video_idx = i;
-			continue;
-		}
-
-		diff = llabs(packet->dts_usec - first_video->dts_usec);
-		if (diff < closest_diff) {
-			closest_diff = diff;
-			idx = i;
+		interleaver_first(il, OBS_ENCODER_VIDEO, 0);
+	struct encoder_packet *closest = NULL;
+
+	for (size_t i = 0; i < MAX_AUDIO_TRACKS; i++) {
+		size_t num = interleaver_num_packets(il, OBS_ENCODER_AUDIO, i);
+
+		for (size_t j = 0; j < num; j++) {
+			struct encoder_packet *packet = interleaver_packet(
+				il, OBS_ENCODER_AUDIO, i, j);
+			int64_t diff;
+
+			diff = llabs(packet->dts_usec - first_video->dts_usec);
+			if (!closest || diff < closest_diff ||
+			    (diff == closest_diff &&
+			     interleave_before(packet, closest))) {
+				closest_diff = diff;
+				closest = packet;
+			}
 		}
 	}
 
-	return video_idx < idx ? video_idx : idx;
+	if (!closest)
+		return NULL;
+
+	return interleave_before(first_video, closest) ? first_video : closest;
 }
 
-static int prune_premature_packets(struct obs_output *output)
+/* returns -1 if a track has no packets yet, 1 if everything up to and
+ * including 'last' needs to be pruned, 0 otherwise */
+static int prune_premature_packets(struct obs_output *output,
+				   struct encoder_packet **last)
 {
+	struct interleaver *il = &output->interleaver;
 	size_t audio_mixes = num_audio_mixes(output);
 	struct encoder_packet *video;
-	int video_idx;
-	int max_idx;
 	int64_t duration_usec;
 	int64_t max_diff = 0;
 	int64_t diff = 0;
 
-	video_idx = find_first_packet_type_idx(output, OBS_ENCODER_VIDEO, 0);
-	if (video_idx == -1) {
+	video = interleaver_first(il, OBS_ENCODER_VIDEO, 0);
+	if (!video) {
 		output->received_video = false;
 		return -1;
 	}
 
-	max_idx = video_idx;
-	video = &output->interleaved_packets.array[video_idx];
+	*last = video;
 	duration_usec = video->timebase_num * 1000000LL / video->timebase_den;
 
 	for (size_t i = 0; i < audio_mixes; i++) {
 		struct encoder_packet *audio;
-		int audio_idx;
 
-		audio_idx = find_first_packet_type_idx(output,
-						       OBS_ENCODER_AUDIO, i);
-		if (audio_idx == -1) {
+		audio = interleaver_first(il, OBS_ENCODER_AUDIO, i);
+		if (!audio) {
 			output->received_audio = false;
 			return -1;
 		}
 
-		audio = &output->interleaved_packets.array[audio_idx];
-		if (audio_idx > max_idx)
-			max_idx = audio_idx;
+		if (interleave_before(*last, audio))
+			*last = audio;
 
 		diff = audio->dts_usec - video->dts_usec;
 		if (diff > max_diff)
 			max_diff = diff;
 	}
 
-	return diff > duration_usec ? max_idx + 1 : 0;
-}
-
-static void discard_to_idx(struct obs_output *output, size_t idx)
-{
-	for (size_t i = 0; i < idx; i++) {
-		struct encoder_packet *packet =
-			&output->interleaved_packets.array[i];
-		obs_encoder_packet_release(packet);
-	}
-
-	da_erase_range(output->interleaved_packets, 0, idx);
+	return diff > duration_usec ? 1 : 0;
 }
 
 #define DEBUG_STARTING_PACKETS 0
 
 static bool prune_interleaved_packets(struct obs_output *output)
 {
-	size_t start_idx = 0;
-	int prune_start = prune_premature_packets(output);
+	struct interleaver *il = &output->interleaver;
+	struct encoder_packet *last = NULL;
+	int prune = prune_premature_packets(output, &last);
 
 #if DEBUG_STARTING_PACKETS == 1
-	blog(LOG_DEBUG, "--------- Pruning! %d ---------", prune_start);
-	for (size_t i = 0; i < output->interleaved_packets.num; i++) {
-		struct encoder_packet *packet =
-			&output->interleaved_packets.array[i];
-		blog(LOG_DEBUG, "packet: %s %d, ts: %lld, pruned = %s",
-		     packet->type == OBS_ENCODER_AUDIO ? "audio" : "video",
-		     (int)packet->track_idx, packet->dts_usec,
-		     (int)i < prune_start ? "true" : "false");
+	blog(LOG_DEBUG, "--------- Pruning! %d ---------", prune);
+	for (size_t i = 0; i < INTERLEAVE_TRACKS; i++) {
+		enum obs_encoder_type type = i ? OBS_ENCODER_AUDIO
+					       : OBS_ENCODER_VIDEO;
+		size_t audio_idx = i ? i - 1 : 0;
+		size_t num = interleaver_num_packets(il, type, audio_idx);
+
+		for (size_t j = 0; j < num; j++) {
+			struct encoder_packet *packet =
+				interleaver_packet(il, type, audio_idx, j);
+			bool pruned = prune == 1 &&
+				      !interleave_before(last, packet);
+			blog(LOG_DEBUG, "packet: %s %d, ts: %lld, pruned = %s",
+			     packet->type == OBS_ENCODER_AUDIO ? "audio"
+							       : "video",
+			     (int)packet->track_idx, packet->dts_usec,
+			     pruned ? "true" : "false");
+		}
 	}
 #endif
 
 	/* prunes the first video packet if it's too far away from audio */
-	if (prune_start == -1)
+	if (prune == -1)
 		return false;
-	else if (prune_start != 0)
-		start_idx = (size_t)prune_start;
-	else
-		start_idx = get_interleaved_start_idx(output);
-
-	if (start_idx)
-		discard_to_idx(output, start_idx);
-
-	return true;
-}
-
-static int find_first_packet_type_idx(struct obs_output *output,
-				      enum obs_encoder_type type,
-				      size_t audio_idx)
-{
-	for (size_t i = 0; i < output->interleaved_packets.num; i++) {
-		struct encoder_packet *packet =
-			&output->interleaved_packets.array[i];
-
-		if (packet->type == type) {
-			if (type == OBS_ENCODER_AUDIO &&
-			    packet->track_idx != audio_idx) {
-				continue;
-			}
-
-			return (int)i;
-		}
-	}
-
-	return -1;
-}
-
-static int find_last_packet_type_idx(struct obs_output *output,
-				     enum obs_encoder_type type,
-				     size_t audio_idx)
-{
-	for (size_t i = output->interleaved_packets.num; i > 0; i--) {
-		struct encoder_packet *packet =
-			&output->interleaved_packets.array[i - 1];
 
-		if (packet->type == type) {
-			if (type == OBS_ENCODER_AUDIO &&
-			    packet->track_idx != audio_idx) {
-				continue;
-			}
-
-			return (int)(i - 1);
-		}
+	if (prune == 1) {
+		interleaver_discard_to(il, last, true);
+	} else {
+		struct encoder_packet *start = get_interleaved_start(output);
+		if (start)
+			interleaver_discard_to(il, start, false);
 	}
 
-	return -1;
-}
-
-static inline struct encoder_packet *
-find_first_packet_type(struct obs_output *output, enum obs_encoder_type type,
-		       size_t audio_idx)
-{
-	int idx = find_first_packet_type_idx(output, type, audio_idx);
-	return (idx != -1) ? &output->interleaved_packets.array[idx] : NULL;
-}
-
-static inline struct encoder_packet *
-find_last_packet_type(struct obs_output *output, enum obs_encoder_type type,
-		      size_t audio_idx)
-{
-	int idx = find_last_packet_type_idx(output, type, audio_idx);
-	return (idx != -1) ? &output->interleaved_packets.array[idx] : NULL;
+	return true;
 }
 
 static bool get_audio_and_video_packets(struct obs_output *output,
@@ -1550,12 +1495,14 @@ static bool get_audio_and_video_packets(struct obs_output *output,
 					struct encoder_packet **audio,
 					size_t audio_mixes)
 {
-	*video = find_first_packet_type(output, OBS_ENCODER_VIDEO, 0);
+	struct interleaver *il = &output->interleaver;
+
+	*video = interleaver_first(il, OBS_ENCODER_VIDEO, 0);
 	if (!*video)
 		output->received_video = false;
 
 	for (size_t i = 0; i < audio_mixes; i++) {
-		audio[i] = find_first_packet_type(output, OBS_ENCODER_AUDIO, i);
+		audio[i] = interleaver_first(il, OBS_ENCODER_AUDIO, i);
 		if (!audio[i]) {
 			output->received_audio = false;
 			return false;
@@ -1571,18 +1518,18 @@ static bool get_audio_and_video_packets(struct obs_output *output,
 
 static bool initialize_interleaved_packets(struct obs_output *output)
 {
+	struct interleaver *il = &output->interleaver;
 	struct encoder_packet *video;
-	struct encoder_packet *audio[MAX_AUDIO_MIXES];
-	struct encoder_packet *last_audio[MAX_AUDIO_MIXES];
+	struct encoder_packet *audio[MAX_AUDIO_TRACKS];
+	struct encoder_packet *last_audio[MAX_AUDIO_TRACKS];
+	struct encoder_packet *start;
 	size_t audio_mixes = num_audio_mixes(output);
-	size_t start_idx;
 
 	if (!get_audio_and_video_packets(output, &video, audio, audio_mixes))
 		return false;
 
 	for (size_t i = 0; i < audio_mixes; i++)
-		last_audio[i] =
-			find_last_packet_type(output, OBS_ENCODER_AUDIO, i);
+		last_audio[i] = interleaver_last(il, OBS_ENCODER_AUDIO, i);
 
 	/* ensure that there is audio past the first video packet */
 	for (size_t i = 0; i < audio_mixes; i++) {
@@ -1593,9 +1540,9 @@ static bool initialize_interleaved_packets(struct obs_output *output)
 	}
 
 	/* clear out excess starting audio if it hasn't been already */
-	start_idx = get_interleaved_start_idx(output);
-	if (start_idx) {
-		discard_to_idx(output, start_idx);
+	start = get_interleaved_start(output);
+	if (start && start != interleaver_peek(il)) {
+		interleaver_discard_to(il, start, false);
 		if (!get_audio_and_video_packets(output, &video, audio,
 						 audio_mixes))
 			return false;
@@ -1622,63 +1569,33 @@ static bool initialize_interleaved_packets(struct obs_output *output)
 	output->highest_video_ts -= video->dts_usec;
 
 	/* apply new offsets to all existing packet DTS/PTS values */
-	for (size_t i = 0; i < output->interleaved_packets.num; i++) {
-		struct encoder_packet *packet =
-			&output->interleaved_packets.array[i];
-		apply_interleaved_packet_offset(output, packet);
-	}
-
-	return true;
-}
-
-static inline void insert_interleaved_packet(struct obs_output *output,
-					     struct encoder_packet *out)
-{
-	size_t idx;
-	for (idx = 0; idx < output->interleaved_packets.num; idx++) {
-		struct encoder_packet *cur_packet;
-		cur_packet = output->interleaved_packets.array + idx;
-
-		if (out->dts_usec == cur_packet->dts_usec &&
-		    out->type == OBS_ENCODER_VIDEO) {
-			break;
-		} else if (out->dts_usec < cur_packet->dts_usec) {
-			break;
+	for (size_t i = 0; i < INTERLEAVE_TRACKS; i++) {
+		enum obs_encoder_type type = i ? OBS_ENCODER_AUDIO
+					       : OBS_ENCODER_VIDEO;
+		size_t audio_idx = i ? i - 1 : 0;
+		size_t num = interleaver_num_packets(il, type, audio_idx);
+
+		for (size_t j = 0; j < num; j++) {
+			struct encoder_packet *packet =
+				interleaver_packet(il, type, audio_idx, j);
+			apply_interleaved_packet_offset(output, packet);
 		}
 	}
 
-	da_insert(output->interleaved_packets, idx, out);
-}
-
-static void resort_interleaved_packets(struct obs_output *output)
-{
-	DARRAY(struct encoder_packet) old_array;
-
-	old_array.da = output->interleaved_packets.da;
-	memset(&output->interleaved_packets, 0,
-	       sizeof(output->interleaved_packets));
-
-	for (size_t i = 0; i < old_array.num; i++)
-		insert_interleaved_packet(output, &old_array.array[i]);
-
-	da_free(old_array);
+	return true;
 }
 
 static void discard_unused_audio_packets(struct obs_output *output,
 					 int64_t dts_usec)
 {
-	size_t idx = 0;
+	struct interleaver *il = &output->interleaver;
+	struct encoder_packet *first;
 
-	for (; idx < output->interleaved_packets.num; idx++) {
-		struct encoder_packet *p =
-			&output->interleaved_packets.array[idx];
-
-		if (p->dts_usec >= dts_usec)
-			break;
+	while ((first = interleaver_peek(il)) && first->dts_usec < dts_usec) {
+		struct encoder_packet packet;
+		interleaver_pop(il, &packet);
+		obs_encoder_packet_release(&packet);
 	}
-
-	if (idx)
-		discard_to_idx(output, idx);
 }
 
 static void interleave_packets(void *data, struct encoder_packet *packet)
@@ -1718,7 +1635,7 @@ static void interleave_packets(void *data, struct encoder_packet *packet)
 	else
 		check_received(output, packet);
 
-	insert_interleaved_packet(output, &out);
+	interleaver_push(&output->interleaver, &out);
 	set_higher_ts(output, &out);
 
 	/* when both video and audio have been received, we're ready
@@ -1727,7 +1644,7 @@ static void interleave_packets(void *data, struct encoder_packet *packet)
 		if (!was_started) {
 			if (prune_interleaved_packets(output)) {
 				if (initialize_interleaved_packets(output)) {
-					resort_interleaved_packets(output);
+					interleaver_sort(&output->interleaver);
 					send_interleaved(output);
 				}
 			}
@@ -1878,7 +1795,7 @@ static inline void start_audio_encoders(struct obs_output *output,
 static inline void start_raw_audio(obs_output_t *output)
 {
 	if (output->info.raw_audio2) {
-		for (int idx = 0; idx < MAX_AUDIO_MIXES; idx++) {
+		for (int idx = 0; idx < MAX_AUDIO_TRACKS; idx++) {
 			if ((output->mixer_mask & ((size_t)1 << idx)) != 0) {
 				audio_output_connect(
 					output->audio, idx,
@@ -1901,7 +1818,7 @@ static void reset_packet_data(obs_output_t *output)
 	output->highest_video_ts = 0;
 	output->video_offset = 0;
 
-	for (size_t i = 0; i < MAX_AUDIO_MIXES; i++)
+	for (size_t i = 0; i < MAX_AUDIO_TRACKS; i++)
 		output->audio_offsets[i] = 0;
 
 	free_packets(output);
@@ -2233,7 +2150,7 @@ static inline void stop_audio_encoders(obs_output_t *output,
 static inline void stop_raw_audio(obs_output_t *output)
 {
 	if (output->info.raw_audio2) {
-		for (int idx = 0; idx < MAX_AUDIO_MIXES; idx++) {
+		for (int idx = 0; idx < MAX_AUDIO_TRACKS; idx++) {
 			if ((output->mixer_mask & ((size_t)1 << idx)) != 0) {
 				audio_output_disconnect(
 					output->audio, idx,
@@ -2627,7 +2544,7 @@ const char *obs_output_get_last_error(obs_output_t *output)
 			return vencoder->last_error_message;
 		}
 
-		for (size_t i = 0; i < MAX_AUDIO_MIXES; i++) {
+		for (size_t i = 0; i < MAX_AUDIO_TRACKS; i++) {
 			obs_encoder_t *aencoder = output->audio_encoders[i];
 			if (aencoder && aencoder->last_error_message) {
 				return aencoder->last_error_message;
@@ -437,6 +437,9 @@ static void update_item_transform(struct obs_scene_item *item, bool update_tex)
 	if (os_atomic_load_long(&item->defer_update) > 0)
 		return;
 
+	/* crop or bounds may have changed what goes into the texture */
+	item->render_cached = false;
+
 	width = obs_source_get_width(item->source);
 	height = obs_source_get_height(item->source);
 	cx = calc_cx(item, width);
@@ -545,6 +548,46 @@ static inline bool item_texture_enabled(const struct obs_scene_item *item)
 	       (item_is_scene(item) && !item->is_group);
 }
 
+/* whether the source and all of its enabled filters only change when
+ * libobs is told about it */
+static bool item_content_static(const struct obs_scene_item *item)
+{
+	obs_source_t *source = item->source;
+	bool is_static = (source->info.output_flags &
+			  OBS_SOURCE_STATIC_VIDEO) != 0;
+
+	if (!is_static || !source->filters.num)
+		return is_static;
+
+	pthread_mutex_lock(&source->filter_mutex);
+	for (size_t i = 0; i < source->filters.num; i++) {
+		obs_source_t *filter = source->filters.array[i];
+		if (filter->enabled &&
+		    !(filter->info.output_flags & OBS_SOURCE_STATIC_VIDEO)) {
+			is_static = false;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&source->filter_mutex);
+
+	return is_static;
+}
+
+static inline bool item_render_cached(const struct obs_scene_item *item,
+				      uint32_t cx, uint32_t cy,
+				      enum gs_color_space space)
+{
+	return item->render_cached && item->render_cached_cx == cx &&
+	       item->render_cached_cy == cy &&
+	       item->render_cached_space == space &&
+	       item->render_cached_gen ==
+		       os_atomic_load_long(&item->source->content_gen) &&
+	       item->render_cached_device_gen ==
+		       os_atomic_load_long(&obs->video.device_gen) &&
+	       !transition_active(item->show_transition) &&
+	       !transition_active(item->hide_transition);
+}
+
 static void render_item_texture(struct obs_scene_item *item,
 				enum gs_color_space current_space,
 				enum gs_color_space source_space)
@@ -731,7 +774,12 @@ static inline void render_item(struct obs_scene_item *item)
 	GS_DEBUG_MARKER_BEGIN_FORMAT(GS_DEBUG_COLOR_ITEM, "Item: %s",
 				     obs_source_get_name(item->source));
 
-	const bool use_texrender = item_texture_enabled(item);
+	/* static sources with filters are rendered into the item texture too,
+	 * so the filter chain does not have to run every frame */
+	const bool is_static = item_content_static(item);
+	const bool use_texrender =
+		item_texture_enabled(item) ||
+		(is_static && item->source->filters.num);
 
 	obs_source_t *const source = item->source;
 	const enum gs_color_space current_space = gs_get_color_space();
@@ -749,6 +797,7 @@ static inline void render_item(struct obs_scene_item *item)
 
 	if (!item->item_render && use_texrender) {
 		item->item_render = gs_texrender_create(format, GS_ZS_NONE);
+		item->render_cached = false;
 	}
 
 	if (item->item_render) {
@@ -761,10 +810,14 @@ static inline void render_item(struct obs_scene_item *item)
 
 		uint32_t cx = calc_cx(item, width);
 		uint32_t cy = calc_cy(item, height);
-
-		if (cx && cy &&
-		    gs_texrender_begin_with_color_space(item->item_render, cx,
-							cy, source_space)) {
+		long gen = os_atomic_load_long(&source->content_gen);
+
+		if (is_static &&
+		    item_render_cached(item, cx, cy, source_space)) {
+			/* the texture from an earlier frame is still valid */
+		} else if (cx && cy &&
+			   gs_texrender_begin_with_color_space(
+				   item->item_render, cx, cy, source_space)) {
 			float cx_scale = (float)width / (float)cx;
 			float cy_scale = (float)height / (float)cy;
 			struct vec4 clear_color;
@@ -805,6 +858,18 @@ static inline void render_item(struct obs_scene_item *item)
 			}
 
 			gs_texrender_end(item->item_render);
+
+			item->render_cached = is_static &&
+					      !transition_active(
+						      item->show_transition) &&
+					      !transition_active(
+						      item->hide_transition);
+			item->render_cached_gen = gen;
+			item->render_cached_device_gen =
+				os_atomic_load_long(&obs->video.device_gen);
+			item->render_cached_cx = cx;
+			item->render_cached_cy = cy;
+			item->render_cached_space = source_space;
 		}
 	}
 
@@ -962,6 +1027,8 @@ static void set_visibility(struct obs_scene_item *item, bool vis)
 	item->user_visible = vis;
 
 	pthread_mutex_unlock(&item->actions_mutex);
+
+	obs_invalidate_audio_render_order();
 }
 
 static void scene_load(void *data, obs_data_t *settings);
@@ -1295,7 +1362,7 @@ static void apply_scene_item_audio_actions(struct obs_scene_item *item,
 		new_frame_num = util_mul_div64(timestamp - ts, sample_rate,
 					       1000000000ULL);
 
-		if (ts && new_frame_num >= AUDIO_OUTPUT_FRAMES)
+		if (ts && new_frame_num >= obs->audio.frames)
 			break;
 
 		da_erase(item->audio_actions, i--);
@@ -1313,7 +1380,7 @@ static void apply_scene_item_audio_actions(struct obs_scene_item *item,
 	}
 
 	if (buf) {
-		for (; frame_num < AUDIO_OUTPUT_FRAMES; frame_num++)
+		for (; frame_num < obs->audio.frames; frame_num++)
 			buf[frame_num] = cur_visible ? 1.0f : 0.0f;
 	}
 
@@ -1342,7 +1409,7 @@ static bool apply_scene_item_volume(struct obs_scene_item *item, float *buf,
 	pthread_mutex_unlock(&item->actions_mutex);
 
 	if (actions_pending) {
-		uint64_t duration = util_mul_div64(AUDIO_OUTPUT_FRAMES,
+		uint64_t duration = util_mul_div64(obs->audio.frames,
 						   1000000000ULL, sample_rate);
 
 		if (!ts || action.timestamp < (ts + duration)) {
@@ -1392,10 +1459,16 @@ static bool scene_audio_render(void *data, uint64_t *ts_out,
 {
 	uint64_t timestamp = 0;
 	float buf[AUDIO_OUTPUT_FRAMES];
-	struct obs_source_audio_mix child_audio;
+	struct obs_source_audio_mix_ext child_audio;
 	struct obs_scene *scene = data;
 	struct obs_scene_item *item;
 
+	/* only valid up to num_mixes */
+	struct obs_source_audio_mix_ext *output =
+		(struct obs_source_audio_mix_ext *)audio_output;
+	size_t num_mixes =
+		obs_source_audio_render_mixes(scene->source, audio_output);
+
 	audio_lock(scene);
 
 	item = scene->first_item;
@@ -1464,7 +1537,7 @@ static bool scene_audio_render(void *data, uint64_t *ts_out,
 
 		pos = (size_t)ns_to_audio_frames(sample_rate,
 						 source_ts - timestamp);
-		count = AUDIO_OUTPUT_FRAMES - pos;
+		count = obs->audio.frames - pos;
 
 		if (!apply_buf && !item->visible &&
 		    !transition_active(item->hide_transition)) {
@@ -1472,11 +1545,11 @@ static bool scene_audio_render(void *data, uint64_t *ts_out,
 			continue;
 		}
 
-		obs_source_get_audio_mix(source, &child_audio);
+		obs_source_get_audio_mix_ext(source, &child_audio);
 
-		for (size_t mix = 0; mix < MAX_AUDIO_MIXES; mix++) {
+		for (size_t mix = 0; mix < num_mixes; mix++) {
 			for (size_t ch = 0; ch < channels; ch++) {
-				float *out = audio_output->output[mix].data[ch];
+				float *out = output->output[mix].data[ch];
 				float *in = child_audio.output[mix].data[ch];
 
 				if (apply_buf)
@@ -2149,6 +2222,8 @@ static obs_sceneitem_t *obs_scene_add_internal(obs_scene_t *scene,
 
 	full_unlock(scene);
 
+	obs_invalidate_audio_render_order();
+
 	if (!scene->source->context.private)
 		init_hotkeys(scene, item, obs_source_get_name(source));
 
@@ -50,6 +50,15 @@ struct obs_scene_item {
 	gs_texrender_t *item_render;
 	struct obs_sceneitem_crop crop;
 
+	/* item_render still holds the source's current content, see
+	 * OBS_SOURCE_STATIC_VIDEO */
+	bool render_cached;
+	long render_cached_gen;
+	long render_cached_device_gen;
+	uint32_t render_cached_cx;
+	uint32_t render_cached_cy;
+	enum gs_color_space render_cached_space;
+
 	struct vec2 pos;
 	struct vec2 scale;
 	float rot;
@@ -270,6 +270,8 @@ set_source(obs_source_t *transition, enum obs_transition_target target,
 
 	unlock_transition(transition);
 
+	obs_invalidate_audio_render_order();
+
 	if (add_success) {
 		if (transition->transition_cx == 0 ||
 		    transition->transition_cy == 0) {
@@ -409,6 +411,8 @@ bool obs_transition_start(obs_source_t *transition,
 		transition->transitioning_audio = true;
 	}
 
+	obs_invalidate_audio_render_order();
+
 	obs_source_dosignal(transition, "source_transition_start",
 			    "transition_start");
 
@@ -619,6 +623,8 @@ void obs_transition_load(obs_source_t *tr, obs_data_t *data)
 	tr->transition_cy = (uint32_t)cy;
 	unlock_transition(tr);
 
+	obs_invalidate_audio_render_order();
+
 	recalculate_transition_size(tr);
 	recalculate_transition_matrices(tr);
 }
@@ -708,6 +714,8 @@ static void obs_transition_stop(obs_source_t *transition)
 	transition->transition_source_active[1] = false;
 	transition->transition_sources[0] = transition->transition_sources[1];
 	transition->transition_sources[1] = NULL;
+
+	obs_invalidate_audio_render_order();
 }
 
 static inline void handle_stop(obs_source_t *transition)
@@ -952,12 +960,13 @@ static inline void mix_child(obs_source_t *transition, float *out, float *in,
 }
 
 static void process_audio(obs_source_t *transition, obs_source_t *child,
-			  struct obs_source_audio_mix *audio, uint64_t min_ts,
-			  uint32_t mixers, size_t channels, size_t sample_rate,
+			  struct obs_source_audio_mix_ext *audio,
+			  size_t num_mixes, uint64_t min_ts, uint32_t mixers,
+			  size_t channels, size_t sample_rate,
 			  obs_transition_audio_mix_callback_t mix)
 {
 	bool valid = child && !child->audio_pending && child->audio_ts;
-	struct obs_source_audio_mix child_audio;
+	struct obs_source_audio_mix_ext child_audio;
 	uint64_t ts;
 	size_t pos;
 
@@ -965,13 +974,13 @@ static void process_audio(obs_source_t *transition, obs_source_t *child,
 		return;
 
 	ts = child->audio_ts;
-	obs_source_get_audio_mix(child, &child_audio);
+	obs_source_get_audio_mix_ext(child, &child_audio);
 	pos = (size_t)ns_to_audio_frames(sample_rate, ts - min_ts);
 
-	if (pos > AUDIO_OUTPUT_FRAMES)
+	if (pos > obs->audio.frames)
 		return;
 
-	for (size_t mix_idx = 0; mix_idx < MAX_AUDIO_MIXES; mix_idx++) {
+	for (size_t mix_idx = 0; mix_idx < num_mixes; mix_idx++) {
 		struct audio_output_data *output = &audio->output[mix_idx];
 		struct audio_output_data *input = &child_audio.output[mix_idx];
 		for (size_t ch = 0; ch < channels; ch++) {
@@ -979,12 +988,26 @@ static void process_audio(obs_source_t *transition, obs_source_t *child,
 			float *in = input->data[ch];
 
 			mix_child(transition, out + pos, in,
-				  AUDIO_OUTPUT_FRAMES - pos, sample_rate, ts,
+				  obs->audio.frames - pos, sample_rate, ts,
 				  mix);
 		}
 	}
 }
 
+static void copy_audio(struct obs_source_audio_mix_ext *audio,
+		       size_t num_mixes, obs_source_t *child, size_t channels)
+{
+	struct obs_source_audio_mix_ext child_audio;
+	obs_source_get_audio_mix_ext(child, &child_audio);
+
+	for (size_t mix_idx = 0; mix_idx < num_mixes; mix_idx++) {
+		for (size_t ch = 0; ch < channels; ch++)
+			memcpy(audio->output[mix_idx].data[ch],
+			       child_audio.output[mix_idx].data[ch],
+			       obs->audio.frames * sizeof(float));
+	}
+}
+
 static inline uint64_t calc_min_ts(obs_source_t *sources[2])
 {
 	uint64_t min_ts = 0;
@@ -1020,6 +1043,8 @@ bool obs_transition_audio_render(obs_source_t *transition, uint64_t *ts_out,
 {
 	obs_source_t *sources[2];
 	struct transition_state state = {0};
+	struct obs_source_audio_mix_ext *output;
+	size_t num_mixes;
 	bool stopped = false;
 	uint64_t min_ts;
 	float t;
@@ -1027,6 +1052,12 @@ bool obs_transition_audio_render(obs_source_t *transition, uint64_t *ts_out,
 	if (!transition_valid(transition, "obs_transition_audio_render"))
 		return false;
 
+	/* 'audio' usually is the mix libobs passed to the transition's
+	 * audio_render, but plugins may pass their own.  only valid up to
+	 * num_mixes. */
+	output = (struct obs_source_audio_mix_ext *)audio;
+	num_mixes = obs_source_audio_render_mixes(transition, audio);
+
 	lock_transition(transition);
 
 	sources[0] = transition->transition_sources[0];
@@ -1056,17 +1087,15 @@ bool obs_transition_audio_render(obs_source_t *transition, uint64_t *ts_out,
 	if (min_ts) {
 		if (state.transitioning_audio) {
 			if (state.s[0])
-				process_audio(transition, state.s[0], audio,
-					      min_ts, mixers, channels,
-					      sample_rate, mix_a);
+				process_audio(transition, state.s[0], output,
+					      num_mixes, min_ts, mixers,
+					      channels, sample_rate, mix_a);
 			if (state.s[1])
-				process_audio(transition, state.s[1], audio,
-					      min_ts, mixers, channels,
-					      sample_rate, mix_b);
+				process_audio(transition, state.s[1], output,
+					      num_mixes, min_ts, mixers,
+					      channels, sample_rate, mix_b);
 		} else if (state.s[0]) {
-			memcpy(audio->output[0].data[0],
-			       state.s[0]->audio_output_buf[0][0],
-			       TOTAL_AUDIO_SIZE);
+			copy_audio(output, num_mixes, state.s[0], channels);
 		}
 
 		obs_source_release(state.s[0]);
@@ -1136,6 +1165,8 @@ void obs_transition_swap_begin(obs_source_t *tr_dest, obs_source_t *tr_source)
 	unlock_transition(tr_dest);
 	unlock_transition(tr_source);
 
+	obs_invalidate_audio_render_order();
+
 	for (size_t i = 0; i < 2; i++)
 		obs_source_release(old_children[i]);
 }
@@ -136,20 +136,119 @@ const char *obs_source_get_display_name(const char *id)
 	return (info != NULL) ? info->get_name(info->type_data) : NULL;
 }
 
-static void allocate_audio_output_buffer(struct obs_source *source)
+/* read-only silence handed out for mixes and channels a source has no
+ * buffer for */
+static float silent_mix_buf[AUDIO_OUTPUT_FRAMES];
+
+/* write-only scratch for audio_render callbacks filling mixes past the
+ * active count; custom audio rendering is never run in parallel */
+static float discard_mix_buf[AUDIO_OUTPUT_FRAMES];
+
+static inline uint32_t get_active_mixes_mask(void)
 {
-	size_t size = sizeof(float) * AUDIO_OUTPUT_FRAMES * MAX_AUDIO_CHANNELS *
-		      MAX_AUDIO_MIXES;
-	float *ptr = bzalloc(size);
+	size_t num_mixes = obs->audio.num_mixes;
+	return num_mixes >= 32 ? 0xFFFFFFFF : (1U << num_mixes) - 1;
+}
+
+static void free_audio_output_mem(struct obs_source *source)
+{
+	for (size_t mix = 0; mix < MAX_AUDIO_TRACKS; mix++) {
+		bfree(source->audio_output_mem[mix]);
+		source->audio_output_mem[mix] = NULL;
+		source->audio_output_users[mix] = 0;
+	}
+}
+
+static inline void set_audio_output_view(struct obs_source *source,
+					 size_t mix, float *mem)
+{
+	for (size_t ch = 0; ch < MAX_AUDIO_CHANNELS; ch++)
+		source->audio_output_buf[mix][ch] =
+			mem && ch < source->audio_output_channels
+				? mem + AUDIO_OUTPUT_FRAMES * ch
+				: silent_mix_buf;
+}
+
+/*
+ * Points audio_output_buf of every mix at its storage, reallocating it if
+ * the channel count changed.
+ *
+ * Plain inputs render the same audio to every mix they are routed to, so
+ * those mixes share the single buffer the input audio is read into
+ * (audio_output_mem[0]) and the others read silence.  Custom audio_render
+ * sources fill each mix themselves and get a buffer per active mix.
+ *
+ * Called by whichever thread renders the source's audio for the tick: the
+ * audio thread, or an audio worker for plain inputs (see audio_callback).
+ * A source is only rendered by one thread per tick, and anything else that
+ * reads the buffers either holds audio_buf_mutex (mix_audio) or runs on the
+ * audio thread after the workers have been joined (scenes, transitions).
+ * Changes to the buffers are therefore made with audio_buf_mutex held.
+ */
+static void update_audio_output_mixes(struct obs_source *source,
+				      size_t channels)
+{
+	bool composite = !!source->info.audio_render;
+	size_t size = sizeof(float) * AUDIO_OUTPUT_FRAMES * channels;
+	uint32_t routing;
+
+	if (composite)
+		routing = get_active_mixes_mask();
+	else if (source->info.output_flags & OBS_SOURCE_SUBMIX)
+		routing = (source->audio_mixers & 1) ? 0x3 : 0x1;
+	else
+		routing = source->audio_mixers & get_active_mixes_mask();
+
+	if (channels == source->audio_output_channels &&
+	    source->audio_output_mem[0] &&
+	    routing == source->audio_output_routing)
+		return;
+
+	pthread_mutex_lock(&source->audio_buf_mutex);
+
+	if (channels != source->audio_output_channels) {
+		free_audio_output_mem(source);
+		source->audio_output_channels = channels;
+	}
 
-	for (size_t mix = 0; mix < MAX_AUDIO_MIXES; mix++) {
-		size_t mix_pos = mix * AUDIO_OUTPUT_FRAMES * MAX_AUDIO_CHANNELS;
+	source->audio_output_routing = routing;
 
-		for (size_t i = 0; i < MAX_AUDIO_CHANNELS; i++) {
-			source->audio_output_buf[mix][i] =
-				ptr + mix_pos + AUDIO_OUTPUT_FRAMES * i;
+	for (size_t mix = 0; mix < MAX_AUDIO_TRACKS; mix++) {
+		uint32_t mix_and_val = (1U << mix);
+		bool wants_mem = mix == 0 ||
+				 (composite && (mix_and_val & routing) != 0);
+		float *mem;
+
+		if (wants_mem && !source->audio_output_mem[mix]) {
+			source->audio_output_mem[mix] = bzalloc(size);
+		} else if (!wants_mem && source->audio_output_mem[mix]) {
+			bfree(source->audio_output_mem[mix]);
+			source->audio_output_mem[mix] = NULL;
+		}
+
+		if (composite) {
+			mem = source->audio_output_mem[mix];
+			source->audio_output_users[mix] = mem ? mix_and_val : 0;
+		} else {
+			mem = (routing & mix_and_val)
+				      ? source->audio_output_mem[0]
+				      : NULL;
 		}
+
+		set_audio_output_view(source, mix, mem);
 	}
+
+	if (!composite)
+		source->audio_output_users[0] = routing;
+
+	pthread_mutex_unlock(&source->audio_buf_mutex);
+}
+
+static void allocate_audio_output_buffer(struct obs_source *source)
+{
+	size_t channels = audio_output_get_channels(obs->audio.audio);
+	update_audio_output_mixes(source,
+				  channels ? channels : MAX_AUDIO_CHANNELS);
 }
 
 static void allocate_audio_mix_buffer(struct obs_source *source)
@@ -225,11 +324,62 @@ static bool obs_source_init(struct obs_source *source)
 
 	source->deinterlace_top_first = true;
 	source->audio_mixers = 0xFF;
+	source->tick_idx = DARRAY_INVALID;
 
 	source->private_settings = obs_data_create();
 	return true;
 }
 
+void obs_source_tick_list_add(obs_source_t *source)
+{
+	struct obs_core_data *data = &obs->data;
+
+	pthread_mutex_lock(&data->ticking_sources_mutex);
+	if (source->tick_idx == DARRAY_INVALID) {
+		source->tick_idx = data->ticking_sources.num;
+		da_push_back(data->ticking_sources, &source);
+	}
+	pthread_mutex_unlock(&data->ticking_sources_mutex);
+}
+
+static void tick_list_remove_locked(obs_source_t *source)
+{
+	struct obs_core_data *data = &obs->data;
+	size_t idx = source->tick_idx;
+	size_t last = data->ticking_sources.num - 1;
+
+	if (idx == DARRAY_INVALID)
+		return;
+
+	if (idx != last) {
+		obs_source_t *moved = data->ticking_sources.array[last];
+		data->ticking_sources.array[idx] = moved;
+		moved->tick_idx = idx;
+	}
+
+	da_pop_back(data->ticking_sources);
+	source->tick_idx = DARRAY_INVALID;
+}
+
+static void obs_source_tick_list_remove(obs_source_t *source)
+{
+	pthread_mutex_lock(&obs->data.ticking_sources_mutex);
+	tick_list_remove_locked(source);
+	pthread_mutex_unlock(&obs->data.ticking_sources_mutex);
+}
+
+/* called on the graphics thread after the source has been ticked.  Anything
+ * that makes obs_source_has_video_tick() true again changes the source state
+ * before calling obs_source_tick_list_add(), so checking under the list lock
+ * cannot lose a source. */
+void obs_source_tick_list_prune(obs_source_t *source)
+{
+	pthread_mutex_lock(&obs->data.ticking_sources_mutex);
+	if (!obs_source_has_video_tick(source))
+		tick_list_remove_locked(source);
+	pthread_mutex_unlock(&obs->data.ticking_sources_mutex);
+}
+
 static void obs_source_init_finalize(struct obs_source *source)
 {
 	if (is_audio_source(source)) {
@@ -243,10 +393,13 @@ static void obs_source_init_finalize(struct obs_source *source)
 		obs->data.first_audio_source = source;
 
 		pthread_mutex_unlock(&obs->data.audio_sources_mutex);
+
+		obs_invalidate_audio_render_order();
 	}
 
 	obs_context_data_insert(&source->context, &obs->data.sources_mutex,
 				&obs->data.first_source);
+	obs_source_tick_list_add(source);
 }
 
 static bool obs_source_hotkey_mute(void *data, obs_hotkey_pair_id id,
@@ -715,6 +868,7 @@ void obs_source_destroy(struct obs_source *source)
 		obs_source_filter_remove(source, source->filters.array[0]);
 
 	obs_context_data_remove(&source->context);
+	obs_source_tick_list_remove(source);
 
 	/* defer source destroy */
 	os_task_queue_queue_task(obs->destruction_task_thread,
@@ -766,10 +920,9 @@ static void obs_source_destroy_defer(struct obs_source *source)
 
 	for (i = 0; i < MAX_AV_PLANES; i++)
 		bfree(source->audio_data.data[i]);
-	for (i = 0; i < MAX_AUDIO_CHANNELS; i++)
-		circlebuf_free(&source->audio_input_buf[i]);
+	float_ring_free(&source->audio_input_buf);
 	audio_resampler_destroy(source->resampler);
-	bfree(source->audio_output_buf[0][0]);
+	free_audio_output_mem(source);
 	bfree(source->audio_mix_buf[0]);
 
 	obs_source_frame_destroy(source->async_preload_frame);
@@ -821,9 +974,16 @@ void obs_source_release(obs_source_t *source)
 		return;
 
 	obs_weak_source_t *control = get_weak(source);
-	if (obs_ref_release(&control->ref)) {
+	bool render_cached = os_atomic_load_bool(&source->audio_render_cached);
+	long refs = os_atomic_dec_long(&control->ref.refs);
+
+	if (refs == -1) {
 		obs_source_destroy(source);
 		obs_weak_source_release(control);
+
+		/* only the cached audio render order still holds it */
+	} else if (refs == 0 && render_cached) {
+		obs_invalidate_audio_render_order();
 	}
 }
 
@@ -1023,9 +1183,23 @@ static void obs_source_deferred_update(obs_source_t *source)
 				    source->context.settings);
 		os_atomic_compare_swap_long(&source->defer_update_count, count,
 					    0);
+		obs_source_content_changed(source);
 	}
 }
 
+void obs_source_content_changed(obs_source_t *source)
+{
+	if (!obs_source_valid(source, "obs_source_content_changed"))
+		return;
+
+	os_atomic_inc_long(&source->content_gen);
+
+	/* a filter changes what its parent renders */
+	obs_source_t *parent = source->filter_parent;
+	if (parent)
+		os_atomic_inc_long(&parent->content_gen);
+}
+
 void obs_source_update(obs_source_t *source, obs_data_t *settings)
 {
 	if (!obs_source_valid(source, "obs_source_update"))
@@ -1037,6 +1211,7 @@ void obs_source_update(obs_source_t *source, obs_data_t *settings)
 
 	if (source->info.output_flags & OBS_SOURCE_VIDEO) {
 		os_atomic_inc_long(&source->defer_update_count);
+		obs_source_tick_list_add(source);
 	} else if (source->context.data && source->info.update) {
 		source->info.update(source->context.data,
 				    source->context.settings);
@@ -1174,6 +1349,7 @@ static void activate_tree(obs_source_t *parent, obs_source_t *child,
 			  void *param)
 {
 	os_atomic_inc_long(&child->activate_refs);
+	obs_source_tick_list_add(child);
 
 	UNUSED_PARAMETER(parent);
 	UNUSED_PARAMETER(param);
@@ -1183,6 +1359,7 @@ static void deactivate_tree(obs_source_t *parent, obs_source_t *child,
 			    void *param)
 {
 	os_atomic_dec_long(&child->activate_refs);
+	obs_source_tick_list_add(child);
 
 	UNUSED_PARAMETER(parent);
 	UNUSED_PARAMETER(param);
@@ -1191,6 +1368,7 @@ static void deactivate_tree(obs_source_t *parent, obs_source_t *child,
 static void show_tree(obs_source_t *parent, obs_source_t *child, void *param)
 {
 	os_atomic_inc_long(&child->show_refs);
+	obs_source_tick_list_add(child);
 
 	UNUSED_PARAMETER(parent);
 	UNUSED_PARAMETER(param);
@@ -1199,6 +1377,7 @@ static void show_tree(obs_source_t *parent, obs_source_t *child, void *param)
 static void hide_tree(obs_source_t *parent, obs_source_t *child, void *param)
 {
 	os_atomic_dec_long(&child->show_refs);
+	obs_source_tick_list_add(child);
 
 	UNUSED_PARAMETER(parent);
 	UNUSED_PARAMETER(param);
@@ -1216,6 +1395,8 @@ void obs_source_activate(obs_source_t *source, enum view_type type)
 		os_atomic_inc_long(&source->activate_refs);
 		obs_source_enum_active_tree(source, activate_tree, NULL);
 	}
+
+	obs_source_tick_list_add(source);
 }
 
 void obs_source_deactivate(obs_source_t *source, enum view_type type)
@@ -1235,6 +1416,8 @@ void obs_source_deactivate(obs_source_t *source, enum view_type type)
 						    NULL);
 		}
 	}
+
+	obs_source_tick_list_add(source);
 }
 
 static inline struct obs_source_frame *get_closest_frame(obs_source_t *source,
@@ -1242,7 +1425,11 @@ static inline struct obs_source_frame *get_closest_frame(obs_source_t *source,
 bool set_async_texture_size(struct obs_source *source,
 			    const struct obs_source_frame *frame);
 
-static void async_tick(obs_source_t *source)
+/* picks the frame to show this tick.  This only touches the source's own
+ * async state, so tick_sources() runs it for all async sources on
+ * obs->video.worker_pool before the sources are ticked on the graphics
+ * thread. */
+void obs_source_async_pretick(obs_source_t *source)
 {
 	uint64_t sys_time = obs->video.video_time;
 
@@ -1261,12 +1448,33 @@ static void async_tick(obs_source_t *source)
 
 	source->last_sys_timestamp = sys_time;
 	pthread_mutex_unlock(&source->async_mutex);
+}
 
+static void async_tick(obs_source_t *source)
+{
 	if (source->cur_async_frame)
 		source->async_update_texture =
 			set_async_texture_size(source, source->cur_async_frame);
 }
 
+/* whether obs_source_video_tick() has anything to do for the source */
+bool obs_source_has_video_tick(const obs_source_t *source)
+{
+	if (source->context.data && source->info.video_tick)
+		return true;
+	if (source->info.type == OBS_SOURCE_TYPE_TRANSITION)
+		return true;
+	if ((source->info.output_flags & OBS_SOURCE_ASYNC) != 0)
+		return true;
+	if (source->filter_texrender)
+		return true;
+	if (os_atomic_load_long(&source->defer_update_count) > 0)
+		return true;
+
+	return !!source->show_refs != source->showing ||
+	       !!source->activate_refs != source->active;
+}
+
 void obs_source_video_tick(obs_source_t *source, float seconds)
 {
 	bool now_showing, now_active;
@@ -1359,7 +1567,8 @@ static inline size_t conv_time_to_frames(const size_t sample_rate,
 }
 
 /* maximum buffer size */
-#define MAX_BUF_SIZE (1000 * AUDIO_OUTPUT_FRAMES * sizeof(float))
+#define MAX_BUF_FRAMES (1000 * AUDIO_OUTPUT_FRAMES)
+#define INITIAL_BUF_FRAMES (16 * AUDIO_OUTPUT_FRAMES)
 
 /* time threshold in nanoseconds to ensure audio timing is as seamless as
  * possible */
@@ -1372,13 +1581,11 @@ static inline void reset_audio_timing(obs_source_t *source, uint64_t timestamp,
 	source->timing_adjust = os_time - timestamp;
 }
 
+/* must be called with audio_buf_mutex held */
 static void reset_audio_data(obs_source_t *source, uint64_t os_time)
 {
-	for (size_t i = 0; i < MAX_AUDIO_CHANNELS; i++) {
-		if (source->audio_input_buf[i].size)
-			circlebuf_pop_front(&source->audio_input_buf[i], NULL,
-					    source->audio_input_buf[i].size);
-	}
+	float_ring_pop_front(&source->audio_input_buf,
+			     float_ring_size(&source->audio_input_buf));
 
 	source->last_audio_input_buf_size = 0;
 	source->audio_ts = os_time;
@@ -1423,58 +1630,62 @@ static inline size_t get_buf_placement(audio_t *audio, uint64_t offset)
 	return (size_t)util_mul_div64(offset, sample_rate, 1000000000ULL);
 }
 
+/* must be called with audio_buf_mutex held */
+static inline void reserve_audio_input_buf(obs_source_t *source,
+					   size_t frames)
+{
+	size_t channels = audio_output_get_channels(obs->audio.audio);
+
+	if (frames < INITIAL_BUF_FRAMES)
+		frames = INITIAL_BUF_FRAMES;
+	float_ring_reserve(&source->audio_input_buf, channels, frames);
+}
+
+/* must be called with audio_buf_mutex held */
 static void source_output_audio_place(obs_source_t *source,
 				      const struct audio_data *in)
 {
 	audio_t *audio = obs->audio.audio;
 	size_t buf_placement;
-	size_t channels = audio_output_get_channels(audio);
-	size_t size = in->frames * sizeof(float);
 
 	if (!source->audio_ts || in->timestamp < source->audio_ts)
 		reset_audio_data(source, in->timestamp);
 
 	buf_placement =
-		get_buf_placement(audio, in->timestamp - source->audio_ts) *
-		sizeof(float);
+		get_buf_placement(audio, in->timestamp - source->audio_ts);
 
 #if DEBUG_AUDIO == 1
 	blog(LOG_DEBUG,
 	     "frames: %lu, size: %lu, placement: %lu, base_ts: %llu, ts: %llu",
 	     (unsigned long)in->frames,
-	     (unsigned long)source->audio_input_buf[0].size,
+	     (unsigned long)float_ring_size(&source->audio_input_buf),
 	     (unsigned long)buf_placement, source->audio_ts, in->timestamp);
 #endif
 
 	/* do not allow the circular buffers to become too big */
-	if ((buf_placement + size) > MAX_BUF_SIZE)
+	if ((buf_placement + in->frames) > MAX_BUF_FRAMES)
 		return;
 
-	for (size_t i = 0; i < channels; i++) {
-		circlebuf_place(&source->audio_input_buf[i], buf_placement,
-				in->data[i], size);
-		circlebuf_pop_back(&source->audio_input_buf[i], NULL,
-				   source->audio_input_buf[i].size -
-					   (buf_placement + size));
-	}
+	reserve_audio_input_buf(source, buf_placement + in->frames);
+	float_ring_place(&source->audio_input_buf, buf_placement,
+			 (const uint8_t *const *)in->data, in->frames);
 
 	source->last_audio_input_buf_size = 0;
 }
 
+/* must be called with audio_buf_mutex held */
 static inline void source_output_audio_push_back(obs_source_t *source,
 						 const struct audio_data *in)
 {
-	audio_t *audio = obs->audio.audio;
-	size_t channels = audio_output_get_channels(audio);
-	size_t size = in->frames * sizeof(float);
+	size_t size = float_ring_size(&source->audio_input_buf);
 
 	/* do not allow the circular buffers to become too big */
-	if ((source->audio_input_buf[0].size + size) > MAX_BUF_SIZE)
+	if ((size + in->frames) > MAX_BUF_FRAMES)
 		return;
 
-	for (size_t i = 0; i < channels; i++)
-		circlebuf_push_back(&source->audio_input_buf[i], in->data[i],
-				    size);
+	reserve_audio_input_buf(source, size + in->frames);
+	float_ring_push_back(&source->audio_input_buf,
+			     (const uint8_t *const *)in->data, in->frames);
 
 	/* reset audio input buffer size to ensure that audio doesn't get
 	 * perpetually cut */
@@ -1549,8 +1760,6 @@ static void source_output_audio_data(obs_source_t *source,
 
 	in.timestamp += source->timing_adjust;
 
-	pthread_mutex_lock(&source->audio_buf_mutex);
-
 	if (source->next_audio_sys_ts_min == in.timestamp) {
 		push_back = true;
 
@@ -1586,14 +1795,16 @@ static void source_output_audio_data(obs_source_t *source,
 	}
 
 	if (obs_source_get_sends(source)) {
+		/* audio_ts and last_audio_input_buf_size are shared with the
+		 * audio thread, so even a plain append takes the lock */
+		pthread_mutex_lock(&source->audio_buf_mutex);
 		if (push_back && source->audio_ts)
 			source_output_audio_push_back(source, &in);
 		else
 			source_output_audio_place(source, &in);
+		pthread_mutex_unlock(&source->audio_buf_mutex);
 	}
 
-	pthread_mutex_unlock(&source->audio_buf_mutex);
-
 	source_signal_audio_data(source, data, source_muted(source, os_time));
 }
 
@@ -2984,6 +3195,9 @@ void obs_source_filter_add(obs_source_t *source, obs_source_t *filter)
 
 	pthread_mutex_unlock(&source->filter_mutex);
 
+	obs_invalidate_audio_render_order();
+	obs_source_content_changed(source);
+
 	calldata_init_fixed(&cd, stack, sizeof(stack));
 	calldata_set_ptr(&cd, "source", source);
 	calldata_set_ptr(&cd, "filter", filter);
@@ -3018,6 +3232,9 @@ static bool obs_source_filter_remove_refless(obs_source_t *source,
 
 	pthread_mutex_unlock(&source->filter_mutex);
 
+	obs_invalidate_audio_render_order();
+	obs_source_content_changed(source);
+
 	calldata_init_fixed(&cd, stack, sizeof(stack));
 	calldata_set_ptr(&cd, "source", source);
 	calldata_set_ptr(&cd, "filter", filter);
@@ -3145,8 +3362,10 @@ void obs_source_filter_set_order(obs_source_t *source, obs_source_t *filter,
 	success = move_filter_dir(source, filter, movement);
 	pthread_mutex_unlock(&source->filter_mutex);
 
-	if (success)
+	if (success) {
+		obs_source_content_changed(source);
 		obs_source_dosignal(source, NULL, "reorder_filters");
+	}
 }
 
 obs_data_t *obs_source_get_settings(const obs_source_t *source)
@@ -3815,11 +4034,10 @@ static void copy_audio_data(obs_source_t *source, const uint8_t *const data[],
 }
 
 /* TODO: SSE optimization */
-static void downmix_to_mono_planar(struct obs_source *source, uint32_t frames)
+static void downmix_to_mono_planar(float **data, uint32_t frames)
 {
 	size_t channels = audio_output_get_channels(obs->audio.audio);
 	const float channels_i = 1.0f / (float)channels;
-	float **data = (float **)source->audio_data.data;
 
 	for (size_t channel = 1; channel < channels; channel++) {
 		for (uint32_t frame = 0; frame < frames; frame++)
@@ -3835,11 +4053,9 @@ static void downmix_to_mono_planar(struct obs_source *source, uint32_t frames)
 	}
 }
 
-static void process_audio_balancing(struct obs_source *source, uint32_t frames,
+static void process_audio_balancing(float **data, uint32_t frames,
 				    float balance, enum obs_balance_type type)
 {
-	float **data = (float **)source->audio_data.data;
-
 	switch (type) {
 	case OBS_BALANCE_TYPE_SINE_LAW:
 		for (uint32_t frame = 0; frame < frames; frame++) {
@@ -3901,12 +4117,14 @@ static void process_audio(obs_source_t *source,
 
 	if (!mono_output && source->sample_info.speakers == SPEAKERS_STEREO &&
 	    (source->balance > 0.51f || source->balance < 0.49f)) {
-		process_audio_balancing(source, frames, source->balance,
+		process_audio_balancing((float **)source->audio_data.data,
+					frames, source->balance,
 					OBS_BALANCE_TYPE_SINE_LAW);
 	}
 
 	if (!mono_output && (source->flags & OBS_SOURCE_FLAG_FORCE_MONO) != 0)
-		downmix_to_mono_planar(source, frames);
+		downmix_to_mono_planar((float **)source->audio_data.data,
+				       frames);
 }
 
 struct obs_audio_data *
@@ -3946,6 +4164,90 @@ obs_source_output_audio_track(obs_source_t *source,
 	return output;
 }
 
+static inline bool balance_centered(const obs_source_t *source)
+{
+	return source->balance <= 0.51f && source->balance >= 0.49f;
+}
+
+/* nothing would touch or look at the mix: no filters, no balance or mono
+ * downmix, and no audio capture callbacks.  read without locks, a filter or
+ * callback added meanwhile is picked up on the next tick. */
+static inline bool audio_track_passthrough(const obs_source_t *source,
+					   size_t channels)
+{
+	return !source->filters.num && !source->audio_cb_list.num &&
+	       (channels != 2 || balance_centered(source)) &&
+	       (channels == 1 ||
+		(source->flags & OBS_SOURCE_FLAG_FORCE_MONO) == 0);
+}
+
+/* processes a track mix in place: the filters of the track source run
+ * directly on the mix buffers, and the result is only copied back if a filter
+ * hands back its own buffer.  returns false if the track should be muted. */
+bool obs_source_process_audio_track(obs_source_t *source, float *data[],
+				    size_t channels, uint64_t timestamp)
+{
+	struct obs_audio_data in = {0};
+	struct obs_audio_data *output;
+	struct audio_data signal_data;
+	bool mono_output = channels == 1;
+
+	if (!source)
+		return false;
+	if (audio_track_passthrough(source, channels))
+		return true;
+
+	if (!mono_output && channels == 2 && !balance_centered(source)) {
+		process_audio_balancing(data, obs->audio.frames,
+					source->balance,
+					OBS_BALANCE_TYPE_SINE_LAW);
+	}
+
+	if (!mono_output && (source->flags & OBS_SOURCE_FLAG_FORCE_MONO) != 0)
+		downmix_to_mono_planar(data, obs->audio.frames);
+
+	for (size_t ch = 0; ch < channels; ch++)
+		in.data[ch] = (uint8_t *)data[ch];
+	in.frames = obs->audio.frames;
+	in.timestamp = timestamp;
+
+	pthread_mutex_lock(&source->filter_mutex);
+
+	output = source->filters.num ? filter_async_audio(source, &in) : &in;
+	if (!output) {
+		pthread_mutex_unlock(&source->filter_mutex);
+		return false;
+	}
+
+	if (output != &in) {
+		size_t frames = output->frames < obs->audio.frames
+					? output->frames
+					: obs->audio.frames;
+
+		for (size_t ch = 0; ch < channels; ch++) {
+			if (output->data[ch] != (uint8_t *)data[ch])
+				memcpy(data[ch], output->data[ch],
+				       frames * sizeof(float));
+			if (frames < obs->audio.frames)
+				memset(data[ch] + frames, 0,
+				       (obs->audio.frames - frames) *
+					       sizeof(float));
+		}
+	}
+
+	pthread_mutex_unlock(&source->filter_mutex);
+
+	for (size_t ch = 0; ch < MAX_AV_PLANES; ch++)
+		signal_data.data[ch] = ch < channels ? (uint8_t *)data[ch]
+						     : NULL;
+	signal_data.frames = obs->audio.frames;
+	signal_data.timestamp = timestamp;
+
+	source_signal_audio_data(source, &signal_data,
+				 source_muted(source, os_gettime_ns()));
+	return true;
+}
+
 void obs_source_output_audio(obs_source_t *source,
 			     const struct obs_source_audio *audio_in)
 {
@@ -4336,6 +4638,7 @@ bool obs_source_process_filter_begin_with_color_space(
 	if (!filter->filter_texrender) {
 		filter->filter_texrender =
 			gs_texrender_create(format, GS_ZS_NONE);
+		obs_source_tick_list_add(filter);
 	}
 
 	if (gs_texrender_begin_with_color_space(filter->filter_texrender, cx,
@@ -4705,6 +5008,7 @@ bool obs_source_add_active_child(obs_source_t *parent, obs_source_t *child)
 		obs_source_activate(child, type);
 	}
 
+	obs_invalidate_audio_render_order();
 	return true;
 }
 
@@ -4720,6 +5024,8 @@ void obs_source_remove_active_child(obs_source_t *parent, obs_source_t *child)
 		type = (i < parent->activate_refs) ? MAIN_VIEW : AUX_VIEW;
 		obs_source_deactivate(child, type);
 	}
+
+	obs_invalidate_audio_render_order();
 }
 
 void obs_source_save(obs_source_t *source)
@@ -5017,6 +5323,7 @@ void obs_source_set_enabled(obs_source_t *source, bool enabled)
 		return;
 
 	source->enabled = enabled;
+	obs_source_content_changed(source);
 
 	calldata_init_fixed(&data, stack, sizeof(stack));
 	calldata_set_ptr(&data, "source", source);
@@ -5255,22 +5562,26 @@ static float get_source_volume(obs_source_t *source, uint64_t os_time)
 	return source->volume;
 }
 
-static inline void multiply_output_audio(obs_source_t *source, size_t mix,
+static inline void multiply_output_audio(obs_source_t *source, size_t idx,
 					 size_t channels, float vol)
 {
-	register float *out = source->audio_output_buf[mix][0];
-	register float *end = out + AUDIO_OUTPUT_FRAMES * channels;
+	for (size_t ch = 0; ch < channels; ch++) {
+		register float *out = source->audio_output_mem[idx] +
+				      AUDIO_OUTPUT_FRAMES * ch;
+		register float *end = out + obs->audio.frames;
 
-	while (out < end)
-		*(out++) *= vol;
+		while (out < end)
+			*(out++) *= vol;
+	}
 }
 
-static inline void multiply_vol_data(obs_source_t *source, size_t mix,
+static inline void multiply_vol_data(obs_source_t *source, size_t idx,
 				     size_t channels, float *vol_data)
 {
 	for (size_t ch = 0; ch < channels; ch++) {
-		register float *out = source->audio_output_buf[mix][ch];
-		register float *end = out + AUDIO_OUTPUT_FRAMES;
+		register float *out = source->audio_output_mem[idx] +
+				      AUDIO_OUTPUT_FRAMES * ch;
+		register float *end = out + obs->audio.frames;
 		register float *vol = vol_data;
 
 		while (out < end)
@@ -5320,7 +5631,7 @@ static void apply_audio_actions(obs_source_t *source, size_t channels,
 		new_frame_num = conv_time_to_frames(
 			sample_rate, timestamp - source->audio_ts);
 
-		if (new_frame_num >= AUDIO_OUTPUT_FRAMES)
+		if (new_frame_num >= obs->audio.frames)
 			break;
 
 		da_erase(source->audio_actions, i--);
@@ -5335,14 +5646,16 @@ static void apply_audio_actions(obs_source_t *source, size_t channels,
 		cur_vol = get_source_volume(source, timestamp);
 	}
 
-	for (; frame_num < AUDIO_OUTPUT_FRAMES; frame_num++)
+	for (; frame_num < obs->audio.frames; frame_num++)
 		vol_data[frame_num] = cur_vol;
 
 	pthread_mutex_unlock(&source->audio_actions_mutex);
 
-	for (size_t mix = 0; mix < MAX_AUDIO_MIXES; mix++) {
-		if ((source->audio_mixers & (1 << mix)) != 0)
-			multiply_vol_data(source, mix, channels, vol_data);
+	/* mixes sharing a buffer get the volume applied only once */
+	for (size_t idx = 0; idx < obs->audio.num_mixes; idx++) {
+		uint32_t users = source->audio_output_users[idx];
+		if ((source->audio_mixers & users) != 0)
+			multiply_vol_data(source, idx, channels, vol_data);
 	}
 }
 
@@ -5363,7 +5676,7 @@ static void apply_audio_volume(obs_source_t *source, uint32_t mixers,
 
 	if (actions_pending) {
 		uint64_t duration =
-			conv_frames_to_time(sample_rate, AUDIO_OUTPUT_FRAMES);
+			conv_frames_to_time(sample_rate, obs->audio.frames);
 
 		if (action.timestamp < (source->audio_ts + duration)) {
 			apply_audio_actions(source, channels, sample_rate);
@@ -5376,39 +5689,58 @@ static void apply_audio_volume(obs_source_t *source, uint32_t mixers,
 		return;
 
 	if (vol == 0.0f || mixers == 0) {
-		memset(source->audio_output_buf[0][0], 0,
-		       AUDIO_OUTPUT_FRAMES * sizeof(float) *
-			       MAX_AUDIO_CHANNELS * MAX_AUDIO_MIXES);
+		for (size_t idx = 0; idx < obs->audio.num_mixes; idx++) {
+			float *mem = source->audio_output_mem[idx];
+			if (!mem)
+				continue;
+			for (size_t ch = 0; ch < channels; ch++)
+				memset(mem + AUDIO_OUTPUT_FRAMES * ch, 0,
+				       obs->audio.frames * sizeof(float));
+		}
 		return;
 	}
 
-	for (size_t mix = 0; mix < MAX_AUDIO_MIXES; mix++) {
-		uint32_t mix_and_val = (1 << mix);
-		if ((source->audio_mixers & mix_and_val) != 0 &&
-		    (mixers & mix_and_val) != 0)
-			multiply_output_audio(source, mix, channels, vol);
+	for (size_t idx = 0; idx < obs->audio.num_mixes; idx++) {
+		if ((source->audio_mixers & mixers &
+		     source->audio_output_users[idx]) != 0)
+			multiply_output_audio(source, idx, channels, vol);
 	}
 }
 
 static void custom_audio_render(obs_source_t *source, uint32_t mixers,
 				size_t channels, size_t sample_rate)
 {
-	struct obs_source_audio_mix audio_data;
+	struct obs_source_audio_mix_ext audio_data;
 	bool success;
 	uint64_t ts;
 
-	for (size_t mix = 0; mix < MAX_AUDIO_MIXES; mix++) {
+	for (size_t mix = 0; mix < MAX_AUDIO_TRACKS; mix++) {
+		/* callbacks may fill every mix up to MAX_AUDIO_MIXES, the
+		 * ones past the active count go to a scratch buffer */
+		if (mix >= obs->audio.num_mixes) {
+			for (size_t ch = 0; ch < channels; ch++)
+				audio_data.output[mix].data[ch] =
+					discard_mix_buf;
+			continue;
+		}
+
 		for (size_t ch = 0; ch < channels; ch++) {
 			audio_data.output[mix].data[ch] =
 				source->audio_output_buf[mix][ch];
+			memset(source->audio_output_buf[mix][ch], 0,
+			       sizeof(float) * obs->audio.frames);
 		}
-		memset(source->audio_output_buf[mix][0], 0,
-		       sizeof(float) * AUDIO_OUTPUT_FRAMES * channels);
 	}
 
-	success = source->info.audio_render(source->context.data, &ts,
-					    &audio_data, mixers, channels,
-					    sample_rate);
+	/* plugins only see the first MAX_AUDIO_MIXES mixes.  libobs' own
+	 * callbacks recognize this pointer through audio_render_mix and fill
+	 * the rest too, see obs_source_audio_render_mixes() */
+	source->audio_render_mix = &audio_data;
+	success = source->info.audio_render(
+		source->context.data, &ts,
+		(struct obs_source_audio_mix *)&audio_data, mixers, channels,
+		sample_rate);
+	source->audio_render_mix = NULL;
 	source->audio_ts = success ? ts : 0;
 	source->audio_pending = !success;
 
@@ -5428,11 +5760,10 @@ static void audio_submix(obs_source_t *source, size_t channels,
 
 	for (size_t ch = 0; ch < channels; ch++) {
 		audio_data.data[ch] = source->audio_mix_buf[ch];
+		memset(source->audio_mix_buf[ch], 0,
+		       sizeof(float) * obs->audio.frames);
 	}
 
-	memset(source->audio_mix_buf[0], 0,
-	       sizeof(float) * AUDIO_OUTPUT_FRAMES * channels);
-
 	success = source->info.audio_mix(source->context.data, &ts, &audio_data,
 					 channels, sample_rate);
 
@@ -5443,7 +5774,7 @@ static void audio_submix(obs_source_t *source, size_t channels,
 		audio.data[i] = (const uint8_t *)audio_data.data[i];
 
 	audio.samples_per_sec = (uint32_t)sample_rate;
-	audio.frames = AUDIO_OUTPUT_FRAMES;
+	audio.frames = (uint32_t)obs->audio.frames;
 	audio.format = AUDIO_FORMAT_FLOAT_PLANAR;
 	audio.speakers = (enum speaker_layout)channels;
 	audio.timestamp = ts;
@@ -5456,63 +5787,43 @@ static inline void process_audio_source_tick(obs_source_t *source,
 					     size_t sample_rate, size_t size)
 {
 	bool audio_submix = !!(source->info.output_flags & OBS_SOURCE_SUBMIX);
+	float *out[MAX_AUDIO_CHANNELS];
 
 	pthread_mutex_lock(&source->audio_buf_mutex);
 
-	if (source->audio_input_buf[0].size < size) {
+	if (float_ring_size(&source->audio_input_buf) < size / sizeof(float) ||
+	    source->audio_input_buf.planes != channels) {
 		source->audio_pending = true;
 		pthread_mutex_unlock(&source->audio_buf_mutex);
 		return;
 	}
 
+	/* every mix the source is routed to shares this buffer (see
+	 * update_audio_output_mixes), so there is nothing to copy */
 	for (size_t ch = 0; ch < channels; ch++)
-		circlebuf_peek_front(&source->audio_input_buf[ch],
-				     source->audio_output_buf[0][ch], size);
+		out[ch] = source->audio_output_mem[0] +
+			  AUDIO_OUTPUT_FRAMES * ch;
 
-	pthread_mutex_unlock(&source->audio_buf_mutex);
-
-	for (size_t mix = 1; mix < MAX_AUDIO_MIXES; mix++) {
-		uint32_t mix_and_val = (1 << mix);
-
-		if (audio_submix) {
-			if (mix > 1)
-				break;
-
-			mixers = 1;
-			mix_and_val = 1;
-		}
+	float_ring_peek_front(&source->audio_input_buf, out,
+			      size / sizeof(float));
 
-		if ((source->audio_mixers & mix_and_val) == 0) {
-			memset(source->audio_output_buf[mix][0], 0,
-			       size * channels);
-			continue;
-		}
-
-		for (size_t ch = 0; ch < channels; ch++)
-			memcpy(source->audio_output_buf[mix][ch],
-			       source->audio_output_buf[0][ch], size);
-	}
-
-	if (audio_submix) {
-		source->audio_pending = false;
-		return;
-	}
-
-	if ((source->audio_mixers & 1) == 0)
-		memset(source->audio_output_buf[0][0], 0, size * channels);
+	pthread_mutex_unlock(&source->audio_buf_mutex);
 
-	apply_audio_volume(source, mixers, channels, sample_rate);
+	if (!audio_submix)
+		apply_audio_volume(source, mixers, channels, sample_rate);
 	source->audio_pending = false;
 }
 
 void obs_source_audio_render(obs_source_t *source, uint32_t mixers,
 			     size_t channels, size_t sample_rate, size_t size)
 {
-	if (!source->audio_output_buf[0][0]) {
+	if (!source->audio_output_mem[0]) {
 		source->audio_pending = true;
 		return;
 	}
 
+	update_audio_output_mixes(source, channels);
+
 	if (source->info.audio_render) {
 		if (!source->context.data) {
 			source->audio_pending = true;
@@ -5551,6 +5862,20 @@ uint64_t obs_source_get_audio_timestamp(const obs_source_t *source)
 		       : 0;
 }
 
+static void get_audio_mix(const obs_source_t *source,
+			  struct audio_output_data *output, size_t num_mixes)
+{
+	for (size_t mix = 0; mix < num_mixes; mix++) {
+		bool has_buf = !!source->audio_output_buf[mix][0];
+
+		for (size_t ch = 0; ch < MAX_AUDIO_CHANNELS; ch++) {
+			output[mix].data[ch] =
+				has_buf ? source->audio_output_buf[mix][ch]
+					: silent_mix_buf;
+		}
+	}
+}
+
 void obs_source_get_audio_mix(const obs_source_t *source,
 			      struct obs_source_audio_mix *audio)
 {
@@ -5559,12 +5884,26 @@ void obs_source_get_audio_mix(const obs_source_t *source,
 	if (!obs_ptr_valid(audio, "audio"))
 		return;
 
-	for (size_t mix = 0; mix < MAX_AUDIO_MIXES; mix++) {
-		for (size_t ch = 0; ch < MAX_AUDIO_CHANNELS; ch++) {
-			audio->output[mix].data[ch] =
-				source->audio_output_buf[mix][ch];
-		}
-	}
+	get_audio_mix(source, audio->output, MAX_AUDIO_MIXES);
+}
+
+void obs_source_get_audio_mix_ext(const obs_source_t *source,
+				  struct obs_source_audio_mix_ext *audio)
+{
+	get_audio_mix(source, audio->output, MAX_AUDIO_TRACKS);
+}
+
+/* number of mixes an audio_render callback of 'source' can fill in 'audio':
+ * every active mix if it is the one libobs passed in, otherwise only those
+ * of the public struct */
+size_t obs_source_audio_render_mixes(const obs_source_t *source,
+				     const struct obs_source_audio_mix *audio)
+{
+	size_t num_mixes = obs->audio.num_mixes;
+
+	if ((const void *)audio == (const void *)source->audio_render_mix)
+		return num_mixes;
+	return num_mixes < MAX_AUDIO_MIXES ? num_mixes : MAX_AUDIO_MIXES;
 }
 
 void obs_source_add_audio_capture_callback(obs_source_t *source,
@@ -5659,12 +5998,7 @@ bool obs_source_get_sends(const obs_source_t *source)
 	if (source->info.output_flags & OBS_SOURCE_TRACK)
 		sends = false;
 	else
-		sends = (source->audio_mixers & 1 << 0) ||
-			(source->audio_mixers & 1 << 1) ||
-			(source->audio_mixers & 1 << 2) ||
-			(source->audio_mixers & 1 << 3) ||
-			(source->audio_mixers & 1 << 4) ||
-			(source->audio_mixers & 1 << 5);
+		sends = (source->audio_mixers & get_active_mixes_mask()) != 0;
 
 	return obs_source_valid(source, "obs_source_get_sends") ? sends : false;
 }
@@ -207,6 +207,13 @@ enum obs_media_state {
  */
 #define OBS_SOURCE_TRACK (1 << 17)
 
+/**
+ * Source type only renders something different when its settings change or
+ * when it calls obs_source_content_changed(), so its render can be cached.
+ * For a filter, the filter's output only depends on its input and settings.
+ */
+#define OBS_SOURCE_STATIC_VIDEO (1 << 18)
+
 /** @} */
 
 typedef void (*obs_source_enum_proc_t)(obs_source_t *parent,
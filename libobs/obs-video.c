@@ -29,10 +29,24 @@
 #include <windows.h>
 #endif
 
+static void async_pretick_job(void *param, size_t idx)
+{
+	struct obs_core_video *video = param;
+	size_t start = idx * TICK_SOURCES_PER_JOB;
+	size_t end = start + TICK_SOURCES_PER_JOB;
+
+	if (end > video->async_tick_sources.num)
+		end = video->async_tick_sources.num;
+
+	for (size_t i = start; i < end; i++)
+		obs_source_async_pretick(video->async_tick_sources.array[i]);
+}
+
 static uint64_t tick_sources(uint64_t cur_time, uint64_t last_time)
 {
 	struct obs_core_data *data = &obs->data;
-	struct obs_source *source;
+	struct obs_core_video *video = &obs->video;
+	size_t jobs;
 	uint64_t delta_time;
 	float seconds;
 
@@ -61,16 +75,36 @@ static uint64_t tick_sources(uint64_t cur_time, uint64_t last_time)
 
 	pthread_mutex_lock(&data->sources_mutex);
 
-	source = data->first_source;
-	while (source) {
-		obs_source_t *s = obs_source_get_ref(source);
+	video->tick_sources.num = 0;
+	video->async_tick_sources.num = 0;
+
+	pthread_mutex_lock(&data->ticking_sources_mutex);
+
+	for (size_t i = 0; i < data->ticking_sources.num; i++) {
+		obs_source_t *s =
+			obs_source_get_ref(data->ticking_sources.array[i]);
 
 		if (s) {
-			obs_source_video_tick(s, seconds);
-			obs_source_release(s);
+			da_push_back(video->tick_sources, &s);
+			if ((s->info.output_flags & OBS_SOURCE_ASYNC) != 0)
+				da_push_back(video->async_tick_sources, &s);
 		}
+	}
+
+	pthread_mutex_unlock(&data->ticking_sources_mutex);
+
+	/* async frame selection needs no graphics context and no other
+	 * source, so it is spread over the video workers.  Everything else may
+	 * call into plugins and stays on this thread. */
+	jobs = (video->async_tick_sources.num + TICK_SOURCES_PER_JOB - 1) /
+	       TICK_SOURCES_PER_JOB;
+	os_task_pool_run(video->worker_pool, async_pretick_job, video, jobs);
 
-		source = (struct obs_source *)source->context.next;
+	for (size_t i = 0; i < video->tick_sources.num; i++) {
+		obs_source_t *s = video->tick_sources.array[i];
+		obs_source_video_tick(s, seconds);
+		obs_source_tick_list_prune(s);
+		obs_source_release(s);
 	}
 
 	pthread_mutex_unlock(&data->sources_mutex);
@@ -576,24 +610,90 @@ static inline bool download_frame(struct obs_core_video *video,
 	return true;
 }
 
-static const uint8_t *set_gpu_converted_plane(uint32_t width, uint32_t height,
-					      uint32_t linesize_input,
-					      uint32_t linesize_output,
-					      const uint8_t *in, uint8_t *out)
+struct plane_copy {
+	const uint8_t *in;
+	uint8_t *out;
+	uint32_t in_linesize;
+	uint32_t out_linesize;
+	uint32_t width;
+	uint32_t height;
+};
+
+/* the planes of a frame copy are split into COPY_ROWS_PER_JOB row slices,
+ * which are spread over the video workers */
+struct frame_copy {
+	struct plane_copy planes[NUM_CHANNELS];
+	size_t num_planes;
+};
+
+static void add_plane_copy(struct frame_copy *copy, uint32_t width,
+			   uint32_t height, uint32_t in_linesize,
+			   uint32_t out_linesize, const uint8_t *in,
+			   uint8_t *out)
+{
+	struct plane_copy *plane = &copy->planes[copy->num_planes++];
+	plane->in = in;
+	plane->out = out;
+	plane->in_linesize = in_linesize;
+	plane->out_linesize = out_linesize;
+	plane->width = width;
+	plane->height = height;
+}
+
+static inline size_t plane_copy_jobs(const struct plane_copy *plane)
+{
+	return (plane->height + COPY_ROWS_PER_JOB - 1) / COPY_ROWS_PER_JOB;
+}
+
+static void copy_plane_rows(const struct plane_copy *plane, uint32_t start_y,
+			    uint32_t end_y)
 {
-	if ((width == linesize_input) && (width == linesize_output)) {
-		size_t total = (size_t)width * (size_t)height;
-		memcpy(out, in, total);
-		in += total;
+	const uint8_t *in = plane->in + (size_t)start_y * plane->in_linesize;
+	uint8_t *out = plane->out + (size_t)start_y * plane->out_linesize;
+
+	if ((plane->width == plane->in_linesize) &&
+	    (plane->width == plane->out_linesize)) {
+		memcpy(out, in, (size_t)plane->width * (end_y - start_y));
 	} else {
-		for (size_t y = 0; y < height; y++) {
-			memcpy(out, in, width);
-			out += linesize_output;
-			in += linesize_input;
+		for (uint32_t y = start_y; y < end_y; y++) {
+			memcpy(out, in, plane->width);
+			out += plane->out_linesize;
+			in += plane->in_linesize;
 		}
 	}
+}
+
+static void frame_copy_job(void *param, size_t idx)
+{
+	const struct frame_copy *copy = param;
 
-	return in;
+	for (size_t i = 0; i < copy->num_planes; i++) {
+		const struct plane_copy *plane = &copy->planes[i];
+		const size_t jobs = plane_copy_jobs(plane);
+
+		if (idx < jobs) {
+			uint32_t start_y = (uint32_t)idx * COPY_ROWS_PER_JOB;
+			uint32_t end_y = start_y + COPY_ROWS_PER_JOB;
+			if (end_y > plane->height)
+				end_y = plane->height;
+
+			copy_plane_rows(plane, start_y, end_y);
+			return;
+		}
+
+		idx -= jobs;
+	}
+}
+
+static void run_frame_copy(struct obs_core_video *video,
+			   struct frame_copy *copy)
+{
+	size_t jobs = 0;
+
+	for (size_t i = 0; i < copy->num_planes; i++)
+		jobs += plane_copy_jobs(&copy->planes[i]);
+
+	os_task_pool_run(video->worker_pool, frame_copy_job, copy, jobs);
 }
 
 static void set_gpu_converted_data(struct obs_core_video *video,
@@ -601,25 +701,27 @@ static void set_gpu_converted_data(struct obs_core_video *video,
 				   const struct video_data *input,
 				   const struct video_output_info *info)
 {
+	struct frame_copy copy = {0};
+
 	switch (info->format) {
 	case VIDEO_FORMAT_I420: {
 		const uint32_t width = info->width;
 		const uint32_t height = info->height;
 
-		set_gpu_converted_plane(width, height, input->linesize[0],
-					output->linesize[0], input->data[0],
-					output->data[0]);
+		add_plane_copy(&copy, width, height, input->linesize[0],
+			       output->linesize[0], input->data[0],
+			       output->data[0]);
 
 		const uint32_t width_d2 = width / 2;
 		const uint32_t height_d2 = height / 2;
 
-		set_gpu_converted_plane(width_d2, height_d2, input->linesize[1],
-					output->linesize[1], input->data[1],
-					output->data[1]);
+		add_plane_copy(&copy, width_d2, height_d2, input->linesize[1],
+			       output->linesize[1], input->data[1],
+			       output->data[1]);
 
-		set_gpu_converted_plane(width_d2, height_d2, input->linesize[2],
-					output->linesize[2], input->data[2],
-					output->data[2]);
+		add_plane_copy(&copy, width_d2, height_d2, input->linesize[2],
+			       output->linesize[2], input->data[2],
+			       output->data[2]);
 
 		break;
 	}
@@ -627,26 +729,22 @@ static void set_gpu_converted_data(struct obs_core_video *video,
 		const uint32_t width = info->width;
 		const uint32_t height = info->height;
 		const uint32_t height_d2 = height / 2;
+
+		add_plane_copy(&copy, width, height, input->linesize[0],
+			       output->linesize[0], input->data[0],
+			       output->data[0]);
+
 		if (input->linesize[1]) {
-			set_gpu_converted_plane(width, height,
-						input->linesize[0],
-						output->linesize[0],
-						input->data[0],
-						output->data[0]);
-			set_gpu_converted_plane(width, height_d2,
-						input->linesize[1],
-						output->linesize[1],
-						input->data[1],
-						output->data[1]);
+			add_plane_copy(&copy, width, height_d2,
+				       input->linesize[1], output->linesize[1],
+				       input->data[1], output->data[1]);
 		} else {
-			const uint8_t *const in_uv = set_gpu_converted_plane(
-				width, height, input->linesize[0],
-				output->linesize[0], input->data[0],
-				output->data[0]);
-			set_gpu_converted_plane(width, height_d2,
-						input->linesize[0],
-						output->linesize[1], in_uv,
-						output->data[1]);
+			const uint8_t *const in_uv =
+				input->data[0] +
+				(size_t)input->linesize[0] * height;
+			add_plane_copy(&copy, width, height_d2,
+				       input->linesize[0], output->linesize[1],
+				       in_uv, output->data[1]);
 		}
 
 		break;
@@ -655,17 +753,17 @@ static void set_gpu_converted_data(struct obs_core_video *video,
 		const uint32_t width = info->width;
 		const uint32_t height = info->height;
 
-		set_gpu_converted_plane(width, height, input->linesize[0],
-					output->linesize[0], input->data[0],
-					output->data[0]);
+		add_plane_copy(&copy, width, height, input->linesize[0],
+			       output->linesize[0], input->data[0],
+			       output->data[0]);
 
-		set_gpu_converted_plane(width, height, input->linesize[1],
-					output->linesize[1], input->data[1],
-					output->data[1]);
+		add_plane_copy(&copy, width, height, input->linesize[1],
+			       output->linesize[1], input->data[1],
+			       output->data[1]);
 
-		set_gpu_converted_plane(width, height, input->linesize[2],
-					output->linesize[2], input->data[2],
-					output->data[2]);
+		add_plane_copy(&copy, width, height, input->linesize[2],
+			       output->linesize[2], input->data[2],
+			       output->data[2]);
 
 		break;
 	}
@@ -673,19 +771,19 @@ static void set_gpu_converted_data(struct obs_core_video *video,
 		const uint32_t width = info->width;
 		const uint32_t height = info->height;
 
-		set_gpu_converted_plane(width * 2, height, input->linesize[0],
-					output->linesize[0], input->data[0],
-					output->data[0]);
+		add_plane_copy(&copy, width * 2, height, input->linesize[0],
+			       output->linesize[0], input->data[0],
+			       output->data[0]);
 
 		const uint32_t height_d2 = height / 2;
 
-		set_gpu_converted_plane(width, height_d2, input->linesize[1],
-					output->linesize[1], input->data[1],
-					output->data[1]);
+		add_plane_copy(&copy, width, height_d2, input->linesize[1],
+			       output->linesize[1], input->data[1],
+			       output->data[1]);
 
-		set_gpu_converted_plane(width, height_d2, input->linesize[2],
-					output->linesize[2], input->data[2],
-					output->data[2]);
+		add_plane_copy(&copy, width, height_d2, input->linesize[2],
+			       output->linesize[2], input->data[2],
+			       output->data[2]);
 
 		break;
 	}
@@ -693,26 +791,22 @@ static void set_gpu_converted_data(struct obs_core_video *video,
 		const uint32_t width_x2 = info->width * 2;
 		const uint32_t height = info->height;
 		const uint32_t height_d2 = height / 2;
+
+		add_plane_copy(&copy, width_x2, height, input->linesize[0],
+			       output->linesize[0], input->data[0],
+			       output->data[0]);
+
 		if (input->linesize[1]) {
-			set_gpu_converted_plane(width_x2, height,
-						input->linesize[0],
-						output->linesize[0],
-						input->data[0],
-						output->data[0]);
-			set_gpu_converted_plane(width_x2, height_d2,
-						input->linesize[1],
-						output->linesize[1],
-						input->data[1],
-						output->data[1]);
+			add_plane_copy(&copy, width_x2, height_d2,
+				       input->linesize[1], output->linesize[1],
+				       input->data[1], output->data[1]);
 		} else {
-			const uint8_t *const in_uv = set_gpu_converted_plane(
-				width_x2, height, input->linesize[0],
-				output->linesize[0], input->data[0],
-				output->data[0]);
-			set_gpu_converted_plane(width_x2, height_d2,
-						input->linesize[0],
-						output->linesize[1], in_uv,
-						output->data[1]);
+			const uint8_t *const in_uv =
+				input->data[0] +
+				(size_t)input->linesize[0] * height;
+			add_plane_copy(&copy, width_x2, height_d2,
+				       input->linesize[0], output->linesize[1],
+				       in_uv, output->data[1]);
 		}
 
 		break;
@@ -735,27 +829,21 @@ static void set_gpu_converted_data(struct obs_core_video *video,
 		/* unimplemented */
 		;
 	}
+
+	run_frame_copy(video, &copy);
 }
 
-static inline void copy_rgbx_frame(struct video_frame *output,
+static inline void copy_rgbx_frame(struct obs_core_video *video,
+				   struct video_frame *output,
 				   const struct video_data *input,
 				   const struct video_output_info *info)
 {
-	uint8_t *in_ptr = input->data[0];
-	uint8_t *out_ptr = output->data[0];
+	struct frame_copy copy = {0};
 
-	/* if the line sizes match, do a single copy */
-	if (input->linesize[0] == output->linesize[0]) {
-		memcpy(out_ptr, in_ptr,
-		       (size_t)input->linesize[0] * (size_t)info->height);
-	} else {
-		const size_t copy_size = (size_t)info->width * 4;
-		for (size_t y = 0; y < info->height; y++) {
-			memcpy(out_ptr, in_ptr, copy_size);
-			in_ptr += input->linesize[0];
-			out_ptr += output->linesize[0];
-		}
-	}
+	add_plane_copy(&copy, info->width * 4, info->height,
+		       input->linesize[0], output->linesize[0], input->data[0],
+		       output->data[0]);
+	run_frame_copy(video, &copy);
 }
 
 static inline void output_video_data(struct obs_core_video *video,
@@ -774,7 +862,8 @@ static inline void output_video_data(struct obs_core_video *video,
 			set_gpu_converted_data(video, &output_frame,
 					       input_frame, info);
 		} else {
-			copy_rgbx_frame(&output_frame, input_frame, info);
+			copy_rgbx_frame(video, &output_frame, input_frame,
+					info);
 		}
 
 		video_output_unlock_frame(video->video);
@@ -997,6 +1086,30 @@ static void uninit_winrt_state(struct winrt_state *winrt)
 
 #endif // #ifdef _WIN32
 
+static void record_frame_stats(struct obs_core_video *video,
+			       const uint64_t phase_ns[OBS_FRAME_PHASE_COUNT],
+			       uint64_t jitter_ns, uint32_t lagged)
+{
+	pthread_mutex_lock(&video->frame_stats_mutex);
+
+	for (size_t i = 0; i < OBS_FRAME_PHASE_COUNT; i++)
+		histogram_record(&video->frame_phase_hist[i], phase_ns[i]);
+	histogram_record(&video->frame_jitter_hist, jitter_ns);
+
+	if (lagged) {
+		size_t slowest = 0;
+		for (size_t i = 1; i < OBS_FRAME_PHASE_TOTAL; i++) {
+			if (phase_ns[i] > phase_ns[slowest])
+				slowest = i;
+		}
+
+		video->frame_lagged[slowest] += lagged;
+		video->frame_lagged[OBS_FRAME_PHASE_TOTAL] += lagged;
+	}
+
+	pthread_mutex_unlock(&video->frame_stats_mutex);
+}
+
 static const char *tick_sources_name = "tick_sources";
 static const char *render_displays_name = "render_displays";
 static const char *output_frame_name = "output_frame";
@@ -1007,6 +1120,9 @@ bool obs_graphics_thread_loop(struct obs_graphics_context *context)
 
 	uint64_t frame_start = os_gettime_ns();
 	uint64_t frame_time_ns;
+	uint64_t phase_ns[OBS_FRAME_PHASE_COUNT];
+	uint64_t phase_start;
+	uint32_t lagged_frames;
 	bool raw_active = os_atomic_load_long(&obs->video.raw_active) > 0;
 #ifdef _WIN32
 	const bool gpu_active =
@@ -1036,10 +1152,17 @@ bool obs_graphics_thread_loop(struct obs_graphics_context *context)
 	gs_begin_frame();
 	gs_leave_context();
 
+	/* video_time is when this frame was due */
+	const uint64_t jitter_ns = frame_start > obs->video.video_time
+					   ? frame_start - obs->video.video_time
+					   : 0;
+
+	phase_start = os_gettime_ns();
 	profile_start(tick_sources_name);
 	context->last_time =
 		tick_sources(obs->video.video_time, context->last_time);
 	profile_end(tick_sources_name);
+	phase_ns[OBS_FRAME_PHASE_TICK] = os_gettime_ns() - phase_start;
 
 #ifdef _WIN32
 	MSG msg;
@@ -1049,24 +1172,36 @@ bool obs_graphics_thread_loop(struct obs_graphics_context *context)
 	}
 #endif
 
+	phase_start = os_gettime_ns();
 	profile_start(output_frame_name);
 	output_frame(raw_active, gpu_active);
 	profile_end(output_frame_name);
+	phase_ns[OBS_FRAME_PHASE_OUTPUT] = os_gettime_ns() - phase_start;
 
+	phase_start = os_gettime_ns();
 	profile_start(render_displays_name);
 	render_displays();
 	profile_end(render_displays_name);
+	phase_ns[OBS_FRAME_PHASE_RENDER_DISPLAYS] =
+		os_gettime_ns() - phase_start;
 
+	phase_start = os_gettime_ns();
 	execute_graphics_tasks();
+	phase_ns[OBS_FRAME_PHASE_GRAPHICS_TASKS] =
+		os_gettime_ns() - phase_start;
 
 	frame_time_ns = os_gettime_ns() - frame_start;
+	phase_ns[OBS_FRAME_PHASE_TOTAL] = frame_time_ns;
 
 	profile_end(context->video_thread_name);
 
 	profile_reenable_thread();
 
+	lagged_frames = obs->video.lagged_frames;
 	video_sleep(&obs->video, raw_active, gpu_active, &obs->video.video_time,
 		    context->interval);
+	record_frame_stats(&obs->video, phase_ns, jitter_ns,
+			   obs->video.lagged_frames - lagged_frames);
 
 	context->frame_time_total_ns += frame_time_ns;
 	context->fps_total_ns += (obs->video.video_time - context->last_time);
@@ -453,6 +453,22 @@ gs_effect_t *obs_load_effect(gs_effect_t **effect, const char *file)
 	return *effect;
 }
 
+#ifdef _WIN32
+/* only the D3D11 device can be lost and rebuilt */
+static void obs_device_loss_release(void *data)
+{
+	UNUSED_PARAMETER(data);
+}
+
+static void obs_device_rebuild(void *device, void *data)
+{
+	struct obs_core_video *video = data;
+	UNUSED_PARAMETER(device);
+
+	os_atomic_inc_long(&video->device_gen);
+}
+#endif
+
 static int obs_init_graphics(struct obs_video_info *ovi)
 {
 	struct obs_core_video *video = &obs->video;
@@ -477,6 +493,15 @@ static int obs_init_graphics(struct obs_video_info *ovi)
 
 	gs_enter_context(video->graphics);
 
+#ifdef _WIN32
+	struct gs_device_loss loss_callbacks = {
+		.device_loss_release = obs_device_loss_release,
+		.device_loss_rebuild = obs_device_rebuild,
+		.data = video,
+	};
+	gs_register_loss_callbacks(&loss_callbacks);
+#endif
+
 	char *filename = obs_find_data_file("default.effect");
 	video->default_effect = gs_effect_create_from_file(filename, NULL);
 	bfree(filename);
@@ -620,6 +645,16 @@ static int obs_init_video(struct obs_video_info *ovi)
 	if (pthread_mutex_init(&video->task_mutex, NULL) < 0)
 		return OBS_VIDEO_FAIL;
 
+	/* the graphics thread takes part in every batch itself */
+	int worker_threads = os_get_logical_cores() - 1;
+	if (worker_threads > MAX_VIDEO_WORKER_THREADS)
+		worker_threads = MAX_VIDEO_WORKER_THREADS;
+	if (worker_threads < 0)
+		worker_threads = 0;
+
+	video->worker_pool = os_task_pool_create((size_t)worker_threads,
+						 "libobs: video workers");
+
 #ifdef __APPLE__
 	errorcode = pthread_create(&video->video_thread, NULL,
 				   obs_graphics_thread_autorelease, obs);
@@ -727,6 +762,11 @@ static void obs_free_video(void)
 		pthread_mutex_init_value(&video->task_mutex);
 		circlebuf_free(&video->tasks);
 
+		os_task_pool_destroy(video->worker_pool);
+		video->worker_pool = NULL;
+		da_free(video->tick_sources);
+		da_free(video->async_tick_sources);
+
 		video->gpu_encoder_active = 0;
 		video->cur_texture = 0;
 	}
@@ -739,6 +779,10 @@ static void obs_free_graphics(void)
 	if (video->graphics) {
 		gs_enter_context(video->graphics);
 
+#ifdef _WIN32
+		gs_unregister_loss_callbacks(video);
+#endif
+
 		gs_texture_destroy(video->transparent_texture);
 
 		gs_samplerstate_destroy(video->point_sampler);
@@ -780,10 +824,21 @@ static bool obs_init_audio(struct audio_output_info *ai)
 	circlebuf_push_back(&audio->tasks, &audio_init, sizeof(audio_init));
 
 	audio->user_volume = 1.0f;
+	audio->render_order_gen = 1;
 
 	audio->monitoring_device_name = bstrdup("Default");
 	audio->monitoring_device_id = bstrdup("default");
 
+	/* the audio thread takes part in every batch itself */
+	int worker_threads = os_get_logical_cores() - 1;
+	if (worker_threads > MAX_AUDIO_WORKER_THREADS)
+		worker_threads = MAX_AUDIO_WORKER_THREADS;
+	if (worker_threads < 0)
+		worker_threads = 0;
+
+	audio->worker_pool = os_task_pool_create((size_t)worker_threads,
+						 "libobs: audio workers");
+
 	errorcode = audio_output_open(&audio->audio, ai);
 	if (errorcode == AUDIO_OUTPUT_SUCCESS)
 		return true;
@@ -803,25 +858,26 @@ static void stop_audio(void)
 		audio_output_close(audio->audio);
 		audio->audio = NULL;
 	}
+
+	audio_release_render_order(audio);
 }
 
 static void obs_free_audio(void)
 {
 	struct obs_core_audio *audio = &obs->audio;
-	const struct audio_output_info *obs_info = NULL;
-	if (audio->audio) {
-		obs_info = audio_output_get_info(audio->audio);
-		if (obs_info) {
-			int channels = get_audio_channels(obs_info->speakers);
-			for (size_t j = 0; j < channels; j++)
-				free(obs_info->audio_out.data[j]);
-		}
+	if (audio->audio)
 		audio_output_close(audio->audio);
-	}
+
+	audio_release_render_order(audio);
+	os_task_pool_destroy(audio->worker_pool);
+
+	if (audio->track_monitor)
+		audio_monitor_destroy(audio->track_monitor);
 
 	circlebuf_free(&audio->buffered_timestamps);
 	da_free(audio->render_order);
 	da_free(audio->root_nodes);
+	da_free(audio->render_inputs);
 
 	da_free(audio->monitors);
 	bfree(audio->monitoring_device_name);
@@ -858,11 +914,13 @@ static bool obs_init_data(void)
 		goto fail;
 	if (pthread_mutex_init_recursive(&obs->data.mixers_mutex) != 0)
 		goto fail;
+	if (pthread_mutex_init(&data->ticking_sources_mutex, NULL) != 0)
+		goto fail;
 
 	if (!obs_view_init(&data->main_view))
 		goto fail;
 
-	for (size_t i = 0; i < MAX_AUDIO_MIXES; i++) {
+	for (size_t i = 0; i < MAX_AUDIO_TRACKS; i++) {
 		data->audio_mixes.volume[i] = 1.0;
 		data->audio_mixes.muted[i] = false;
 		data->audio_mixes.meters[i] = NULL;
@@ -925,6 +983,8 @@ static void obs_free_data(void)
 	pthread_mutex_destroy(&data->encoders_mutex);
 	pthread_mutex_destroy(&data->services_mutex);
 	pthread_mutex_destroy(&data->draw_callbacks_mutex);
+	pthread_mutex_destroy(&data->ticking_sources_mutex);
+	da_free(data->ticking_sources);
 	da_free(data->draw_callbacks);
 	da_free(data->tick_callbacks);
 	obs_data_release(data->private_data);
@@ -1077,6 +1137,9 @@ static bool obs_init(const char *locale, const char *module_config_path,
 	pthread_mutex_init_value(&obs->video.gpu_encoder_mutex);
 	pthread_mutex_init_value(&obs->video.task_mutex);
 
+	if (pthread_mutex_init(&obs->video.frame_stats_mutex, NULL) != 0)
+		return false;
+
 	obs->name_store_owned = !store;
 	obs->name_store = store ? store : profiler_name_store_create();
 	if (!obs->name_store) {
@@ -1284,6 +1347,8 @@ void obs_shutdown(void)
 	if (obs->name_store_owned)
 		profiler_name_store_free(obs->name_store);
 
+	pthread_mutex_destroy(&obs->video.frame_stats_mutex);
+
 	bfree(obs->module_config_path);
 	bfree(obs->locale);
 	bfree(obs);
@@ -1420,11 +1485,10 @@ int obs_reset_video(struct obs_video_info *ovi)
 #define SEC_TO_MSEC 1000
 #endif
 
-bool obs_reset_audio2(const struct obs_audio_info2 *oai)
+bool obs_reset_audio3(const struct obs_audio_info3 *oai)
 {
 	struct obs_core_audio *audio = &obs->audio;
 	struct audio_output_info ai;
-	size_t channels = get_audio_channels(oai->speakers);
 
 	/* don't allow changing of audio settings if active. */
 	if (!obs || (audio->audio && audio_output_active(audio->audio)))
@@ -1434,45 +1498,83 @@ bool obs_reset_audio2(const struct obs_audio_info2 *oai)
 	if (!oai)
 		return true;
 
+	uint32_t frames = oai->frames_per_tick;
+	if (!frames) {
+		frames = AUDIO_OUTPUT_FRAMES;
+	} else if (frames < AUDIO_OUTPUT_MIN_FRAMES ||
+		   frames > AUDIO_OUTPUT_FRAMES) {
+		blog(LOG_WARNING,
+		     "obs_reset_audio3: invalid audio period of %u frames, "
+		     "using %d",
+		     frames, AUDIO_OUTPUT_FRAMES);
+		frames = AUDIO_OUTPUT_FRAMES;
+	}
+	audio->frames = frames;
+
+	uint32_t num_mixes = oai->num_mixes;
+	if (!num_mixes) {
+		num_mixes = MAX_AUDIO_MIXES;
+	} else if (num_mixes > MAX_AUDIO_TRACKS) {
+		blog(LOG_WARNING,
+		     "obs_reset_audio3: %u mixes requested, "
+		     "only %d are supported",
+		     num_mixes, MAX_AUDIO_TRACKS);
+		num_mixes = MAX_AUDIO_TRACKS;
+	}
+	audio->num_mixes = num_mixes;
+
 	if (oai->max_buffering_ms) {
 		uint32_t max_frames = oai->max_buffering_ms *
 				      oai->samples_per_sec / SEC_TO_MSEC;
-		max_frames += (AUDIO_OUTPUT_FRAMES - 1);
-		audio->max_buffering_ticks = max_frames / AUDIO_OUTPUT_FRAMES;
+		max_frames += (frames - 1);
+		audio->max_buffering_ticks = max_frames / frames;
 	} else {
-		audio->max_buffering_ticks = 45;
+		audio->max_buffering_ticks = 45 * AUDIO_OUTPUT_FRAMES / frames;
 	}
 	audio->fixed_buffer = oai->fixed_buffering;
 
-	int max_buffering_ms = audio->max_buffering_ticks *
-			       AUDIO_OUTPUT_FRAMES * SEC_TO_MSEC /
-			       (int)oai->samples_per_sec;
+	int max_buffering_ms = audio->max_buffering_ticks * (int)frames *
+			       SEC_TO_MSEC / (int)oai->samples_per_sec;
 
 	ai.name = "Audio";
 	ai.samples_per_sec = oai->samples_per_sec;
 	ai.format = AUDIO_FORMAT_FLOAT_PLANAR;
 	ai.speakers = oai->speakers;
+	ai.frames = frames;
+	ai.mixes = num_mixes;
 	ai.input_callback = audio_callback;
-	ai.audio_out = (struct audio_data){0};
-	ai.audio_out.frames = AUDIO_OUTPUT_FRAMES;
-	for (size_t j = 0; j < channels; j++) {
-		ai.audio_out.data[j] =
-			malloc(AUDIO_OUTPUT_FRAMES * sizeof(float));
-	}
 
 	blog(LOG_INFO, "---------------------------------");
 	blog(LOG_INFO,
 	     "audio settings reset:\n"
 	     "\tsamples per sec: %d\n"
 	     "\tspeakers:        %d\n"
+	     "\tframes per tick: %d\n"
+	     "\ttracks:          %d\n"
 	     "\tmax buffering:   %d milliseconds\n"
 	     "\tbuffering type:  %s",
-	     (int)ai.samples_per_sec, (int)ai.speakers, max_buffering_ms,
+	     (int)ai.samples_per_sec, (int)ai.speakers, (int)frames,
+	     (int)num_mixes, max_buffering_ms,
 	     oai->fixed_buffering ? "fixed" : "dynamically increasing");
 
 	return obs_init_audio(&ai);
 }
 
+bool obs_reset_audio2(const struct obs_audio_info2 *oai)
+{
+	struct obs_audio_info3 oai3 = {0};
+
+	if (!oai)
+		return obs_reset_audio3(NULL);
+
+	oai3.samples_per_sec = oai->samples_per_sec;
+	oai3.speakers = oai->speakers;
+	oai3.max_buffering_ms = oai->max_buffering_ms;
+	oai3.fixed_buffering = oai->fixed_buffering;
+
+	return obs_reset_audio3(&oai3);
+}
+
 bool obs_reset_audio(const struct obs_audio_info *oai)
 {
 	struct obs_audio_info2 oai2 = {
@@ -1737,6 +1839,8 @@ void obs_set_output_source(uint32_t channel, obs_source_t *source)
 
 	pthread_mutex_unlock(&view->channels_mutex);
 
+	obs_invalidate_audio_render_order();
+
 	if (source)
 		obs_source_activate(source, MAIN_VIEW);
 
@@ -2488,7 +2592,7 @@ obs_data_array_t *obs_save_track_sources()
 	obs_data_array_t *array;
 	array = obs_data_array_create();
 
-	for (size_t i = 0; i < MAX_AUDIO_MIXES; i++) {
+	for (size_t i = 0; i < MAX_AUDIO_TRACKS; i++) {
 		if (tracks[i]) {
 			obs_data_t *track_data = obs_save_source(tracks[i]);
 			obs_data_t *private_data =
@@ -2513,8 +2617,8 @@ void obs_load_track_sources(obs_data_array_t *array, obs_load_source_cb cb,
 	obs_audio_mix_lock();
 	obs_source_t **tracks = (obs_source_t **)obs_audio_mix_tracks();
 	size_t count = obs_data_array_count(array);
-	if (count > MAX_AUDIO_MIXES)
-		count = MAX_AUDIO_MIXES;
+	if (count > MAX_AUDIO_TRACKS)
+		count = MAX_AUDIO_TRACKS;
 
 	for (size_t i = 0; i < count; i++) {
 		obs_data_t *source_data = obs_data_array_item(array, i);
@@ -2797,6 +2901,65 @@ void obs_get_audio_monitoring_device(const char **name, const char **id)
 		*id = obs->audio.monitoring_device_id;
 }
 
+bool obs_set_audio_monitoring_track(int mix_idx)
+{
+	struct obs_core_audio *audio = &obs->audio;
+	struct audio_monitor *monitor = NULL;
+	struct audio_monitor *old_monitor;
+
+	if (!audio->audio ||
+	    (mix_idx >= 0 && (size_t)mix_idx >= audio->num_mixes))
+		return false;
+
+	if (mix_idx >= 0) {
+		if (!obs_audio_monitoring_available())
+			return false;
+
+		monitor = audio_monitor_create_track((size_t)mix_idx);
+		if (!monitor)
+			return false;
+	}
+
+	pthread_mutex_lock(&audio->monitoring_mutex);
+	old_monitor = audio->track_monitor;
+	audio->track_monitor = monitor;
+	audio->track_monitor_mix = monitor ? (size_t)mix_idx : 0;
+	pthread_mutex_unlock(&audio->monitoring_mutex);
+
+	audio_monitor_destroy(old_monitor);
+	return true;
+}
+
+int obs_get_audio_monitoring_track(void)
+{
+	struct obs_core_audio *audio = &obs->audio;
+	int mix_idx;
+
+	pthread_mutex_lock(&audio->monitoring_mutex);
+	mix_idx = audio->track_monitor ? (int)audio->track_monitor_mix : -1;
+	pthread_mutex_unlock(&audio->monitoring_mutex);
+	return mix_idx;
+}
+
+uint64_t obs_get_audio_monitoring_track_latency(void)
+{
+	struct obs_core_audio *audio = &obs->audio;
+	uint64_t latency;
+
+	pthread_mutex_lock(&audio->monitoring_mutex);
+	latency = audio_monitor_get_latency(audio->track_monitor);
+	pthread_mutex_unlock(&audio->monitoring_mutex);
+
+	if (!latency)
+		return 0;
+
+	/* plus the time the mix spends in the audio buffering */
+	return latency + audio_frames_to_ns(
+				 audio_output_get_sample_rate(audio->audio),
+				 (uint64_t)audio->total_buffering_ticks *
+					 audio->frames);
+}
+
 void obs_add_tick_callback(void (*tick)(void *param, float seconds),
 			   void *param)
 {
@@ -2849,6 +3012,107 @@ uint32_t obs_get_lagged_frames(void)
 	return obs->video.lagged_frames;
 }
 
+static void get_frame_timing(struct obs_frame_timing *timing,
+			     const struct histogram *hist)
+{
+	timing->count = hist->count;
+	timing->p50_ns = histogram_percentile(hist, 0.5);
+	timing->p99_ns = histogram_percentile(hist, 0.99);
+	timing->p999_ns = histogram_percentile(hist, 0.999);
+	timing->max_ns = hist->max;
+}
+
+void obs_get_frame_stats(struct obs_frame_stats *stats)
+{
+	struct obs_core_video *video = &obs->video;
+
+	pthread_mutex_lock(&video->frame_stats_mutex);
+
+	for (size_t i = 0; i < OBS_FRAME_PHASE_COUNT; i++) {
+		get_frame_timing(&stats->phases[i],
+				 &video->frame_phase_hist[i]);
+		stats->lagged_frames[i] = video->frame_lagged[i];
+	}
+	get_frame_timing(&stats->start_jitter, &video->frame_jitter_hist);
+
+	pthread_mutex_unlock(&video->frame_stats_mutex);
+}
+
+void obs_reset_frame_stats(void)
+{
+	struct obs_core_video *video = &obs->video;
+
+	pthread_mutex_lock(&video->frame_stats_mutex);
+
+	for (size_t i = 0; i < OBS_FRAME_PHASE_COUNT; i++)
+		histogram_clear(&video->frame_phase_hist[i]);
+	histogram_clear(&video->frame_jitter_hist);
+	memset(video->frame_lagged, 0, sizeof(video->frame_lagged));
+
+	pthread_mutex_unlock(&video->frame_stats_mutex);
+}
+
+static const char *frame_phase_names[OBS_FRAME_PHASE_COUNT] = {
+	"tick_sources",
+	"output_frame",
+	"render_displays",
+	"graphics_tasks",
+	"frame",
+};
+
+static void write_frame_timing(FILE *file, const char *name,
+			       const struct histogram *hist, uint32_t lagged)
+{
+	fprintf(file,
+		"%s,%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64
+		",%" PRIu32 "\n",
+		name, hist->count, histogram_percentile(hist, 0.5),
+		histogram_percentile(hist, 0.99),
+		histogram_percentile(hist, 0.999), hist->max, lagged);
+}
+
+static void write_frame_buckets(FILE *file, const char *name,
+				const struct histogram *hist)
+{
+	for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+		if (hist->buckets[i])
+			fprintf(file, "%s,%" PRIu64 ",%" PRIu32 "\n", name,
+				histogram_bucket_value(i), hist->buckets[i]);
+	}
+}
+
+bool obs_save_frame_stats(const char *path)
+{
+	struct obs_core_video *video = &obs->video;
+	FILE *file = os_fopen(path, "w");
+	if (!file) {
+		blog(LOG_WARNING, "Could not open '%s' to save frame stats",
+		     path);
+		return false;
+	}
+
+	pthread_mutex_lock(&video->frame_stats_mutex);
+
+	fprintf(file, "phase,count,p50_ns,p99_ns,p999_ns,max_ns,lagged\n");
+	for (size_t i = 0; i < OBS_FRAME_PHASE_COUNT; i++)
+		write_frame_timing(file, frame_phase_names[i],
+				   &video->frame_phase_hist[i],
+				   video->frame_lagged[i]);
+	write_frame_timing(file, "start_jitter", &video->frame_jitter_hist,
+			   0);
+
+	fprintf(file, "\nphase,bucket_max_ns,count\n");
+	for (size_t i = 0; i < OBS_FRAME_PHASE_COUNT; i++)
+		write_frame_buckets(file, frame_phase_names[i],
+				    &video->frame_phase_hist[i]);
+	write_frame_buckets(file, "start_jitter", &video->frame_jitter_hist);
+
+	pthread_mutex_unlock(&video->frame_stats_mutex);
+
+	fclose(file);
+	return true;
+}
+
 void start_raw_video(video_t *v, const struct video_scale_info *conversion,
 		     void (*callback)(void *param, struct video_data *frame),
 		     void *param)
@@ -165,6 +165,42 @@ struct obs_transform_info {
 	struct vec2 bounds;
 };
 
+/** Phases of a frame on the graphics thread */
+enum obs_frame_phase {
+	OBS_FRAME_PHASE_TICK,            /**< tick_sources */
+	OBS_FRAME_PHASE_OUTPUT,          /**< output_frame */
+	OBS_FRAME_PHASE_RENDER_DISPLAYS, /**< render_displays */
+	OBS_FRAME_PHASE_GRAPHICS_TASKS,  /**< execute_graphics_tasks */
+	OBS_FRAME_PHASE_TOTAL,           /**< the whole frame */
+	OBS_FRAME_PHASE_COUNT,
+};
+
+/** Latency distribution of one frame phase, in nanoseconds */
+struct obs_frame_timing {
+	uint64_t count;
+	uint64_t p50_ns;
+	uint64_t p99_ns;
+	uint64_t p999_ns;
+	uint64_t max_ns;
+};
+
+/**
+ * Frame pacing statistics of the graphics thread since it started or since
+ * the last obs_reset_frame_stats()
+ */
+struct obs_frame_stats {
+	struct obs_frame_timing phases[OBS_FRAME_PHASE_COUNT];
+
+	/** how late frames started compared to when they were due */
+	struct obs_frame_timing start_jitter;
+
+	/**
+	 * Lagged frames, attributed to the slowest phase of the frame that
+	 * overran.  OBS_FRAME_PHASE_TOTAL holds the sum.
+	 */
+	uint32_t lagged_frames[OBS_FRAME_PHASE_COUNT];
+};
+
 /**
  * Video initialization structure
  */
@@ -214,6 +250,23 @@ struct obs_audio_info2 {
 	bool fixed_buffering;
 };
 
+struct obs_audio_info3 {
+	uint32_t samples_per_sec;
+	enum speaker_layout speakers;
+
+	uint32_t max_buffering_ms;
+	bool fixed_buffering;
+
+	/* audio engine period, from AUDIO_OUTPUT_MIN_FRAMES up to
+	 * AUDIO_OUTPUT_FRAMES.  0 uses AUDIO_OUTPUT_FRAMES.  encoders still
+	 * receive their own frame size. */
+	uint32_t frames_per_tick;
+
+	/* number of mixes (tracks), up to MAX_AUDIO_TRACKS.  0 uses
+	 * MAX_AUDIO_MIXES. */
+	uint32_t num_mixes;
+};
+
 /**
  * Sent to source filters via the filter_audio callback to allow filtering of
  * audio data
@@ -422,6 +475,7 @@ EXPORT int obs_reset_video(struct obs_video_info *ovi);
  */
 EXPORT bool obs_reset_audio(const struct obs_audio_info *oai);
 EXPORT bool obs_reset_audio2(const struct obs_audio_info2 *oai);
+EXPORT bool obs_reset_audio3(const struct obs_audio_info3 *oai);
 
 /** Gets the current video settings, returns false if no video */
 EXPORT bool obs_get_video_info(struct obs_video_info *ovi);
@@ -814,6 +868,20 @@ EXPORT void obs_enum_audio_monitoring_devices(obs_enum_audio_device_cb cb,
 EXPORT bool obs_set_audio_monitoring_device(const char *name, const char *id);
 EXPORT void obs_get_audio_monitoring_device(const char **name, const char **id);
 
+/**
+ * Monitors an entire track (after its filters and volume) on the monitoring
+ * device, as one low latency stream.  Pass -1 to stop track monitoring.
+ */
+EXPORT bool obs_set_audio_monitoring_track(int mix_idx);
+/** Returns the monitored track, or -1 if no track is monitored */
+EXPORT int obs_get_audio_monitoring_track(void);
+/**
+ * Returns the measured delay of the monitored track in nanoseconds, from
+ * when its audio is due to when it leaves the monitoring device, or 0 if not
+ * known.
+ */
+EXPORT uint64_t obs_get_audio_monitoring_track_latency(void);
+
 EXPORT void obs_add_tick_callback(void (*tick)(void *param, float seconds),
 				  void *param);
 EXPORT void obs_remove_tick_callback(void (*tick)(void *param, float seconds),
@@ -848,6 +916,11 @@ EXPORT uint64_t obs_get_frame_interval_ns(void);
 EXPORT uint32_t obs_get_total_frames(void);
 EXPORT uint32_t obs_get_lagged_frames(void);
 
+EXPORT void obs_get_frame_stats(struct obs_frame_stats *stats);
+EXPORT void obs_reset_frame_stats(void);
+/** Writes the frame stats and the non-empty histogram buckets as CSV */
+EXPORT bool obs_save_frame_stats(const char *path);
+
 EXPORT bool obs_nv12_tex_active(void);
 EXPORT bool obs_p010_tex_active(void);
 
@@ -1047,6 +1120,12 @@ EXPORT obs_properties_t *obs_source_properties(const obs_source_t *source);
 
 /** Updates settings for this source */
 EXPORT void obs_source_update(obs_source_t *source, obs_data_t *settings);
+
+/**
+ * Tells libobs that a source with OBS_SOURCE_STATIC_VIDEO now renders
+ * something different, so any cached render of it has to be redone
+ */
+EXPORT void obs_source_content_changed(obs_source_t *source);
 EXPORT void obs_source_reset_settings(obs_source_t *source,
 				      obs_data_t *settings);
 
@@ -2409,12 +2488,25 @@ EXPORT void obs_encoder_packet_ref(struct encoder_packet *dst,
 				   struct encoder_packet *src);
 EXPORT void obs_encoder_packet_release(struct encoder_packet *packet);
 
+/**
+ * Returns the storage of the video data of a frame passed to encode(), or
+ * NULL.  An encoder that still needs the frame after encode() returns can
+ * keep it alive with video_buffer_addref() instead of copying it.  Only
+ * valid on the frame pointer encode() was given, not on a copy of it.
+ */
+EXPORT struct video_buffer *
+obs_encoder_frame_get_buffer(const struct encoder_frame *frame);
+
 EXPORT void *obs_encoder_create_rerouted(obs_encoder_t *encoder,
 					 const char *reroute_id);
 
 /** Returns whether encoder is paused */
 EXPORT bool obs_encoder_paused(const obs_encoder_t *output);
 
+/** Returns the number of raw frames the encoder skipped because it fell
+ * behind */
+EXPORT uint32_t obs_encoder_get_skipped_frames(obs_encoder_t *encoder);
+
 EXPORT const char *obs_encoder_get_last_error(obs_encoder_t *encoder);
 EXPORT void obs_encoder_set_last_error(obs_encoder_t *encoder,
 				       const char *message);
@@ -0,0 +1,214 @@
+#pragma once
+
+#include "c99defs.h"
+#include <string.h>
+
+#include "bmem.h"
+#include "threading.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Single-producer/single-consumer ring buffer of planar float audio.
+ *
+ * float_ring_push_back() may be called by one producer thread while one
+ * consumer thread calls float_ring_peek_front()/float_ring_pop_front(),
+ * without any locking.  float_ring_size() and float_ring_space() can be
+ * called from either side.
+ *
+ * The remaining functions (init/free/reserve/place/clear) are not lock-free,
+ * the caller has to make sure neither the producer nor the consumer is
+ * using the ring at the same time.
+ *
+ * Positions are free-running frame counters; the capacity is always a power
+ * of two so that they can wrap around freely.
+ */
+
+/* one plane per audio channel, so this has to be at least
+ * MAX_AUDIO_CHANNELS (media-io/audio-io.h) */
+#define FLOAT_RING_MAX_PLANES 24
+
+struct float_ring {
+	float *data[FLOAT_RING_MAX_PLANES];
+	size_t planes;
+	size_t capacity;
+
+	volatile long read_pos;
+	volatile long write_pos;
+};
+
+static inline void float_ring_init(struct float_ring *ring)
+{
+	memset(ring, 0, sizeof(struct float_ring));
+}
+
+static inline void float_ring_free(struct float_ring *ring)
+{
+	for (size_t i = 0; i < ring->planes; i++)
+		bfree(ring->data[i]);
+	memset(ring, 0, sizeof(struct float_ring));
+}
+
+static inline size_t float_ring_size(const struct float_ring *ring)
+{
+	unsigned long write_pos =
+		(unsigned long)os_atomic_load_long(&ring->write_pos);
+	unsigned long read_pos =
+		(unsigned long)os_atomic_load_long(&ring->read_pos);
+	return (size_t)(write_pos - read_pos);
+}
+
+static inline size_t float_ring_space(const struct float_ring *ring)
+{
+	return ring->capacity - float_ring_size(ring);
+}
+
+/* copies 'frames' frames between the ring at frame position 'pos' and a
+ * linear buffer, in either direction */
+static inline void float_ring_copy_plane(float *ring_data, size_t capacity,
+					 size_t pos, float *linear,
+					 size_t frames, bool to_ring)
+{
+	size_t start = pos & (capacity - 1);
+	size_t first = capacity - start;
+
+	if (first > frames)
+		first = frames;
+
+	if (to_ring) {
+		memcpy(ring_data + start, linear, first * sizeof(float));
+		memcpy(ring_data, linear + first,
+		       (frames - first) * sizeof(float));
+	} else {
+		memcpy(linear, ring_data + start, first * sizeof(float));
+		memcpy(linear + first, ring_data,
+		       (frames - first) * sizeof(float));
+	}
+}
+
+/* (not lock-free) sets the plane count and makes sure at least 'frames'
+ * frames fit, keeping the buffered data if the plane count is unchanged */
+static inline void float_ring_reserve(struct float_ring *ring, size_t planes,
+				      size_t frames)
+{
+	size_t size = float_ring_size(ring);
+	size_t capacity = ring->capacity ? ring->capacity : 1024;
+	unsigned long read_pos = (unsigned long)ring->read_pos;
+
+	if (planes > FLOAT_RING_MAX_PLANES)
+		planes = FLOAT_RING_MAX_PLANES;
+
+	if (planes == ring->planes && frames <= ring->capacity)
+		return;
+
+	if (planes != ring->planes)
+		size = 0;
+
+	while (capacity < frames)
+		capacity *= 2;
+
+	for (size_t i = 0; i < planes; i++) {
+		float *new_data = bmalloc(capacity * sizeof(float));
+
+		if (size)
+			float_ring_copy_plane(ring->data[i], ring->capacity,
+					      read_pos, new_data, size, false);
+		if (i < ring->planes)
+			bfree(ring->data[i]);
+		ring->data[i] = new_data;
+	}
+
+	for (size_t i = planes; i < ring->planes; i++) {
+		bfree(ring->data[i]);
+		ring->data[i] = NULL;
+	}
+
+	ring->planes = planes;
+	ring->capacity = capacity;
+	os_atomic_store_long(&ring->read_pos, 0);
+	os_atomic_store_long(&ring->write_pos, (long)size);
+}
+
+/* producer side, returns false without writing anything if there is not
+ * enough space */
+static inline bool float_ring_push_back(struct float_ring *ring,
+					const uint8_t *const data[],
+					size_t frames)
+{
+	unsigned long write_pos =
+		(unsigned long)os_atomic_load_long(&ring->write_pos);
+
+	if (!ring->capacity || float_ring_space(ring) < frames)
+		return false;
+
+	for (size_t i = 0; i < ring->planes; i++)
+		float_ring_copy_plane(ring->data[i], ring->capacity, write_pos,
+				      (float *)data[i], frames, true);
+
+	os_atomic_store_long(&ring->write_pos, (long)(write_pos + frames));
+	return true;
+}
+
+/* consumer side, 'frames' must not exceed float_ring_size() */
+static inline void float_ring_peek_front(struct float_ring *ring,
+					 float *const data[], size_t frames)
+{
+	unsigned long read_pos =
+		(unsigned long)os_atomic_load_long(&ring->read_pos);
+
+	for (size_t i = 0; i < ring->planes; i++)
+		float_ring_copy_plane(ring->data[i], ring->capacity, read_pos,
+				      data[i], frames, false);
+}
+
+/* consumer side, drops up to 'frames' frames */
+static inline void float_ring_pop_front(struct float_ring *ring, size_t frames)
+{
+	unsigned long read_pos =
+		(unsigned long)os_atomic_load_long(&ring->read_pos);
+	size_t size = float_ring_size(ring);
+
+	if (frames > size)
+		frames = size;
+
+	os_atomic_store_long(&ring->read_pos, (long)(read_pos + frames));
+}
+
+/* (not lock-free) drops everything */
+static inline void float_ring_clear(struct float_ring *ring)
+{
+	os_atomic_store_long(&ring->read_pos,
+			     os_atomic_load_long(&ring->write_pos));
+}
+
+/* (not lock-free) writes 'frames' frames at 'position' frames from the front
+ * and drops everything after them.  a gap between the previous end and
+ * 'position' is filled with silence. */
+static inline void float_ring_place(struct float_ring *ring, size_t position,
+				    const uint8_t *const data[], size_t frames)
+{
+	size_t size = float_ring_size(ring);
+	unsigned long read_pos;
+
+	float_ring_reserve(ring, ring->planes, position + frames);
+	read_pos = (unsigned long)ring->read_pos;
+
+	for (size_t i = 0; i < ring->planes; i++) {
+		for (size_t pos = size; pos < position; pos++)
+			ring->data[i][(read_pos + pos) & (ring->capacity - 1)] =
+				0.0f;
+
+		float_ring_copy_plane(ring->data[i], ring->capacity,
+				      read_pos + position, (float *)data[i],
+				      frames, true);
+	}
+
+	os_atomic_store_long(&ring->write_pos,
+			     (long)(read_pos + position + frames));
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,124 @@
+#pragma once
+
+#include "c99defs.h"
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Fixed-size log-linear histogram of 64-bit values (e.g. nanoseconds).
+ *
+ * Values below HISTOGRAM_SUB_BUCKETS are counted exactly.  Above that, every
+ * power of two is split into HISTOGRAM_SUB_BUCKETS linear buckets, so a
+ * bucket never spans more than 1/HISTOGRAM_SUB_BUCKETS of the values in it.
+ * Recording is a handful of instructions and never allocates.
+ *
+ * Not thread safe.
+ */
+
+#define HISTOGRAM_SUB_BUCKET_BITS 4
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_SUB_BUCKET_BITS)
+#define HISTOGRAM_BUCKETS \
+	((64 - HISTOGRAM_SUB_BUCKET_BITS + 1) * HISTOGRAM_SUB_BUCKETS)
+
+struct histogram {
+	uint64_t count;
+	uint64_t sum;
+	uint64_t min;
+	uint64_t max;
+	uint32_t buckets[HISTOGRAM_BUCKETS];
+};
+
+static inline void histogram_clear(struct histogram *h)
+{
+	memset(h, 0, sizeof(*h));
+}
+
+static inline int histogram_msb(uint64_t value)
+{
+	int msb = 0;
+
+	for (int shift = 32; shift; shift >>= 1) {
+		if (value >> shift) {
+			value >>= shift;
+			msb += shift;
+		}
+	}
+
+	return msb;
+}
+
+static inline size_t histogram_index(uint64_t value)
+{
+	if (value < HISTOGRAM_SUB_BUCKETS)
+		return (size_t)value;
+
+	int shift = histogram_msb(value) - HISTOGRAM_SUB_BUCKET_BITS;
+	return (size_t)(shift + 1) * HISTOGRAM_SUB_BUCKETS +
+	       (size_t)((value >> shift) - HISTOGRAM_SUB_BUCKETS);
+}
+
+/* largest value that is counted in the bucket */
+static inline uint64_t histogram_bucket_value(size_t idx)
+{
+	if (idx < HISTOGRAM_SUB_BUCKETS)
+		return (uint64_t)idx;
+
+	int shift = (int)(idx / HISTOGRAM_SUB_BUCKETS) - 1;
+	uint64_t sub = (uint64_t)(idx % HISTOGRAM_SUB_BUCKETS);
+	uint64_t low = (HISTOGRAM_SUB_BUCKETS + sub) << shift;
+	return low + ((1ULL << shift) - 1);
+}
+
+static inline void histogram_record(struct histogram *h, uint64_t value)
+{
+	uint32_t *bucket = &h->buckets[histogram_index(value)];
+
+	if (*bucket != UINT32_MAX)
+		(*bucket)++;
+
+	if (!h->count || value < h->min)
+		h->min = value;
+	if (value > h->max)
+		h->max = value;
+
+	h->count++;
+	h->sum += value;
+}
+
+/* value at or below which 'percentile' (0.0 to 1.0) of the recorded values
+ * lie, rounded up to the bucket it falls into */
+static inline uint64_t histogram_percentile(const struct histogram *h,
+					    double percentile)
+{
+	uint64_t target;
+	uint64_t seen = 0;
+
+	if (!h->count)
+		return 0;
+
+	if (percentile >= 1.0)
+		return h->max;
+	if (percentile < 0.0)
+		percentile = 0.0;
+
+	target = (uint64_t)(percentile * (double)h->count) + 1;
+	if (target > h->count)
+		target = h->count;
+
+	for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+		seen += h->buckets[i];
+		if (seen >= target) {
+			uint64_t value = histogram_bucket_value(i);
+			return value < h->max ? value : h->max;
+		}
+	}
+
+	return h->max;
+}
+
+#ifdef __cplusplus
+}
+#endif
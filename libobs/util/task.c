@@ -2,6 +2,7 @@
 #include "bmem.h"
 #include "threading.h"
 #include "circlebuf.h"
+#include "darray.h"
 
 struct os_task_queue {
 	pthread_t thread;
@@ -163,3 +164,143 @@ static void *tiny_tubular_task_thread(void *param)
 
 	return NULL;
 }
+
+/* ------------------------------------------------------------------------- */
+
+struct os_task_pool {
+	DARRAY(pthread_t) threads;
+	char *name;
+
+	pthread_mutex_t run_mutex;
+	os_sem_t *start_sem;
+	os_event_t *done_event;
+	volatile bool exiting;
+
+	os_task_pool_job_t job;
+	void *param;
+	long count;
+	volatile long next_idx;
+	volatile long participants;
+};
+
+static void task_pool_do_jobs(struct os_task_pool *pool)
+{
+	long idx;
+
+	while ((idx = os_atomic_inc_long(&pool->next_idx) - 1) < pool->count)
+		pool->job(pool->param, (size_t)idx);
+}
+
+static void *task_pool_thread(void *param)
+{
+	struct os_task_pool *pool = param;
+
+	os_set_thread_name(pool->name);
+
+	while (os_sem_wait(pool->start_sem) == 0) {
+		if (os_atomic_load_bool(&pool->exiting))
+			break;
+
+		task_pool_do_jobs(pool);
+
+		if (os_atomic_dec_long(&pool->participants) == 0)
+			os_event_signal(pool->done_event);
+	}
+
+	return NULL;
+}
+
+os_task_pool_t *os_task_pool_create(size_t num_threads, const char *name)
+{
+	struct os_task_pool *pool = bzalloc(sizeof(*pool));
+	pool->name = bstrdup(name ? name : "task pool");
+
+	if (pthread_mutex_init(&pool->run_mutex, NULL) != 0)
+		goto fail1;
+	if (os_sem_init(&pool->start_sem, 0) != 0)
+		goto fail2;
+	if (os_event_init(&pool->done_event, OS_EVENT_TYPE_AUTO) != 0)
+		goto fail3;
+
+	for (size_t i = 0; i < num_threads; i++) {
+		pthread_t thread;
+		if (pthread_create(&thread, NULL, task_pool_thread, pool) != 0)
+			break;
+		da_push_back(pool->threads, &thread);
+	}
+
+	return pool;
+
+fail3:
+	os_sem_destroy(pool->start_sem);
+fail2:
+	pthread_mutex_destroy(&pool->run_mutex);
+fail1:
+	bfree(pool->name);
+	bfree(pool);
+	return NULL;
+}
+
+void os_task_pool_destroy(os_task_pool_t *pool)
+{
+	if (!pool)
+		return;
+
+	os_atomic_set_bool(&pool->exiting, true);
+	for (size_t i = 0; i < pool->threads.num; i++)
+		os_sem_post(pool->start_sem);
+	for (size_t i = 0; i < pool->threads.num; i++)
+		pthread_join(pool->threads.array[i], NULL);
+
+	da_free(pool->threads);
+	os_event_destroy(pool->done_event);
+	os_sem_destroy(pool->start_sem);
+	pthread_mutex_destroy(&pool->run_mutex);
+	bfree(pool->name);
+	bfree(pool);
+}
+
+size_t os_task_pool_num_threads(const os_task_pool_t *pool)
+{
+	return pool ? pool->threads.num : 0;
+}
+
+void os_task_pool_run(os_task_pool_t *pool, os_task_pool_job_t job,
+		      void *param, size_t count)
+{
+	size_t helpers;
+
+	if (!count)
+		return;
+
+	if (!pool || !pool->threads.num || count == 1) {
+		for (size_t i = 0; i < count; i++)
+			job(param, i);
+		return;
+	}
+
+	helpers = count - 1;
+	if (helpers > pool->threads.num)
+		helpers = pool->threads.num;
+
+	pthread_mutex_lock(&pool->run_mutex);
+
+	pool->job = job;
+	pool->param = param;
+	pool->count = (long)count;
+	os_atomic_store_long(&pool->next_idx, 0);
+
+	/* every woken thread checks out through 'participants', so no thread
+	 * can still be looking at this batch once we return */
+	os_atomic_store_long(&pool->participants, (long)helpers + 1);
+
+	for (size_t i = 0; i < helpers; i++)
+		os_sem_post(pool->start_sem);
+
+	task_pool_do_jobs(pool);
+
+	if (os_atomic_dec_long(&pool->participants) != 0)
+		os_event_wait(pool->done_event);
+
+	pthread_mutex_unlock(&pool->run_mutex);
+}
@@ -18,6 +18,23 @@ EXPORT void os_task_queue_destroy(os_task_queue_t *tt);
 EXPORT bool os_task_queue_wait(os_task_queue_t *tt);
 EXPORT bool os_task_queue_inside(os_task_queue_t *tt);
 
+/* Fork/join worker pool.  os_task_pool_run() calls job(param, idx) once for
+ * every idx in [0, count), spreading the calls across the pool threads and
+ * the calling thread, and returns once all of them have finished.  Calls to
+ * os_task_pool_run() on the same pool are serialized, and a job must not run
+ * its own pool.  A pool with zero threads runs every job on the caller. */
+struct os_task_pool;
+typedef struct os_task_pool os_task_pool_t;
+
+typedef void (*os_task_pool_job_t)(void *param, size_t idx);
+
+EXPORT os_task_pool_t *os_task_pool_create(size_t num_threads,
+					   const char *name);
+EXPORT void os_task_pool_destroy(os_task_pool_t *pool);
+EXPORT size_t os_task_pool_num_threads(const os_task_pool_t *pool);
+EXPORT void os_task_pool_run(os_task_pool_t *pool, os_task_pool_job_t job,
+			     void *param, size_t count);
+
 #ifdef __cplusplus
 }
 #endif
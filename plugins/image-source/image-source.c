@@ -65,6 +65,8 @@ static void image_source_load(struct image_source *context)
 		if (!context->if3.image2.image.loaded)
 			warn("failed to load texture '%s'", file);
 	}
+
+	obs_source_content_changed(context->source);
 }
 
 static void image_source_unload(struct image_source *context)
@@ -72,6 +74,8 @@ static void image_source_unload(struct image_source *context)
 	obs_enter_graphics();
 	gs_image_file3_free(&context->if3);
 	obs_leave_graphics();
+
+	obs_source_content_changed(context->source);
 }
 
 static void image_source_update(void *data, obs_data_t *settings)
@@ -129,6 +133,7 @@ static void restart_gif(void *data)
 		gs_image_file3_update_texture(&context->if3);
 		obs_leave_graphics();
 
+		obs_source_content_changed(context->source);
 		context->restart_gif = false;
 	}
 }
@@ -241,6 +246,8 @@ static void image_source_tick(void *data, float seconds)
 			obs_enter_graphics();
 			gs_image_file3_update_texture(&context->if3);
 			obs_leave_graphics();
+
+			obs_source_content_changed(context->source);
 		}
 	}
 
@@ -326,7 +333,8 @@ static obs_missing_files_t *image_source_missingfiles(void *data)
 static struct obs_source_info image_source_info = {
 	.id = "image_source",
 	.type = OBS_SOURCE_TYPE_INPUT,
-	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_SRGB,
+	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_SRGB |
+			OBS_SOURCE_STATIC_VIDEO,
 	.get_name = image_source_get_name,
 	.create = image_source_create,
 	.destroy = image_source_destroy,
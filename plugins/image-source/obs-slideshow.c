@@ -770,15 +770,15 @@ static inline bool ss_audio_render_(obs_source_t *transition, uint64_t *ts_out,
 	if (!source_ts)
 		return false;
 
+	uint32_t frames = audio_output_get_frames(obs_get_audio());
+
 	obs_source_get_audio_mix(transition, &child_audio);
 	for (size_t mix = 0; mix < MAX_AUDIO_MIXES; mix++) {
 		for (size_t ch = 0; ch < channels; ch++) {
 			float *out = audio_output->output[mix].data[ch];
 			float *in = child_audio.output[mix].data[ch];
 
-			memcpy(out, in,
-			       AUDIO_OUTPUT_FRAMES * MAX_AUDIO_CHANNELS *
-				       sizeof(float));
+			memcpy(out, in, frames * sizeof(float));
 		}
 	}
 
@@ -13,6 +13,10 @@ struct virtualcam_data {
 	obs_output_t *output;
 	int device;
 	uint32_t frame_size;
+	bool keep_format;
+	enum video_format format;
+	uint32_t width;
+	uint32_t height;
 };
 
 static const char *virtualcam_name(void *unused)
@@ -106,7 +110,9 @@ static void *virtualcam_create(obs_data_t *settings, obs_output_t *output)
 		(struct virtualcam_data *)bzalloc(sizeof(*vcam));
 	vcam->output = output;
 
-	UNUSED_PARAMETER(settings);
+	/* write NV12/I420 frames as they come instead of converting them to
+	 * YUY2, for sources that already render in a camera format */
+	vcam->keep_format = obs_data_get_bool(settings, "keep_format");
 	return vcam;
 }
 
@@ -119,9 +125,29 @@ static bool try_connect(void *data, const char *device)
 
 	uint32_t width = obs_output_get_width(vcam->output);
 	uint32_t height = obs_output_get_height(vcam->output);
+	uint32_t pixelformat = V4L2_PIX_FMT_YUYV;
 
+	vcam->format = VIDEO_FORMAT_YUY2;
 	vcam->frame_size = width * height * 2;
 
+	if (vcam->keep_format) {
+		const struct video_output_info *voi =
+			video_output_get_info(obs_output_video(vcam->output));
+
+		if (voi && voi->format == VIDEO_FORMAT_NV12) {
+			pixelformat = V4L2_PIX_FMT_NV12;
+			vcam->format = VIDEO_FORMAT_NV12;
+			vcam->frame_size = width * height * 3 / 2;
+		} else if (voi && voi->format == VIDEO_FORMAT_I420) {
+			pixelformat = V4L2_PIX_FMT_YUV420;
+			vcam->format = VIDEO_FORMAT_I420;
+			vcam->frame_size = width * height * 3 / 2;
+		}
+	}
+
+	vcam->width = width;
+	vcam->height = height;
+
 	vcam->device = open(device, O_RDWR);
 
 	if (vcam->device < 0)
@@ -150,14 +176,14 @@ static bool try_connect(void *data, const char *device)
 
 	format.fmt.pix.width = width;
 	format.fmt.pix.height = height;
-	format.fmt.pix.pixelformat = V4L2_PIX_FMT_YUYV;
+	format.fmt.pix.pixelformat = pixelformat;
 	format.fmt.pix.sizeimage = vcam->frame_size;
 
 	if (ioctl(vcam->device, VIDIOC_S_FMT, &format) < 0)
 		return false;
 
 	struct video_scale_info vsi = {0};
-	vsi.format = VIDEO_FORMAT_YUY2;
+	vsi.format = vcam->format;
 	vsi.width = width;
 	vsi.height = height;
 	obs_output_set_video_conversion(vcam->output, &vsi);
@@ -228,16 +254,36 @@ static void virtualcam_stop(void *data, uint64_t ts)
 	UNUSED_PARAMETER(ts);
 }
 
+static void write_plane(struct virtualcam_data *vcam, const uint8_t *data,
+			uint32_t size)
+{
+	while (size > 0) {
+		ssize_t written = write(vcam->device, data, size);
+		if (written <= 0)
+			break;
+		data += written;
+		size -= (uint32_t)written;
+	}
+}
+
 static void virtual_video(void *param, struct video_data *frame)
 {
 	struct virtualcam_data *vcam = (struct virtualcam_data *)param;
-	uint32_t frame_size = vcam->frame_size;
-	while (frame_size > 0) {
-		ssize_t written =
-			write(vcam->device, frame->data[0], vcam->frame_size);
-		if (written == -1)
-			break;
-		frame_size -= written;
+	uint32_t luma_size = vcam->width * vcam->height;
+
+	/* planes are not necessarily contiguous in the frame */
+	switch (vcam->format) {
+	case VIDEO_FORMAT_NV12:
+		write_plane(vcam, frame->data[0], luma_size);
+		write_plane(vcam, frame->data[1], luma_size / 2);
+		break;
+	case VIDEO_FORMAT_I420:
+		write_plane(vcam, frame->data[0], luma_size);
+		write_plane(vcam, frame->data[1], luma_size / 4);
+		write_plane(vcam, frame->data[2], luma_size / 4);
+		break;
+	default:
+		write_plane(vcam, frame->data[0], vcam->frame_size);
 	}
 }
 
@@ -0,0 +1,343 @@
+#include "ffmpeg-mux-ring.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <util/threading.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define RING_MAGIC 0x4D4D4646 /* "FFMM" */
+#define RING_NAME_SIZE 64
+#define RING_DATA_OFFSET 64
+#define RING_NAME_PREFIX "obs-ffmpeg-mux-"
+
+/* Positions only ever grow (and wrap around at 2^32); the offset into the
+ * data is the position masked by the size.  A packet is never split, if it
+ * does not fit before the end of the data it starts at offset 0 instead. */
+struct ring_header {
+	uint32_t magic;
+	uint32_t size;
+	volatile long attached;
+	volatile long read_pos;
+};
+
+struct ffm_ring {
+	struct ring_header *header;
+	uint8_t *data;
+	size_t map_size;
+	uint32_t write_pos;
+	bool owner;
+	bool unlinked;
+	char name[RING_NAME_SIZE];
+#ifdef _WIN32
+	HANDLE mapping;
+#endif
+};
+
+static inline uint32_t ring_mask(const struct ffm_ring *ring)
+{
+	return ring->header->size - 1;
+}
+
+/* ------------------------------------------------------------------------- */
+
+#ifdef _WIN32
+static void *map_ring(struct ffm_ring *ring, bool create, size_t size)
+{
+	char name[RING_NAME_SIZE + 8];
+	snprintf(name, sizeof(name), "Local\\%s", ring->name);
+
+	if (create)
+		ring->mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL,
+						   PAGE_READWRITE, 0,
+						   (DWORD)size, name);
+	else
+		ring->mapping =
+			OpenFileMappingA(FILE_MAP_ALL_ACCESS, false, name);
+
+	if (!ring->mapping)
+		return NULL;
+
+	/* a size of 0 maps the whole object */
+	return MapViewOfFile(ring->mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+}
+
+static void unmap_ring(struct ffm_ring *ring)
+{
+	if (ring->header)
+		UnmapViewOfFile(ring->header);
+	if (ring->mapping)
+		CloseHandle(ring->mapping);
+}
+
+static size_t get_map_size(struct ffm_ring *ring)
+{
+	MEMORY_BASIC_INFORMATION mbi;
+
+	if (!VirtualQuery(ring->header, &mbi, sizeof(mbi)))
+		return 0;
+	return mbi.RegionSize;
+}
+
+static unsigned long get_process_id(void)
+{
+	return (unsigned long)GetCurrentProcessId();
+}
+
+/* named mappings go away with the last handle, nothing can be left over */
+static inline void unlink_ring(struct ffm_ring *ring)
+{
+	(void)ring;
+}
+
+static inline void remove_stale_rings(void) {}
+#else
+static void *map_ring(struct ffm_ring *ring, bool create, size_t size)
+{
+	char name[RING_NAME_SIZE + 1];
+	struct stat st;
+	void *ptr;
+	int fd;
+
+	snprintf(name, sizeof(name), "/%s", ring->name);
+
+	fd = create ? shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600)
+		    : shm_open(name, O_RDWR, 0);
+	if (fd == -1)
+		return NULL;
+
+	if (create && ftruncate(fd, (off_t)size) != 0)
+		goto fail;
+	if (!create) {
+		if (fstat(fd, &st) != 0)
+			goto fail;
+		size = (size_t)st.st_size;
+	}
+
+	ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (ptr == MAP_FAILED)
+		return NULL;
+
+	ring->map_size = size;
+	return ptr;
+
+fail:
+	close(fd);
+	if (create)
+		shm_unlink(name);
+	return NULL;
+}
+
+/* both sides keep their mapping, so the name is only needed until
+ * ffmpeg-mux has opened it; removing it then means a crash of either
+ * process cannot leave the object behind */
+static void unlink_ring(struct ffm_ring *ring)
+{
+	char name[RING_NAME_SIZE + 1];
+
+	if (!ring->owner || ring->unlinked)
+		return;
+
+	snprintf(name, sizeof(name), "/%s", ring->name);
+	shm_unlink(name);
+	ring->unlinked = true;
+}
+
+static void unmap_ring(struct ffm_ring *ring)
+{
+	if (ring->header)
+		munmap(ring->header, ring->map_size);
+
+	unlink_ring(ring);
+}
+
+static bool process_exists(unsigned long pid)
+{
+	return kill((pid_t)pid, 0) == 0 || errno != ESRCH;
+}
+
+/* removes the rings of processes that exited before ffmpeg-mux opened them.
+ * The counter starts over in every process, so rings named after this
+ * process are left over from an earlier one with the same id. */
+static void remove_stale_rings(void)
+{
+	const size_t prefix_len = sizeof(RING_NAME_PREFIX) - 1;
+	const unsigned long self = (unsigned long)getpid();
+	struct dirent *entry;
+	DIR *dir;
+
+	dir = opendir("/dev/shm");
+	if (!dir)
+		return;
+
+	while ((entry = readdir(dir)) != NULL) {
+		char name[RING_NAME_SIZE + 1];
+		unsigned long pid;
+		char *end;
+
+		if (strncmp(entry->d_name, RING_NAME_PREFIX, prefix_len) != 0)
+			continue;
+
+		pid = strtoul(entry->d_name + prefix_len, &end, 10);
+		if (*end != '-' || (pid != self && process_exists(pid)))
+			continue;
+
+		snprintf(name, sizeof(name), "/%s", entry->d_name);
+		shm_unlink(name);
+	}
+
+	closedir(dir);
+}
+
+static size_t get_map_size(struct ffm_ring *ring)
+{
+	return ring->map_size;
+}
+
+static unsigned long get_process_id(void)
+{
+	return (unsigned long)getpid();
+}
+#endif
+
+/* ------------------------------------------------------------------------- */
+
+struct ffm_ring *ffm_ring_create(uint32_t size)
+{
+	static volatile long counter = 0;
+	static volatile bool cleaned = false;
+	struct ffm_ring *ring;
+	uint32_t pow2 = 4096;
+
+	if (!os_atomic_exchange_bool(&cleaned, true))
+		remove_stale_rings();
+
+	while (pow2 < size && pow2 < (1U << 30))
+		pow2 <<= 1;
+
+	ring = calloc(1, sizeof(*ring));
+	ring->owner = true;
+	snprintf(ring->name, sizeof(ring->name), RING_NAME_PREFIX "%lu-%ld",
+		 get_process_id(), os_atomic_inc_long(&counter));
+
+	ring->map_size = RING_DATA_OFFSET + (size_t)pow2;
+	ring->header = map_ring(ring, true, ring->map_size);
+	if (!ring->header) {
+		ring->owner = false;
+		ffm_ring_close(ring);
+		return NULL;
+	}
+
+	ring->header->magic = RING_MAGIC;
+	ring->header->size = pow2;
+	os_atomic_set_long(&ring->header->read_pos, 0);
+	os_atomic_set_long(&ring->header->attached, 0);
+	ring->data = (uint8_t *)ring->header + RING_DATA_OFFSET;
+	return ring;
+}
+
+const char *ffm_ring_name(const struct ffm_ring *ring)
+{
+	return ring ? ring->name : "";
+}
+
+bool ffm_ring_attached(struct ffm_ring *ring)
+{
+	if (!ring || os_atomic_load_long(&ring->header->attached) == 0)
+		return false;
+
+	unlink_ring(ring);
+	return true;
+}
+
+bool ffm_ring_write(struct ffm_ring *ring, const uint8_t *data, uint32_t size,
+		    uint32_t *pos)
+{
+	const uint32_t ring_size = ring->header->size;
+	uint32_t read_pos = (uint32_t)os_atomic_load_long(
+		&ring->header->read_pos);
+	uint32_t write_pos = ring->write_pos;
+	uint32_t offset = write_pos & ring_mask(ring);
+	uint32_t skip = 0;
+
+	if (size > ring_size)
+		return false;
+
+	if (offset + size > ring_size)
+		skip = ring_size - offset;
+	if ((write_pos - read_pos) + skip + size > ring_size)
+		return false;
+
+	write_pos += skip;
+	memcpy(ring->data + (write_pos & ring_mask(ring)), data, size);
+
+	*pos = write_pos;
+	ring->write_pos = write_pos + size;
+	return true;
+}
+
+struct ffm_ring *ffm_ring_open(const char *name)
+{
+	struct ffm_ring *ring;
+
+	if (!name || !*name || strlen(name) >= RING_NAME_SIZE)
+		return NULL;
+
+	ring = calloc(1, sizeof(*ring));
+	strcpy(ring->name, name);
+
+	ring->header = map_ring(ring, false, 0);
+	if (!ring->header)
+		goto fail;
+
+	ring->map_size = get_map_size(ring);
+	if (ring->header->magic != RING_MAGIC ||
+	    ring->map_size < RING_DATA_OFFSET + (size_t)ring->header->size)
+		goto fail;
+
+	ring->data = (uint8_t *)ring->header + RING_DATA_OFFSET;
+	os_atomic_set_long(&ring->header->attached, 1);
+	return ring;
+
+fail:
+	ffm_ring_close(ring);
+	return NULL;
+}
+
+const uint8_t *ffm_ring_peek(const struct ffm_ring *ring, uint32_t pos,
+			     uint32_t size)
+{
+	uint32_t offset = pos & ring_mask(ring);
+
+	if (offset + size > ring->header->size)
+		return NULL;
+
+	return ring->data + offset;
+}
+
+void ffm_ring_consume(struct ffm_ring *ring, uint32_t pos, uint32_t size)
+{
+	os_atomic_set_long(&ring->header->read_pos, (long)(pos + size));
+}
+
+void ffm_ring_close(struct ffm_ring *ring)
+{
+	if (!ring)
+		return;
+
+	unmap_ring(ring);
+	free(ring);
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Shared memory ring that carries packet data from obs to ffmpeg-mux.
+ *
+ * The pipe still carries an ffm_packet_info for every packet and stays the
+ * only control channel; when a packet is in the ring, the info just says
+ * where.  obs is the only writer and ffmpeg-mux the only reader.  The writer
+ * never waits for room: when the ring is full (or the reader has not opened
+ * it yet) the packet is sent over the pipe as before.
+ */
+
+#define FFM_RING_DEFAULT_SIZE (32 * 1024 * 1024)
+
+struct ffm_ring;
+
+/* obs side */
+extern struct ffm_ring *ffm_ring_create(uint32_t size);
+extern const char *ffm_ring_name(const struct ffm_ring *ring);
+/* true once ffmpeg-mux has opened the ring, which also removes its name */
+extern bool ffm_ring_attached(struct ffm_ring *ring);
+extern bool ffm_ring_write(struct ffm_ring *ring, const uint8_t *data,
+			   uint32_t size, uint32_t *pos);
+
+/* ffmpeg-mux side */
+extern struct ffm_ring *ffm_ring_open(const char *name);
+extern const uint8_t *ffm_ring_peek(const struct ffm_ring *ring, uint32_t pos,
+				    uint32_t size);
+extern void ffm_ring_consume(struct ffm_ring *ring, uint32_t pos,
+			     uint32_t size);
+
+extern void ffm_ring_close(struct ffm_ring *ring);
@@ -25,6 +25,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "ffmpeg-mux.h"
+#include "ffmpeg-mux-ring.h"
 
 #include <util/dstr.h>
 #include <libavcodec/avcodec.h>
@@ -45,6 +46,7 @@
 /* ------------------------------------------------------------------------- */
 
 static char *global_stream_key = "";
+static struct ffm_ring *global_ring = NULL;
 
 struct resize_buf {
 	uint8_t *buf;
@@ -97,6 +99,7 @@ struct main_params {
 	int max_luminance;
 	char *acodec;
 	char *muxer_settings;
+	char *ring_name;
 };
 
 struct audio_params {
@@ -359,6 +362,10 @@ static bool init_params(int *argc, char ***argv, struct main_params *params,
 
 	get_opt_str(argc, argv, &params->muxer_settings, "muxer settings");
 
+	/* not passed if obs could not create the ring */
+	if (*argc)
+		get_opt_str(argc, argv, &params->ring_name, "ring name");
+
 	return true;
 }
 
@@ -553,21 +560,44 @@ static size_t safe_read(void *vdata, size_t size)
 	return total;
 }
 
+/* the data either follows the info on the pipe or is in the shared ring */
+static uint8_t *read_packet_data(const struct ffm_packet_info *info,
+				 struct resize_buf *rb)
+{
+	if (info->in_ring) {
+		return global_ring ? (uint8_t *)ffm_ring_peek(global_ring,
+							      info->ring_pos,
+							      info->size)
+				   : NULL;
+	}
+
+	resize_buf_resize(rb, info->size);
+	return safe_read(rb->buf, info->size) == info->size ? rb->buf : NULL;
+}
+
+static void release_packet_data(const struct ffm_packet_info *info)
+{
+	if (info->in_ring && global_ring)
+		ffm_ring_consume(global_ring, info->ring_pos, info->size);
+}
+
 static bool ffmpeg_mux_get_header(struct ffmpeg_mux *ffm)
 {
 	struct ffm_packet_info info = {0};
 
 	bool success = safe_read(&info, sizeof(info)) == sizeof(info);
 	if (success) {
-		uint8_t *data = malloc(info.size);
+		struct resize_buf rb = {0};
+		uint8_t *data = read_packet_data(&info, &rb);
 
-		if (safe_read(data, info.size) == info.size) {
+		if (data) {
 			ffmpeg_mux_header(ffm, data, &info);
 		} else {
 			success = false;
 		}
 
-		free(data);
+		release_packet_data(&info);
+		resize_buf_free(&rb);
 	}
 
 	return success;
@@ -924,6 +954,9 @@ int main(int argc, char *argv[])
 		return ret;
 	}
 
+	/* obs keeps using the pipe for data until the ring is opened */
+	global_ring = ffm_ring_open(ffm.params.ring_name);
+
 	while (!fail && safe_read(&info, sizeof(info)) == sizeof(info)) {
 		if (info.type == FFM_PACKET_CHANGE_FILE) {
 			fail = !read_change_file(&ffm, info.size, &rb_filename,
@@ -931,16 +964,18 @@ int main(int argc, char *argv[])
 			continue;
 		}
 
-		resize_buf_resize(&rb, info.size);
-
-		if (safe_read(rb.buf, info.size) == info.size) {
-			fail = !ffmpeg_mux_packet(&ffm, rb.buf, &info);
+		uint8_t *data = read_packet_data(&info, &rb);
+		if (data) {
+			fail = !ffmpeg_mux_packet(&ffm, data, &info);
 		} else {
 			fail = true;
 		}
+
+		release_packet_data(&info);
 	}
 
 	ffmpeg_mux_free(&ffm);
+	ffm_ring_close(global_ring);
 	resize_buf_free(&rb);
 	resize_buf_free(&rb_filename);
 
@@ -36,4 +36,9 @@ struct ffm_packet_info {
 	uint32_t index;
 	enum ffm_packet_type type;
 	bool keyframe;
+
+	/* the data is in the shared ring at ring_pos instead of following
+	 * the info on the pipe */
+	bool in_ring;
+	uint32_t ring_pos;
 };
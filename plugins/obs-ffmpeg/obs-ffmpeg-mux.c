@@ -15,7 +15,9 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 ******************************************************************************/
 #include "ffmpeg-mux/ffmpeg-mux.h"
+#include "ffmpeg-mux/ffmpeg-mux-ring.h"
 #include "obs-ffmpeg-mux.h"
+#include "obs-ffmpeg-replay-segment.h"
 
 #ifdef _WIN32
 #include "util/windows/win-version.h"
@@ -44,8 +46,30 @@ static const char *ffmpeg_mpegts_mux_getname(void *type)
 }
 #endif
 
+static void replay_buffer_stop_spill(struct ffmpeg_muxer *stream)
+{
+	if (!stream->spill_thread_active)
+		return;
+
+	os_atomic_set_bool(&stream->spill_stop, true);
+	os_sem_post(stream->spill_sem);
+	pthread_join(stream->spill_thread, NULL);
+	stream->spill_thread_active = false;
+
+	for (size_t i = 0; i < stream->spill_queue.num; i++)
+		replay_segment_release(stream->spill_queue.array[i]);
+	for (size_t i = 0; i < stream->spill_done.num; i++) {
+		replay_segment_release(stream->spill_done.array[i].memory);
+		replay_segment_release(stream->spill_done.array[i].disk);
+	}
+	da_free(stream->spill_queue);
+	da_free(stream->spill_done);
+}
+
 static inline void replay_buffer_clear(struct ffmpeg_muxer *stream)
 {
+	replay_buffer_stop_spill(stream);
+
 	while (stream->packets.size > 0) {
 		struct encoder_packet pkt;
 		circlebuf_pop_front(&stream->packets, &pkt, sizeof(pkt));
@@ -53,14 +77,32 @@ static inline void replay_buffer_clear(struct ffmpeg_muxer *stream)
 	}
 
 	circlebuf_free(&stream->packets);
+
+	for (size_t i = 0; i < stream->segments.num; i++)
+		replay_segment_release(stream->segments.array[i]);
+	da_free(stream->segments);
+
 	stream->cur_size = 0;
 	stream->cur_time = 0;
 	stream->max_size = 0;
 	stream->max_time = 0;
+	stream->max_memory = 0;
+	stream->mem_size = 0;
+	stream->mem_segments_size = 0;
 	stream->save_ts = 0;
 	stream->keyframes = 0;
 }
 
+static void replay_buffer_release_mux_data(struct ffmpeg_muxer *stream)
+{
+	for (size_t i = 0; i < stream->mux_packets.num; i++)
+		obs_encoder_packet_release(&stream->mux_packets.array[i]);
+	for (size_t i = 0; i < stream->mux_segments.num; i++)
+		replay_segment_release(stream->mux_segments.array[i]);
+	da_free(stream->mux_packets);
+	da_free(stream->mux_segments);
+}
+
 static void ffmpeg_mux_destroy(void *data)
 {
 	struct ffmpeg_muxer *stream = data;
@@ -68,13 +110,12 @@ static void ffmpeg_mux_destroy(void *data)
 	replay_buffer_clear(stream);
 	if (stream->mux_thread_joinable)
 		pthread_join(stream->mux_thread, NULL);
-	for (size_t i = 0; i < stream->mux_packets.num; i++)
-		obs_encoder_packet_release(&stream->mux_packets.array[i]);
-	da_free(stream->mux_packets);
+	replay_buffer_release_mux_data(stream);
 	circlebuf_free(&stream->packets);
 
-	os_process_pipe_destroy(stream->pipe);
+	stop_pipe(stream);
 	dstr_free(&stream->path);
+	dstr_free(&stream->spill_path);
 	dstr_free(&stream->printable_path);
 	dstr_free(&stream->stream_key);
 	dstr_free(&stream->muxer_settings);
@@ -260,7 +301,7 @@ static void build_command_line(struct ffmpeg_muxer *stream, struct dstr *cmd,
 			       const char *path)
 {
 	obs_encoder_t *vencoder = obs_output_get_video_encoder(stream->output);
-	obs_encoder_t *aencoders[MAX_AUDIO_MIXES];
+	obs_encoder_t *aencoders[MAX_AUDIO_TRACKS];
 	int num_tracks = 0;
 
 	for (;;) {
@@ -296,14 +337,40 @@ static void build_command_line(struct ffmpeg_muxer *stream, struct dstr *cmd,
 
 	add_stream_key(cmd, stream);
 	add_muxer_params(cmd, stream);
+
+	if (stream->ring)
+		dstr_catf(cmd, "\"%s\" ", ffm_ring_name(stream->ring));
 }
 
 void start_pipe(struct ffmpeg_muxer *stream, const char *path)
 {
 	struct dstr cmd;
+
+	/* packet data goes through shared memory once ffmpeg-mux has opened
+	 * it, the pipe is still used for everything else */
+	stream->ring = ffm_ring_create(FFM_RING_DEFAULT_SIZE);
+	if (!stream->ring)
+		warn("Failed to create shared memory ring, "
+		     "sending packets over the pipe");
+
 	build_command_line(stream, &cmd, path);
 	stream->pipe = os_process_pipe_create(cmd.array, "w");
 	dstr_free(&cmd);
+
+	if (!stream->pipe) {
+		ffm_ring_close(stream->ring);
+		stream->ring = NULL;
+	}
+}
+
+int stop_pipe(struct ffmpeg_muxer *stream)
+{
+	int ret = os_process_pipe_destroy(stream->pipe);
+	stream->pipe = NULL;
+
+	ffm_ring_close(stream->ring);
+	stream->ring = NULL;
+	return ret;
 }
 
 static void set_file_not_readable_error(struct ffmpeg_muxer *stream,
@@ -332,7 +399,7 @@ inline static void ts_offset_clear(struct ffmpeg_muxer *stream)
 	stream->found_video = false;
 	stream->video_pts_offset = 0;
 
-	for (size_t i = 0; i < MAX_AUDIO_MIXES; i++) {
+	for (size_t i = 0; i < MAX_AUDIO_TRACKS; i++) {
 		stream->found_audio[i] = false;
 		stream->audio_dts_offsets[i] = 0;
 	}
@@ -450,8 +517,7 @@ int deactivate(struct ffmpeg_muxer *stream, int code)
 	}
 
 	if (active(stream)) {
-		ret = os_process_pipe_destroy(stream->pipe);
-		stream->pipe = NULL;
+		ret = stop_pipe(stream);
 
 		os_atomic_set_bool(&stream->active, false);
 		os_atomic_set_bool(&stream->sent_headers, false);
@@ -612,6 +678,10 @@ bool write_packet(struct ffmpeg_muxer *stream, struct encoder_packet *packet)
 		}
 	}
 
+	if (ffm_ring_attached(stream->ring))
+		info.in_ring = ffm_ring_write(stream->ring, packet->data,
+					      info.size, &info.ring_pos);
+
 	ret = os_process_pipe_write(stream->pipe, (const uint8_t *)&info,
 				    sizeof(info));
 	if (ret != sizeof(info)) {
@@ -620,11 +690,14 @@ bool write_packet(struct ffmpeg_muxer *stream, struct encoder_packet *packet)
 		return false;
 	}
 
-	ret = os_process_pipe_write(stream->pipe, packet->data, packet->size);
-	if (ret != packet->size) {
-		warn("os_process_pipe_write for packet data failed");
-		signal_failure(stream);
-		return false;
+	if (!info.in_ring) {
+		ret = os_process_pipe_write(stream->pipe, packet->data,
+					    packet->size);
+		if (ret != packet->size) {
+			warn("os_process_pipe_write for packet data failed");
+			signal_failure(stream);
+			return false;
+		}
 	}
 
 	stream->total_bytes += packet->size;
@@ -951,12 +1024,69 @@ static void get_last_replay(void *data, calldata_t *cd)
 		calldata_set_string(cd, "path", stream->path.array);
 }
 
+/* Writes the segments queued by replay_buffer_spill() to disk, so the
+ * encoder callback never waits for the file system. */
+static void *replay_buffer_spill_thread(void *data)
+{
+	struct ffmpeg_muxer *stream = data;
+
+	os_set_thread_name("replay buffer spill thread");
+
+	while (os_sem_wait(stream->spill_sem) == 0) {
+		struct spilled_segment done = {0};
+
+		if (os_atomic_load_bool(&stream->spill_stop))
+			break;
+
+		pthread_mutex_lock(&stream->spill_mutex);
+		if (stream->spill_queue.num) {
+			done.memory = stream->spill_queue.array[0];
+			da_erase(stream->spill_queue, 0);
+		}
+		pthread_mutex_unlock(&stream->spill_mutex);
+
+		if (!done.memory)
+			continue;
+
+		if (!os_atomic_load_bool(&stream->spill_failed)) {
+			done.disk = replay_segment_create(
+				stream->spill_path.array,
+				replay_segment_packet(done.memory, 0),
+				replay_segment_num_packets(done.memory));
+
+			if (!done.disk) {
+				warn("Failed to move replay buffer to '%s', "
+				     "keeping it in memory",
+				     stream->spill_path.array);
+				os_atomic_set_bool(&stream->spill_failed,
+						   true);
+			}
+		}
+
+		pthread_mutex_lock(&stream->spill_mutex);
+		da_push_back(stream->spill_done, &done);
+		pthread_mutex_unlock(&stream->spill_mutex);
+	}
+
+	return NULL;
+}
+
 static void *replay_buffer_create(obs_data_t *settings, obs_output_t *output)
 {
 	UNUSED_PARAMETER(settings);
 	struct ffmpeg_muxer *stream = bzalloc(sizeof(*stream));
 	stream->output = output;
 
+	if (pthread_mutex_init(&stream->spill_mutex, NULL) != 0) {
+		bfree(stream);
+		return NULL;
+	}
+	if (os_sem_init(&stream->spill_sem, 0) != 0) {
+		pthread_mutex_destroy(&stream->spill_mutex);
+		bfree(stream);
+		return NULL;
+	}
+
 	stream->hotkey =
 		obs_hotkey_register_output(output, "ReplayBuffer.Save",
 					   obs_module_text("ReplayBuffer.Save"),
@@ -978,6 +1108,11 @@ static void replay_buffer_destroy(void *data)
 	struct ffmpeg_muxer *stream = data;
 	if (stream->hotkey)
 		obs_hotkey_unregister(stream->hotkey);
+
+	replay_buffer_stop_spill(stream);
+	pthread_mutex_destroy(&stream->spill_mutex);
+	os_sem_destroy(stream->spill_sem);
+
 	ffmpeg_mux_destroy(data);
 }
 
@@ -993,8 +1128,25 @@ static bool replay_buffer_start(void *data)
 	obs_data_t *s = obs_output_get_settings(stream->output);
 	stream->max_time = obs_data_get_int(s, "max_time_sec") * 1000000LL;
 	stream->max_size = obs_data_get_int(s, "max_size_mb") * (1024 * 1024);
+	stream->max_memory = obs_data_get_int(s, "max_memory_mb") *
+			     (1024 * 1024);
+
+	dstr_copy(&stream->spill_path,
+		  obs_data_get_string(s, "spill_directory"));
 	obs_data_release(s);
 
+	/* spilling is opt-in, it needs both a limit and somewhere to go */
+	if (stream->max_memory && !dstr_is_empty(&stream->spill_path)) {
+		os_atomic_set_bool(&stream->spill_stop, false);
+		os_atomic_set_bool(&stream->spill_failed, false);
+		stream->spill_thread_active =
+			pthread_create(&stream->spill_thread, NULL,
+				       replay_buffer_spill_thread, stream) == 0;
+	}
+
+	if (!stream->spill_thread_active)
+		stream->max_memory = 0;
+
 	os_atomic_set_bool(&stream->active, true);
 	os_atomic_set_bool(&stream->capturing, true);
 	stream->total_bytes = 0;
@@ -1003,11 +1155,73 @@ static bool replay_buffer_start(void *data)
 	return true;
 }
 
+static inline bool replay_buffer_empty(struct ffmpeg_muxer *stream)
+{
+	return !stream->segments.num && !stream->packets.size;
+}
+
+/* oldest packet in the buffer, whether it is on disk or not */
+static inline const struct encoder_packet *
+replay_buffer_front(struct ffmpeg_muxer *stream)
+{
+	if (stream->segments.num)
+		return replay_segment_packet(stream->segments.array[0], 0);
+	if (stream->packets.size)
+		return circlebuf_data(&stream->packets, 0);
+	return NULL;
+}
+
+static void update_front(struct ffmpeg_muxer *stream)
+{
+	const struct encoder_packet *first = replay_buffer_front(stream);
+
+	if (first) {
+		stream->cur_time = first->dts_usec;
+	} else {
+		stream->cur_size = 0;
+		stream->cur_time = 0;
+		stream->mem_size = 0;
+	}
+}
+
+/* segments always end right before a keyframe, so one segment is always
+ * purged as a whole */
+static bool purge_segment(struct ffmpeg_muxer *stream)
+{
+	struct replay_segment *segment = stream->segments.array[0];
+	size_t num = replay_segment_num_packets(segment);
+	bool keyframe = false;
+
+	for (size_t i = 0; i < num; i++) {
+		const struct encoder_packet *pkt =
+			replay_segment_packet(segment, i);
+
+		if (pkt->type == OBS_ENCODER_VIDEO && pkt->keyframe) {
+			stream->keyframes--;
+			keyframe = true;
+		}
+	}
+
+	stream->cur_size -= (int64_t)replay_segment_size(segment);
+	if (!replay_segment_on_disk(segment)) {
+		stream->mem_size -= (int64_t)replay_segment_size(segment);
+		stream->mem_segments_size -=
+			(int64_t)replay_segment_size(segment);
+	}
+	da_erase(stream->segments, 0);
+	replay_segment_release(segment);
+
+	update_front(stream);
+	return keyframe;
+}
+
 static bool purge_front(struct ffmpeg_muxer *stream)
 {
 	struct encoder_packet pkt;
 	bool keyframe;
 
+	if (stream->segments.num)
+		return purge_segment(stream);
 	if (!stream->packets.size)
 		return false;
 
@@ -1018,15 +1232,9 @@ static bool purge_front(struct ffmpeg_muxer *stream)
 	if (keyframe)
 		stream->keyframes--;
 
-	if (!stream->packets.size) {
-		stream->cur_size = 0;
-		stream->cur_time = 0;
-	} else {
-		struct encoder_packet first;
-		circlebuf_peek_front(&stream->packets, &first, sizeof(first));
-		stream->cur_time = first.dts_usec;
-		stream->cur_size -= (int64_t)pkt.size;
-	}
+	stream->cur_size -= (int64_t)pkt.size;
+	stream->mem_size -= (int64_t)pkt.size;
+	update_front(stream);
 
 	obs_encoder_packet_release(&pkt);
 	return keyframe;
@@ -1035,14 +1243,13 @@ static bool purge_front(struct ffmpeg_muxer *stream)
 static inline void purge(struct ffmpeg_muxer *stream)
 {
 	if (purge_front(stream)) {
-		struct encoder_packet pkt;
+		const struct encoder_packet *pkt;
 
 		for (;;) {
-			if (!stream->packets.size)
+			pkt = replay_buffer_front(stream);
+			if (!pkt)
 				return;
-			circlebuf_peek_front(&stream->packets, &pkt,
-					     sizeof(pkt));
-			if (pkt.type == OBS_ENCODER_VIDEO && pkt.keyframe)
+			if (pkt->type == OBS_ENCODER_VIDEO && pkt->keyframe)
 				return;
 
 			purge_front(stream);
@@ -1054,7 +1261,7 @@ static inline void replay_buffer_purge(struct ffmpeg_muxer *stream,
 				       struct encoder_packet *pkt)
 {
 	if (stream->max_size) {
-		if (!stream->packets.size || stream->keyframes <= 2)
+		if (replay_buffer_empty(stream) || stream->keyframes <= 2)
 			return;
 
 		while ((stream->cur_size + (int64_t)pkt->size) >
@@ -1062,49 +1269,207 @@ static inline void replay_buffer_purge(struct ffmpeg_muxer *stream,
 			purge(stream);
 	}
 
-	if (!stream->packets.size || stream->keyframes <= 2)
+	if (replay_buffer_empty(stream) || stream->keyframes <= 2)
 		return;
 
 	while ((pkt->dts_usec - stream->cur_time) > stream->max_time)
 		purge(stream);
 }
 
-static void insert_packet(struct darray *array, struct encoder_packet *packet,
-			  int64_t video_offset, int64_t *audio_offsets,
-			  int64_t video_pts_offset, int64_t *audio_dts_offsets)
+/* number of packets in memory up to (not including) the second keyframe,
+ * or 0 if the oldest keyframe in memory is still the latest one */
+static size_t oldest_gop_packets(struct ffmpeg_muxer *stream)
 {
-	struct encoder_packet pkt;
-	DARRAY(struct encoder_packet) packets;
-	packets.da = *array;
-	size_t idx;
+	const size_t size = sizeof(struct encoder_packet);
+	size_t num_packets = stream->packets.size / size;
+	bool found_keyframe = false;
 
-	obs_encoder_packet_ref(&pkt, packet);
+	for (size_t i = 0; i < num_packets; i++) {
+		struct encoder_packet *pkt;
+		pkt = circlebuf_data(&stream->packets, i * size);
 
-	if (pkt.type == OBS_ENCODER_VIDEO) {
-		pkt.dts_usec -= video_offset;
-		pkt.dts -= video_pts_offset;
-		pkt.pts -= video_pts_offset;
-	} else {
-		pkt.dts_usec -= audio_offsets[pkt.track_idx];
-		pkt.dts -= audio_dts_offsets[pkt.track_idx];
-		pkt.pts -= audio_dts_offsets[pkt.track_idx];
+		if (pkt->type != OBS_ENCODER_VIDEO || !pkt->keyframe)
+			continue;
+		if (found_keyframe)
+			return i;
+		found_keyframe = true;
 	}
 
-	for (idx = packets.num; idx > 0; idx--) {
-		struct encoder_packet *p = packets.array + (idx - 1);
-		if (p->dts_usec < pkt.dts_usec)
-			break;
+	return 0;
+}
+
+/* swaps the segments the spill thread has written for their copies on disk,
+ * unless they were purged in the meantime */
+static void replay_buffer_collect_spilled(struct ffmpeg_muxer *stream)
+{
+	DARRAY(struct spilled_segment) done;
+
+	pthread_mutex_lock(&stream->spill_mutex);
+	done.da = stream->spill_done.da;
+	da_init(stream->spill_done);
+	pthread_mutex_unlock(&stream->spill_mutex);
+
+	for (size_t i = 0; i < done.num; i++) {
+		struct spilled_segment *seg = &done.array[i];
+		size_t idx = da_find(stream->segments, &seg->memory, 0);
+
+		if (idx != DARRAY_INVALID && seg->disk) {
+			int64_t size = (int64_t)replay_segment_size(seg->disk);
+
+			stream->segments.array[idx] = seg->disk;
+			stream->mem_size -= size;
+			stream->mem_segments_size -= size;
+
+			/* the reference the buffer held */
+			replay_segment_release(seg->memory);
+			seg->disk = NULL;
+		}
+
+		replay_segment_release(seg->memory);
+		replay_segment_release(seg->disk);
 	}
 
-	da_insert(packets, idx, &pkt);
-	*array = packets.da;
+	da_free(done);
+}
+
+/* Hands the oldest GOPs in memory to the spill thread until the packets
+ * still waiting in memory fit in max_memory again.  The GOP that is being
+ * encoded always stays.  Until the spill thread is done, a GOP stays in the
+ * buffer as a segment that holds the packets in memory. */
+static void replay_buffer_spill(struct ffmpeg_muxer *stream)
+{
+	const size_t size = sizeof(struct encoder_packet);
+
+	if (!stream->spill_thread_active)
+		return;
+
+	replay_buffer_collect_spilled(stream);
+
+	if (os_atomic_load_bool(&stream->spill_failed))
+		return;
+
+	while (stream->mem_size - stream->mem_segments_size >
+	       stream->max_memory) {
+		DARRAY(struct encoder_packet) gop = {0};
+		struct replay_segment *segment;
+		size_t num = oldest_gop_packets(stream);
+
+		if (!num)
+			return;
+
+		da_resize(gop, num);
+		circlebuf_pop_front(&stream->packets, gop.array, num * size);
+		segment = replay_segment_create_memory(gop.array, num);
+		da_free(gop);
+
+		stream->mem_segments_size +=
+			(int64_t)replay_segment_size(segment);
+		da_push_back(stream->segments, &segment);
+
+		replay_segment_addref(segment);
+		pthread_mutex_lock(&stream->spill_mutex);
+		da_push_back(stream->spill_queue, &segment);
+		pthread_mutex_unlock(&stream->spill_mutex);
+		os_sem_post(stream->spill_sem);
+	}
+}
+
+struct replay_entry {
+	const struct encoder_packet *pkt;
+	int64_t dts_usec;
+	int64_t ts_offset;
+	size_t order;
+};
+
+static int compare_entries(const void *a, const void *b)
+{
+	const struct replay_entry *entry_a = a;
+	const struct replay_entry *entry_b = b;
+
+	if (entry_a->dts_usec != entry_b->dts_usec)
+		return entry_a->dts_usec < entry_b->dts_usec ? -1 : 1;
+	return entry_a->order < entry_b->order ? -1 : 1;
+}
+
+/* Puts the saved packets in the order they are muxed in.  Every track
+ * starts at 0 in the file, so tracks that started at different times can
+ * change places once their offsets are taken away. */
+static struct replay_entry *sort_replay_packets(struct ffmpeg_muxer *stream,
+						size_t *num)
+{
+	struct replay_entry *entries;
+	size_t num_packets = stream->mux_packets.num;
+	size_t count = 0;
+
+	for (size_t i = 0; i < stream->mux_segments.num; i++)
+		num_packets += replay_segment_num_packets(
+			stream->mux_segments.array[i]);
+
+	entries = bmalloc(sizeof(*entries) * (num_packets ? num_packets : 1));
+
+	for (size_t i = 0; i < stream->mux_segments.num; i++) {
+		struct replay_segment *segment = stream->mux_segments.array[i];
+		size_t seg_packets = replay_segment_num_packets(segment);
+
+		for (size_t j = 0; j < seg_packets; j++)
+			entries[count++].pkt =
+				replay_segment_packet(segment, j);
+	}
+
+	for (size_t i = 0; i < stream->mux_packets.num; i++)
+		entries[count++].pkt = &stream->mux_packets.array[i];
+
+	bool found_video = false;
+	bool found_audio[MAX_AUDIO_TRACKS] = {0};
+	int64_t video_offset = 0;
+	int64_t video_pts_offset = 0;
+	int64_t audio_offsets[MAX_AUDIO_TRACKS] = {0};
+	int64_t audio_dts_offsets[MAX_AUDIO_TRACKS] = {0};
+
+	for (size_t i = 0; i < count; i++) {
+		const struct encoder_packet *pkt = entries[i].pkt;
+		size_t idx = pkt->track_idx;
+
+		if (pkt->type == OBS_ENCODER_VIDEO) {
+			if (!found_video) {
+				video_pts_offset = pkt->pts;
+				video_offset = video_pts_offset * 1000000 /
+					       pkt->timebase_den;
+				found_video = true;
+			}
+
+			entries[i].dts_usec = pkt->dts_usec - video_offset;
+			entries[i].ts_offset = video_pts_offset;
+		} else {
+			if (!found_audio[idx]) {
+				found_audio[idx] = true;
+				audio_offsets[idx] = pkt->dts_usec;
+				audio_dts_offsets[idx] = pkt->dts;
+			}
+
+			entries[i].dts_usec = pkt->dts_usec -
+					      audio_offsets[idx];
+			entries[i].ts_offset = audio_dts_offsets[idx];
+		}
+
+		entries[i].order = i;
+	}
+
+	qsort(entries, count, sizeof(*entries), compare_entries);
+
+	*num = count;
+	return entries;
 }
 
 static void *replay_buffer_mux_thread(void *data)
 {
 	struct ffmpeg_muxer *stream = data;
+	struct replay_entry *entries;
+	size_t num_entries;
 	bool error = false;
 
+	entries = sort_replay_packets(stream, &num_entries);
+
 	start_pipe(stream, stream->path.array);
 
 	if (!stream->pipe) {
@@ -1120,23 +1485,21 @@ static void *replay_buffer_mux_thread(void *data)
 		goto error;
 	}
 
-	for (size_t i = 0; i < stream->mux_packets.num; i++) {
-		struct encoder_packet *pkt = &stream->mux_packets.array[i];
-		write_packet(stream, pkt);
-		obs_encoder_packet_release(pkt);
+	for (size_t i = 0; i < num_entries; i++) {
+		struct encoder_packet pkt = *entries[i].pkt;
+
+		pkt.dts -= entries[i].ts_offset;
+		pkt.pts -= entries[i].ts_offset;
+		pkt.dts_usec = entries[i].dts_usec;
+		write_packet(stream, &pkt);
 	}
 
 	info("Wrote replay buffer to '%s'", stream->path.array);
 
 error:
-	os_process_pipe_destroy(stream->pipe);
-	stream->pipe = NULL;
-	if (error) {
-		for (size_t i = 0; i < stream->mux_packets.num; i++)
-			obs_encoder_packet_release(
-				&stream->mux_packets.array[i]);
-	}
-	da_free(stream->mux_packets);
+	stop_pipe(stream);
+	bfree(entries);
+	replay_buffer_release_mux_data(stream);
 	os_atomic_set_bool(&stream->muxing, false);
 
 	if (!error) {
@@ -1149,45 +1512,27 @@ error:
 	return NULL;
 }
 
+/* Only takes references to what is in the buffer right now, the packets on
+ * disk are handed over a segment at a time.  Putting everything in order is
+ * left to the mux thread. */
 static void replay_buffer_save(struct ffmpeg_muxer *stream)
 {
 	const size_t size = sizeof(struct encoder_packet);
 	size_t num_packets = stream->packets.size / size;
 
-	da_reserve(stream->mux_packets, num_packets);
-
-	/* ---------------------------- */
-	/* reorder packets */
-
-	bool found_video = false;
-	bool found_audio[MAX_AUDIO_MIXES] = {0};
-	int64_t video_offset = 0;
-	int64_t video_pts_offset = 0;
-	int64_t audio_offsets[MAX_AUDIO_MIXES] = {0};
-	int64_t audio_dts_offsets[MAX_AUDIO_MIXES] = {0};
+	da_reserve(stream->mux_segments, stream->segments.num);
+	for (size_t i = 0; i < stream->segments.num; i++) {
+		struct replay_segment *segment = stream->segments.array[i];
+		replay_segment_addref(segment);
+		da_push_back(stream->mux_segments, &segment);
+	}
 
+	da_reserve(stream->mux_packets, num_packets);
 	for (size_t i = 0; i < num_packets; i++) {
 		struct encoder_packet *pkt;
 		pkt = circlebuf_data(&stream->packets, i * size);
-
-		if (pkt->type == OBS_ENCODER_VIDEO) {
-			if (!found_video) {
-				video_pts_offset = pkt->pts;
-				video_offset = video_pts_offset * 1000000 /
-					       pkt->timebase_den;
-				found_video = true;
-			}
-		} else {
-			if (!found_audio[pkt->track_idx]) {
-				found_audio[pkt->track_idx] = true;
-				audio_offsets[pkt->track_idx] = pkt->dts_usec;
-				audio_dts_offsets[pkt->track_idx] = pkt->dts;
-			}
-		}
-
-		insert_packet(&stream->mux_packets.da, pkt, video_offset,
-			      audio_offsets, video_pts_offset,
-			      audio_dts_offsets);
+		obs_encoder_packet_ref(da_push_back_new(stream->mux_packets),
+				       pkt);
 	}
 
 	generate_filename(stream, &stream->path, true);
@@ -1198,6 +1543,7 @@ static void replay_buffer_save(struct ffmpeg_muxer *stream)
 						     stream) == 0;
 	if (!stream->mux_thread_joinable) {
 		warn("Failed to create muxer thread");
+		replay_buffer_release_mux_data(stream);
 		os_atomic_set_bool(&stream->muxing, false);
 	}
 }
@@ -1240,15 +1586,18 @@ static void replay_buffer_data(void *data, struct encoder_packet *packet)
 	obs_encoder_packet_ref(&pkt, packet);
 	replay_buffer_purge(stream, &pkt);
 
-	if (!stream->packets.size)
+	if (replay_buffer_empty(stream))
 		stream->cur_time = pkt.dts_usec;
 	stream->cur_size += pkt.size;
+	stream->mem_size += pkt.size;
 
 	circlebuf_push_back(&stream->packets, packet, sizeof(*packet));
 
 	if (packet->type == OBS_ENCODER_VIDEO && packet->keyframe)
 		stream->keyframes++;
 
+	replay_buffer_spill(stream);
+
 	if (stream->save_ts && packet->sys_dts_usec >= stream->save_ts) {
 		if (os_atomic_load_bool(&stream->muxing))
 			return;
@@ -1267,6 +1616,7 @@ static void replay_buffer_defaults(obs_data_t *s)
 {
 	obs_data_set_default_int(s, "max_time_sec", 15);
 	obs_data_set_default_int(s, "max_size_mb", 500);
+	obs_data_set_default_int(s, "max_memory_mb", 0);
 	obs_data_set_default_string(s, "format", "%CCYY-%MM-%DD %hh-%mm-%ss");
 	obs_data_set_default_string(s, "extension", "mp4");
 	obs_data_set_default_bool(s, "allow_spaces", true);
@@ -10,9 +10,19 @@
 #include <util/platform.h>
 #include <util/threading.h>
 
+struct ffm_ring;
+struct replay_segment;
+
+/* a segment the spill thread is done with, disk is NULL if writing failed */
+struct spilled_segment {
+	struct replay_segment *memory;
+	struct replay_segment *disk;
+};
+
 struct ffmpeg_muxer {
 	obs_output_t *output;
 	os_process_pipe_t *pipe;
+	struct ffm_ring *ring;
 	int64_t stop_ts;
 	uint64_t total_bytes;
 	bool sent_headers;
@@ -36,12 +46,31 @@ struct ffmpeg_muxer {
 	obs_hotkey_id hotkey;
 	volatile bool muxing;
 	DARRAY(struct encoder_packet) mux_packets;
+	DARRAY(struct replay_segment *) mux_segments;
+
+	/* older parts of the replay buffer are moved to disk by the spill
+	 * thread once the packets in memory take up more than max_memory,
+	 * see replay_buffer_spill() */
+	int64_t max_memory;
+	int64_t mem_size;
+	int64_t mem_segments_size; /* part of mem_size in segments */
+	struct dstr spill_path;
+	DARRAY(struct replay_segment *) segments;
+
+	pthread_t spill_thread;
+	bool spill_thread_active;
+	pthread_mutex_t spill_mutex;
+	os_sem_t *spill_sem;
+	volatile bool spill_stop;
+	volatile bool spill_failed;
+	DARRAY(struct replay_segment *) spill_queue;
+	DARRAY(struct spilled_segment) spill_done;
 
 	/* split file */
 	bool found_video;
-	bool found_audio[MAX_AUDIO_MIXES];
+	bool found_audio[MAX_AUDIO_TRACKS];
 	int64_t video_pts_offset;
-	int64_t audio_dts_offsets[MAX_AUDIO_MIXES];
+	int64_t audio_dts_offsets[MAX_AUDIO_TRACKS];
 	bool split_file_ready;
 
 	/* these are accessed both by replay buffer and by HLS */
@@ -68,6 +97,7 @@ struct ffmpeg_muxer {
 bool stopping(struct ffmpeg_muxer *stream);
 bool active(struct ffmpeg_muxer *stream);
 void start_pipe(struct ffmpeg_muxer *stream, const char *path);
+int stop_pipe(struct ffmpeg_muxer *stream);
 bool write_packet(struct ffmpeg_muxer *stream, struct encoder_packet *packet);
 bool send_headers(struct ffmpeg_muxer *stream);
 int deactivate(struct ffmpeg_muxer *stream, int code);
@@ -0,0 +1,283 @@
+/******************************************************************************
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+#include "obs-ffmpeg-replay-segment.h"
+
+#include <util/darray.h>
+#include <util/dstr.h>
+#include <util/platform.h>
+#include <util/threading.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+struct replay_segment {
+	volatile long refs;
+	DARRAY(struct encoder_packet) packets;
+	uint8_t *map;
+	size_t size;
+#ifdef _WIN32
+	HANDLE file;
+	HANDLE mapping;
+#else
+	int fd;
+#endif
+};
+
+/* ------------------------------------------------------------------------- */
+
+#ifdef _WIN32
+static unsigned long get_process_id(void)
+{
+	return (unsigned long)GetCurrentProcessId();
+}
+
+static bool open_file(struct replay_segment *segment, const char *path)
+{
+	wchar_t *wpath = NULL;
+
+	if (!os_utf8_to_wcs_ptr(path, 0, &wpath))
+		return false;
+
+	/* the file goes away with the last handle to it, mapping included */
+	segment->file = CreateFileW(wpath, GENERIC_READ | GENERIC_WRITE,
+				    FILE_SHARE_READ | FILE_SHARE_DELETE, NULL,
+				    CREATE_NEW,
+				    FILE_ATTRIBUTE_TEMPORARY |
+					    FILE_FLAG_DELETE_ON_CLOSE,
+				    NULL);
+	bfree(wpath);
+
+	if (segment->file == INVALID_HANDLE_VALUE) {
+		segment->file = NULL;
+		return false;
+	}
+
+	return true;
+}
+
+static bool write_file(struct replay_segment *segment, const uint8_t *data,
+		       size_t size)
+{
+	while (size) {
+		DWORD chunk = size > 0x40000000 ? 0x40000000 : (DWORD)size;
+		DWORD written = 0;
+
+		if (!WriteFile(segment->file, data, chunk, &written, NULL) ||
+		    !written)
+			return false;
+
+		data += written;
+		size -= written;
+	}
+
+	return true;
+}
+
+static bool map_file(struct replay_segment *segment)
+{
+	segment->mapping = CreateFileMappingW(segment->file, NULL,
+					      PAGE_READONLY, 0, 0, NULL);
+	if (!segment->mapping)
+		return false;
+
+	segment->map = MapViewOfFile(segment->mapping, FILE_MAP_READ, 0, 0,
+				     segment->size);
+	return !!segment->map;
+}
+
+static void close_file(struct replay_segment *segment)
+{
+	if (segment->map)
+		UnmapViewOfFile(segment->map);
+	if (segment->mapping)
+		CloseHandle(segment->mapping);
+	if (segment->file)
+		CloseHandle(segment->file);
+}
+#else
+static unsigned long get_process_id(void)
+{
+	return (unsigned long)getpid();
+}
+
+static bool open_file(struct replay_segment *segment, const char *path)
+{
+	segment->fd = open(path, O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (segment->fd == -1)
+		return false;
+
+	/* the mapping keeps the data around, nothing else needs the name */
+	unlink(path);
+	return true;
+}
+
+static bool write_file(struct replay_segment *segment, const uint8_t *data,
+		       size_t size)
+{
+	while (size) {
+		ssize_t written = write(segment->fd, data, size);
+		if (written < 0 && errno == EINTR)
+			continue;
+		if (written <= 0)
+			return false;
+
+		data += written;
+		size -= (size_t)written;
+	}
+
+	return true;
+}
+
+static bool map_file(struct replay_segment *segment)
+{
+	void *map = mmap(NULL, segment->size, PROT_READ, MAP_SHARED,
+			 segment->fd, 0);
+	if (map == MAP_FAILED)
+		return false;
+
+	close(segment->fd);
+	segment->fd = -1;
+	segment->map = map;
+	return true;
+}
+
+static void close_file(struct replay_segment *segment)
+{
+	if (segment->map)
+		munmap(segment->map, segment->size);
+	if (segment->fd != -1)
+		close(segment->fd);
+}
+#endif
+
+/* ------------------------------------------------------------------------- */
+
+struct replay_segment *
+replay_segment_create(const char *dir, const struct encoder_packet *packets,
+		      size_t num)
+{
+	static volatile long counter = 0;
+	struct replay_segment *segment;
+	struct dstr path = {0};
+	size_t offset = 0;
+
+	for (size_t i = 0; i < num; i++)
+		offset += packets[i].size;
+	if (!offset)
+		return NULL;
+
+	segment = bzalloc(sizeof(*segment));
+	segment->refs = 1;
+	segment->size = offset;
+#ifndef _WIN32
+	segment->fd = -1;
+#endif
+
+	dstr_copy(&path, dir);
+	dstr_replace(&path, "\\", "/");
+	if (dstr_end(&path) != '/')
+		dstr_cat_ch(&path, '/');
+	dstr_catf(&path, ".obs-replay-%lu-%ld.tmp", get_process_id(),
+		  os_atomic_inc_long(&counter));
+
+	bool success = open_file(segment, path.array);
+	dstr_free(&path);
+
+	for (size_t i = 0; success && i < num; i++)
+		success = write_file(segment, packets[i].data,
+				     packets[i].size);
+
+	if (!success || !map_file(segment)) {
+		replay_segment_release(segment);
+		return NULL;
+	}
+
+	da_reserve(segment->packets, num);
+	offset = 0;
+
+	for (size_t i = 0; i < num; i++) {
+		struct encoder_packet *pkt = da_push_back_new(segment->packets);
+		*pkt = packets[i];
+		pkt->data = segment->map + offset;
+		offset += pkt->size;
+	}
+
+	return segment;
+}
+
+struct replay_segment *
+replay_segment_create_memory(const struct encoder_packet *packets, size_t num)
+{
+	struct replay_segment *segment = bzalloc(sizeof(*segment));
+	segment->refs = 1;
+#ifndef _WIN32
+	segment->fd = -1;
+#endif
+
+	da_push_back_array(segment->packets, packets, num);
+	for (size_t i = 0; i < num; i++)
+		segment->size += packets[i].size;
+
+	return segment;
+}
+
+void replay_segment_addref(struct replay_segment *segment)
+{
+	if (segment)
+		os_atomic_inc_long(&segment->refs);
+}
+
+void replay_segment_release(struct replay_segment *segment)
+{
+	if (!segment || os_atomic_dec_long(&segment->refs) != 0)
+		return;
+
+	if (!segment->map) {
+		for (size_t i = 0; i < segment->packets.num; i++)
+			obs_encoder_packet_release(&segment->packets.array[i]);
+	}
+
+	close_file(segment);
+	da_free(segment->packets);
+	bfree(segment);
+}
+
+size_t replay_segment_num_packets(const struct replay_segment *segment)
+{
+	return segment->packets.num;
+}
+
+const struct encoder_packet *
+replay_segment_packet(const struct replay_segment *segment, size_t idx)
+{
+	return &segment->packets.array[idx];
+}
+
+size_t replay_segment_size(const struct replay_segment *segment)
+{
+	return segment->size;
+}
+
+bool replay_segment_on_disk(const struct replay_segment *segment)
+{
+	return !!segment->map;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <obs-module.h>
+
+/*
+ * Part of the replay buffer that is (about to be) moved out of memory.
+ *
+ * A segment either still holds references to its packets in memory, or has
+ * its packet data written to a file in the given directory and mapped back
+ * in read-only, so the packets of a segment look like any other packets but
+ * their data is backed by the file rather than by the heap.  The file is
+ * removed as soon as it is mapped (or marked to be deleted on close on
+ * Windows), it never outlives the segment.
+ *
+ * Segments never change once created.  They are reference counted so that
+ * saving the replay buffer and writing them to disk can happen on other
+ * threads while new packets keep coming in.
+ */
+
+struct replay_segment;
+
+/* returns NULL if the file could not be written, the packets are left
+ * untouched either way */
+struct replay_segment *
+replay_segment_create(const char *dir, const struct encoder_packet *packets,
+		      size_t num);
+
+/* takes over the references of the packets, the data stays in memory */
+struct replay_segment *
+replay_segment_create_memory(const struct encoder_packet *packets, size_t num);
+
+void replay_segment_addref(struct replay_segment *segment);
+void replay_segment_release(struct replay_segment *segment);
+
+size_t replay_segment_num_packets(const struct replay_segment *segment);
+const struct encoder_packet *
+replay_segment_packet(const struct replay_segment *segment, size_t idx);
+
+/* total size of the packet data */
+size_t replay_segment_size(const struct replay_segment *segment);
+
+bool replay_segment_on_disk(const struct replay_segment *segment);
@@ -54,6 +54,12 @@ bool ffmpeg_video_encoder_init_codec(struct ffmpeg_video_encoder *enc)
 		return false;
 	}
 
+	enc->ref_vframe = av_frame_alloc();
+	if (!enc->ref_vframe) {
+		warn("Failed to allocate video frame");
+		return false;
+	}
+
 	enc->initialized = true;
 	return true;
 }
@@ -138,6 +144,7 @@ void ffmpeg_video_encoder_free(struct ffmpeg_video_encoder *enc)
 	avcodec_free_context(&enc->context);
 	av_frame_unref(enc->vframe);
 	av_frame_free(&enc->vframe);
+	av_frame_free(&enc->ref_vframe);
 	da_free(enc->buffer);
 }
 
@@ -206,6 +213,67 @@ static inline void copy_data(AVFrame *pic, const struct encoder_frame *frame,
 	}
 }
 
+static void release_video_buffer(void *opaque, uint8_t *data)
+{
+	UNUSED_PARAMETER(data);
+	video_buffer_release(opaque);
+}
+
+/* Wraps the frame from libobs in an AVFrame without copying it.  The codec
+ * takes its own reference if it holds on to the frame (lookahead, frame
+ * threads), which keeps the libobs buffer from being reused until then. */
+static bool ref_data(struct ffmpeg_video_encoder *enc, AVFrame *pic,
+		     const struct encoder_frame *frame)
+{
+	struct video_buffer *buffer = obs_encoder_frame_get_buffer(frame);
+	const size_t alignment = base_get_alignment();
+	int h_chroma_shift, v_chroma_shift;
+	size_t size = 0;
+
+	if (!buffer)
+		return false;
+
+	av_pix_fmt_get_chroma_sub_sample(enc->context->pix_fmt, &h_chroma_shift,
+					 &v_chroma_shift);
+
+	for (int plane = 0; plane < MAX_AV_PLANES; plane++) {
+		if (!frame->data[plane])
+			break;
+
+		/* leave anything the codec might not expect to the copy */
+		if ((uintptr_t)frame->data[plane] % alignment ||
+		    frame->linesize[plane] % alignment)
+			return false;
+
+		int plane_height = enc->height >> (plane ? v_chroma_shift : 0);
+		size_t end = (size_t)(frame->data[plane] - frame->data[0]) +
+			     (size_t)frame->linesize[plane] * plane_height;
+		if (end > size)
+			size = end;
+	}
+
+	pic->buf[0] = av_buffer_create(frame->data[0], (int)size,
+				       release_video_buffer, buffer,
+				       AV_BUFFER_FLAG_READONLY);
+	if (!pic->buf[0])
+		return false;
+
+	video_buffer_addref(buffer);
+
+	pic->format = enc->context->pix_fmt;
+	pic->width = enc->context->width;
+	pic->height = enc->context->height;
+	pic->colorspace = enc->context->colorspace;
+	pic->color_range = enc->context->color_range;
+
+	for (int plane = 0; plane < MAX_AV_PLANES; plane++) {
+		pic->data[plane] = frame->data[plane];
+		pic->linesize[plane] = (int)frame->linesize[plane];
+	}
+
+	return true;
+}
+
 #define SEC_TO_NSEC 1000000000LL
 #define TIMEOUT_MAX_SEC 5
 #define TIMEOUT_MAX_NSEC (TIMEOUT_MAX_SEC * SEC_TO_NSEC)
@@ -215,6 +283,7 @@ bool ffmpeg_video_encode(struct ffmpeg_video_encoder *enc,
 			 struct encoder_packet *packet, bool *received_packet)
 {
 	AVPacket av_pkt = {0};
+	AVFrame *pic = enc->vframe;
 	bool timeout = false;
 	int64_t cur_ts = (int64_t)os_gettime_ns();
 	int got_packet;
@@ -223,10 +292,16 @@ bool ffmpeg_video_encode(struct ffmpeg_video_encoder *enc,
 	if (!enc->start_ts)
 		enc->start_ts = cur_ts;
 
-	copy_data(enc->vframe, frame, enc->height, enc->context->pix_fmt);
+	if (ref_data(enc, enc->ref_vframe, frame))
+		pic = enc->ref_vframe;
+	else
+		copy_data(enc->vframe, frame, enc->height,
+			  enc->context->pix_fmt);
 
-	enc->vframe->pts = frame->pts;
-	ret = avcodec_send_frame(enc->context, enc->vframe);
+	pic->pts = frame->pts;
+	ret = avcodec_send_frame(enc->context, pic);
+	if (pic == enc->ref_vframe)
+		av_frame_unref(pic);
 	if (ret == 0)
 		ret = avcodec_receive_packet(enc->context, &av_pkt);
 
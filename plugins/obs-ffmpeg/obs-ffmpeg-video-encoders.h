@@ -27,6 +27,7 @@ struct ffmpeg_video_encoder {
 	bool first_packet;
 
 	AVFrame *vframe;
+	AVFrame *ref_vframe;
 
 	DARRAY(uint8_t) buffer;
 
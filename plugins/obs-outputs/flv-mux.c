@@ -43,6 +43,7 @@ static inline double encoder_bitrate(obs_encoder_t *encoder)
 }
 
 #define FLV_INFO_SIZE_OFFSET 42
+#define FLV_TAG_HEADER_SIZE 11
 
 void write_file_info(FILE *file, int64_t duration_ms, int64_t size)
 {
@@ -185,19 +186,56 @@ void flv_meta_data(obs_output_t *context, uint8_t **output, size_t *size,
 static int32_t last_time = 0;
 #endif
 
-static void flv_video(struct serializer *s, int32_t dts_offset,
-		      struct encoder_packet *packet, bool is_header)
+/* ------------------------------------------------------------------------- */
+/* serializer into a fixed buffer, for the parts of a tag around the data    */
+
+struct fixed_output_data {
+	uint8_t *bytes;
+	size_t capacity;
+	size_t size;
+};
+
+static size_t fixed_output_write(void *param, const void *data, size_t size)
 {
-	int64_t offset = packet->pts - packet->dts;
-	int32_t time_ms = get_ms_time(packet, packet->dts) - dts_offset;
+	struct fixed_output_data *out = param;
 
-	if (!packet->data || !packet->size)
-		return;
+	if (size > out->capacity - out->size)
+		size = out->capacity - out->size;
+
+	memcpy(out->bytes + out->size, data, size);
+	out->size += size;
+	return size;
+}
+
+static int64_t fixed_output_get_pos(void *param)
+{
+	struct fixed_output_data *out = param;
+	return (int64_t)out->size;
+}
+
+static void fixed_output_serializer_init(struct serializer *s,
+					 struct fixed_output_data *out,
+					 uint8_t *bytes, size_t capacity)
+{
+	memset(s, 0, sizeof(struct serializer));
+	out->bytes = bytes;
+	out->capacity = capacity;
+	out->size = 0;
+	s->data = out;
+	s->write = fixed_output_write;
+	s->get_pos = fixed_output_get_pos;
+}
 
-	s_w8(s, RTMP_PACKET_TYPE_VIDEO);
+/* ------------------------------------------------------------------------- */
+
+static void flv_tag_header(struct serializer *s, uint8_t type, int32_t time_ms,
+			   uint32_t body_size)
+{
+	s_w8(s, type);
 
 #ifdef DEBUG_TIMESTAMPS
-	blog(LOG_DEBUG, "Video: %lu", time_ms);
+	blog(LOG_DEBUG, "%s: %lu",
+	     type == RTMP_PACKET_TYPE_VIDEO ? "Video" : "Audio", time_ms);
 
 	if (last_time > time_ms)
 		blog(LOG_DEBUG, "Non-monotonic");
@@ -205,48 +243,62 @@ static void flv_video(struct serializer *s, int32_t dts_offset,
 	last_time = time_ms;
 #endif
 
-	s_wb24(s, (uint32_t)packet->size + 5);
+	s_wb24(s, body_size);
 	s_wb24(s, time_ms);
 	s_w8(s, (time_ms >> 24) & 0x7F);
 	s_wb24(s, 0);
+}
+
+/* everything of a video tag up to the packet data */
+static void flv_video_header(struct serializer *s, int32_t dts_offset,
+			     struct encoder_packet *packet, bool is_header)
+{
+	int64_t offset = packet->pts - packet->dts;
+	int32_t time_ms = get_ms_time(packet, packet->dts) - dts_offset;
+
+	flv_tag_header(s, RTMP_PACKET_TYPE_VIDEO, time_ms,
+		       (uint32_t)packet->size + 5);
 
 	/* these are the 5 extra bytes mentioned above */
 	s_w8(s, packet->keyframe ? 0x17 : 0x27);
 	s_w8(s, is_header ? 0 : 1);
 	s_wb24(s, get_ms_time(packet, offset));
-	s_write(s, packet->data, packet->size);
-
-	/* write tag size (starting byte doesn't count) */
-	s_wb32(s, (uint32_t)serializer_get_pos(s) - 1);
 }
 
-static void flv_audio(struct serializer *s, int32_t dts_offset,
+static void flv_video(struct serializer *s, int32_t dts_offset,
 		      struct encoder_packet *packet, bool is_header)
 {
-	int32_t time_ms = get_ms_time(packet, packet->dts) - dts_offset;
-
 	if (!packet->data || !packet->size)
 		return;
 
-	s_w8(s, RTMP_PACKET_TYPE_AUDIO);
-
-#ifdef DEBUG_TIMESTAMPS
-	blog(LOG_DEBUG, "Audio: %lu", time_ms);
+	flv_video_header(s, dts_offset, packet, is_header);
+	s_write(s, packet->data, packet->size);
 
-	if (last_time > time_ms)
-		blog(LOG_DEBUG, "Non-monotonic");
+	/* write tag size (starting byte doesn't count) */
+	s_wb32(s, (uint32_t)serializer_get_pos(s) - 1);
+}
 
-	last_time = time_ms;
-#endif
+/* everything of an audio tag up to the packet data */
+static void flv_audio_header(struct serializer *s, int32_t dts_offset,
+			     struct encoder_packet *packet, bool is_header)
+{
+	int32_t time_ms = get_ms_time(packet, packet->dts) - dts_offset;
 
-	s_wb24(s, (uint32_t)packet->size + 2);
-	s_wb24(s, time_ms);
-	s_w8(s, (time_ms >> 24) & 0x7F);
-	s_wb24(s, 0);
+	flv_tag_header(s, RTMP_PACKET_TYPE_AUDIO, time_ms,
+		       (uint32_t)packet->size + 2);
 
 	/* these are the two extra bytes mentioned above */
 	s_w8(s, 0xaf);
 	s_w8(s, is_header ? 0 : 1);
+}
+
+static void flv_audio(struct serializer *s, int32_t dts_offset,
+		      struct encoder_packet *packet, bool is_header)
+{
+	if (!packet->data || !packet->size)
+		return;
+
+	flv_audio_header(s, dts_offset, packet, is_header);
 	s_write(s, packet->data, packet->size);
 
 	/* write tag size (starting byte doesn't count) */
@@ -270,6 +322,28 @@ void flv_packet_mux(struct encoder_packet *packet, int32_t dts_offset,
 	*size = data.bytes.num;
 }
 
+bool flv_packet_parts(struct encoder_packet *packet, int32_t dts_offset,
+		      struct flv_packet_parts *parts, bool is_header)
+{
+	struct fixed_output_data out;
+	struct serializer s;
+
+	if (!packet->data || !packet->size)
+		return false;
+
+	fixed_output_serializer_init(&s, &out, parts->header,
+				     sizeof(parts->header));
+
+	if (packet->type == OBS_ENCODER_VIDEO)
+		flv_video_header(&s, dts_offset, packet, is_header);
+	else
+		flv_audio_header(&s, dts_offset, packet, is_header);
+
+	parts->header_size = out.size;
+	parts->footer_size = 0;
+	return true;
+}
+
 /* ------------------------------------------------------------------------- */
 /* stuff for additional media streams                                        */
 
@@ -426,6 +500,36 @@ static inline void s_u29b_value(struct serializer *s, uint32_t val)
 	s_u29(s, 1 | ((val & 0xFFFFFFF) << 1));
 }
 
+/* the AMF object of an additional audio packet up to the packet data, which
+ * is then followed by FLV_ADDITIONAL_AUDIO_END */
+static void flv_additional_audio_prefix(struct serializer *s,
+					struct encoder_packet *packet,
+					bool is_header)
+{
+	s_w8(s, AMF_STRING);
+	s_amf_conststring(s, "additionalMedia");
+
+	s_w8(s, AMF_OBJECT);
+	{
+		s_amf_conststring(s, "id");
+
+		s_w8(s, AMF_STRING);
+		s_amf_conststring(s, "stream0");
+
+		/* ----- */
+
+		s_amf_conststring(s, "media");
+
+		s_w8(s, AMF_AVMPLUS);
+		s_w8(s, AMF3_BYTE_ARRAY);
+		s_u29b_value(s, (uint32_t)packet->size + 2);
+		s_w8(s, 0xaf);
+		s_w8(s, is_header ? 0 : 1);
+	}
+}
+
+#define FLV_ADDITIONAL_AUDIO_END_SIZE 3
+
 static void flv_build_additional_audio(uint8_t **data, size_t *size,
 				       struct encoder_packet *packet,
 				       bool is_header, size_t index)
@@ -436,27 +540,8 @@ static void flv_build_additional_audio(uint8_t **data, size_t *size,
 
 	array_output_serializer_init(&s, &out);
 
-	s_w8(&s, AMF_STRING);
-	s_amf_conststring(&s, "additionalMedia");
-
-	s_w8(&s, AMF_OBJECT);
-	{
-		s_amf_conststring(&s, "id");
-
-		s_w8(&s, AMF_STRING);
-		s_amf_conststring(&s, "stream0");
-
-		/* ----- */
-
-		s_amf_conststring(&s, "media");
-
-		s_w8(&s, AMF_AVMPLUS);
-		s_w8(&s, AMF3_BYTE_ARRAY);
-		s_u29b_value(&s, (uint32_t)packet->size + 2);
-		s_w8(&s, 0xaf);
-		s_w8(&s, is_header ? 0 : 1);
-		s_write(&s, packet->data, packet->size);
-	}
+	flv_additional_audio_prefix(&s, packet, is_header);
+	s_write(&s, packet->data, packet->size);
 	s_wb24(&s, AMF_OBJECT_END);
 
 	*data = out.bytes.array;
@@ -517,3 +602,43 @@ void flv_additional_packet_mux(struct encoder_packet *packet,
 	*data = out.bytes.array;
 	*size = out.bytes.num;
 }
+
+bool flv_additional_packet_parts(struct encoder_packet *packet,
+				 int32_t dts_offset,
+				 struct flv_packet_parts *parts, bool is_header,
+				 size_t index)
+{
+	UNUSED_PARAMETER(index);
+	uint8_t prefix[FLV_PACKET_HEADER_MAX - FLV_TAG_HEADER_SIZE];
+	struct fixed_output_data prefix_out;
+	struct fixed_output_data out;
+	struct serializer s;
+	int32_t time_ms;
+
+	if (!packet->data || !packet->size)
+		return false;
+
+	if (packet->type == OBS_ENCODER_VIDEO) {
+		//currently unsupported
+		bcrash("who said you could output an additional video packet?");
+	}
+
+	fixed_output_serializer_init(&s, &prefix_out, prefix, sizeof(prefix));
+	flv_additional_audio_prefix(&s, packet, is_header);
+
+	time_ms = get_ms_time(packet, packet->dts) - dts_offset;
+
+	fixed_output_serializer_init(&s, &out, parts->header,
+				     sizeof(parts->header));
+	flv_tag_header(&s, RTMP_PACKET_TYPE_INFO, time_ms,
+		       (uint32_t)(prefix_out.size + packet->size +
+				  FLV_ADDITIONAL_AUDIO_END_SIZE));
+	s_write(&s, prefix, prefix_out.size);
+	parts->header_size = out.size;
+
+	fixed_output_serializer_init(&s, &out, parts->footer,
+				     sizeof(parts->footer));
+	s_wb24(&s, AMF_OBJECT_END);
+	parts->footer_size = out.size;
+	return true;
+}
@@ -38,3 +38,25 @@ extern void flv_additional_packet_mux(struct encoder_packet *packet,
 				      int32_t dts_offset, uint8_t **output,
 				      size_t *size, bool is_header,
 				      size_t index);
+
+/* The parts of an FLV tag that surround the packet data: the tag is
+ * 'header', then the packet data, then 'footer'.  Lets the data be sent
+ * straight from the packet instead of being copied into a muxed buffer.
+ * The previous tag size that follows every tag is left out. */
+#define FLV_PACKET_HEADER_MAX 80
+#define FLV_PACKET_FOOTER_MAX 4
+
+struct flv_packet_parts {
+	uint8_t header[FLV_PACKET_HEADER_MAX];
+	size_t header_size;
+	uint8_t footer[FLV_PACKET_FOOTER_MAX];
+	size_t footer_size;
+};
+
+/* return false if the packet has no data, in which case there is no tag */
+extern bool flv_packet_parts(struct encoder_packet *packet, int32_t dts_offset,
+			     struct flv_packet_parts *parts, bool is_header);
+extern bool flv_additional_packet_parts(struct encoder_packet *packet,
+					int32_t dts_offset,
+					struct flv_packet_parts *parts,
+					bool is_header, size_t index);
@@ -34,6 +34,10 @@
 
 #include <util/platform.h>
 
+#ifndef _WIN32
+#include <sys/uio.h>
+#endif
+
 #if !defined(MSG_NOSIGNAL)
 #define MSG_NOSIGNAL 0
 #endif
@@ -4045,18 +4049,18 @@ RTMP_SendChunk(RTMP *r, RTMPChunk *chunk)
     return wrote;
 }
 
-int
-RTMP_SendPacket(RTMP *r, RTMPPacket *packet, int queue)
+/* Writes the header of the first chunk of 'packet' so that it ends at
+ * 'hend', which needs RTMP_MAX_HEADER_SIZE bytes of room in front of it.
+ * 'c' gets the byte the headers of the following chunks are based on. */
+static int
+EncodeFirstChunkHeader(RTMP *r, RTMPPacket *packet, char *hend,
+                       char **header, int *hSize, int *cSize, char *c)
 {
     const RTMPPacket *prevPacket;
     uint32_t last = 0;
     int nSize;
-    int hSize, cSize;
-    char *header, *hptr, *hend, hbuf[RTMP_MAX_HEADER_SIZE], c;
+    char *hptr;
     uint32_t t;
-    char *buffer, *tbuf = NULL, *toff = NULL;
-    int nChunkSize;
-    int tlen;
 
     if (packet->m_nChannel >= r->m_channelsAllocatedOut)
     {
@@ -4097,56 +4101,47 @@ RTMP_SendPacket(RTMP *r, RTMPPacket *packet, int queue)
     }
 
     nSize = packetSize[packet->m_headerType];
-    hSize = nSize;
-    cSize = 0;
+    *hSize = nSize;
+    *cSize = 0;
     t = packet->m_nTimeStamp - last;
 
-    if (packet->m_body)
-    {
-        header = packet->m_body - nSize;
-        hend = packet->m_body;
-    }
-    else
-    {
-        header = hbuf + 6;
-        hend = hbuf + sizeof(hbuf);
-    }
+    *header = hend - nSize;
 
     if (packet->m_nChannel > 319)
-        cSize = 2;
+        *cSize = 2;
     else if (packet->m_nChannel > 63)
-        cSize = 1;
-    if (cSize)
+        *cSize = 1;
+    if (*cSize)
     {
-        header -= cSize;
-        hSize += cSize;
+        *header -= *cSize;
+        *hSize += *cSize;
     }
 
     if (nSize > 1 && t >= 0xffffff)
     {
-        header -= 4;
-        hSize += 4;
+        *header -= 4;
+        *hSize += 4;
     }
 
-    hptr = header;
-    c = packet->m_headerType << 6;
-    switch (cSize)
+    hptr = *header;
+    *c = packet->m_headerType << 6;
+    switch (*cSize)
     {
     case 0:
-        c |= packet->m_nChannel;
+        *c |= packet->m_nChannel;
         break;
     case 1:
         break;
     case 2:
-        c |= 1;
+        *c |= 1;
         break;
     }
-    *hptr++ = c;
-    if (cSize)
+    *hptr++ = *c;
+    if (*cSize)
     {
         int tmp = packet->m_nChannel - 64;
         *hptr++ = tmp & 0xff;
-        if (cSize == 2)
+        if (*cSize == 2)
             *hptr++ = tmp >> 8;
     }
 
@@ -4167,6 +4162,23 @@ RTMP_SendPacket(RTMP *r, RTMPPacket *packet, int queue)
     if (nSize > 1 && t >= 0xffffff)
         hptr = AMF_EncodeInt32(hptr, hend, t);
 
+    return TRUE;
+}
+
+int
+RTMP_SendPacket(RTMP *r, RTMPPacket *packet, int queue)
+{
+    int nSize;
+    int hSize, cSize;
+    char *header, *hend, hbuf[RTMP_MAX_HEADER_SIZE], c;
+    char *buffer, *tbuf = NULL, *toff = NULL;
+    int nChunkSize;
+    int tlen;
+
+    hend = packet->m_body ? packet->m_body : hbuf + sizeof(hbuf);
+    if (!EncodeFirstChunkHeader(r, packet, hend, &header, &hSize, &cSize, &c))
+        return FALSE;
+
     nSize = packet->m_nBodySize;
     buffer = packet->m_body;
     nChunkSize = r->m_outChunkSize;
@@ -5335,3 +5347,278 @@ RTMP_Write(RTMP *r, const char *buf, int size, int streamIdx)
     }
     return size+s2;
 }
+
+/* scatter/gather writing, used by RTMP_WriteV */
+
+#define RTMP_GATHER_PARTS 64
+#define RTMP_GATHER_SIZE 8192
+
+typedef struct RTMPGather
+{
+    RTMP *r;
+    int vectored;
+    AVal parts[RTMP_GATHER_PARTS];
+    int numParts;
+    char buf[RTMP_GATHER_SIZE];
+    int bufLen;
+} RTMPGather;
+
+/* WriteN for several buffers at once, plain sockets only */
+static int
+WriteVN(RTMP *r, AVal *parts, int count)
+{
+    while (count > 0)
+    {
+        int nBytes;
+        int i;
+#ifdef _WIN32
+        WSABUF bufs[RTMP_GATHER_PARTS];
+        DWORD sent = 0;
+
+        for (i = 0; i < count; i++)
+        {
+            bufs[i].buf = parts[i].av_val;
+            bufs[i].len = (ULONG)parts[i].av_len;
+        }
+
+        if (WSASend(r->m_sb.sb_socket, bufs, (DWORD)count, &sent, 0, NULL, NULL) == 0)
+            nBytes = (int)sent;
+        else
+            nBytes = -1;
+#else
+        struct iovec iov[RTMP_GATHER_PARTS];
+        struct msghdr msg;
+
+        for (i = 0; i < count; i++)
+        {
+            iov[i].iov_base = parts[i].av_val;
+            iov[i].iov_len = (size_t)parts[i].av_len;
+        }
+
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = count;
+        nBytes = (int)sendmsg(r->m_sb.sb_socket, &msg, MSG_NOSIGNAL);
+#endif
+
+#if defined(RTMP_NETSTACK_DUMP)
+        for (i = 0; i < count && nBytes > 0; i++)
+            fwrite(parts[i].av_val, 1, parts[i].av_len, netstackdump);
+#endif
+
+        if (nBytes < 0)
+        {
+            int sockerr = GetSockError();
+            RTMP_Log(RTMP_LOGERROR, "%s, RTMP send error %d", __FUNCTION__,
+                     sockerr);
+
+            if (sockerr == EINTR && !RTMP_ctrlC)
+                continue;
+
+            r->last_error_code = sockerr;
+
+            RTMP_Close(r);
+            return FALSE;
+        }
+
+        if (nBytes == 0)
+            return FALSE;
+
+        /* skip whatever has been sent */
+        while (count > 0 && nBytes >= parts->av_len)
+        {
+            nBytes -= parts->av_len;
+            parts++;
+            count--;
+        }
+        if (count > 0)
+        {
+            parts->av_val += nBytes;
+            parts->av_len -= nBytes;
+        }
+    }
+
+    return TRUE;
+}
+
+static int
+Gather_Flush(RTMPGather *g)
+{
+    int ret = TRUE;
+
+    if (g->numParts)
+        ret = WriteVN(g->r, g->parts, g->numParts);
+    else if (g->bufLen)
+        ret = WriteN(g->r, g->buf, g->bufLen);
+
+    g->numParts = 0;
+    g->bufLen = 0;
+    return ret;
+}
+
+/* TLS and custom send functions get the data in one piece per chunk or so,
+ * plain sockets get the buffers as they are */
+static int
+Gather_Add(RTMPGather *g, const char *data, int len)
+{
+    if (!len)
+        return TRUE;
+
+    if (g->vectored)
+    {
+        if (g->numParts == RTMP_GATHER_PARTS && !Gather_Flush(g))
+            return FALSE;
+
+        g->parts[g->numParts].av_val = (char *)data;
+        g->parts[g->numParts].av_len = len;
+        g->numParts++;
+        return TRUE;
+    }
+
+    if (g->bufLen + len > RTMP_GATHER_SIZE && !Gather_Flush(g))
+        return FALSE;
+    if (len > RTMP_GATHER_SIZE)
+        return WriteN(g->r, data, len);
+
+    memcpy(g->buf + g->bufLen, data, len);
+    g->bufLen += len;
+    return TRUE;
+}
+
+/* Like RTMP_Write, but the FLV tag is given in parts, so the payload does
+ * not have to be copied into one buffer first (and is not copied into a
+ * packet body either).  The first part has to start with the whole 11 byte
+ * tag header; unlike RTMP_Write, the previous tag size that follows a tag
+ * is not expected.  Returns the number of bytes written, or -1. */
+int
+RTMP_WriteV(RTMP *r, const AVal *parts, int numParts, int streamIdx)
+{
+    RTMPPacket packet = {0};
+    RTMPGather g;
+    const char *tag;
+    char hbuf[RTMP_MAX_HEADER_SIZE], *header, c, cont[3];
+    int hSize, cSize, contSize;
+    int size = 0, remaining, chunkFill = 0;
+    int part = 0, offset = 11;
+    int i;
+
+    if (numParts < 1 || parts[0].av_len < 11)
+    {
+        /* FLV pkt too small */
+        return 0;
+    }
+
+    for (i = 0; i < numParts; i++)
+        size += parts[i].av_len;
+
+    tag = parts[0].av_val;
+    packet.m_nChannel = 0x04;	/* source channel */
+    packet.m_nInfoField2 = r->Link.streams[streamIdx].id;
+    packet.m_packetType = tag[0];
+    packet.m_nBodySize = AMF_DecodeInt24(tag + 1);
+    packet.m_nTimeStamp = AMF_DecodeInt24(tag + 4);
+    packet.m_nTimeStamp |= (uint32_t)(unsigned char)tag[7] << 24;
+
+    if (packet.m_nBodySize != (uint32_t)(size - 11))
+    {
+        RTMP_Log(RTMP_LOGERROR, "%s, tag size does not match its data", __FUNCTION__);
+        return -1;
+    }
+
+    if (((packet.m_packetType == RTMP_PACKET_TYPE_AUDIO
+            || packet.m_packetType == RTMP_PACKET_TYPE_VIDEO) &&
+            !packet.m_nTimeStamp) || packet.m_packetType == RTMP_PACKET_TYPE_INFO)
+    {
+        packet.m_headerType = RTMP_PACKET_SIZE_LARGE;
+    }
+    else
+    {
+        packet.m_headerType = RTMP_PACKET_SIZE_MEDIUM;
+    }
+
+    /* HTTP sends all chunks of a packet in one request, leave that to
+     * RTMP_SendPacket */
+    if (r->Link.protocol & RTMP_FEATURE_HTTP)
+    {
+        char *enc;
+        int ret;
+
+        if (!RTMPPacket_Alloc(&packet, packet.m_nBodySize))
+            return -1;
+
+        enc = packet.m_body;
+        memcpy(enc, parts[0].av_val + 11, parts[0].av_len - 11);
+        enc += parts[0].av_len - 11;
+        for (i = 1; i < numParts; i++)
+        {
+            memcpy(enc, parts[i].av_val, parts[i].av_len);
+            enc += parts[i].av_len;
+        }
+
+        ret = RTMP_SendPacket(r, &packet, FALSE);
+        RTMPPacket_Free(&packet);
+        return ret ? size : -1;
+    }
+
+    if (!EncodeFirstChunkHeader(r, &packet, hbuf + sizeof(hbuf), &header, &hSize, &cSize, &c))
+        return -1;
+
+    /* header of every chunk after the first */
+    cont[0] = (char)(0xc0 | c);
+    contSize = 1;
+    if (cSize)
+    {
+        int tmp = packet.m_nChannel - 64;
+        cont[contSize++] = tmp & 0xff;
+        if (cSize == 2)
+            cont[contSize++] = tmp >> 8;
+    }
+
+    g.r = r;
+    g.numParts = 0;
+    g.bufLen = 0;
+    g.vectored = !(r->m_bCustomSend && r->m_customSendFunc) && !r->m_sb.sb_ssl;
+
+    if (!Gather_Add(&g, header, hSize))
+        return -1;
+
+    remaining = packet.m_nBodySize;
+    while (remaining > 0)
+    {
+        int avail = parts[part].av_len - offset;
+        int n;
+
+        if (!avail)
+        {
+            part++;
+            offset = 0;
+            continue;
+        }
+
+        if (chunkFill == r->m_outChunkSize)
+        {
+            if (!Gather_Add(&g, cont, contSize))
+                return -1;
+            chunkFill = 0;
+        }
+
+        n = r->m_outChunkSize - chunkFill;
+        if (n > avail)
+            n = avail;
+
+        if (!Gather_Add(&g, parts[part].av_val + offset, n))
+            return -1;
+
+        offset += n;
+        chunkFill += n;
+        remaining -= n;
+    }
+
+    if (!Gather_Flush(&g))
+        return -1;
+
+    if (!r->m_vecChannelsOut[packet.m_nChannel])
+        r->m_vecChannelsOut[packet.m_nChannel] = malloc(sizeof(RTMPPacket));
+    memcpy(r->m_vecChannelsOut[packet.m_nChannel], &packet, sizeof(RTMPPacket));
+    return size;
+}
@@ -539,6 +539,7 @@ extern "C"
     void RTMP_DropRequest(RTMP *r, int i, int freeit);
     int RTMP_Read(RTMP *r, char *buf, int size);
     int RTMP_Write(RTMP *r, const char *buf, int size, int streamIdx);
+    int RTMP_WriteV(RTMP *r, const AVal *parts, int numParts, int streamIdx);
 
 #ifdef USE_HASHSWF
     /* hashswf.c */
@@ -0,0 +1,107 @@
+/******************************************************************************
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "net-sim.h"
+
+#include <string.h>
+
+#ifndef SEC_TO_NSEC
+#define SEC_TO_NSEC 1000000000ULL
+#endif
+
+void net_sim_init(struct net_sim *sim, uint64_t now, uint64_t rate,
+		  size_t buffer_size, uint64_t base_rtt)
+{
+	memset(sim, 0, sizeof(*sim));
+	sim->time = now;
+	sim->rate = rate;
+	sim->buffer_size = buffer_size;
+	sim->base_rtt = base_rtt;
+}
+
+/* time it takes to drain 'size' bytes of what is queued */
+static uint64_t drain_time(const struct net_sim *sim, size_t size)
+{
+	uint64_t byte_ns = (uint64_t)size * SEC_TO_NSEC - sim->remainder;
+	return (byte_ns + sim->rate - 1) / sim->rate;
+}
+
+static void drain(struct net_sim *sim, uint64_t now)
+{
+	if (now <= sim->time)
+		return;
+
+	if (!sim->rate) {
+		sim->time = now;
+		return;
+	}
+
+	uint64_t elapsed = now - sim->time;
+	sim->time = now;
+
+	/* checked first so that the multiplication cannot overflow */
+	if (!sim->queued || elapsed >= drain_time(sim, sim->queued)) {
+		sim->queued = 0;
+		sim->remainder = 0;
+		return;
+	}
+
+	uint64_t byte_ns = sim->rate * elapsed + sim->remainder;
+	sim->queued -= (size_t)(byte_ns / SEC_TO_NSEC);
+	sim->remainder = byte_ns % SEC_TO_NSEC;
+}
+
+void net_sim_set_rate(struct net_sim *sim, uint64_t now, uint64_t rate)
+{
+	drain(sim, now);
+	sim->rate = rate;
+	sim->remainder = 0;
+}
+
+uint64_t net_sim_send(struct net_sim *sim, uint64_t now, size_t size)
+{
+	if (!sim->rate)
+		return now;
+
+	drain(sim, now);
+	if (now < sim->time)
+		now = sim->time;
+
+	if (sim->queued + size > sim->buffer_size) {
+		size_t over = sim->queued + size - sim->buffer_size;
+
+		/* more than the buffer can hold at once waits until it
+		 * is empty */
+		if (over > sim->queued)
+			over = sim->queued;
+
+		if (over) {
+			now += drain_time(sim, over);
+			drain(sim, now);
+		}
+	}
+
+	sim->queued += size;
+	return now;
+}
+
+uint64_t net_sim_rtt(struct net_sim *sim, uint64_t now)
+{
+	drain(sim, now);
+
+	if (!sim->rate)
+		return sim->base_rtt;
+	return sim->base_rtt + drain_time(sim, sim->queued);
+}
@@ -0,0 +1,54 @@
+/******************************************************************************
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <util/c99defs.h>
+
+/*
+ * Simulated network link, used to cap the send rate when testing frame
+ * drops and to run bitrate controllers offline.
+ *
+ * The socket buffer and the queue of the bottleneck are modeled as one
+ * queue that drains at 'rate' bytes per second.  A send blocks until the
+ * data fits in 'buffer_size' bytes, and everything in the queue adds to the
+ * round trip time.  Nothing looks at the clock, the time is always passed
+ * in, so the same calls always give the same results.  A zeroed net_sim is
+ * valid, it lets everything through without delay until it has a rate.
+ */
+
+struct net_sim {
+	uint64_t time; /* ns, queue drained up to here */
+	uint64_t rate; /* bytes per second */
+	uint64_t base_rtt;
+	size_t buffer_size;
+
+	size_t queued;
+	uint64_t remainder; /* part of a byte drained, in byte-ns */
+};
+
+extern void net_sim_init(struct net_sim *sim, uint64_t now, uint64_t rate,
+			 size_t buffer_size, uint64_t base_rtt);
+
+/* the link speed changes at 'now', the queue drains at the old speed until
+ * then */
+extern void net_sim_set_rate(struct net_sim *sim, uint64_t now,
+			     uint64_t rate);
+
+/* queues 'size' bytes at 'now', returns when the send returns */
+extern uint64_t net_sim_send(struct net_sim *sim, uint64_t now, size_t size);
+
+/* round trip time of data sent at 'now' */
+extern uint64_t net_sim_rtt(struct net_sim *sim, uint64_t now);
@@ -0,0 +1,525 @@
+/******************************************************************************
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "rate-control.h"
+
+#include <string.h>
+#include <util/bmem.h>
+#include <util/circlebuf.h>
+
+#ifndef SEC_TO_NSEC
+#define SEC_TO_NSEC 1000000000ULL
+#endif
+
+#ifndef MSEC_TO_USEC
+#define MSEC_TO_USEC 1000ULL
+#endif
+
+#ifndef MSEC_TO_NSEC
+#define MSEC_TO_NSEC 1000000ULL
+#endif
+
+/* ========================================================================= */
+/* default: lower the bitrate to the estimated send rate when the buffer
+ * grows, go back up in steps on a timer */
+
+#define DBR_INC_TIMER_SLOW (30ULL * SEC_TO_NSEC)
+#define DBR_INC_TIMER_FAST (2ULL * SEC_TO_NSEC)
+#define DBR_TRIGGER_USEC (200ULL * MSEC_TO_USEC)
+#define MIN_ESTIMATE_DURATION_MS 1000
+#define MAX_ESTIMATE_DURATION_MS 2000
+
+struct dbr_frame {
+	uint64_t send_beg;
+	uint64_t send_end;
+	size_t size;
+};
+
+struct dbr {
+	struct rate_control_config config;
+	struct circlebuf frames;
+	size_t data_size;
+	uint64_t inc_timeout;
+	long est_bitrate;
+	long prev_bitrate;
+	long cur_bitrate;
+	long inc_bitrate;
+	bool below_floor;
+};
+
+static void *dbr_create(const struct rate_control_config *config)
+{
+	struct dbr *dbr = bzalloc(sizeof(*dbr));
+	dbr->config = *config;
+	dbr->cur_bitrate = config->orig_bitrate;
+	dbr->inc_bitrate = config->orig_bitrate / 10;
+	return dbr;
+}
+
+static void dbr_destroy(void *data)
+{
+	struct dbr *dbr = data;
+	circlebuf_free(&dbr->frames);
+	bfree(dbr);
+}
+
+static void dbr_sample(void *data, const struct rate_sample *sample)
+{
+	struct dbr *dbr = data;
+	struct dbr_frame back = {sample->send_beg, sample->send_end,
+				 sample->size};
+	struct dbr_frame front;
+	uint64_t dur;
+
+	circlebuf_push_back(&dbr->frames, &back, sizeof(back));
+	circlebuf_peek_front(&dbr->frames, &front, sizeof(front));
+
+	dbr->data_size += back.size;
+
+	dur = (back.send_end - front.send_beg) / 1000000;
+
+	if (dur >= MAX_ESTIMATE_DURATION_MS) {
+		dbr->data_size -= front.size;
+		circlebuf_pop_front(&dbr->frames, NULL, sizeof(front));
+	}
+
+	dbr->est_bitrate = (dur >= MIN_ESTIMATE_DURATION_MS)
+				   ? (long)(dbr->data_size * 1000 / dur)
+				   : 0;
+	dbr->est_bitrate *= 8;
+	dbr->est_bitrate /= 1000;
+
+	if (dbr->est_bitrate) {
+		dbr->est_bitrate -= dbr->config.audio_bitrate;
+		if (dbr->est_bitrate < dbr->config.floor_bitrate)
+			dbr->est_bitrate = dbr->config.floor_bitrate;
+		dbr->below_floor = true;
+	}
+}
+
+static inline uint64_t dbr_inc_timer(struct dbr *dbr)
+{
+	return dbr->config.fast ? DBR_INC_TIMER_FAST : DBR_INC_TIMER_SLOW;
+}
+
+static void dbr_lower_bitrate(struct dbr *dbr, uint64_t now)
+{
+	long est_bitrate = 0;
+	long new_bitrate;
+
+	if (dbr->est_bitrate && dbr->est_bitrate < dbr->cur_bitrate) {
+		dbr->data_size = 0;
+		circlebuf_pop_front(&dbr->frames, NULL, dbr->frames.size);
+		est_bitrate = dbr->est_bitrate / 100 * 100;
+		if (est_bitrate < dbr->config.floor_bitrate) {
+			est_bitrate = dbr->config.floor_bitrate;
+			dbr->below_floor = true;
+		}
+	}
+
+	if (est_bitrate)
+		new_bitrate = est_bitrate;
+	else if (dbr->prev_bitrate)
+		new_bitrate = dbr->prev_bitrate;
+	else
+		return;
+
+	if (new_bitrate == dbr->cur_bitrate)
+		return;
+
+	dbr->prev_bitrate = 0;
+	dbr->cur_bitrate = new_bitrate;
+	dbr->inc_timeout = now + dbr_inc_timer(dbr);
+}
+
+static void dbr_inc_bitrate(struct dbr *dbr, uint64_t now)
+{
+	dbr->prev_bitrate = dbr->cur_bitrate;
+	dbr->cur_bitrate += dbr->inc_bitrate;
+	dbr->below_floor = false;
+
+	if (dbr->cur_bitrate >= dbr->config.orig_bitrate)
+		dbr->cur_bitrate = dbr->config.orig_bitrate;
+	else
+		dbr->inc_timeout = now + dbr_inc_timer(dbr);
+}
+
+static long dbr_update(void *data, uint64_t now, int64_t buffer_usec,
+		       bool *drop_frames)
+{
+	struct dbr *dbr = data;
+
+	if (dbr->inc_timeout && now >= dbr->inc_timeout) {
+		dbr->inc_timeout = 0;
+		dbr_inc_bitrate(dbr, now);
+	}
+
+	if ((uint64_t)buffer_usec >= DBR_TRIGGER_USEC)
+		dbr_lower_bitrate(dbr, now);
+
+	*drop_frames = dbr->below_floor;
+	return dbr->cur_bitrate;
+}
+
+const struct rate_control_info rate_control_default = {
+	.id = "default",
+	.create = dbr_create,
+	.destroy = dbr_destroy,
+	.sample = dbr_sample,
+	.update = dbr_update,
+};
+
+/* ========================================================================= */
+/* bbr: model the path by its bottleneck bandwidth (windowed maximum of the
+ * delivery rate) and its round trip time, then cycle the bitrate around the
+ * bandwidth to find out whether there is more of it */
+
+#define BBR_INTERVAL RATE_CONTROL_RTT_INTERVAL
+#define BBR_APP_INTERVAL (2ULL * SEC_TO_NSEC)
+#define BBR_BW_WINDOW (10ULL * SEC_TO_NSEC)
+#define BBR_RTT_WINDOW (10ULL * SEC_TO_NSEC)
+#define BBR_QUEUE_WINDOW (1ULL * SEC_TO_NSEC)
+#define BBR_PHASE_FAST (2ULL * SEC_TO_NSEC)
+#define BBR_PHASE_SLOW (8ULL * SEC_TO_NSEC)
+#define BBR_CRUISE_PHASES 6
+#define BBR_CONGESTED_USEC 200000LL
+#define BBR_DRAINED_USEC 100000LL
+
+/* gains are in percent */
+#define BBR_PROBE_GAIN 125
+#define BBR_DRAIN_GAIN 75
+#define BBR_CRUISE_GAIN 100
+#define BBR_PROBE_GROWTH 105
+
+/* the encoder only hits its bitrate on average, leave room for that */
+#define BBR_HEADROOM 90
+
+/* Sends only block once the socket buffer is full, so a delivery rate
+ * sample only measures the path if the sender was busy for most of it.
+ * Otherwise it measures the encoder, which is a lower bound of the
+ * bandwidth, but only over long enough intervals to even out keyframes. */
+#define BBR_BUSY 80
+
+/* windowed minimum / maximum: keeps the best, second best and third best
+ * value from different parts of the window, so the result can fall back to
+ * the next one when the best one expires */
+struct minmax_sample {
+	uint64_t t;
+	uint64_t v;
+};
+
+struct minmax {
+	struct minmax_sample s[3];
+};
+
+static uint64_t minmax_reset(struct minmax *m, uint64_t t, uint64_t v)
+{
+	m->s[0].t = m->s[1].t = m->s[2].t = t;
+	m->s[0].v = m->s[1].v = m->s[2].v = v;
+	return v;
+}
+
+static uint64_t minmax_subwin_update(struct minmax *m, uint64_t win,
+				     const struct minmax_sample *val)
+{
+	uint64_t dt = val->t - m->s[0].t;
+
+	if (dt > win) {
+		m->s[0] = m->s[1];
+		m->s[1] = m->s[2];
+		m->s[2] = *val;
+		if (val->t - m->s[0].t > win) {
+			m->s[0] = m->s[1];
+			m->s[1] = m->s[2];
+			m->s[2] = *val;
+		}
+	} else if (m->s[1].t == m->s[0].t && dt > win / 4) {
+		m->s[2] = m->s[1] = *val;
+	} else if (m->s[2].t == m->s[1].t && dt > win / 2) {
+		m->s[2] = *val;
+	}
+
+	return m->s[0].v;
+}
+
+static uint64_t minmax_running_max(struct minmax *m, uint64_t win, uint64_t t,
+				   uint64_t v)
+{
+	struct minmax_sample val = {t, v};
+
+	if (v >= m->s[0].v || t - m->s[2].t > win)
+		return minmax_reset(m, t, v);
+
+	if (v >= m->s[1].v)
+		m->s[2] = m->s[1] = val;
+	else if (v >= m->s[2].v)
+		m->s[2] = val;
+
+	return minmax_subwin_update(m, win, &val);
+}
+
+static uint64_t minmax_running_min(struct minmax *m, uint64_t win, uint64_t t,
+				   uint64_t v)
+{
+	struct minmax_sample val = {t, v};
+
+	if (v <= m->s[0].v || t - m->s[2].t > win)
+		return minmax_reset(m, t, v);
+
+	if (v <= m->s[1].v)
+		m->s[2] = m->s[1] = val;
+	else if (v <= m->s[2].v)
+		m->s[2] = val;
+
+	return minmax_subwin_update(m, win, &val);
+}
+
+enum bbr_state {
+	BBR_PROBE,
+	BBR_DRAIN,
+	BBR_CRUISE,
+};
+
+struct bbr {
+	struct rate_control_config config;
+
+	/* delivery rate interval being measured */
+	uint64_t interval_beg;
+	uint64_t interval_end;
+	uint64_t interval_busy;
+	size_t interval_size;
+
+	struct minmax bw; /* kbps, audio included */
+	bool bw_path_limited;
+	long bw_samples;
+	struct minmax min_rtt;
+	uint64_t rtt;
+
+	/* a keyframe queues up for a moment, only a queue that stays around
+	 * means the bitrate is too high */
+	struct minmax standing_queue;
+
+	enum bbr_state state;
+	uint64_t phase_start;
+	uint64_t phase_bw;
+	long phase_samples;
+	int cruise_phases;
+
+	long cur_bitrate;
+};
+
+static void *bbr_create(const struct rate_control_config *config)
+{
+	struct bbr *bbr = bzalloc(sizeof(*bbr));
+	bbr->config = *config;
+	bbr->cur_bitrate = config->orig_bitrate;
+	bbr->state = BBR_CRUISE;
+	return bbr;
+}
+
+static void bbr_destroy(void *data)
+{
+	bfree(data);
+}
+
+static inline uint64_t bbr_bw(const struct bbr *bbr)
+{
+	return bbr->bw.s[0].v;
+}
+
+static void bbr_sample(void *data, const struct rate_sample *sample)
+{
+	struct bbr *bbr = data;
+
+	if (sample->rtt) {
+		minmax_running_min(&bbr->min_rtt, BBR_RTT_WINDOW,
+				   sample->send_end, sample->rtt);
+		bbr->rtt = sample->rtt;
+	}
+
+	if (!bbr->interval_size)
+		bbr->interval_beg = sample->send_beg;
+
+	bbr->interval_end = sample->send_end;
+	bbr->interval_busy += sample->send_end - sample->send_beg;
+	bbr->interval_size += sample->size;
+
+	uint64_t elapsed = bbr->interval_end - bbr->interval_beg;
+	bool busy = bbr->interval_busy * 100 >= elapsed * BBR_BUSY;
+
+	if (elapsed < BBR_INTERVAL || (!busy && elapsed < BBR_APP_INTERVAL))
+		return;
+
+	uint64_t rate = (uint64_t)bbr->interval_size * 8 * 1000000 / elapsed;
+
+	bbr->interval_busy = 0;
+	bbr->interval_size = 0;
+	bbr->bw_samples++;
+
+	if (busy) {
+		/* while draining only what gets through right now counts */
+		if (bbr->state == BBR_DRAIN)
+			minmax_reset(&bbr->bw, sample->send_end, rate);
+		else
+			minmax_running_max(&bbr->bw, BBR_BW_WINDOW,
+					   sample->send_end, rate);
+		bbr->bw_path_limited = true;
+
+	} else if (bbr->state != BBR_DRAIN && rate > bbr_bw(bbr)) {
+		minmax_running_max(&bbr->bw, BBR_BW_WINDOW, sample->send_end,
+				   rate);
+		bbr->bw_path_limited = false;
+	}
+}
+
+static inline uint64_t bbr_phase(const struct bbr *bbr)
+{
+	return bbr->config.fast ? BBR_PHASE_FAST : BBR_PHASE_SLOW;
+}
+
+static void bbr_set_state(struct bbr *bbr, enum bbr_state state, uint64_t now)
+{
+	bbr->state = state;
+	bbr->phase_start = now;
+	bbr->phase_bw = bbr_bw(bbr);
+	bbr->phase_samples = bbr->bw_samples;
+	bbr->cruise_phases = 0;
+}
+
+static void bbr_next_phase(struct bbr *bbr, uint64_t now)
+{
+	if (now - bbr->phase_start < bbr_phase(bbr))
+		return;
+
+	if (bbr->state == BBR_PROBE) {
+		/* the probe has not been measured yet */
+		if (bbr->bw_samples == bbr->phase_samples)
+			return;
+
+		/* keep going up for as long as the bandwidth keeps up */
+		if (bbr_bw(bbr) * 100 < bbr->phase_bw * BBR_PROBE_GROWTH)
+			bbr_set_state(bbr, BBR_CRUISE, now);
+		else
+			bbr_set_state(bbr, BBR_PROBE, now);
+
+	} else if (bbr->state == BBR_CRUISE) {
+		int phases = bbr->cruise_phases + 1;
+
+		if (phases >= BBR_CRUISE_PHASES) {
+			bbr_set_state(bbr, BBR_PROBE, now);
+		} else {
+			bbr->phase_start = now;
+			bbr->cruise_phases = phases;
+		}
+	}
+}
+
+static long bbr_update(void *data, uint64_t now, int64_t buffer_usec,
+		       bool *drop_frames)
+{
+	struct bbr *bbr = data;
+	uint64_t min_rtt = bbr->min_rtt.s[0].v;
+	int64_t queue_usec = buffer_usec > 0 ? buffer_usec : 0;
+	int64_t standing_usec;
+	int gain;
+
+	/* a queue in the socket or in the network shows up as a longer
+	 * round trip */
+	if (min_rtt && bbr->rtt > min_rtt)
+		queue_usec += (int64_t)((bbr->rtt - min_rtt) / 1000);
+
+	standing_usec = (int64_t)minmax_running_min(&bbr->standing_queue,
+						    BBR_QUEUE_WINDOW, now,
+						    (uint64_t)queue_usec);
+
+	if (standing_usec >= BBR_CONGESTED_USEC) {
+		if (bbr->state != BBR_DRAIN)
+			bbr_set_state(bbr, BBR_DRAIN, now);
+	} else if (bbr->state == BBR_DRAIN) {
+		if (queue_usec < BBR_DRAINED_USEC)
+			bbr_set_state(bbr, BBR_CRUISE, now);
+	} else {
+		bbr_next_phase(bbr, now);
+	}
+
+	uint64_t bw = bbr_bw(bbr);
+	if (!bw) {
+		/* nothing measured yet */
+		*drop_frames = false;
+		return bbr->cur_bitrate;
+	}
+
+	switch (bbr->state) {
+	case BBR_PROBE:
+		gain = BBR_PROBE_GAIN;
+		break;
+	case BBR_DRAIN:
+		gain = BBR_DRAIN_GAIN;
+		break;
+	default:
+		gain = BBR_CRUISE_GAIN;
+	}
+
+	long bitrate = (long)(bw * gain / 100 * BBR_HEADROOM / 100);
+	bitrate -= bbr->config.audio_bitrate;
+	bitrate = bitrate / 100 * 100;
+
+	/* a bandwidth that is only what the encoder put out is no reason to
+	 * go down */
+	if (bbr->state == BBR_DRAIN) {
+		if (bitrate > bbr->cur_bitrate)
+			bitrate = bbr->cur_bitrate;
+	} else if (!bbr->bw_path_limited && bitrate < bbr->cur_bitrate) {
+		bitrate = bbr->cur_bitrate;
+	}
+
+	*drop_frames = false;
+
+	if (bitrate > bbr->config.orig_bitrate) {
+		bitrate = bbr->config.orig_bitrate;
+	} else if (bitrate < bbr->config.floor_bitrate) {
+		bitrate = bbr->config.floor_bitrate;
+		*drop_frames = bbr->state == BBR_DRAIN;
+	}
+
+	bbr->cur_bitrate = bitrate;
+	return bitrate;
+}
+
+const struct rate_control_info rate_control_bbr = {
+	.id = "bbr",
+	.create = bbr_create,
+	.destroy = bbr_destroy,
+	.sample = bbr_sample,
+	.update = bbr_update,
+};
+
+/* ========================================================================= */
+
+static const struct rate_control_info *controllers[] = {
+	&rate_control_default,
+	&rate_control_bbr,
+};
+
+const struct rate_control_info *rate_control_find(const char *id)
+{
+	for (size_t i = 0; id && i < sizeof(controllers) / sizeof(*controllers);
+	     i++) {
+		if (strcmp(controllers[i]->id, id) == 0)
+			return controllers[i];
+	}
+
+	return &rate_control_default;
+}
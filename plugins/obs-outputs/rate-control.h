@@ -0,0 +1,92 @@
+/******************************************************************************
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <util/c99defs.h>
+
+/*
+ * Dynamic bitrate controllers.
+ *
+ * A controller is told how fast data leaves (rate samples, from the thread
+ * that sends) and how much is waiting to be sent (updates, for every video
+ * packet that is queued), and answers with the video bitrate the encoder
+ * should use.  Controllers never look at the clock themselves, every time
+ * is passed in, so they can be run against a simulated network.
+ *
+ * All bitrates are in kbps, all times in nanoseconds unless noted.
+ */
+
+struct rate_control_config {
+	long orig_bitrate;  /* video bitrate set by the user, the maximum */
+	long audio_bitrate;
+	long floor_bitrate; /* lowest video bitrate */
+	bool fast;          /* recover faster */
+};
+
+struct rate_sample {
+	uint64_t send_beg;
+	uint64_t send_end;
+	size_t size; /* bytes */
+	uint64_t rtt; /* smoothed round trip time of the socket, 0 if unknown
+		       * or not looked up for this sample */
+};
+
+/* the socket's round trip time only needs to be looked up this often,
+ * controllers measure over intervals at least this long */
+#define RATE_CONTROL_RTT_INTERVAL (250ULL * 1000000ULL)
+
+struct rate_control_info {
+	const char *id;
+
+	void *(*create)(const struct rate_control_config *config);
+	void (*destroy)(void *data);
+
+	/* data has been sent */
+	void (*sample)(void *data, const struct rate_sample *sample);
+
+	/* 'buffer_usec' is the duration of the packets waiting to be sent,
+	 * 0 when there are too few to tell.  Returns the video bitrate to
+	 * use, and sets 'drop_frames' if the bitrate cannot go any lower and
+	 * frames should be dropped past the usual thresholds instead. */
+	long (*update)(void *data, uint64_t now, int64_t buffer_usec,
+		       bool *drop_frames);
+};
+
+extern const struct rate_control_info rate_control_default;
+extern const struct rate_control_info rate_control_bbr;
+
+/* returns the default controller if 'id' is unknown */
+extern const struct rate_control_info *rate_control_find(const char *id);
+
+struct rate_control {
+	const struct rate_control_info *info;
+	void *data;
+};
+
+static inline void rate_control_create(struct rate_control *rc,
+				       const struct rate_control_info *info,
+				       const struct rate_control_config *config)
+{
+	rc->info = info;
+	rc->data = info->create(config);
+}
+
+static inline void rate_control_destroy(struct rate_control *rc)
+{
+	if (rc->data)
+		rc->info->destroy(rc->data);
+	rc->data = NULL;
+}
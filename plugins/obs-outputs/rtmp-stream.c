@@ -18,6 +18,9 @@
 #include "rtmp-stream.h"
 #ifdef _WIN32
 #include <util/windows/win-version.h>
+#include <mstcpip.h>
+#else
+#include <netinet/tcp.h>
 #endif
 
 #ifndef SEC_TO_NSEC
@@ -32,13 +35,6 @@
 #define MSEC_TO_NSEC 1000000ULL
 #endif
 
-/* dynamic bitrate coefficients */
-#define DBR_INC_TIMER_SLOW (30ULL * SEC_TO_NSEC)
-#define DBR_INC_TIMER_FAST (2ULL * SEC_TO_NSEC)
-#define DBR_TRIGGER_USEC (200ULL * MSEC_TO_USEC)
-#define MIN_ESTIMATE_DURATION_MS 1000
-#define MAX_ESTIMATE_DURATION_MS 2000
-
 static const char *rtmp_stream_getname(void *unused)
 {
 	UNUSED_PARAMETER(unused);
@@ -131,10 +127,7 @@ static void rtmp_stream_destroy(void *data)
 	os_sem_destroy(stream->send_sem);
 	pthread_mutex_destroy(&stream->packets_mutex);
 	circlebuf_free(&stream->packets);
-#ifdef TEST_FRAMEDROPS
-	circlebuf_free(&stream->droptest_info);
-#endif
-	circlebuf_free(&stream->dbr_frames);
+	rate_control_destroy(&stream->dbr);
 	pthread_mutex_destroy(&stream->dbr_mutex);
 
 	os_event_destroy(stream->buffer_space_available_event);
@@ -307,7 +300,6 @@ static bool process_recv_data(struct rtmp_stream *stream, size_t size)
 static void droptest_cap_data_rate(struct rtmp_stream *stream, size_t size)
 {
 	uint64_t ts = os_gettime_ns();
-	struct droptest_info info;
 
 #if defined(_WIN32) && defined(TEST_FRAMEDROPS_WITH_BITRATE_SHORTCUTS)
 	uint64_t check_elapsed = ts - stream->droptest_last_key_check;
@@ -352,31 +344,14 @@ static void droptest_cap_data_rate(struct rtmp_stream *stream, size_t size)
 	}
 #endif
 
-	info.ts = ts;
-	info.size = size;
-
-	circlebuf_push_back(&stream->droptest_info, &info, sizeof(info));
-	stream->droptest_size += size;
-
-	if (stream->droptest_info.size) {
-		circlebuf_peek_front(&stream->droptest_info, &info,
-				     sizeof(info));
-
-		if (stream->droptest_size > stream->droptest_max) {
-			uint64_t elapsed = ts - info.ts;
-
-			if (elapsed < 1000000000ULL) {
-				elapsed = 1000000000ULL - elapsed;
-				os_sleepto_ns(ts + elapsed);
-			}
-
-			while (stream->droptest_size > stream->droptest_max) {
-				circlebuf_pop_front(&stream->droptest_info,
-						    &info, sizeof(info));
-				stream->droptest_size -= info.size;
-			}
-		}
+	/* allows a second worth of data to queue up, like a socket buffer
+	 * that has grown to fit the connection would */
+	if (stream->droptest.rate != stream->droptest_max) {
+		net_sim_set_rate(&stream->droptest, ts, stream->droptest_max);
+		stream->droptest.buffer_size = stream->droptest_max;
 	}
+
+	os_sleepto_ns(net_sim_send(&stream->droptest, ts, size));
 }
 #endif
 
@@ -419,8 +394,11 @@ static int send_packet(struct rtmp_stream *stream,
 		       struct encoder_packet *packet, bool is_header,
 		       size_t idx)
 {
-	uint8_t *data;
-	size_t size;
+	struct flv_packet_parts parts;
+	AVal bufs[3];
+	int num_bufs = 0;
+	bool has_tag;
+	size_t size = 0;
 	int recv_size = 0;
 	int ret = 0;
 
@@ -440,21 +418,37 @@ static int send_packet(struct rtmp_stream *stream,
 		}
 	}
 
+	/* only the tag header (and footer) are built here, the packet data
+	 * is sent from where it is */
+	int32_t dts_offset = is_header ? 0 : stream->start_dts_offset;
+
 	if (idx > 0) {
-		flv_additional_packet_mux(
-			packet, is_header ? 0 : stream->start_dts_offset, &data,
-			&size, is_header, idx);
+		has_tag = flv_additional_packet_parts(packet, dts_offset,
+						      &parts, is_header, idx);
 	} else {
-		flv_packet_mux(packet, is_header ? 0 : stream->start_dts_offset,
-			       &data, &size, is_header);
+		has_tag = flv_packet_parts(packet, dts_offset, &parts,
+					   is_header);
+	}
+
+	if (has_tag) {
+		bufs[num_bufs].av_val = (char *)parts.header;
+		bufs[num_bufs++].av_len = (int)parts.header_size;
+		bufs[num_bufs].av_val = (char *)packet->data;
+		bufs[num_bufs++].av_len = (int)packet->size;
+
+		if (parts.footer_size) {
+			bufs[num_bufs].av_val = (char *)parts.footer;
+			bufs[num_bufs++].av_len = (int)parts.footer_size;
+		}
+
+		size = parts.header_size + packet->size + parts.footer_size;
 	}
 
 #ifdef TEST_FRAMEDROPS
 	droptest_cap_data_rate(stream, size);
 #endif
 
-	ret = RTMP_Write(&stream->rtmp, (char *)data, (int)size, 0);
-	bfree(data);
+	ret = has_tag ? RTMP_WriteV(&stream->rtmp, bufs, num_bufs, 0) : 0;
 
 	if (is_header)
 		bfree(packet->data);
@@ -553,36 +547,58 @@ static void set_output_error(struct rtmp_stream *stream)
 		obs_output_set_last_error(stream->output, msg);
 }
 
-static void dbr_add_frame(struct rtmp_stream *stream, struct dbr_frame *back)
+/* smoothed round trip time of the connection, 0 if the system does not
+ * tell */
+static uint64_t get_socket_rtt(struct rtmp_stream *stream)
 {
-	struct dbr_frame front;
-	uint64_t dur;
-
-	circlebuf_push_back(&stream->dbr_frames, back, sizeof(*back));
-	circlebuf_peek_front(&stream->dbr_frames, &front, sizeof(front));
-
-	stream->dbr_data_size += back->size;
+	SOCKET sock = stream->rtmp.m_sb.sb_socket;
+
+#if defined(_WIN32) && defined(SIO_TCP_INFO)
+	TCP_INFO_v0 tcp_info;
+	DWORD version = 0;
+	DWORD size;
+
+	if (WSAIoctl(sock, SIO_TCP_INFO, &version, sizeof(version), &tcp_info,
+		     sizeof(tcp_info), &size, NULL, NULL) == 0)
+		return (uint64_t)tcp_info.RttUs * 1000;
+#elif defined(__linux__) || defined(__FreeBSD__)
+	struct tcp_info tcp_info;
+	socklen_t size = sizeof(tcp_info);
+
+	if (getsockopt(sock, IPPROTO_TCP, TCP_INFO, &tcp_info, &size) == 0)
+		return (uint64_t)tcp_info.tcpi_rtt * 1000;
+#elif defined(__APPLE__)
+	struct tcp_connection_info tcp_info;
+	socklen_t size = sizeof(tcp_info);
+
+	if (getsockopt(sock, IPPROTO_TCP, TCP_CONNECTION_INFO, &tcp_info,
+		       &size) == 0)
+		return (uint64_t)tcp_info.tcpi_srtt * MSEC_TO_NSEC;
+#else
+	UNUSED_PARAMETER(sock);
+#endif
 
-	dur = (back->send_end - front.send_beg) / 1000000;
+	return 0;
+}
 
-	if (dur >= MAX_ESTIMATE_DURATION_MS) {
-		stream->dbr_data_size -= front.size;
-		circlebuf_pop_front(&stream->dbr_frames, NULL, sizeof(front));
+static void dbr_add_sample(struct rtmp_stream *stream,
+			   struct rate_sample *sample)
+{
+	/* TCP_INFO is a syscall, one lookup per interval is plenty */
+	sample->rtt = 0;
+	if (sample->send_end - stream->dbr_rtt_time >=
+	    RATE_CONTROL_RTT_INTERVAL) {
+		sample->rtt = get_socket_rtt(stream);
+#ifdef TEST_FRAMEDROPS
+		sample->rtt += net_sim_rtt(&stream->droptest,
+					   sample->send_end);
+#endif
+		stream->dbr_rtt_time = sample->send_end;
 	}
 
-	stream->dbr_est_bitrate =
-		(dur >= MIN_ESTIMATE_DURATION_MS)
-			? (long)(stream->dbr_data_size * 1000 / dur)
-			: 0;
-	stream->dbr_est_bitrate *= 8;
-	stream->dbr_est_bitrate /= 1000;
-
-	if (stream->dbr_est_bitrate) {
-		stream->dbr_est_bitrate -= stream->audio_bitrate;
-		if (stream->dbr_est_bitrate < stream->dbr_floor)
-			stream->dbr_est_bitrate = stream->dbr_floor;
-		stream->dbr_below_floor = true;
-	}
+	pthread_mutex_lock(&stream->dbr_mutex);
+	stream->dbr.info->sample(stream->dbr.data, sample);
+	pthread_mutex_unlock(&stream->dbr_mutex);
 }
 
 static void dbr_set_bitrate(struct rtmp_stream *stream);
@@ -633,7 +649,7 @@ static void *send_thread(void *data)
 
 	while (os_sem_wait(stream->send_sem) == 0) {
 		struct encoder_packet packet;
-		struct dbr_frame dbr_frame;
+		struct rate_sample dbr_sample;
 
 		if (stopping(stream) && stream->stop_ts == 0) {
 			break;
@@ -665,8 +681,8 @@ static void *send_thread(void *data)
 		}
 
 		if (stream->dbr_enabled) {
-			dbr_frame.send_beg = os_gettime_ns();
-			dbr_frame.size = packet.size;
+			dbr_sample.send_beg = os_gettime_ns();
+			dbr_sample.size = packet.size;
 		}
 
 		if (send_packet(stream, &packet, false, packet.track_idx) < 0) {
@@ -675,11 +691,8 @@ static void *send_thread(void *data)
 		}
 
 		if (stream->dbr_enabled) {
-			dbr_frame.send_end = os_gettime_ns();
-
-			pthread_mutex_lock(&stream->dbr_mutex);
-			dbr_add_frame(stream, &dbr_frame);
-			pthread_mutex_unlock(&stream->dbr_mutex);
+			dbr_sample.send_end = os_gettime_ns();
+			dbr_add_sample(stream, &dbr_sample);
 		}
 	}
 
@@ -1143,18 +1156,25 @@ static bool init_connect(struct rtmp_stream *stream)
 	obs_data_t *vsettings = obs_encoder_get_settings(venc);
 	obs_data_t *asettings = obs_encoder_get_settings(aenc);
 
-	circlebuf_free(&stream->dbr_frames);
-	stream->audio_bitrate = (long)obs_data_get_int(asettings, "bitrate");
-	stream->dbr_data_size = 0;
-	stream->dbr_orig_bitrate = (long)obs_data_get_int(vsettings, "bitrate");
+	struct rate_control_config dbr_config;
+	const char *dbr_id = obs_data_get_string(settings, OPT_DYN_CONTROLLER);
+
+	dbr_config.orig_bitrate = (long)obs_data_get_int(vsettings, "bitrate");
+	dbr_config.audio_bitrate = (long)obs_data_get_int(asettings, "bitrate");
+	dbr_config.floor_bitrate = dbr_config.orig_bitrate / 2;
+	dbr_config.fast = obs_data_get_int(settings, OPT_DYN_PRESET) ==
+			  OPT_DYN_PRESET_FASTER;
+
+	pthread_mutex_lock(&stream->dbr_mutex);
+	rate_control_destroy(&stream->dbr);
+	rate_control_create(&stream->dbr, rate_control_find(dbr_id),
+			    &dbr_config);
+	pthread_mutex_unlock(&stream->dbr_mutex);
+
+	stream->dbr_orig_bitrate = dbr_config.orig_bitrate;
 	stream->dbr_cur_bitrate = stream->dbr_orig_bitrate;
-	stream->dbr_est_bitrate = 0;
-	stream->dbr_inc_bitrate = stream->dbr_orig_bitrate / 10;
-	stream->dbr_inc_timeout = 0;
 	stream->dbr_enabled = obs_data_get_bool(settings, OPT_DYN_BITRATE);
 	stream->dbr_below_floor = false;
-	stream->dbr_preset = obs_data_get_int(settings, OPT_DYN_PRESET);
-	stream->dbr_floor = stream->dbr_orig_bitrate / 2;
 
 	caps = obs_encoder_get_caps(venc);
 	if ((caps & OBS_ENCODER_CAP_DYN_BITRATE) == 0) {
@@ -1167,6 +1187,7 @@ static bool init_connect(struct rtmp_stream *stream)
 
 	if (stream->dbr_enabled) {
 		info("Dynamic bitrate enabled.  Dropped frames begone!");
+		info("Bitrate controller: %s", stream->dbr.info->id);
 	}
 
 	obs_data_release(vsettings);
@@ -1324,73 +1345,6 @@ static bool find_first_video_packet(struct rtmp_stream *stream,
 	return false;
 }
 
-static bool dbr_bitrate_lowered(struct rtmp_stream *stream)
-{
-	long prev_bitrate = stream->dbr_prev_bitrate;
-	long est_bitrate = 0;
-	long new_bitrate;
-
-	if (stream->dbr_est_bitrate &&
-	    stream->dbr_est_bitrate < stream->dbr_cur_bitrate) {
-		stream->dbr_data_size = 0;
-		circlebuf_pop_front(&stream->dbr_frames, NULL,
-				    stream->dbr_frames.size);
-		est_bitrate = stream->dbr_est_bitrate / 100 * 100;
-		if (est_bitrate < stream->dbr_floor) {
-			est_bitrate = stream->dbr_floor;
-			stream->dbr_below_floor = true;
-		}
-	}
-
-#if 0
-	if (prev_bitrate && est_bitrate) {
-		if (prev_bitrate < est_bitrate) {
-			blog(LOG_INFO, "going back to prev bitrate: "
-					"prev_bitrate (%d) < est_bitrate (%d)",
-					prev_bitrate,
-					est_bitrate);
-			new_bitrate = prev_bitrate;
-		} else {
-			new_bitrate = est_bitrate;
-		}
-		new_bitrate = est_bitrate;
-	} else if (prev_bitrate) {
-		new_bitrate = prev_bitrate;
-		info("going back to prev bitrate");
-
-	} else if (est_bitrate) {
-		new_bitrate = est_bitrate;
-
-	} else {
-		return false;
-	}
-#else
-	if (est_bitrate) {
-		new_bitrate = est_bitrate;
-
-	} else if (prev_bitrate) {
-		new_bitrate = prev_bitrate;
-		info("going back to prev bitrate");
-
-	} else {
-		return false;
-	}
-
-	if (new_bitrate == stream->dbr_cur_bitrate) {
-		return false;
-	}
-#endif
-
-	stream->dbr_prev_bitrate = 0;
-	stream->dbr_cur_bitrate = new_bitrate;
-	uint64_t timeout = stream->dbr_preset == OPT_DYN_PRESET_FASTER
-				   ? DBR_INC_TIMER_FAST
-				   : DBR_INC_TIMER_SLOW;
-	stream->dbr_inc_timeout = os_gettime_ns() + timeout;
-	info("bitrate decreased to: %ld", stream->dbr_cur_bitrate);
-	return true;
-}
-
 static void dbr_set_bitrate(struct rtmp_stream *stream)
 {
 	obs_encoder_t *vencoder = obs_output_get_video_encoder(stream->output);
@@ -1402,48 +1356,50 @@ static void dbr_set_bitrate(struct rtmp_stream *stream)
 	obs_data_release(settings);
 }
 
-static void dbr_inc_bitrate(struct rtmp_stream *stream)
+static void dbr_update(struct rtmp_stream *stream, int64_t buffer_usec)
 {
-	stream->dbr_prev_bitrate = stream->dbr_cur_bitrate;
-	stream->dbr_cur_bitrate += stream->dbr_inc_bitrate;
-	stream->dbr_below_floor = false;
+	bool drop = false;
+	long bitrate;
 
-	if (stream->dbr_cur_bitrate >= stream->dbr_orig_bitrate) {
-		stream->dbr_cur_bitrate = stream->dbr_orig_bitrate;
-		info("bitrate increased to: %ld, done",
-		     stream->dbr_cur_bitrate);
-	} else if (stream->dbr_cur_bitrate < stream->dbr_orig_bitrate) {
-		uint64_t timeout = stream->dbr_preset == OPT_DYN_PRESET_FASTER
-					   ? DBR_INC_TIMER_FAST
-					   : DBR_INC_TIMER_SLOW;
-		stream->dbr_inc_timeout = os_gettime_ns() + timeout;
-		info("bitrate increased to: %ld, waiting",
-		     stream->dbr_cur_bitrate);
-	}
+	pthread_mutex_lock(&stream->dbr_mutex);
+	bitrate = stream->dbr.info->update(stream->dbr.data, os_gettime_ns(),
+					   buffer_usec, &drop);
+	pthread_mutex_unlock(&stream->dbr_mutex);
+
+	stream->dbr_below_floor = drop;
+
+	if (bitrate == stream->dbr_cur_bitrate)
+		return;
+
+	info("bitrate %s to: %ld",
+	     bitrate > stream->dbr_cur_bitrate ? "increased" : "decreased",
+	     bitrate);
+	debug("buffer_duration_msec: %" PRId64, buffer_usec / 1000);
+
+	stream->dbr_cur_bitrate = bitrate;
+	dbr_set_bitrate(stream);
 }
 
 static void check_to_drop_frames(struct rtmp_stream *stream, bool pframes)
 {
 	struct encoder_packet first;
-	int64_t buffer_duration_usec;
+	int64_t buffer_duration_usec = 0;
 	size_t num_packets = num_buffered_packets(stream);
 	const char *name = pframes ? "p-frames" : "b-frames";
 	int priority = pframes ? OBS_NAL_PRIORITY_HIGHEST
 			       : OBS_NAL_PRIORITY_HIGH;
 	int64_t drop_threshold = pframes ? stream->pframe_drop_threshold_usec
 					 : stream->drop_threshold_usec;
+	bool have_first = num_packets >= 5 &&
+			  find_first_video_packet(stream, &first);
 
-	if (!pframes && stream->dbr_enabled) {
-		if (stream->dbr_inc_timeout) {
-			uint64_t t = os_gettime_ns();
+	/* if the amount of time stored in the buffered packets waiting to be
+	 * sent is higher than threshold, drop frames */
+	if (have_first)
+		buffer_duration_usec = stream->last_dts_usec - first.dts_usec;
 
-			if (t >= stream->dbr_inc_timeout) {
-				stream->dbr_inc_timeout = 0;
-				dbr_inc_bitrate(stream);
-				dbr_set_bitrate(stream);
-			}
-		}
-	}
+	if (!pframes && stream->dbr_enabled)
+		dbr_update(stream, buffer_duration_usec);
 
 	if (num_packets < 5) {
 		if (!pframes)
@@ -1451,13 +1407,9 @@ static void check_to_drop_frames(struct rtmp_stream *stream, bool pframes)
 		return;
 	}
 
-	if (!find_first_video_packet(stream, &first))
+	if (!have_first)
 		return;
 
-	/* if the amount of time stored in the buffered packets waiting to be
-	 * sent is higher than threshold, drop frames */
-	buffer_duration_usec = stream->last_dts_usec - first.dts_usec;
-
 	if (!pframes) {
 		stream->congestion =
 			(float)buffer_duration_usec / (float)drop_threshold;
@@ -1468,24 +1420,7 @@ static void check_to_drop_frames(struct rtmp_stream *stream, bool pframes)
 	 * but let's test without dropping frames
 	 * at all first */
 	if (stream->dbr_enabled) {
-		bool bitrate_changed = false;
-
-		if (pframes) {
-			return;
-		}
-
-		if ((uint64_t)buffer_duration_usec >= DBR_TRIGGER_USEC) {
-			pthread_mutex_lock(&stream->dbr_mutex);
-			bitrate_changed = dbr_bitrate_lowered(stream);
-			pthread_mutex_unlock(&stream->dbr_mutex);
-		}
-
-		if (bitrate_changed) {
-			debug("buffer_duration_msec: %" PRId64,
-			      buffer_duration_usec / 1000);
-			dbr_set_bitrate(stream);
-		}
-		if (!stream->dbr_below_floor)
+		if (pframes || !stream->dbr_below_floor)
 			return;
 	}
 
@@ -1566,6 +1501,8 @@ static void rtmp_stream_defaults(obs_data_t *defaults)
 	obs_data_set_default_int(defaults, OPT_PFRAME_DROP_THRESHOLD, 900);
 	obs_data_set_default_int(defaults, OPT_DYN_PRESET,
 				 OPT_DYN_PRESET_FASTER);
+	obs_data_set_default_string(defaults, OPT_DYN_CONTROLLER,
+				    rate_control_default.id);
 	obs_data_set_default_int(defaults, OPT_MAX_SHUTDOWN_TIME_SEC, 30);
 	obs_data_set_default_string(defaults, OPT_BIND_IP, "default");
 	obs_data_set_default_bool(defaults, OPT_NEWSOCKETLOOP_ENABLED, false);
@@ -1611,6 +1548,16 @@ static obs_properties_t *rtmp_stream_properties(void *unused)
 	obs_property_list_add_int(p,
 				  obs_module_text("RTMPStream.Presets.Slower"),
 				  OPT_DYN_PRESET_SLOWER);
+	p = obs_properties_add_list(props, OPT_DYN_CONTROLLER,
+				    obs_module_text("RTMPStream.Controller"),
+				    OBS_COMBO_TYPE_LIST,
+				    OBS_COMBO_FORMAT_STRING);
+	obs_property_list_add_string(
+		p, obs_module_text("RTMPStream.Controller.Default"),
+		rate_control_default.id);
+	obs_property_list_add_string(
+		p, obs_module_text("RTMPStream.Controller.BBR"),
+		rate_control_bbr.id);
 	return props;
 }
 
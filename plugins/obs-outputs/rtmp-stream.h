@@ -9,6 +9,8 @@
 #include "librtmp/log.h"
 #include "flv-mux.h"
 #include "net-if.h"
+#include "net-sim.h"
+#include "rate-control.h"
 
 #ifdef _WIN32
 #include <Iphlpapi.h>
@@ -28,6 +30,7 @@
 #define OPT_DYN_PRESET "dyn_bitrate_preset"
 #define OPT_DYN_PRESET_FASTER 1
 #define OPT_DYN_PRESET_SLOWER 0
+#define OPT_DYN_CONTROLLER "dyn_bitrate_controller"
 #define OPT_DROP_THRESHOLD "drop_threshold_ms"
 #define OPT_PFRAME_DROP_THRESHOLD "pframe_drop_threshold_ms"
 #define OPT_MAX_SHUTDOWN_TIME_SEC "max_shutdown_time_sec"
@@ -43,19 +46,8 @@
 
 #define DROPTEST_MAX_KBPS 3000
 #define DROPTEST_MAX_BYTES (DROPTEST_MAX_KBPS * 1000 / 8)
-
-struct droptest_info {
-	uint64_t ts;
-	size_t size;
-};
 #endif
 
-struct dbr_frame {
-	uint64_t send_beg;
-	uint64_t send_end;
-	size_t size;
-};
-
 struct rtmp_stream {
 	obs_output_t *output;
 
@@ -99,26 +91,18 @@ struct rtmp_stream {
 	int dropped_frames;
 
 #ifdef TEST_FRAMEDROPS
-	struct circlebuf droptest_info;
+	struct net_sim droptest;
 	uint64_t droptest_last_key_check;
 	size_t droptest_max;
-	size_t droptest_size;
 #endif
 
 	pthread_mutex_t dbr_mutex;
-	struct circlebuf dbr_frames;
-	size_t dbr_data_size;
-	uint64_t dbr_inc_timeout;
-	long audio_bitrate;
-	long dbr_est_bitrate;
+	struct rate_control dbr;
 	long dbr_orig_bitrate;
-	long dbr_prev_bitrate;
 	long dbr_cur_bitrate;
-	long dbr_inc_bitrate;
 	bool dbr_enabled;
-	long dbr_floor;
 	bool dbr_below_floor;
-	int dbr_preset;
+	uint64_t dbr_rtt_time;
 
 	RTMP rtmp;
 
@@ -446,11 +446,13 @@ static bool stinger_audio_render(void *data, uint64_t *ts_out,
 	struct obs_source_audio_mix child_audio;
 	obs_source_get_audio_mix(s->media_source, &child_audio);
 
+	uint32_t frames = audio_output_get_frames(obs_get_audio());
+
 	for (size_t mix = 0; mix < MAX_AUDIO_MIXES; mix++) {
 		for (size_t ch = 0; ch < channels; ch++) {
 			register float *out = audio->output[mix].data[ch];
 			register float *in = child_audio.output[mix].data[ch];
-			register float *end = in + AUDIO_OUTPUT_FRAMES;
+			register float *end = in + frames;
 
 			while (in < end)
 				*(out++) += *(in++);
@@ -0,0 +1,345 @@
+#include "vcam-hub.h"
+#include <util/darray.h>
+#include <util/threading.h>
+
+/* frames a feed may have waiting before new ones are dropped */
+#define MAX_PENDING_FRAMES 2
+
+struct video_frame {
+	uint8_t *data[MAX_AV_PLANES];
+	uint32_t linesize[MAX_AV_PLANES];
+};
+
+struct vcam_feed {
+	obs_output_t *output;
+	video_t *video;
+	bool active;
+	long pending;
+};
+
+struct vcam_hub {
+	pthread_t thread;
+	bool thread_created;
+	os_sem_t *sem;
+	volatile bool stop;
+
+	/* guards the queue and the pool */
+	pthread_mutex_t mutex;
+	/* held while a frame is handed to a feed's video output, so a feed
+	 * cannot go away in the middle of it */
+	pthread_mutex_t deliver_mutex;
+
+	DARRAY(struct vcam_frame *) queue;
+	DARRAY(struct vcam_frame *) pool;
+};
+
+static struct vcam_hub *hub = NULL;
+
+static void frame_destroy(struct vcam_frame *frame)
+{
+	if (frame) {
+		bfree(frame->data[0]);
+		bfree(frame);
+	}
+}
+
+static void copy_plane(uint8_t *dst, uint32_t dst_linesize, const uint8_t *src,
+		       uint32_t src_linesize, uint32_t height)
+{
+	if (dst_linesize == src_linesize) {
+		memcpy(dst, src, (size_t)dst_linesize * height);
+	} else {
+		uint32_t row = dst_linesize < src_linesize ? dst_linesize
+							   : src_linesize;
+		for (uint32_t i = 0; i < height; ++i)
+			memcpy(dst + dst_linesize * i, src + src_linesize * i,
+			       row);
+	}
+}
+
+static void deliver_frame(struct vcam_frame *frame)
+{
+	struct vcam_feed *feed = frame->feed;
+	struct video_frame output_frame;
+
+	if (!video_output_lock_frame(feed->video, &output_frame, 1,
+				     frame->timestamp))
+		return;
+
+	for (size_t p = 0; p < MAX_AV_PLANES; p++) {
+		if (!frame->data[p] || !output_frame.data[p])
+			break;
+
+		copy_plane(output_frame.data[p], output_frame.linesize[p],
+			   frame->data[p], frame->linesize[p],
+			   frame->height[p]);
+	}
+
+	video_output_unlock_frame(feed->video);
+}
+
+static void *hub_thread(void *data)
+{
+	UNUSED_PARAMETER(data);
+
+	os_set_thread_name("vcam-hub");
+
+	while (os_sem_wait(hub->sem) == 0) {
+		struct vcam_frame *frame = NULL;
+
+		if (hub->stop)
+			break;
+
+		pthread_mutex_lock(&hub->deliver_mutex);
+
+		pthread_mutex_lock(&hub->mutex);
+		if (hub->queue.num) {
+			frame = hub->queue.array[0];
+			da_erase(hub->queue, 0);
+		}
+		pthread_mutex_unlock(&hub->mutex);
+
+		if (frame) {
+			deliver_frame(frame);
+			os_atomic_dec_long(&frame->feed->pending);
+			vcam_hub_release_frame(frame);
+		}
+
+		pthread_mutex_unlock(&hub->deliver_mutex);
+	}
+
+	return NULL;
+}
+
+bool vcam_hub_init(void)
+{
+	hub = bzalloc(sizeof(struct vcam_hub));
+
+	if (pthread_mutex_init(&hub->mutex, NULL) != 0)
+		goto fail_mutex;
+	if (pthread_mutex_init(&hub->deliver_mutex, NULL) != 0)
+		goto fail_deliver_mutex;
+	if (os_sem_init(&hub->sem, 0) != 0)
+		goto fail_sem;
+	if (pthread_create(&hub->thread, NULL, hub_thread, NULL) != 0)
+		goto fail_thread;
+
+	hub->thread_created = true;
+	return true;
+
+fail_thread:
+	os_sem_destroy(hub->sem);
+fail_sem:
+	pthread_mutex_destroy(&hub->deliver_mutex);
+fail_deliver_mutex:
+	pthread_mutex_destroy(&hub->mutex);
+fail_mutex:
+	bfree(hub);
+	hub = NULL;
+	return false;
+}
+
+void vcam_hub_free(void)
+{
+	if (!hub)
+		return;
+
+	if (hub->thread_created) {
+		hub->stop = true;
+		os_sem_post(hub->sem);
+		pthread_join(hub->thread, NULL);
+	}
+
+	for (size_t i = 0; i < hub->queue.num; i++)
+		frame_destroy(hub->queue.array[i]);
+	for (size_t i = 0; i < hub->pool.num; i++)
+		frame_destroy(hub->pool.array[i]);
+	da_free(hub->queue);
+	da_free(hub->pool);
+
+	os_sem_destroy(hub->sem);
+	pthread_mutex_destroy(&hub->deliver_mutex);
+	pthread_mutex_destroy(&hub->mutex);
+	bfree(hub);
+	hub = NULL;
+}
+
+struct vcam_feed *vcam_hub_add_feed(const char *name,
+				    const struct video_output_info *info)
+{
+	struct video_output_info vi = *info;
+	struct vcam_feed *feed;
+
+	if (!hub)
+		return NULL;
+
+	/* the hub keeps its own queue, the video output only needs room for
+	 * the frame that is being sent out */
+	vi.cache_size = MAX_PENDING_FRAMES;
+	vi.name = name;
+
+	feed = bzalloc(sizeof(struct vcam_feed));
+	if (video_output_open(&feed->video, &vi) != VIDEO_OUTPUT_SUCCESS) {
+		bfree(feed);
+		return NULL;
+	}
+
+	/* the frames are already in a format the camera takes, don't let the
+	 * output convert them again */
+	obs_data_t *settings = obs_data_create();
+	obs_data_set_bool(settings, "keep_format", true);
+	feed->output = obs_output_create("virtualcam_output",
+					 "virtualcam_output_filter", settings,
+					 NULL);
+	obs_data_release(settings);
+
+	if (!feed->output) {
+		video_output_close(feed->video);
+		bfree(feed);
+		return NULL;
+	}
+
+	return feed;
+}
+
+void vcam_hub_remove_feed(struct vcam_feed *feed)
+{
+	if (!feed)
+		return;
+
+	vcam_feed_stop(feed);
+
+	/* wait for a delivery in progress, then drop what is still queued */
+	pthread_mutex_lock(&hub->deliver_mutex);
+	pthread_mutex_lock(&hub->mutex);
+	for (size_t i = hub->queue.num; i > 0; i--) {
+		struct vcam_frame *frame = hub->queue.array[i - 1];
+		if (frame->feed == feed) {
+			da_erase(hub->queue, i - 1);
+			frame->feed = NULL;
+			da_push_back(hub->pool, &frame);
+		}
+	}
+	pthread_mutex_unlock(&hub->mutex);
+	pthread_mutex_unlock(&hub->deliver_mutex);
+
+	obs_output_release(feed->output);
+	video_output_close(feed->video);
+	bfree(feed);
+}
+
+bool vcam_feed_start(struct vcam_feed *feed)
+{
+	if (feed->active)
+		return true;
+
+	obs_output_set_media(feed->output, feed->video, NULL);
+	feed->active = obs_output_start(feed->output);
+	return feed->active;
+}
+
+void vcam_feed_stop(struct vcam_feed *feed)
+{
+	if (!feed->active)
+		return;
+
+	obs_output_stop(feed->output);
+	feed->active = false;
+}
+
+const struct video_output_info *vcam_feed_get_info(struct vcam_feed *feed)
+{
+	return video_output_get_info(feed->video);
+}
+
+struct vcam_frame *vcam_hub_get_frame(struct vcam_feed *feed)
+{
+	const struct video_output_info *info = video_output_get_info(
+		feed->video);
+	struct vcam_frame *frame = NULL;
+	uint32_t linesize[MAX_AV_PLANES] = {0};
+	uint32_t height[MAX_AV_PLANES] = {0};
+	size_t size = 0;
+
+	if (!feed->active || os_atomic_load_long(&feed->pending) >=
+				     MAX_PENDING_FRAMES)
+		return NULL;
+
+	switch (info->format) {
+	case VIDEO_FORMAT_NV12:
+		linesize[0] = info->width;
+		linesize[1] = info->width;
+		height[0] = info->height;
+		height[1] = info->height / 2;
+		break;
+	case VIDEO_FORMAT_I420:
+		linesize[0] = info->width;
+		linesize[1] = info->width / 2;
+		linesize[2] = info->width / 2;
+		height[0] = info->height;
+		height[1] = info->height / 2;
+		height[2] = info->height / 2;
+		break;
+	default:
+		linesize[0] = info->width * 4;
+		height[0] = info->height;
+	}
+
+	for (size_t p = 0; p < MAX_AV_PLANES; p++)
+		size += (size_t)linesize[p] * height[p];
+
+	/* any pooled frame that is big enough will do, so feeds of the same
+	 * size share the same buffers */
+	pthread_mutex_lock(&hub->mutex);
+	for (size_t i = hub->pool.num; i > 0; i--) {
+		if (hub->pool.array[i - 1]->capacity >= size) {
+			frame = hub->pool.array[i - 1];
+			da_erase(hub->pool, i - 1);
+			break;
+		}
+	}
+	if (!frame && hub->pool.num) {
+		frame = hub->pool.array[hub->pool.num - 1];
+		da_pop_back(hub->pool);
+	}
+	pthread_mutex_unlock(&hub->mutex);
+
+	if (!frame)
+		frame = bzalloc(sizeof(struct vcam_frame));
+	if (frame->capacity < size) {
+		frame->data[0] = brealloc(frame->data[0], size);
+		frame->capacity = size;
+	}
+
+	uint8_t *data = frame->data[0];
+	for (size_t p = 0; p < MAX_AV_PLANES; p++) {
+		frame->data[p] = linesize[p] ? data : NULL;
+		frame->linesize[p] = linesize[p];
+		frame->height[p] = height[p];
+		data += (size_t)linesize[p] * height[p];
+	}
+
+	frame->feed = feed;
+	frame->timestamp = 0;
+	return frame;
+}
+
+void vcam_hub_push_frame(struct vcam_frame *frame)
+{
+	os_atomic_inc_long(&frame->feed->pending);
+
+	pthread_mutex_lock(&hub->mutex);
+	da_push_back(hub->queue, &frame);
+	pthread_mutex_unlock(&hub->mutex);
+
+	os_sem_post(hub->sem);
+}
+
+void vcam_hub_release_frame(struct vcam_frame *frame)
+{
+	frame->feed = NULL;
+
+	pthread_mutex_lock(&hub->mutex);
+	da_push_back(hub->pool, &frame);
+	pthread_mutex_unlock(&hub->mutex);
+}
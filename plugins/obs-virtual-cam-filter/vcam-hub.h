@@ -0,0 +1,37 @@
+#pragma once
+
+#include <obs-module.h>
+
+/* The hub owns every virtual camera output of the plugin. Each filter gets a
+ * feed with a fixed size and format; the filters hand downloaded frames to
+ * the hub, which keeps them in a shared frame pool and delivers them to the
+ * outputs from a single thread. */
+
+struct vcam_feed;
+
+struct vcam_frame {
+	uint8_t *data[MAX_AV_PLANES];
+	uint32_t linesize[MAX_AV_PLANES];
+	uint32_t height[MAX_AV_PLANES];
+	uint64_t timestamp;
+
+	struct vcam_feed *feed;
+	size_t capacity;
+};
+
+bool vcam_hub_init(void);
+void vcam_hub_free(void);
+
+struct vcam_feed *vcam_hub_add_feed(const char *name,
+				    const struct video_output_info *info);
+void vcam_hub_remove_feed(struct vcam_feed *feed);
+
+bool vcam_feed_start(struct vcam_feed *feed);
+void vcam_feed_stop(struct vcam_feed *feed);
+const struct video_output_info *vcam_feed_get_info(struct vcam_feed *feed);
+
+/* returns NULL if the feed already has enough frames waiting, in which case
+ * the frame should be dropped */
+struct vcam_frame *vcam_hub_get_frame(struct vcam_feed *feed);
+void vcam_hub_push_frame(struct vcam_frame *frame);
+void vcam_hub_release_frame(struct vcam_frame *frame);
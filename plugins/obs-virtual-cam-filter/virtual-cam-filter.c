@@ -1,19 +1,39 @@
 #include <obs-module.h>
+#include <graphics/matrix4.h>
+#include "vcam-hub.h"
+
+/* frames are staged into a ring of surfaces and mapped
+ * STAGE_SURFACE_COUNT - 1 frames later, so mapping never waits on the GPU */
+#define STAGE_SURFACE_COUNT 3
+#define MAX_CONVERT_PLANES 3
+
+/* libobs' own format_conversion.effect, shared by all filter instances */
+static gs_effect_t *conversion_effect = NULL;
 
 struct virtual_cam_filter_context {
 	obs_source_t *source;
-	obs_output_t *virtualCam;
-	uint8_t *video_data;
-	uint32_t video_linesize;
-	video_t *video_output;
+	struct vcam_feed *feed;
 	bool output_active;
+	/* size of the feed, the source is letterboxed into it when its own
+	 * size changes while the camera is running */
 	uint32_t width;
 	uint32_t height;
+	enum video_format format;
+	bool format_changed;
+	enum video_format output_format;
 	gs_texrender_t *texrender;
-	gs_stagesurf_t *stagesurface;
+	/* the texrender holds this frame's render of the target, at the
+	 * target's own size, so the filter's video_render can draw it instead
+	 * of rendering the target again */
+	bool frame_ready;
+	gs_texture_t *convert_textures[MAX_CONVERT_PLANES];
+	gs_stagesurf_t *stagesurfaces[STAGE_SURFACE_COUNT][MAX_CONVERT_PLANES];
+	uint64_t stage_timestamps[STAGE_SURFACE_COUNT];
+	bool stage_copied[STAGE_SURFACE_COUNT];
+	int cur_stage;
+	float color_matrix[16];
 	struct obs_video_info ovi;
 	uint64_t last_failed_start;
-	bool restart;
 };
 
 static const char *virtual_cam_filter_source_get_name(void *unused)
@@ -22,11 +42,320 @@ static const char *virtual_cam_filter_source_get_name(void *unused)
 	return "Virtual Camera";
 }
 
-struct video_frame {
-	uint8_t *data[MAX_AV_PLANES];
-	uint32_t linesize[MAX_AV_PLANES];
+struct convert_plane {
+	const char *tech;
+	enum gs_color_format format;
+	uint32_t divisor;
+	uint32_t pixel_size;
 };
 
+static const struct convert_plane bgra_planes[] = {
+	{NULL, GS_BGRA, 1, 4},
+};
+
+static const struct convert_plane nv12_planes[] = {
+	{"NV12_Y", GS_R8, 1, 1},
+	{"NV12_UV", GS_R8G8, 2, 2},
+};
+
+static const struct convert_plane i420_planes[] = {
+	{"Planar_Y", GS_R8, 1, 1},
+	{"Planar_U_Left", GS_R8, 2, 1},
+	{"Planar_V_Left", GS_R8, 2, 1},
+};
+
+static const struct convert_plane *get_convert_planes(enum video_format format,
+						      size_t *count)
+{
+	switch (format) {
+	case VIDEO_FORMAT_NV12:
+		*count = 2;
+		return nv12_planes;
+	case VIDEO_FORMAT_I420:
+		*count = 3;
+		return i420_planes;
+	default:
+		*count = 1;
+		return bgra_planes;
+	}
+}
+
+/* the conversion shaders expect an SDR source, which the BGRA texrender
+ * always is */
+static enum video_colorspace
+get_output_colorspace(const struct obs_video_info *ovi)
+{
+	switch (ovi->colorspace) {
+	case VIDEO_CS_2100_PQ:
+	case VIDEO_CS_2100_HLG:
+		return VIDEO_CS_709;
+	default:
+		return ovi->colorspace;
+	}
+}
+
+static void update_color_matrix(struct virtual_cam_filter_context *filter)
+{
+	struct matrix4 mat;
+	struct vec4 r_row;
+
+	video_format_get_parameters_for_format(
+		get_output_colorspace(&filter->ovi), filter->ovi.range,
+		filter->output_format, (float *)&mat, NULL, NULL);
+	matrix4_inv(&mat, &mat);
+
+	/* swap R and G */
+	r_row = mat.x;
+	mat.x = mat.y;
+	mat.y = r_row;
+
+	memcpy(filter->color_matrix, &mat, sizeof(float) * 16);
+}
+
+static void free_conversion(struct virtual_cam_filter_context *filter)
+{
+	for (int i = 0; i < STAGE_SURFACE_COUNT; i++) {
+		for (int p = 0; p < MAX_CONVERT_PLANES; p++) {
+			gs_stagesurface_destroy(filter->stagesurfaces[i][p]);
+			filter->stagesurfaces[i][p] = NULL;
+		}
+		filter->stage_copied[i] = false;
+	}
+	for (int p = 0; p < MAX_CONVERT_PLANES; p++) {
+		gs_texture_destroy(filter->convert_textures[p]);
+		filter->convert_textures[p] = NULL;
+	}
+	filter->cur_stage = 0;
+}
+
+static void reset_conversion(struct virtual_cam_filter_context *filter,
+			     uint32_t width, uint32_t height,
+			     enum video_format format)
+{
+	size_t count;
+	const struct convert_plane *planes = get_convert_planes(format, &count);
+
+	free_conversion(filter);
+
+	for (size_t p = 0; p < count; p++) {
+		uint32_t plane_width = width / planes[p].divisor;
+		uint32_t plane_height = height / planes[p].divisor;
+
+		if (planes[p].tech)
+			filter->convert_textures[p] = gs_texture_create(
+				plane_width, plane_height, planes[p].format, 1,
+				NULL, GS_RENDER_TARGET);
+
+		for (int i = 0; i < STAGE_SURFACE_COUNT; i++)
+			filter->stagesurfaces[i][p] = gs_stagesurface_create(
+				plane_width, plane_height, planes[p].format);
+	}
+}
+
+static void render_convert_plane(gs_texture_t *target, const char *tech_name)
+{
+	gs_technique_t *tech =
+		gs_effect_get_technique(conversion_effect, tech_name);
+
+	const uint32_t width = gs_texture_get_width(target);
+	const uint32_t height = gs_texture_get_height(target);
+
+	gs_set_render_target(target, NULL);
+	gs_ortho(0.0f, (float)width, 0.0f, (float)height, -100.0f, 100.0f);
+	gs_set_viewport(0, 0, width, height);
+
+	size_t passes = gs_technique_begin(tech);
+	for (size_t i = 0; i < passes; i++) {
+		gs_technique_begin_pass(tech, i);
+		gs_draw(GS_TRIS, 0, 3);
+		gs_technique_end_pass(tech);
+	}
+	gs_technique_end(tech);
+}
+
+/* same as render_convert_texture() in obs-video.c, but for the filter's own
+ * texrender and size */
+static void convert_frame(struct virtual_cam_filter_context *filter)
+{
+	size_t count;
+	const struct convert_plane *planes =
+		get_convert_planes(filter->output_format, &count);
+	gs_texture_t *texture = gs_texrender_get_texture(filter->texrender);
+	gs_texture_t *prev_target = gs_get_render_target();
+	gs_zstencil_t *prev_zstencil = gs_get_zstencil_target();
+	const float *m = filter->color_matrix;
+
+	gs_effect_t *effect = conversion_effect;
+	gs_eparam_t *color_vec0 =
+		gs_effect_get_param_by_name(effect, "color_vec0");
+	gs_eparam_t *color_vec1 =
+		gs_effect_get_param_by_name(effect, "color_vec1");
+	gs_eparam_t *color_vec2 =
+		gs_effect_get_param_by_name(effect, "color_vec2");
+	gs_eparam_t *image = gs_effect_get_param_by_name(effect, "image");
+	gs_eparam_t *width_i = gs_effect_get_param_by_name(effect, "width_i");
+
+	struct vec4 vec0, vec1, vec2;
+	vec4_set(&vec0, m[4], m[5], m[6], m[7]);
+	vec4_set(&vec1, m[0], m[1], m[2], m[3]);
+	vec4_set(&vec2, m[8], m[9], m[10], m[11]);
+
+	gs_viewport_push();
+	gs_projection_push();
+	gs_enable_blending(false);
+
+	for (size_t p = 0; p < count; p++) {
+		gs_effect_set_texture(image, texture);
+		gs_effect_set_vec4(color_vec0, &vec0);
+		gs_effect_set_vec4(color_vec1, &vec1);
+		gs_effect_set_vec4(color_vec2, &vec2);
+		gs_effect_set_float(width_i, 1.0f / (float)filter->width);
+		render_convert_plane(filter->convert_textures[p],
+				     planes[p].tech);
+	}
+
+	gs_enable_blending(true);
+	gs_projection_pop();
+	gs_viewport_pop();
+	gs_set_render_target(prev_target, prev_zstencil);
+}
+
+static void stage_frame(struct virtual_cam_filter_context *filter)
+{
+	int cur = filter->cur_stage;
+	size_t count;
+
+	get_convert_planes(filter->output_format, &count);
+
+	for (size_t p = 0; p < count; p++) {
+		gs_texture_t *texture =
+			filter->convert_textures[p]
+				? filter->convert_textures[p]
+				: gs_texrender_get_texture(filter->texrender);
+		if (!filter->stagesurfaces[cur][p])
+			return;
+
+		gs_stage_texture(filter->stagesurfaces[cur][p], texture);
+	}
+
+	filter->stage_timestamps[cur] = obs_get_video_frame_time();
+	filter->stage_copied[cur] = true;
+}
+
+static void copy_plane(uint8_t *dst, uint32_t dst_linesize, const uint8_t *src,
+		       uint32_t src_linesize, uint32_t row, uint32_t height)
+{
+	if (dst_linesize == src_linesize) {
+		memcpy(dst, src, (size_t)dst_linesize * height);
+	} else {
+		for (uint32_t i = 0; i < height; ++i)
+			memcpy(dst + dst_linesize * i, src + src_linesize * i,
+			       row);
+	}
+}
+
+/* maps the oldest staged surfaces, whose copy has finished by now, and hands
+ * them to the hub */
+static void download_frame(struct virtual_cam_filter_context *filter)
+{
+	int oldest = (filter->cur_stage + 1) % STAGE_SURFACE_COUNT;
+	struct vcam_frame *frame;
+	size_t count;
+	const struct convert_plane *planes =
+		get_convert_planes(filter->output_format, &count);
+
+	if (!filter->stage_copied[oldest])
+		return;
+	filter->stage_copied[oldest] = false;
+
+	frame = vcam_hub_get_frame(filter->feed);
+	if (!frame)
+		return;
+
+	for (size_t p = 0; p < count; p++) {
+		gs_stagesurf_t *surface = filter->stagesurfaces[oldest][p];
+		uint8_t *video_data;
+		uint32_t video_linesize;
+
+		if (!gs_stagesurface_map(surface, &video_data,
+					 &video_linesize)) {
+			vcam_hub_release_frame(frame);
+			return;
+		}
+
+		copy_plane(frame->data[p], frame->linesize[p], video_data,
+			   video_linesize,
+			   filter->width / planes[p].divisor *
+				   planes[p].pixel_size,
+			   filter->height / planes[p].divisor);
+
+		gs_stagesurface_unmap(surface);
+	}
+
+	frame->timestamp = filter->stage_timestamps[oldest];
+	vcam_hub_push_frame(frame);
+}
+
+static void reset_feed(struct virtual_cam_filter_context *filter,
+		       uint32_t width, uint32_t height,
+		       enum video_format format)
+{
+	struct video_output_info vi = {0};
+	vi.format = format;
+	vi.width = width;
+	vi.height = height;
+	vi.fps_den = filter->ovi.fps_den;
+	vi.fps_num = filter->ovi.fps_num;
+	vi.colorspace = get_output_colorspace(&filter->ovi);
+	vi.range = filter->ovi.range;
+
+	vcam_hub_remove_feed(filter->feed);
+	filter->feed = NULL;
+	filter->output_active = false;
+	filter->width = 0;
+	filter->height = 0;
+
+	reset_conversion(filter, width, height, format);
+
+	filter->feed = vcam_hub_add_feed(obs_source_get_name(filter->source),
+					 &vi);
+	if (filter->feed) {
+		filter->width = width;
+		filter->height = height;
+		filter->output_format = format;
+		update_color_matrix(filter);
+	}
+}
+
+/* scales the source to fit the feed and centers it */
+static void render_letterboxed(struct virtual_cam_filter_context *filter,
+			       uint32_t width, uint32_t height)
+{
+	if (width == filter->width && height == filter->height) {
+		obs_source_skip_video_filter(filter->source);
+		return;
+	}
+
+	float scale_x = (float)filter->width / (float)width;
+	float scale_y = (float)filter->height / (float)height;
+	float scale = scale_x < scale_y ? scale_x : scale_y;
+	float x = floorf(((float)filter->width - (float)width * scale) * 0.5f);
+	float y = floorf(((float)filter->height - (float)height * scale) *
+			 0.5f);
+
+	gs_matrix_push();
+	gs_matrix_translate3f(x, y, 0.0f);
+	gs_matrix_scale3f(scale, scale, 1.0f);
+	obs_source_skip_video_filter(filter->source);
+	gs_matrix_pop();
+}
+
+static bool parent_showing(struct virtual_cam_filter_context *filter)
+{
+	obs_source_t *parent = obs_filter_get_parent(filter->source);
+	return parent && obs_source_showing(parent);
+}
+
 void virtual_cam_filter_offscreen_render(void *data, uint32_t cx, uint32_t cy)
 {
 	struct virtual_cam_filter_context *filter = data;
@@ -40,113 +369,92 @@ void virtual_cam_filter_offscreen_render(void *data, uint32_t cx, uint32_t cy)
 	if (!width || !height)
 		return;
 
+	/* a running camera keeps its size and letterboxes the source, the size
+	 * is only picked up again while the camera is stopped */
+	if (!filter->feed || filter->format_changed ||
+	    (!filter->output_active &&
+	     (filter->width != width || filter->height != height))) {
+		/* chroma subsampled formats need even dimensions */
+		enum video_format format = filter->format;
+		if (!conversion_effect || (width & 1) || (height & 1))
+			format = VIDEO_FORMAT_BGRA;
+
+		filter->format_changed = false;
+		reset_feed(filter, width, height, format);
+	}
+	/* nothing to render for until the output has a device, or while the
+	 * parent is not shown anywhere */
+	if (!filter->feed || !filter->output_active || !parent_showing(filter))
+		return;
+
 	gs_texrender_reset(filter->texrender);
 
-	if (!gs_texrender_begin(filter->texrender, width, height))
+	if (!gs_texrender_begin(filter->texrender, filter->width,
+				filter->height))
 		return;
 
 	struct vec4 background;
 	vec4_zero(&background);
 
 	gs_clear(GS_CLEAR_COLOR, &background, 0.0f, 0);
-	gs_ortho(0.0f, (float)width, 0.0f, (float)height, -100.0f, 100.0f);
+	gs_ortho(0.0f, (float)filter->width, 0.0f, (float)filter->height,
+		 -100.0f, 100.0f);
 
 	gs_blend_state_push();
 	gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
 
-	obs_source_skip_video_filter(filter->source);
+	render_letterboxed(filter, width, height);
 
 	gs_blend_state_pop();
 	gs_texrender_end(filter->texrender);
 
-	if (filter->width != width || filter->height != height) {
-
-		gs_stagesurface_destroy(filter->stagesurface);
-		filter->stagesurface =
-			gs_stagesurface_create(width, height, GS_BGRA);
-
-		struct video_output_info vi = {0};
-		vi.format = VIDEO_FORMAT_BGRA;
-		vi.width = width;
-		vi.height = height;
-		vi.fps_den = filter->ovi.fps_den;
-		vi.fps_num = filter->ovi.fps_num;
-		vi.cache_size = 16;
-		vi.colorspace = VIDEO_CS_DEFAULT;
-		vi.range = VIDEO_RANGE_DEFAULT;
-		vi.name = obs_source_get_name(filter->source);
-
-		video_output_close(filter->video_output);
-		filter->video_output = NULL;
-		if (video_output_open(&filter->video_output, &vi) ==
-		    VIDEO_OUTPUT_SUCCESS) {
-			filter->width = width;
-			filter->height = height;
-			filter->restart = true;
-		}
-	}
-	if (!filter->video_output || video_output_stopped(filter->video_output))
-		return;
-
-	if (!filter->output_active && obs_source_enabled(filter->source)) {
-		const uint64_t time = obs_get_video_frame_time();
-		if (time - filter->last_failed_start < 1000000)
-			return;
-		obs_output_set_media(filter->virtualCam, filter->video_output,
-				     NULL);
-		if (obs_output_start(filter->virtualCam)) {
-			filter->output_active = true;
-		} else {
-			filter->last_failed_start = time;
-		}
+	filter->frame_ready = width == filter->width &&
+			      height == filter->height;
 
-	} else if (filter->output_active &&
-		   !obs_source_enabled(filter->source)) {
-		obs_output_stop(filter->virtualCam);
-		filter->output_active = false;
-	}
-
-	struct video_frame output_frame;
-	if (!video_output_lock_frame(filter->video_output, &output_frame, 1,
-				     obs_get_video_frame_time()))
-		return;
+	if (filter->output_format != VIDEO_FORMAT_BGRA)
+		convert_frame(filter);
 
-	if (filter->video_data) {
-		gs_stagesurface_unmap(filter->stagesurface);
-		filter->video_data = NULL;
-	}
-	if (!filter->stagesurface)
-		filter->stagesurface =
-			gs_stagesurface_create(width, height, GS_BGRA);
-
-	gs_stage_texture(filter->stagesurface,
-			 gs_texrender_get_texture(filter->texrender));
-	gs_stagesurface_map(filter->stagesurface, &filter->video_data,
-			    &filter->video_linesize);
-
-	if (filter->video_data && filter->video_linesize) {
-		const uint32_t linesize = output_frame.linesize[0];
-		for (uint32_t i = 0; i < filter->height; ++i) {
-			const uint32_t dst_offset = linesize * i;
-			const uint32_t src_offset = filter->video_linesize * i;
-			memcpy(output_frame.data[0] + dst_offset,
-			       filter->video_data + src_offset, linesize);
-		}
-	}
+	stage_frame(filter);
+	download_frame(filter);
 
-	video_output_unlock_frame(filter->video_output);
+	if (++filter->cur_stage == STAGE_SURFACE_COUNT)
+		filter->cur_stage = 0;
 }
 
 static void virtual_cam_filter_source_update(void *data, obs_data_t *settings)
 {
 	struct virtual_cam_filter_context *context = data;
+	enum video_format format =
+		(enum video_format)obs_data_get_int(settings, "format");
+	if (format != VIDEO_FORMAT_NV12 && format != VIDEO_FORMAT_I420)
+		format = VIDEO_FORMAT_BGRA;
+	if (context->format != format) {
+		context->format = format;
+		context->format_changed = true;
+	}
+}
+
+static void update_render_callback(struct virtual_cam_filter_context *context,
+				   bool enabled)
+{
 	obs_remove_main_render_callback(virtual_cam_filter_offscreen_render,
 					context);
-	obs_add_main_render_callback(virtual_cam_filter_offscreen_render,
-				     context);
+	if (enabled)
+		obs_add_main_render_callback(
+			virtual_cam_filter_offscreen_render, context);
+}
+
+/* a disabled filter has no camera to feed, so it does not render at all */
+static void virtual_cam_filter_enable(void *data, calldata_t *cd)
+{
+	struct virtual_cam_filter_context *context = data;
+	update_render_callback(context, calldata_bool(cd, "enabled"));
 }
 
-static void virtual_cam_filter_source_defaults(obs_data_t *settings) {}
+static void virtual_cam_filter_source_defaults(obs_data_t *settings)
+{
+	obs_data_set_default_int(settings, "format", VIDEO_FORMAT_NV12);
+}
 
 static void *virtual_cam_filter_source_create(obs_data_t *settings,
 					      obs_source_t *source)
@@ -154,46 +462,46 @@ static void *virtual_cam_filter_source_create(obs_data_t *settings,
 	struct virtual_cam_filter_context *context =
 		bzalloc(sizeof(struct virtual_cam_filter_context));
 	context->source = source;
-	context->virtualCam = obs_output_create(
-		"virtualcam_output", "virtualcam_output_filter", NULL, NULL);
 	context->texrender = gs_texrender_create(GS_BGRA, GS_ZS_NONE);
 	obs_get_video_info(&context->ovi);
 	virtual_cam_filter_source_update(context, settings);
+
+	signal_handler_connect(obs_source_get_signal_handler(source), "enable",
+			       virtual_cam_filter_enable, context);
+	update_render_callback(context, obs_source_enabled(source));
 	return context;
 }
 
 static void virtual_cam_filter_source_destroy(void *data)
 {
 	struct virtual_cam_filter_context *context = data;
-	obs_output_stop(context->virtualCam);
+	signal_handler_t *sh = obs_source_get_signal_handler(context->source);
 
-	obs_remove_main_render_callback(virtual_cam_filter_offscreen_render,
-					context);
+	signal_handler_disconnect(sh, "enable", virtual_cam_filter_enable,
+				  context);
+	update_render_callback(context, false);
 
-	video_output_close(context->video_output);
-	context->video_output = NULL;
+	vcam_hub_remove_feed(context->feed);
+	context->feed = NULL;
 
-	gs_stagesurface_unmap(context->stagesurface);
-	gs_stagesurface_destroy(context->stagesurface);
+	obs_enter_graphics();
+	free_conversion(context);
 	gs_texrender_destroy(context->texrender);
+	obs_leave_graphics();
 	bfree(context);
 }
 
 static void virtual_cam_filter_source_tick(void *data, float seconds)
 {
 	struct virtual_cam_filter_context *context = data;
-	if (context->restart && context->output_active) {
-		obs_output_stop(context->virtualCam);
-		context->output_active = false;
-		context->restart = false;
-	} else if (!context->output_active && context->video_output &&
-		   obs_source_enabled(context->source)) {
+	context->frame_ready = false;
+
+	if (!context->output_active && context->feed &&
+	    obs_source_enabled(context->source)) {
 		uint64_t time = obs_get_video_frame_time();
 		if (time - context->last_failed_start < 1000000)
 			return;
-		obs_output_set_media(context->virtualCam, context->video_output,
-				     NULL);
-		if (obs_output_start(context->virtualCam)) {
+		if (vcam_feed_start(context->feed)) {
 			context->output_active = true;
 		} else {
 			context->last_failed_start = time;
@@ -201,7 +509,7 @@ static void virtual_cam_filter_source_tick(void *data, float seconds)
 
 	} else if (context->output_active &&
 		   !obs_source_enabled(context->source)) {
-		obs_output_stop(context->virtualCam);
+		vcam_feed_stop(context->feed);
 		context->output_active = false;
 	}
 }
@@ -210,6 +518,12 @@ static obs_properties_t *virtual_cam_filter_source_properties(void *data)
 {
 	struct virtual_cam_filter_context *s = data;
 	obs_properties_t *props = obs_properties_create();
+	obs_property_t *p = obs_properties_add_list(props, "format", "Format",
+						    OBS_COMBO_TYPE_LIST,
+						    OBS_COMBO_FORMAT_INT);
+	obs_property_list_add_int(p, "NV12", VIDEO_FORMAT_NV12);
+	obs_property_list_add_int(p, "I420", VIDEO_FORMAT_I420);
+	obs_property_list_add_int(p, "BGRA", VIDEO_FORMAT_BGRA);
 	return props;
 }
 
@@ -217,25 +531,27 @@ void virtual_cam_filter_source_render(void *data, gs_effect_t *effect)
 {
 	UNUSED_PARAMETER(effect);
 	struct virtual_cam_filter_context *context = data;
-	obs_source_skip_video_filter(context->source);
+
+	if (!context->frame_ready) {
+		obs_source_skip_video_filter(context->source);
+		return;
+	}
+
+	/* the main render callbacks run before the views, so the camera
+	 * render of this frame can be reused for the scene */
+	gs_effect_t *default_effect = obs_get_base_effect(OBS_EFFECT_DEFAULT);
+	gs_texture_t *tex = gs_texrender_get_texture(context->texrender);
+	gs_effect_set_texture(gs_effect_get_param_by_name(default_effect,
+							  "image"),
+			      tex);
+	while (gs_effect_loop(default_effect, "Draw"))
+		gs_draw_sprite(tex, 0, 0, 0);
 }
 static void virtual_cam_filter_source_filter_remove(void *data,
 						    obs_source_t *parent)
 {
 }
 
-uint32_t virtual_cam_filter_source_width(void *data)
-{
-	struct virtual_cam_filter_context *s = data;
-	return s->width;
-}
-
-uint32_t virtual_cam_filter_source_height(void *data)
-{
-	struct virtual_cam_filter_context *s = data;
-	return s->height;
-}
-
 struct obs_source_info virtual_cam_filter_info = {
 	.id = "virtual_cam_filter",
 	.type = OBS_SOURCE_TYPE_FILTER,
@@ -249,8 +565,6 @@ struct obs_source_info virtual_cam_filter_info = {
 	.video_tick = virtual_cam_filter_source_tick,
 	.get_properties = virtual_cam_filter_source_properties,
 	.filter_remove = virtual_cam_filter_source_filter_remove,
-	.get_width = virtual_cam_filter_source_width,
-	.get_height = virtual_cam_filter_source_height,
 };
 
 OBS_DECLARE_MODULE()
@@ -262,6 +576,29 @@ MODULE_EXPORT const char *obs_module_description(void)
 
 bool obs_module_load(void)
 {
+	char *filename = obs_find_data_file("format_conversion.effect");
+	obs_enter_graphics();
+	conversion_effect = gs_effect_create_from_file(filename, NULL);
+	obs_leave_graphics();
+	bfree(filename);
+
+	if (!conversion_effect)
+		blog(LOG_WARNING, "[Virtual Camera Filter] GPU format "
+				  "conversion not available, using BGRA");
+
+	if (!vcam_hub_init())
+		return false;
+
 	obs_register_source(&virtual_cam_filter_info);
 	return true;
 }
+
+void obs_module_unload(void)
+{
+	vcam_hub_free();
+
+	obs_enter_graphics();
+	gs_effect_destroy(conversion_effect);
+	conversion_effect = NULL;
+	obs_leave_graphics();
+}
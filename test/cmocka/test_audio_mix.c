@@ -0,0 +1,165 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <math.h>
+
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <media-io/audio-mix.h>
+
+/* odd length so the scalar tail is exercised as well */
+#define TEST_FRAMES 1023
+#define BENCH_FRAMES 1024
+#define BENCH_TRACKS 6
+#define BENCH_CHANNELS 24
+#define BENCH_ITERATIONS 2000
+
+static void fill(float *data, size_t frames, float seed)
+{
+	for (size_t i = 0; i < frames; i++)
+		data[i] = seed * (float)((int)(i % 97) - 48) / 48.0f;
+}
+
+static void mix_accumulate_test(void **state)
+{
+	float src[TEST_FRAMES];
+	float dst[TEST_FRAMES];
+	float expected[TEST_FRAMES];
+
+	fill(src, TEST_FRAMES, 0.5f);
+	fill(dst, TEST_FRAMES, 0.25f);
+	for (size_t i = 0; i < TEST_FRAMES; i++)
+		expected[i] = dst[i] + src[i] * 0.7f;
+
+	audio_mix_accumulate(dst, src, 0.7f, TEST_FRAMES);
+
+	for (size_t i = 0; i < TEST_FRAMES; i++)
+		assert_true(fabsf(dst[i] - expected[i]) < 1e-6f);
+}
+
+static void mix_apply_gain_test(void **state)
+{
+	float data[TEST_FRAMES];
+
+	fill(data, TEST_FRAMES, 1.0f);
+	audio_mix_apply_gain(data + 1, 0.0f, TEST_FRAMES - 1);
+	assert_true(data[0] != 0.0f);
+	for (size_t i = 1; i < TEST_FRAMES; i++)
+		assert_true(data[i] == 0.0f);
+
+	fill(data, TEST_FRAMES, 1.0f);
+	audio_mix_apply_gain(data, 2.0f, TEST_FRAMES);
+	for (size_t i = 0; i < TEST_FRAMES; i++)
+		assert_true(data[i] ==
+			    2.0f * (float)((int)(i % 97) - 48) / 48.0f);
+}
+
+static void mix_ops_skip_zero_gain_test(void **state)
+{
+	float src[TEST_FRAMES];
+	float dst[2][TEST_FRAMES] = {0};
+	struct audio_mix_op ops[2] = {
+		{dst[0], src, 0.0f},
+		{dst[1], src, 1.0f},
+	};
+
+	fill(src, TEST_FRAMES, 1.0f);
+	audio_mix_accumulate_ops(ops, 2, TEST_FRAMES);
+
+	for (size_t i = 0; i < TEST_FRAMES; i++) {
+		assert_true(dst[0][i] == 0.0f);
+		assert_true(dst[1][i] == src[i]);
+	}
+}
+
+static void mix_ops_shared_source_test(void **state)
+{
+	float src[2][TEST_FRAMES];
+	float dst[3][TEST_FRAMES];
+	float expected[3][TEST_FRAMES];
+	struct audio_mix_op ops[] = {
+		{dst[0], src[0], 0.5f},
+		{dst[1], src[0], 0.0f},
+		{dst[2], src[0], 2.0f},
+		{dst[1], src[1], 1.0f},
+	};
+
+	fill(src[0], TEST_FRAMES, 1.0f);
+	fill(src[1], TEST_FRAMES, 0.25f);
+	for (size_t i = 0; i < 3; i++)
+		fill(dst[i], TEST_FRAMES, 0.1f * (float)(i + 1));
+
+	for (size_t i = 0; i < TEST_FRAMES; i++) {
+		expected[0][i] = dst[0][i] + src[0][i] * 0.5f;
+		expected[1][i] = dst[1][i] + src[1][i];
+		expected[2][i] = dst[2][i] + src[0][i] * 2.0f;
+	}
+
+	audio_mix_accumulate_ops(ops, 4, TEST_FRAMES);
+
+	for (size_t j = 0; j < 3; j++)
+		for (size_t i = 0; i < TEST_FRAMES; i++)
+			assert_true(fabsf(dst[j][i] - expected[j][i]) < 1e-6f);
+}
+
+static void scalar_mix(float *dst, const float *src, float gain, size_t frames)
+{
+	volatile float g = gain;
+	for (size_t i = 0; i < frames; i++)
+		dst[i] += src[i] * g;
+}
+
+/* one input with its own buffer feeding every track, the common case */
+static void mix_benchmark(void **state)
+{
+	const size_t count = BENCH_TRACKS * BENCH_CHANNELS;
+	float *src = bzalloc(BENCH_CHANNELS * BENCH_FRAMES * sizeof(float));
+	float *dst = bzalloc(count * BENCH_FRAMES * sizeof(float));
+	struct audio_mix_op ops[BENCH_TRACKS * BENCH_CHANNELS];
+	uint64_t start, scalar_ns, simd_ns;
+
+	for (size_t ch = 0; ch < BENCH_CHANNELS; ch++)
+		fill(src + ch * BENCH_FRAMES, BENCH_FRAMES, 0.5f);
+
+	for (size_t i = 0; i < count; i++) {
+		size_t ch = i / BENCH_TRACKS;
+		ops[i].dst = dst + i * BENCH_FRAMES;
+		ops[i].src = src + ch * BENCH_FRAMES;
+		ops[i].gain = 0.5f;
+	}
+
+	start = os_gettime_ns();
+	for (size_t n = 0; n < BENCH_ITERATIONS; n++)
+		for (size_t i = 0; i < count; i++)
+			scalar_mix(ops[i].dst, ops[i].src, 0.5f, BENCH_FRAMES);
+	scalar_ns = os_gettime_ns() - start;
+
+	start = os_gettime_ns();
+	for (size_t n = 0; n < BENCH_ITERATIONS; n++)
+		audio_mix_accumulate_ops(ops, count, BENCH_FRAMES);
+	simd_ns = os_gettime_ns() - start;
+
+	print_message("%d tracks x %d channels, per tick: "
+		      "scalar %.2f us, kernel %.2f us\n",
+		      BENCH_TRACKS, BENCH_CHANNELS,
+		      (double)scalar_ns / BENCH_ITERATIONS / 1000.0,
+		      (double)simd_ns / BENCH_ITERATIONS / 1000.0);
+
+	bfree(src);
+	bfree(dst);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(mix_accumulate_test),
+		cmocka_unit_test(mix_apply_gain_test),
+		cmocka_unit_test(mix_ops_skip_zero_gain_test),
+		cmocka_unit_test(mix_ops_shared_source_test),
+		cmocka_unit_test(mix_benchmark),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
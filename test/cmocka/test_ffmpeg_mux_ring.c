@@ -0,0 +1,271 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <string.h>
+#include <cmocka.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <util/threading.h>
+
+#include "ffmpeg-mux-ring.h"
+
+#define RING_SIZE 4096
+
+/* roughly a 1 Gbps recording: 64 KB packets, 120 MB per run */
+#define BENCH_PACKET_SIZE (64 * 1024)
+#define BENCH_PACKETS 1920
+
+static void fill(uint8_t *data, uint32_t size, uint8_t seed)
+{
+	for (uint32_t i = 0; i < size; i++)
+		data[i] = (uint8_t)(seed + i * 7);
+}
+
+static void attach_test(void **state)
+{
+	struct ffm_ring *writer = ffm_ring_create(RING_SIZE);
+	assert_non_null(writer);
+	assert_false(ffm_ring_attached(writer));
+
+	assert_null(ffm_ring_open(""));
+	assert_null(ffm_ring_open("obs-ffmpeg-mux-does-not-exist"));
+
+	struct ffm_ring *reader = ffm_ring_open(ffm_ring_name(writer));
+	assert_non_null(reader);
+	assert_true(ffm_ring_attached(writer));
+
+	/* the name is removed once the reader is in, the mappings stay */
+	assert_null(ffm_ring_open(ffm_ring_name(writer)));
+
+	ffm_ring_close(reader);
+	ffm_ring_close(writer);
+}
+
+static void wrap_test(void **state)
+{
+	struct ffm_ring *writer = ffm_ring_create(RING_SIZE);
+	struct ffm_ring *reader = ffm_ring_open(ffm_ring_name(writer));
+	uint8_t packet[1500];
+	uint8_t seed = 0;
+
+	assert_non_null(reader);
+
+	/* odd sized packets, so they regularly hit the end of the ring and
+	 * have to start over at the beginning */
+	for (int i = 0; i < 200; i++) {
+		uint32_t size = 100 + (uint32_t)(i * 37) % 1400;
+		uint32_t pos;
+
+		fill(packet, size, seed);
+		assert_true(ffm_ring_write(writer, packet, size, &pos));
+
+		const uint8_t *data = ffm_ring_peek(reader, pos, size);
+		assert_non_null(data);
+		assert_memory_equal(data, packet, size);
+
+		ffm_ring_consume(reader, pos, size);
+		seed++;
+	}
+
+	ffm_ring_close(reader);
+	ffm_ring_close(writer);
+}
+
+static void full_test(void **state)
+{
+	struct ffm_ring *writer = ffm_ring_create(RING_SIZE);
+	struct ffm_ring *reader = ffm_ring_open(ffm_ring_name(writer));
+	uint8_t packet[1024];
+	uint32_t pos[4];
+	uint32_t extra;
+
+	assert_non_null(reader);
+	assert_false(ffm_ring_write(writer, packet, RING_SIZE + 1, &extra));
+
+	for (int i = 0; i < 4; i++) {
+		fill(packet, sizeof(packet), (uint8_t)i);
+		assert_true(ffm_ring_write(writer, packet, sizeof(packet),
+					   &pos[i]));
+	}
+
+	/* nothing consumed yet, so the writer has to fall back to the pipe */
+	assert_false(ffm_ring_write(writer, packet, 1, &extra));
+
+	/* consuming frees the space again, and unread data stays intact */
+	ffm_ring_consume(reader, pos[0], sizeof(packet));
+	fill(packet, sizeof(packet), 42);
+	assert_true(ffm_ring_write(writer, packet, sizeof(packet), &extra));
+
+	for (int i = 1; i < 4; i++) {
+		const uint8_t *data =
+			ffm_ring_peek(reader, pos[i], sizeof(packet));
+		fill(packet, sizeof(packet), (uint8_t)i);
+		assert_memory_equal(data, packet, sizeof(packet));
+	}
+
+	ffm_ring_close(reader);
+	ffm_ring_close(writer);
+}
+
+#ifndef _WIN32
+/* what goes over the pipe for every packet, like ffm_packet_info */
+struct bench_info {
+	uint32_t size;
+	uint32_t pos;
+	uint8_t in_ring;
+};
+
+struct bench_reader {
+	int fd;
+	struct ffm_ring *ring;
+	uint64_t sum;
+};
+
+static bool read_all(int fd, void *data, size_t size)
+{
+	uint8_t *out = data;
+
+	while (size) {
+		ssize_t ret = read(fd, out, size);
+		if (ret <= 0)
+			return false;
+		out += ret;
+		size -= (size_t)ret;
+	}
+
+	return true;
+}
+
+static void write_all(int fd, const void *data, size_t size)
+{
+	const uint8_t *in = data;
+
+	while (size) {
+		ssize_t ret = write(fd, in, size);
+		assert_true(ret > 0);
+		in += ret;
+		size -= (size_t)ret;
+	}
+}
+
+static uint64_t checksum(const uint8_t *data, uint32_t size)
+{
+	uint64_t sum = 0;
+	for (uint32_t i = 0; i < size; i += 64)
+		sum += data[i];
+	return sum;
+}
+
+/* stands in for ffmpeg-mux: pipe packets are read into a heap buffer,
+ * ring packets are used in place */
+static void *bench_reader_thread(void *param)
+{
+	struct bench_reader *reader = param;
+	uint8_t *buf = bmalloc(BENCH_PACKET_SIZE);
+	struct bench_info info;
+
+	while (read_all(reader->fd, &info, sizeof(info))) {
+		if (info.in_ring) {
+			const uint8_t *data = ffm_ring_peek(
+				reader->ring, info.pos, info.size);
+			reader->sum += checksum(data, info.size);
+			ffm_ring_consume(reader->ring, info.pos, info.size);
+		} else {
+			if (!read_all(reader->fd, buf, info.size))
+				break;
+			reader->sum += checksum(buf, info.size);
+		}
+	}
+
+	bfree(buf);
+	return NULL;
+}
+
+static uint64_t bench_run(bool use_ring, size_t *ring_packets)
+{
+	struct ffm_ring *writer = ffm_ring_create(FFM_RING_DEFAULT_SIZE);
+	struct bench_reader reader = {0};
+	uint8_t *packet = bmalloc(BENCH_PACKET_SIZE);
+	pthread_t thread;
+	uint64_t start, ns;
+	int fds[2];
+
+	assert_int_equal(pipe(fds), 0);
+	reader.fd = fds[0];
+	reader.ring = ffm_ring_open(ffm_ring_name(writer));
+	assert_non_null(reader.ring);
+	fill(packet, BENCH_PACKET_SIZE, 1);
+	*ring_packets = 0;
+
+	/* fault in the whole mapping first, a recording only pays for that
+	 * once */
+	for (size_t i = 0; i < FFM_RING_DEFAULT_SIZE / BENCH_PACKET_SIZE; i++) {
+		uint32_t pos;
+		assert_true(ffm_ring_write(writer, packet, BENCH_PACKET_SIZE,
+					   &pos));
+		ffm_ring_consume(reader.ring, pos, BENCH_PACKET_SIZE);
+	}
+
+	pthread_create(&thread, NULL, bench_reader_thread, &reader);
+
+	start = os_gettime_ns();
+	for (size_t i = 0; i < BENCH_PACKETS; i++) {
+		struct bench_info info = {BENCH_PACKET_SIZE, 0, 0};
+
+		/* the same fallback as the output: anything that does not
+		 * fit in the ring goes over the pipe */
+		info.in_ring = use_ring && ffm_ring_write(writer, packet,
+							  info.size, &info.pos);
+		write_all(fds[1], &info, sizeof(info));
+		if (info.in_ring)
+			(*ring_packets)++;
+		else
+			write_all(fds[1], packet, info.size);
+	}
+	close(fds[1]);
+	pthread_join(thread, NULL);
+	ns = os_gettime_ns() - start;
+
+	assert_int_equal(reader.sum,
+			 checksum(packet, BENCH_PACKET_SIZE) * BENCH_PACKETS);
+
+	close(fds[0]);
+	bfree(packet);
+	ffm_ring_close(reader.ring);
+	ffm_ring_close(writer);
+	return ns;
+}
+
+static void ring_benchmark(void **state)
+{
+	const double mb = (double)BENCH_PACKET_SIZE * BENCH_PACKETS / 1e6;
+	size_t ring_packets;
+	uint64_t pipe_ns = bench_run(false, &ring_packets);
+	uint64_t ring_ns = bench_run(true, &ring_packets);
+
+	print_message("%d x %d KB packets: pipe %.0f MB/s, ring %.0f MB/s "
+		      "(%zu in ring)\n",
+		      BENCH_PACKETS, BENCH_PACKET_SIZE / 1024,
+		      mb / ((double)pipe_ns / 1e9),
+		      mb / ((double)ring_ns / 1e9), ring_packets);
+}
+#endif
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(attach_test),
+		cmocka_unit_test(wrap_test),
+		cmocka_unit_test(full_test),
+#ifndef _WIN32
+		cmocka_unit_test(ring_benchmark),
+#endif
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
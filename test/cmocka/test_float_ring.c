@@ -0,0 +1,214 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <util/float-ring.h>
+#include <media-io/audio-io.h>
+#include <util/platform.h>
+
+#define PLANES 2
+#define CHUNK 300
+#define STRESS_FRAMES (CHUNK * 5000)
+
+static void fill(float *data[PLANES], size_t frames, size_t start)
+{
+	for (size_t ch = 0; ch < PLANES; ch++)
+		for (size_t i = 0; i < frames; i++)
+			data[ch][i] = (float)((start + i) % 65536) + ch * 0.5f;
+}
+
+static void ring_wraparound_test(void **state)
+{
+	struct float_ring ring;
+	float buf[PLANES][CHUNK];
+	float *data[PLANES] = {buf[0], buf[1]};
+	size_t pos = 0;
+
+	float_ring_init(&ring);
+	float_ring_reserve(&ring, PLANES, 1000);
+	assert_int_equal(ring.capacity, 1024);
+
+	/* 300 does not divide 1024, so this wraps at every offset */
+	for (size_t n = 0; n < 50; n++) {
+		fill(data, CHUNK, n * CHUNK);
+		assert_true(float_ring_push_back(
+			&ring, (const uint8_t *const *)data, CHUNK));
+		assert_int_equal(float_ring_size(&ring), CHUNK);
+
+		float_ring_peek_front(&ring, data, CHUNK);
+		for (size_t i = 0; i < CHUNK; i++)
+			assert_true(buf[1][i] ==
+				    (float)((pos + i) % 65536) + 0.5f);
+
+		float_ring_pop_front(&ring, CHUNK);
+		pos += CHUNK;
+	}
+
+	assert_int_equal(float_ring_size(&ring), 0);
+	float_ring_free(&ring);
+}
+
+static void ring_full_and_grow_test(void **state)
+{
+	struct float_ring ring;
+	float buf[PLANES][CHUNK];
+	float *data[PLANES] = {buf[0], buf[1]};
+
+	float_ring_init(&ring);
+	float_ring_reserve(&ring, PLANES, 1024);
+
+	fill(data, CHUNK, 0);
+	for (size_t n = 0; n < 3; n++)
+		assert_true(float_ring_push_back(
+			&ring, (const uint8_t *const *)data, CHUNK));
+	assert_false(float_ring_push_back(&ring, (const uint8_t *const *)data,
+					  CHUNK));
+	assert_int_equal(float_ring_size(&ring), 3 * CHUNK);
+
+	float_ring_pop_front(&ring, 100);
+	float_ring_reserve(&ring, PLANES, 4 * CHUNK);
+	assert_int_equal(ring.capacity, 2048);
+	assert_int_equal(float_ring_size(&ring), 3 * CHUNK - 100);
+
+	float_ring_peek_front(&ring, data, CHUNK);
+	assert_true(buf[0][0] == 100.0f);
+	assert_true(buf[0][CHUNK - 101] == (float)(CHUNK - 1));
+	assert_true(buf[0][CHUNK - 100] == 0.0f);
+
+	float_ring_free(&ring);
+}
+
+static void ring_place_test(void **state)
+{
+	struct float_ring ring;
+	float buf[PLANES][CHUNK];
+	float *data[PLANES] = {buf[0], buf[1]};
+
+	float_ring_init(&ring);
+	float_ring_reserve(&ring, PLANES, 1024);
+
+	fill(data, CHUNK, 1);
+	float_ring_push_back(&ring, (const uint8_t *const *)data, CHUNK);
+
+	/* overwrite the tail */
+	float_ring_place(&ring, 100, (const uint8_t *const *)data, 10);
+	assert_int_equal(float_ring_size(&ring), 110);
+
+	/* leave a gap, which has to be silent */
+	float_ring_place(&ring, 200, (const uint8_t *const *)data, 10);
+	assert_int_equal(float_ring_size(&ring), 210);
+
+	float_ring_peek_front(&ring, data, 210);
+	assert_true(buf[0][99] == 100.0f);
+	assert_true(buf[0][100] == 1.0f);
+	assert_true(buf[0][150] == 0.0f);
+	assert_true(buf[0][209] == 10.0f);
+
+	/* placing past the capacity grows the ring */
+	float_ring_place(&ring, 2000, (const uint8_t *const *)data, 10);
+	assert_int_equal(float_ring_size(&ring), 2010);
+	assert_int_equal(ring.capacity, 2048);
+
+	float_ring_free(&ring);
+}
+
+static void ring_max_planes_test(void **state)
+{
+	struct float_ring ring;
+	float buf[FLOAT_RING_MAX_PLANES][CHUNK];
+	float *data[FLOAT_RING_MAX_PLANES];
+
+	for (size_t ch = 0; ch < FLOAT_RING_MAX_PLANES; ch++) {
+		data[ch] = buf[ch];
+		for (size_t i = 0; i < CHUNK; i++)
+			buf[ch][i] = (float)(ch * CHUNK + i);
+	}
+
+	/* every audio channel needs its own plane */
+	float_ring_init(&ring);
+	float_ring_reserve(&ring, MAX_AUDIO_CHANNELS, CHUNK);
+	assert_int_equal(ring.planes, MAX_AUDIO_CHANNELS);
+
+	assert_true(float_ring_push_back(&ring, (const uint8_t *const *)data,
+					 CHUNK));
+
+	memset(buf, 0, sizeof(buf));
+	float_ring_peek_front(&ring, data, CHUNK);
+	for (size_t ch = 0; ch < MAX_AUDIO_CHANNELS; ch++)
+		for (size_t i = 0; i < CHUNK; i++)
+			assert_true(buf[ch][i] == (float)(ch * CHUNK + i));
+
+	float_ring_free(&ring);
+}
+
+static void *producer_thread(void *param)
+{
+	struct float_ring *ring = param;
+	float buf[PLANES][CHUNK];
+	float *data[PLANES] = {buf[0], buf[1]};
+	size_t pos = 0;
+
+	while (pos < STRESS_FRAMES) {
+		fill(data, CHUNK, pos);
+		if (float_ring_push_back(ring, (const uint8_t *const *)data,
+					 CHUNK))
+			pos += CHUNK;
+		else
+			os_sleep_ms(0);
+	}
+
+	return NULL;
+}
+
+static void ring_spsc_test(void **state)
+{
+	struct float_ring ring;
+	float buf[PLANES][1024];
+	float *data[PLANES] = {buf[0], buf[1]};
+	pthread_t thread;
+	size_t pos = 0;
+	bool ok = true;
+
+	float_ring_init(&ring);
+	float_ring_reserve(&ring, PLANES, 2048);
+
+	pthread_create(&thread, NULL, producer_thread, &ring);
+
+	while (pos < STRESS_FRAMES) {
+		size_t frames = float_ring_size(&ring);
+		if (frames > 1024)
+			frames = 1024;
+		if (!frames) {
+			os_sleep_ms(0);
+			continue;
+		}
+
+		float_ring_peek_front(&ring, data, frames);
+		for (size_t ch = 0; ch < PLANES; ch++)
+			for (size_t i = 0; i < frames; i++)
+				ok = ok && buf[ch][i] ==
+						   (float)((pos + i) % 65536) +
+							   ch * 0.5f;
+		float_ring_pop_front(&ring, frames);
+		pos += frames;
+	}
+
+	pthread_join(thread, NULL);
+	assert_true(ok);
+	assert_int_equal(float_ring_size(&ring), 0);
+	float_ring_free(&ring);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(ring_wraparound_test),
+		cmocka_unit_test(ring_full_and_grow_test),
+		cmocka_unit_test(ring_place_test),
+		cmocka_unit_test(ring_max_planes_test),
+		cmocka_unit_test(ring_spsc_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
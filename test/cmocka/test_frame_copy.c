@@ -0,0 +1,154 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <string.h>
+#include <cmocka.h>
+
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <util/task.h>
+
+/* mirrors the row slicing of the CPU frame copies in obs-video.c, which run
+ * after GPU conversion: COPY_ROWS_PER_JOB rows per job on the video workers
+ * (MAX_VIDEO_WORKER_THREADS) plus the graphics thread */
+#define COPY_ROWS_PER_JOB 64
+#define VIDEO_WORKER_THREADS 3
+
+#define BENCH_ITERATIONS 200
+
+struct plane_copy {
+	const uint8_t *in;
+	uint8_t *out;
+	uint32_t linesize;
+	uint32_t width;
+	uint32_t height;
+};
+
+static void copy_rows(const struct plane_copy *plane, uint32_t start_y,
+		      uint32_t end_y)
+{
+	for (uint32_t y = start_y; y < end_y; y++)
+		memcpy(plane->out + (size_t)y * plane->linesize,
+		       plane->in + (size_t)y * plane->linesize, plane->width);
+}
+
+static void copy_job(void *param, size_t idx)
+{
+	const struct plane_copy *plane = param;
+	uint32_t start_y = (uint32_t)idx * COPY_ROWS_PER_JOB;
+	uint32_t end_y = start_y + COPY_ROWS_PER_JOB;
+
+	if (end_y > plane->height)
+		end_y = plane->height;
+
+	copy_rows(plane, start_y, end_y);
+}
+
+static void copy_sliced(os_task_pool_t *pool, const struct plane_copy *plane)
+{
+	size_t jobs = (plane->height + COPY_ROWS_PER_JOB - 1) /
+		      COPY_ROWS_PER_JOB;
+
+	os_task_pool_run(pool, copy_job, (void *)plane, jobs);
+}
+
+static void init_plane(struct plane_copy *plane, uint32_t width,
+		       uint32_t height)
+{
+	/* padded the way GPU staging surfaces usually are, so every row is
+	 * copied separately */
+	size_t size;
+	uint8_t *in;
+
+	plane->width = width;
+	plane->height = height;
+	plane->linesize = (width + 255) & ~255U;
+
+	size = (size_t)plane->linesize * height;
+	in = bmalloc(size);
+	for (size_t i = 0; i < size; i++)
+		in[i] = (uint8_t)(i * 7 + (i >> 11));
+
+	plane->in = in;
+	plane->out = bzalloc(size);
+}
+
+static void free_plane(struct plane_copy *plane)
+{
+	bfree((void *)plane->in);
+	bfree(plane->out);
+}
+
+static void sliced_copy_test(void **state)
+{
+	os_task_pool_t *pool =
+		os_task_pool_create(VIDEO_WORKER_THREADS, "test");
+	struct plane_copy plane;
+
+	/* height that does not divide into whole jobs */
+	init_plane(&plane, 1000, COPY_ROWS_PER_JOB * 5 + 7);
+	copy_sliced(pool, &plane);
+
+	for (uint32_t y = 0; y < plane.height; y++)
+		assert_memory_equal(plane.out + (size_t)y * plane.linesize,
+				    plane.in + (size_t)y * plane.linesize,
+				    plane.width);
+
+	free_plane(&plane);
+	os_task_pool_destroy(pool);
+}
+
+static void bench_frame(os_task_pool_t *pool, uint32_t width,
+			uint32_t height)
+{
+	/* NV12: full size luma plane and half height interleaved chroma */
+	struct plane_copy luma, chroma;
+	uint64_t start, serial_ns, sliced_ns;
+
+	init_plane(&luma, width, height);
+	init_plane(&chroma, width, height / 2);
+
+	start = os_gettime_ns();
+	for (size_t n = 0; n < BENCH_ITERATIONS; n++) {
+		copy_rows(&luma, 0, luma.height);
+		copy_rows(&chroma, 0, chroma.height);
+	}
+	serial_ns = os_gettime_ns() - start;
+
+	start = os_gettime_ns();
+	for (size_t n = 0; n < BENCH_ITERATIONS; n++) {
+		copy_sliced(pool, &luma);
+		copy_sliced(pool, &chroma);
+	}
+	sliced_ns = os_gettime_ns() - start;
+
+	print_message("NV12 %ux%u, per frame: serial %.1f us, "
+		      "sliced %.1f us\n",
+		      width, height,
+		      (double)serial_ns / BENCH_ITERATIONS / 1000.0,
+		      (double)sliced_ns / BENCH_ITERATIONS / 1000.0);
+
+	free_plane(&luma);
+	free_plane(&chroma);
+}
+
+static void frame_copy_benchmark(void **state)
+{
+	os_task_pool_t *pool =
+		os_task_pool_create(VIDEO_WORKER_THREADS, "test");
+
+	bench_frame(pool, 1920, 1080);
+	bench_frame(pool, 3840, 2160);
+
+	os_task_pool_destroy(pool);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(sliced_copy_test),
+		cmocka_unit_test(frame_copy_benchmark),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
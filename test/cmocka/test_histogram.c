@@ -0,0 +1,68 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <util/histogram.h>
+
+static void histogram_index_test(void **state)
+{
+	/* small values are exact */
+	for (uint64_t v = 0; v < HISTOGRAM_SUB_BUCKETS; v++)
+		assert_int_equal(histogram_index(v), v);
+
+	/* every value lies within its bucket, and buckets are ordered */
+	size_t last = 0;
+	for (uint64_t v = 1; v < (1ULL << 62); v = v * 3 + 1) {
+		size_t idx = histogram_index(v);
+		uint64_t high = histogram_bucket_value(idx);
+
+		assert_true(idx < HISTOGRAM_BUCKETS);
+		assert_true(idx >= last);
+		assert_true(v <= high);
+		assert_true(high - v <= v / HISTOGRAM_SUB_BUCKETS);
+		last = idx;
+	}
+
+	assert_int_equal(histogram_index(UINT64_MAX), HISTOGRAM_BUCKETS - 1);
+	assert_true(histogram_bucket_value(HISTOGRAM_BUCKETS - 1) ==
+		    UINT64_MAX);
+}
+
+static void histogram_percentile_test(void **state)
+{
+	struct histogram h;
+	histogram_clear(&h);
+
+	assert_true(histogram_percentile(&h, 0.5) == 0);
+
+	/* 1000 frames of ~16 ms with ten 50 ms spikes and one 200 ms hitch */
+	for (int i = 0; i < 989; i++)
+		histogram_record(&h, 16000000 + (uint64_t)i * 1000);
+	for (int i = 0; i < 10; i++)
+		histogram_record(&h, 50000000);
+	histogram_record(&h, 200000000);
+
+	assert_true(h.count == 1000);
+	assert_true(h.min == 16000000);
+	assert_true(h.max == 200000000);
+
+	uint64_t p50 = histogram_percentile(&h, 0.5);
+	assert_true(p50 >= 16500000 && p50 <= 16500000 + 16500000 / 16);
+
+	uint64_t p99 = histogram_percentile(&h, 0.99);
+	assert_true(p99 >= 50000000 && p99 <= 50000000 + 50000000 / 16);
+
+	assert_true(histogram_percentile(&h, 0.999) == 200000000);
+	assert_true(histogram_percentile(&h, 1.0) == 200000000);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(histogram_index_test),
+		cmocka_unit_test(histogram_percentile_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,325 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdlib.h>
+#include <cmocka.h>
+
+#include <util/darray.h>
+#include <util/platform.h>
+
+#include "obs-output-interleave.h"
+
+#define AUDIO_TRACKS 6
+#define SECONDS 120
+
+/* backlogs of an output without a delay and with a 10 second delay */
+#define BENCH_PACKETS 200000
+#define BENCH_SHORT_BACKLOG 64
+#define BENCH_LONG_BACKLOG 3400
+
+static struct encoder_packet make_packet(enum obs_encoder_type type,
+					 size_t track, int64_t dts_usec)
+{
+	struct encoder_packet packet = {0};
+
+	packet.type = type;
+	packet.track_idx = track;
+	packet.dts_usec = dts_usec;
+	packet.dts = dts_usec;
+	packet.pts = dts_usec;
+	return packet;
+}
+
+static int compare_packets(const void *a, const void *b)
+{
+	const struct encoder_packet *pa = a;
+	const struct encoder_packet *pb = b;
+
+	if (interleave_before(pa, pb))
+		return -1;
+	return interleave_before(pb, pa) ? 1 : 0;
+}
+
+/* 60 fps video and six 48 kHz audio tracks, each track coming in on its own
+ * schedule (as if each encoder ran on its own thread), checked against a
+ * plain sort of the same packets */
+static void order_test(void **state)
+{
+	const int64_t video_usec = 1000000 / 60;
+	const int64_t audio_usec = 1024 * 1000000LL / 48000;
+	const size_t video_packets = SECONDS * 60;
+	const size_t audio_packets = (size_t)(SECONDS * 1000000LL / audio_usec);
+	const size_t total = video_packets + audio_packets * AUDIO_TRACKS;
+
+	struct encoder_packet *expected = malloc(total * sizeof(*expected));
+	size_t next[AUDIO_TRACKS + 1] = {0};
+	struct interleaver il = {0};
+	size_t count = 0;
+	size_t popped = 0;
+
+	srand(1234);
+
+	while (count < total) {
+		size_t track = (size_t)rand() % (AUDIO_TRACKS + 1);
+		struct encoder_packet packet;
+
+		if (!track) {
+			if (next[0] == video_packets)
+				continue;
+			packet = make_packet(OBS_ENCODER_VIDEO, 0,
+					     (int64_t)next[0]++ * video_usec);
+		} else {
+			if (next[track] == audio_packets)
+				continue;
+			packet = make_packet(OBS_ENCODER_AUDIO, track - 1,
+					     (int64_t)next[track]++ *
+						     audio_usec);
+		}
+
+		expected[count++] = packet;
+		interleaver_push(&il, &packet);
+
+		/* keep a backlog in the interleaver, as an output with a
+		 * delay would */
+		if (count > 500) {
+			struct encoder_packet out;
+			assert_true(interleaver_pop(&il, &out));
+			popped++;
+		}
+	}
+
+	interleaver_free(&il);
+
+	/* now all of it at once, and compare the full order */
+	for (size_t i = 0; i < total; i++)
+		interleaver_push(&il, &expected[i]);
+
+	qsort(expected, total, sizeof(*expected), compare_packets);
+
+	for (size_t i = 0; i < total; i++) {
+		struct encoder_packet out;
+
+		assert_true(interleaver_pop(&il, &out));
+		assert_int_equal(out.type, expected[i].type);
+		assert_int_equal(out.track_idx, expected[i].track_idx);
+		assert_true(out.dts_usec == expected[i].dts_usec);
+	}
+
+	assert_null(interleaver_peek(&il));
+	assert_false(interleaver_pop(&il, &(struct encoder_packet){0}));
+	assert_true(popped == total - 500);
+
+	interleaver_free(&il);
+	free(expected);
+}
+
+static void tie_test(void **state)
+{
+	struct interleaver il = {0};
+	struct encoder_packet packet;
+
+	packet = make_packet(OBS_ENCODER_AUDIO, 2, 1000);
+	interleaver_push(&il, &packet);
+	packet = make_packet(OBS_ENCODER_AUDIO, 0, 1000);
+	interleaver_push(&il, &packet);
+	packet = make_packet(OBS_ENCODER_VIDEO, 0, 1000);
+	interleaver_push(&il, &packet);
+
+	/* video first on equal timestamps, then audio in track order */
+	assert_true(interleaver_pop(&il, &packet));
+	assert_int_equal(packet.type, OBS_ENCODER_VIDEO);
+	assert_true(interleaver_pop(&il, &packet));
+	assert_int_equal(packet.track_idx, 0);
+	assert_true(interleaver_pop(&il, &packet));
+	assert_int_equal(packet.track_idx, 2);
+
+	interleaver_free(&il);
+}
+
+static void discard_test(void **state)
+{
+	struct interleaver il = {0};
+	struct encoder_packet packet;
+
+	for (int64_t i = 0; i < 10; i++) {
+		packet = make_packet(OBS_ENCODER_VIDEO, 0, i * 20);
+		interleaver_push(&il, &packet);
+		packet = make_packet(OBS_ENCODER_AUDIO, 0, i * 20 + 5);
+		interleaver_push(&il, &packet);
+	}
+
+	/* up to, not including, the fourth video packet */
+	interleaver_discard_to(
+		&il, interleaver_packet(&il, OBS_ENCODER_VIDEO, 0, 3), false);
+	assert_true(interleaver_peek(&il)->dts_usec == 60);
+	assert_int_equal(interleaver_num_packets(&il, OBS_ENCODER_VIDEO, 0), 7);
+	assert_int_equal(interleaver_num_packets(&il, OBS_ENCODER_AUDIO, 0), 7);
+
+	/* including the first audio packet left */
+	interleaver_discard_to(
+		&il, interleaver_first(&il, OBS_ENCODER_AUDIO, 0), true);
+	assert_true(interleaver_peek(&il)->dts_usec == 80);
+	assert_true(interleaver_last(&il, OBS_ENCODER_AUDIO, 0)->dts_usec ==
+		    185);
+
+	interleaver_free(&il);
+}
+
+static void sort_test(void **state)
+{
+	struct interleaver il = {0};
+	struct encoder_packet packet;
+
+	for (int64_t i = 0; i < 5; i++) {
+		packet = make_packet(OBS_ENCODER_VIDEO, 0, 1000 + i * 20);
+		interleaver_push(&il, &packet);
+		packet = make_packet(OBS_ENCODER_AUDIO, 1, 500 + i * 20);
+		interleaver_push(&il, &packet);
+	}
+
+	assert_int_equal(interleaver_peek(&il)->type, OBS_ENCODER_AUDIO);
+
+	/* both tracks start at 0 once their offsets are taken away */
+	for (size_t i = 0; i < 5; i++) {
+		interleaver_packet(&il, OBS_ENCODER_VIDEO, 0, i)->dts_usec -=
+			1000;
+		interleaver_packet(&il, OBS_ENCODER_AUDIO, 1, i)->dts_usec -=
+			500;
+	}
+
+	interleaver_sort(&il);
+
+	for (int64_t i = 0; i < 5; i++) {
+		assert_true(interleaver_pop(&il, &packet));
+		assert_int_equal(packet.type, OBS_ENCODER_VIDEO);
+		assert_true(packet.dts_usec == i * 20);
+		assert_true(interleaver_pop(&il, &packet));
+		assert_int_equal(packet.type, OBS_ENCODER_AUDIO);
+		assert_true(packet.dts_usec == i * 20);
+	}
+
+	interleaver_free(&il);
+}
+
+/* the sorted array outputs used before the interleaver: a linear scan from
+ * the front to insert, and a memmove to take the first packet out */
+static void array_push(struct darray *array, struct encoder_packet *packet)
+{
+	DARRAY(struct encoder_packet) packets;
+	size_t idx;
+
+	packets.da = *array;
+
+	for (idx = 0; idx < packets.num; idx++) {
+		struct encoder_packet *cur = packets.array + idx;
+
+		if (packet->dts_usec == cur->dts_usec &&
+		    packet->type == OBS_ENCODER_VIDEO)
+			break;
+		if (packet->dts_usec < cur->dts_usec)
+			break;
+	}
+
+	da_insert(packets, idx, packet);
+	*array = packets.da;
+}
+
+static void array_pop(struct darray *array)
+{
+	DARRAY(struct encoder_packet) packets;
+
+	packets.da = *array;
+	da_erase(packets, 0);
+	*array = packets.da;
+}
+
+/* the same arrival pattern as order_test, generated up front */
+static struct encoder_packet *bench_packets(void)
+{
+	const int64_t video_usec = 1000000 / 60;
+	const int64_t audio_usec = 1024 * 1000000LL / 48000;
+	struct encoder_packet *packets =
+		malloc(BENCH_PACKETS * sizeof(*packets));
+	size_t next[AUDIO_TRACKS + 1] = {0};
+
+	srand(1234);
+
+	for (size_t i = 0; i < BENCH_PACKETS; i++) {
+		size_t track = (size_t)rand() % (AUDIO_TRACKS + 1);
+
+		/* keep every track within a few packets of real time */
+		int64_t dts = track ? (int64_t)next[track] * audio_usec
+				    : (int64_t)next[0] * video_usec;
+		for (size_t t = 0; t <= AUDIO_TRACKS; t++) {
+			int64_t other = t ? (int64_t)next[t] * audio_usec
+					  : (int64_t)next[0] * video_usec;
+			if (other + 100000 < dts) {
+				track = t;
+				dts = other;
+			}
+		}
+
+		packets[i] = make_packet(track ? OBS_ENCODER_AUDIO
+					       : OBS_ENCODER_VIDEO,
+					 track ? track - 1 : 0, dts);
+		next[track]++;
+	}
+
+	return packets;
+}
+
+static void bench_backlog(const struct encoder_packet *packets,
+			  size_t backlog)
+{
+	DARRAY(struct encoder_packet) array = {0};
+	struct interleaver il = {0};
+	struct encoder_packet out;
+	uint64_t start, array_ns, il_ns;
+
+	start = os_gettime_ns();
+	for (size_t i = 0; i < BENCH_PACKETS; i++) {
+		array_push(&array.da, (struct encoder_packet *)&packets[i]);
+		if (array.num > backlog)
+			array_pop(&array.da);
+	}
+	array_ns = os_gettime_ns() - start;
+
+	start = os_gettime_ns();
+	for (size_t i = 0; i < BENCH_PACKETS; i++) {
+		interleaver_push(&il, &packets[i]);
+		if (i >= backlog)
+			interleaver_pop(&il, &out);
+	}
+	il_ns = os_gettime_ns() - start;
+
+	print_message("backlog %zu, per packet: sorted array %.1f ns, "
+		      "interleaver %.1f ns\n",
+		      backlog, (double)array_ns / BENCH_PACKETS,
+		      (double)il_ns / BENCH_PACKETS);
+
+	da_free(array);
+	interleaver_free(&il);
+}
+
+static void interleave_benchmark(void **state)
+{
+	struct encoder_packet *packets = bench_packets();
+
+	bench_backlog(packets, BENCH_SHORT_BACKLOG);
+	bench_backlog(packets, BENCH_LONG_BACKLOG);
+
+	free(packets);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(order_test),
+		cmocka_unit_test(tie_test),
+		cmocka_unit_test(discard_test),
+		cmocka_unit_test(sort_test),
+		cmocka_unit_test(interleave_benchmark),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,382 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <string.h>
+#include <cmocka.h>
+
+#include <util/circlebuf.h>
+
+#include "net-sim.h"
+#include "rate-control.h"
+
+#define SEC 1000000000ULL
+#define MSEC 1000000ULL
+
+static void net_sim_test(void **state)
+{
+	struct net_sim sim;
+
+	/* 1000 bytes per second, 500 bytes fit */
+	net_sim_init(&sim, 0, 1000, 500, 20 * MSEC);
+
+	assert_true(net_sim_send(&sim, 0, 500) == 0);
+	assert_true(net_sim_rtt(&sim, 0) == 520 * MSEC);
+
+	/* has to wait for all of it to go out */
+	assert_true(net_sim_send(&sim, 0, 500) == 500 * MSEC);
+	assert_true(net_sim_rtt(&sim, 500 * MSEC) == 520 * MSEC);
+
+	/* drained a bit meanwhile */
+	assert_true(net_sim_send(&sim, 750 * MSEC, 400) == 900 * MSEC);
+
+	/* bigger than the buffer, waits until it is empty */
+	net_sim_init(&sim, 0, 1000, 500, 0);
+	net_sim_send(&sim, 0, 100);
+	assert_true(net_sim_send(&sim, 0, 800) == 100 * MSEC);
+
+	/* slower from 1 s on: 200 bytes out at the old rate, the rest at the
+	 * new one */
+	net_sim_init(&sim, 0, 1000, 5000, 0);
+	net_sim_send(&sim, 800 * MSEC, 500);
+	net_sim_set_rate(&sim, 1 * SEC, 100);
+	assert_true(net_sim_rtt(&sim, 1 * SEC) == 3 * SEC);
+	assert_true(net_sim_rtt(&sim, 2 * SEC) == 2 * SEC);
+
+	/* no rate, no limit */
+	memset(&sim, 0, sizeof(sim));
+	assert_true(net_sim_send(&sim, 5, 1000000) == 5);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Streams to a simulated link the way rtmp-stream does: the encoder queues
+ * a frame every 1/30 s, a sender takes them out one at a time and blocks
+ * on the link, and the controller gets a sample for every frame sent and an
+ * update for every frame queued.  Every second GOP starts with a keyframe
+ * ten times the size of the other frames. */
+
+#define FPS 30
+#define FRAME (SEC / FPS)
+#define GOP (2 * FPS)
+#define KEYFRAME_WEIGHT 10
+#define AUDIO_BITRATE 160
+#define DROP_THRESHOLD (700 * MSEC)
+#define SETTLED (500 * MSEC)
+
+struct scenario {
+	long orig_bitrate;
+	long link_bitrate; /* kbps, audio and overhead included */
+	long low_bitrate;
+	uint64_t low_at;
+	uint64_t restore_at;
+	uint64_t end;
+	uint64_t base_rtt;
+	size_t buffer_size;
+};
+
+struct result {
+	uint64_t max_delay;
+	uint64_t recovery; /* from the drop until frames wait less than
+			    * SETTLED for good */
+	uint64_t restore;  /* from the link coming back until the bitrate is
+			    * back to the original, 0 if it never is */
+	long low_avg;      /* video bitrate while the link is slow */
+	int late;          /* frames that would have been dropped */
+	int dropped;       /* frames the controller asked to drop */
+	int changes;       /* encoder bitrate changes */
+};
+
+struct sim_frame {
+	uint64_t ts;
+	size_t size;
+	bool keyframe;
+};
+
+static size_t frame_size(long bitrate, int idx)
+{
+	size_t gop_bytes = (size_t)bitrate * 1000 / 8 * GOP / FPS;
+	size_t unit = gop_bytes / (KEYFRAME_WEIGHT + GOP - 1);
+	size_t audio = AUDIO_BITRATE * 1000 / 8 / FPS;
+
+	return (idx % GOP == 0 ? unit * KEYFRAME_WEIGHT : unit) + audio;
+}
+
+static void drop_queued_frames(struct circlebuf *queue, int *dropped)
+{
+	struct circlebuf kept = {0};
+
+	while (queue->size) {
+		struct sim_frame frame;
+		circlebuf_pop_front(queue, &frame, sizeof(frame));
+
+		if (frame.keyframe)
+			circlebuf_push_back(&kept, &frame, sizeof(frame));
+		else
+			(*dropped)++;
+	}
+
+	circlebuf_free(queue);
+	*queue = kept;
+}
+
+static void simulate(const struct rate_control_info *info,
+		     const struct scenario *sc, struct result *res)
+{
+	struct rate_control_config config = {
+		.orig_bitrate = sc->orig_bitrate,
+		.audio_bitrate = AUDIO_BITRATE,
+		.floor_bitrate = sc->orig_bitrate / 2,
+		.fast = true,
+	};
+	struct circlebuf queue = {0};
+	struct net_sim net;
+	struct rate_control rc;
+	uint64_t sender_time = 0;
+	uint64_t rtt_time = 0;
+	uint64_t last_late = 0;
+	uint64_t low_sum = 0;
+	int low_frames = 0;
+	long bitrate = sc->orig_bitrate;
+	bool low = false, restored = false;
+
+	memset(res, 0, sizeof(*res));
+	rate_control_create(&rc, info, &config);
+	net_sim_init(&net, 0, (uint64_t)sc->link_bitrate * 1000 / 8,
+		     sc->buffer_size, sc->base_rtt);
+
+	for (int i = 0; (uint64_t)i * FRAME < sc->end; i++) {
+		uint64_t now = (uint64_t)i * FRAME;
+		struct sim_frame frame;
+		int64_t buffer_usec = 0;
+		bool drop = false;
+
+		if (!low && sc->low_at && now >= sc->low_at) {
+			net_sim_set_rate(&net, now,
+					 (uint64_t)sc->low_bitrate * 1000 / 8);
+			low = true;
+		}
+		if (!restored && sc->restore_at && now >= sc->restore_at) {
+			net_sim_set_rate(&net, now,
+					 (uint64_t)sc->link_bitrate * 1000 / 8);
+			restored = true;
+		}
+
+		/* sender */
+		while (queue.size && sender_time <= now) {
+			struct rate_sample sample;
+
+			circlebuf_pop_front(&queue, &frame, sizeof(frame));
+
+			sample.send_beg = frame.ts > sender_time ? frame.ts
+								 : sender_time;
+			sample.send_end =
+				net_sim_send(&net, sample.send_beg, frame.size);
+			sample.size = frame.size;
+			sample.rtt = 0;
+			if (!rtt_time || sample.send_end - rtt_time >=
+						 RATE_CONTROL_RTT_INTERVAL) {
+				sample.rtt = net_sim_rtt(&net, sample.send_end);
+				rtt_time = sample.send_end;
+			}
+			info->sample(rc.data, &sample);
+
+			uint64_t delay = sample.send_beg - frame.ts;
+			if (delay > res->max_delay)
+				res->max_delay = delay;
+			if (delay > DROP_THRESHOLD)
+				res->late++;
+			if (delay > SETTLED)
+				last_late = sample.send_beg;
+
+			sender_time = sample.send_end;
+		}
+
+		/* encoder */
+		frame.ts = now;
+		frame.size = frame_size(bitrate, i);
+		frame.keyframe = i % GOP == 0;
+		circlebuf_push_back(&queue, &frame, sizeof(frame));
+
+		if (queue.size / sizeof(frame) >= 5) {
+			struct sim_frame *first = circlebuf_data(&queue, 0);
+			buffer_usec = (int64_t)(now - first->ts) / 1000;
+		}
+
+		long new_bitrate = info->update(rc.data, now, buffer_usec,
+						&drop);
+		if (new_bitrate != bitrate) {
+			bitrate = new_bitrate;
+			res->changes++;
+		}
+
+		if (drop && (uint64_t)buffer_usec * 1000 > DROP_THRESHOLD)
+			drop_queued_frames(&queue, &res->dropped);
+
+		if (low && !restored) {
+			low_sum += (uint64_t)bitrate;
+			low_frames++;
+		}
+		if (restored && !res->restore &&
+		    bitrate == sc->orig_bitrate)
+			res->restore = now - sc->restore_at + 1;
+	}
+
+	if (sc->low_at && last_late > sc->low_at)
+		res->recovery = last_late - sc->low_at;
+	if (low_frames)
+		res->low_avg = (long)(low_sum / (uint64_t)low_frames);
+
+	rate_control_destroy(&rc);
+	circlebuf_free(&queue);
+}
+
+static void print_result(const char *name,
+			 const struct rate_control_info *info,
+			 const struct result *res)
+{
+	printf("%-10s %-8s max delay %5d ms, recovery %5d ms, "
+	       "restore %5d ms, low avg %5ld kbps, late %4d, dropped %4d, "
+	       "changes %3d\n",
+	       name, info->id, (int)(res->max_delay / MSEC),
+	       (int)(res->recovery / MSEC), (int)(res->restore / MSEC),
+	       res->low_avg, res->late, res->dropped, res->changes);
+}
+
+static const struct rate_control_info *controllers[] = {
+	&rate_control_default,
+	&rate_control_bbr,
+};
+
+#define NUM_CONTROLLERS (sizeof(controllers) / sizeof(*controllers))
+
+static void steady_link_test(void **state)
+{
+	struct scenario sc = {
+		.orig_bitrate = 4000,
+		.link_bitrate = 8000,
+		.end = 120 * SEC,
+		.base_rtt = 40 * MSEC,
+		.buffer_size = 256 * 1024,
+	};
+
+	for (size_t i = 0; i < NUM_CONTROLLERS; i++) {
+		struct result res;
+
+		simulate(controllers[i], &sc, &res);
+		print_result("steady", controllers[i], &res);
+
+		/* plenty of bandwidth, nothing to do */
+		assert_int_equal(res.changes, 0);
+		assert_int_equal(res.late, 0);
+		assert_true(res.max_delay < SETTLED);
+	}
+}
+
+static void bandwidth_drop_test(void **state)
+{
+	struct scenario sc = {
+		.orig_bitrate = 5000,
+		.link_bitrate = 7000,
+		.low_bitrate = 3500,
+		.low_at = 20 * SEC,
+		.restore_at = 80 * SEC,
+		.end = 180 * SEC,
+		.base_rtt = 40 * MSEC,
+		.buffer_size = 256 * 1024,
+	};
+
+	for (size_t i = 0; i < NUM_CONTROLLERS; i++) {
+		struct result res;
+
+		simulate(controllers[i], &sc, &res);
+		print_result("drop", controllers[i], &res);
+
+		/* settles around what the link can take */
+		assert_true(res.recovery < 20 * SEC);
+		assert_true(res.low_avg < sc.low_bitrate);
+		assert_true(res.low_avg >= sc.orig_bitrate / 2);
+
+		/* goes by the round trip time before the buffer fills up */
+		if (controllers[i] == &rate_control_bbr)
+			assert_int_equal(res.late, 0);
+
+		/* and goes back up once the link is fast again */
+		assert_true(res.restore > 0);
+		assert_true(res.restore < 60 * SEC);
+	}
+}
+
+static void deep_drop_test(void **state)
+{
+	/* the link ends up below the floor, so frames have to go */
+	struct scenario sc = {
+		.orig_bitrate = 6000,
+		.link_bitrate = 8000,
+		.low_bitrate = 2000,
+		.low_at = 10 * SEC,
+		.restore_at = 60 * SEC,
+		.end = 150 * SEC,
+		.base_rtt = 80 * MSEC,
+		.buffer_size = 512 * 1024,
+	};
+	struct result res[NUM_CONTROLLERS];
+
+	for (size_t i = 0; i < NUM_CONTROLLERS; i++) {
+		simulate(controllers[i], &sc, &res[i]);
+		print_result("deep drop", controllers[i], &res[i]);
+
+		assert_true(res[i].dropped > 0);
+		assert_true(res[i].low_avg < sc.orig_bitrate * 55 / 100);
+		assert_true(res[i].restore > 0);
+	}
+
+	/* below the floor only dropping frames helps, so the queue goes up
+	 * to the drop threshold either way and neither settles before the
+	 * link is back.  Going by the round trip time, bbr gets there with
+	 * fewer late frames. */
+	assert_true(res[1].late < res[0].late);
+}
+
+static void deterministic_test(void **state)
+{
+	struct scenario sc = {
+		.orig_bitrate = 5000,
+		.link_bitrate = 7000,
+		.low_bitrate = 3000,
+		.low_at = 10 * SEC,
+		.restore_at = 40 * SEC,
+		.end = 90 * SEC,
+		.base_rtt = 30 * MSEC,
+		.buffer_size = 128 * 1024,
+	};
+
+	for (size_t i = 0; i < NUM_CONTROLLERS; i++) {
+		struct result a, b;
+
+		simulate(controllers[i], &sc, &a);
+		simulate(controllers[i], &sc, &b);
+		assert_memory_equal(&a, &b, sizeof(a));
+	}
+}
+
+static void find_test(void **state)
+{
+	assert_ptr_equal(rate_control_find("bbr"), &rate_control_bbr);
+	assert_ptr_equal(rate_control_find("default"), &rate_control_default);
+	assert_ptr_equal(rate_control_find("unknown"), &rate_control_default);
+	assert_ptr_equal(rate_control_find(NULL), &rate_control_default);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(net_sim_test),
+		cmocka_unit_test(steady_link_test),
+		cmocka_unit_test(bandwidth_drop_test),
+		cmocka_unit_test(deep_drop_test),
+		cmocka_unit_test(deterministic_test),
+		cmocka_unit_test(find_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,186 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <string.h>
+#include <cmocka.h>
+
+#include <util/platform.h>
+#include "obs-ffmpeg-replay-segment.h"
+
+#define NUM_PACKETS 50
+
+static void fill(uint8_t *data, size_t size, uint8_t seed)
+{
+	for (size_t i = 0; i < size; i++)
+		data[i] = (uint8_t)(seed + i * 7);
+}
+
+static size_t count_files(const char *dir)
+{
+	os_dir_t *d = os_opendir(dir);
+	struct os_dirent *ent;
+	size_t count = 0;
+
+	if (!d)
+		return 0;
+
+	while ((ent = os_readdir(d)) != NULL) {
+		if (!ent->directory)
+			count++;
+	}
+
+	os_closedir(d);
+	return count;
+}
+
+static void segment_test(void **state)
+{
+	struct encoder_packet packets[NUM_PACKETS] = {0};
+	size_t total = 0;
+	char dir[] = "replay-segment-test";
+
+	os_mkdir(dir);
+
+	for (size_t i = 0; i < NUM_PACKETS; i++) {
+		size_t size = 100 + (i * 397) % 5000;
+
+		packets[i].data = bmalloc(size);
+		packets[i].size = size;
+		packets[i].pts = (int64_t)i;
+		packets[i].dts = (int64_t)i - 1;
+		packets[i].type = i % 3 ? OBS_ENCODER_AUDIO : OBS_ENCODER_VIDEO;
+		packets[i].keyframe = i == 0;
+		packets[i].track_idx = i % 3;
+		fill(packets[i].data, size, (uint8_t)i);
+		total += size;
+	}
+
+	struct replay_segment *segment =
+		replay_segment_create(dir, packets, NUM_PACKETS);
+	assert_non_null(segment);
+
+	/* the file is gone once it is mapped */
+	assert_int_equal(count_files(dir), 0);
+
+	/* the segment does not depend on the original data */
+	for (size_t i = 0; i < NUM_PACKETS; i++)
+		fill(packets[i].data, packets[i].size, 0xFF);
+
+	replay_segment_addref(segment);
+	replay_segment_release(segment);
+
+	assert_int_equal(replay_segment_num_packets(segment), NUM_PACKETS);
+	assert_int_equal(replay_segment_size(segment), total);
+
+	for (size_t i = 0; i < NUM_PACKETS; i++) {
+		const struct encoder_packet *pkt =
+			replay_segment_packet(segment, i);
+		uint8_t *expected = bmalloc(packets[i].size);
+
+		fill(expected, packets[i].size, (uint8_t)i);
+
+		assert_int_equal(pkt->size, packets[i].size);
+		assert_true(pkt->pts == packets[i].pts);
+		assert_true(pkt->dts == packets[i].dts);
+		assert_int_equal(pkt->type, packets[i].type);
+		assert_int_equal(pkt->keyframe, packets[i].keyframe);
+		assert_int_equal(pkt->track_idx, packets[i].track_idx);
+		assert_memory_equal(pkt->data, expected, pkt->size);
+
+		bfree(expected);
+	}
+
+	replay_segment_release(segment);
+
+	for (size_t i = 0; i < NUM_PACKETS; i++)
+		bfree(packets[i].data);
+
+	assert_int_equal(count_files(dir), 0);
+	os_rmdir(dir);
+}
+
+/* packet data with the reference count in front, the way libobs hands out
+ * encoder packets */
+static uint8_t *alloc_packet_data(size_t size)
+{
+	long *refs = bmalloc(sizeof(long) + size);
+	*refs = 1;
+	return (uint8_t *)(refs + 1);
+}
+
+static void memory_segment_test(void **state)
+{
+	struct encoder_packet packets[NUM_PACKETS] = {0};
+	long allocs = bnum_allocs();
+	size_t total = 0;
+
+	for (size_t i = 0; i < NUM_PACKETS; i++) {
+		size_t size = 100 + (i * 397) % 5000;
+
+		packets[i].data = alloc_packet_data(size);
+		packets[i].size = size;
+		packets[i].pts = (int64_t)i;
+		fill(packets[i].data, size, (uint8_t)i);
+		total += size;
+	}
+
+	/* the segment owns the packet references from here on */
+	struct replay_segment *segment =
+		replay_segment_create_memory(packets, NUM_PACKETS);
+
+	assert_false(replay_segment_on_disk(segment));
+	assert_int_equal(replay_segment_num_packets(segment), NUM_PACKETS);
+	assert_int_equal(replay_segment_size(segment), total);
+
+	for (size_t i = 0; i < NUM_PACKETS; i++) {
+		const struct encoder_packet *pkt =
+			replay_segment_packet(segment, i);
+		assert_ptr_equal(pkt->data, packets[i].data);
+		assert_true(pkt->pts == packets[i].pts);
+	}
+
+	/* writing it out leaves the memory segment untouched */
+	char dir[] = "replay-segment-test";
+	os_mkdir(dir);
+
+	struct replay_segment *disk = replay_segment_create(
+		dir, replay_segment_packet(segment, 0), NUM_PACKETS);
+	assert_non_null(disk);
+	assert_true(replay_segment_on_disk(disk));
+
+	for (size_t i = 0; i < NUM_PACKETS; i++) {
+		const struct encoder_packet *pkt =
+			replay_segment_packet(disk, i);
+		assert_memory_equal(pkt->data, packets[i].data, pkt->size);
+	}
+
+	replay_segment_release(disk);
+	os_rmdir(dir);
+
+	replay_segment_release(segment);
+	assert_int_equal(bnum_allocs(), allocs);
+}
+
+static void failure_test(void **state)
+{
+	uint8_t data[16] = {0};
+	struct encoder_packet packet = {.data = data, .size = sizeof(data)};
+
+	assert_null(replay_segment_create("replay-segment-does-not-exist",
+					  &packet, 1));
+
+	/* nothing to write */
+	packet.size = 0;
+	assert_null(replay_segment_create(".", &packet, 1));
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(segment_test),
+		cmocka_unit_test(memory_segment_test),
+		cmocka_unit_test(failure_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,199 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <string.h>
+#include <cmocka.h>
+
+#include <media-io/video-io.h>
+#include <media-io/video-frame.h>
+#include <util/threading.h>
+
+#define WIDTH 16
+#define HEIGHT 16
+
+static const struct video_output_info test_info = {
+	.name = "test",
+	.format = VIDEO_FORMAT_BGRA,
+	.fps_num = 30,
+	.fps_den = 1,
+	.width = WIDTH,
+	.height = HEIGHT,
+	.cache_size = 2,
+};
+
+struct pin_data {
+	os_event_t *received;
+	struct video_buffer *pinned;
+	uint8_t *pinned_data;
+};
+
+static void pin_first_frame(void *param, struct video_data *frame)
+{
+	struct pin_data *pin = param;
+
+	if (!pin->pinned) {
+		struct video_buffer *buffer = video_data_get_buffer(frame);
+
+		assert_non_null(buffer);
+		video_buffer_addref(buffer);
+		pin->pinned = buffer;
+		pin->pinned_data = frame->data[0];
+	}
+
+	os_event_signal(pin->received);
+}
+
+static void output_frame(video_t *video, struct pin_data *pin, uint8_t value,
+			 uint64_t timestamp)
+{
+	struct video_frame frame;
+
+	assert_true(video_output_lock_frame(video, &frame, 1, timestamp));
+	memset(frame.data[0], value, frame.linesize[0] * HEIGHT);
+	video_output_unlock_frame(video);
+
+	os_event_wait(pin->received);
+}
+
+static void pinned_frame_test(void **state)
+{
+	struct video_output_info info = test_info;
+	struct pin_data pin = {0};
+	video_t *video;
+
+	assert_int_equal(video_output_open(&video, &info),
+			 VIDEO_OUTPUT_SUCCESS);
+	assert_int_equal(os_event_init(&pin.received, OS_EVENT_TYPE_AUTO), 0);
+	assert_true(video_output_connect(video, NULL, pin_first_frame, &pin));
+
+	/* the cache only has two slots, so without the reference the first
+	 * frame would have been written over several times */
+	for (int i = 0; i < 8; i++)
+		output_frame(video, &pin, (uint8_t)(0x10 + i), i);
+
+	for (size_t i = 0; i < WIDTH * 4 * HEIGHT; i++)
+		assert_int_equal(pin.pinned_data[i], 0x10);
+
+	video_output_disconnect(video, pin_first_frame, &pin);
+	video_output_close(video);
+
+	/* the frame stays valid after its output is gone */
+	assert_int_equal(pin.pinned_data[0], 0x10);
+	video_buffer_release(pin.pinned);
+
+	os_event_destroy(pin.received);
+}
+
+struct input_data {
+	os_event_t *entered;
+	os_event_t *release;
+	video_t *video;
+};
+
+static void fast_input(void *param, struct video_data *frame)
+{
+	struct input_data *data = param;
+	os_event_signal(data->entered);
+}
+
+static void slow_input(void *param, struct video_data *frame)
+{
+	struct input_data *data = param;
+	os_event_signal(data->entered);
+	os_event_wait(data->release);
+}
+
+static void slow_input_test(void **state)
+{
+	struct video_output_info info = test_info;
+	struct input_data fast = {0};
+	struct input_data slow = {0};
+	uint32_t total, skipped;
+	video_t *video;
+
+	assert_int_equal(video_output_open(&video, &info),
+			 VIDEO_OUTPUT_SUCCESS);
+	os_event_init(&fast.entered, OS_EVENT_TYPE_AUTO);
+	os_event_init(&slow.entered, OS_EVENT_TYPE_AUTO);
+	os_event_init(&slow.release, OS_EVENT_TYPE_MANUAL);
+
+	assert_true(video_output_connect(video, NULL, fast_input, &fast));
+	assert_true(video_output_connect(video, NULL, slow_input, &slow));
+
+	for (int i = 0; i < 10; i++) {
+		struct video_frame frame;
+
+		assert_true(video_output_lock_frame(video, &frame, 1, i));
+		video_output_unlock_frame(video);
+
+		os_event_wait(fast.entered);
+		if (i == 0)
+			os_event_wait(slow.entered);
+	}
+
+	/* the slow input is stuck on the first frame with a full queue, the
+	 * fast one must not have lost anything because of it */
+	assert_true(video_output_get_input_frames(video, fast_input, &fast,
+						  &total, &skipped));
+	assert_int_equal(total, 10);
+	assert_int_equal(skipped, 0);
+
+	assert_true(video_output_get_input_frames(video, slow_input, &slow,
+						  &total, &skipped));
+	assert_int_equal(total, 10);
+	assert_int_equal(skipped, 10 - 1 - info.cache_size);
+
+	/* every frame was produced, the output itself skipped none */
+	assert_int_equal(video_output_get_skipped_frames(video), 0);
+
+	os_event_signal(slow.release);
+	video_output_disconnect(video, slow_input, &slow);
+	video_output_disconnect(video, fast_input, &fast);
+	video_output_close(video);
+
+	os_event_destroy(fast.entered);
+	os_event_destroy(slow.entered);
+	os_event_destroy(slow.release);
+}
+
+static void disconnect_self(void *param, struct video_data *frame)
+{
+	struct input_data *data = param;
+	video_output_disconnect(data->video, disconnect_self, data);
+	os_event_signal(data->entered);
+}
+
+static void disconnect_from_callback_test(void **state)
+{
+	struct video_output_info info = test_info;
+	struct input_data data = {0};
+	struct video_frame frame;
+
+	assert_int_equal(video_output_open(&data.video, &info),
+			 VIDEO_OUTPUT_SUCCESS);
+	os_event_init(&data.entered, OS_EVENT_TYPE_AUTO);
+
+	assert_true(video_output_connect(data.video, NULL, disconnect_self,
+					 &data));
+
+	assert_true(video_output_lock_frame(data.video, &frame, 1, 0));
+	video_output_unlock_frame(data.video);
+	os_event_wait(data.entered);
+
+	assert_false(video_output_get_input_frames(
+		data.video, disconnect_self, &data, NULL, NULL));
+
+	video_output_close(data.video);
+	os_event_destroy(data.entered);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(pinned_frame_test),
+		cmocka_unit_test(slow_input_test),
+		cmocka_unit_test(disconnect_from_callback_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}